@@ -0,0 +1,460 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <ostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "FrameChangeDetector.h"
+#include "FrameSource.h"
+#include "OcrJitter.h"
+#include "OcrPreprocessor.h"
+#include "VocabularyShortlist.h"
+
+// --- Benchmark Harness ---
+
+// Calls `fn` once to warm up, then repeatedly until `min_duration` has elapsed.
+// Returns the mean wall time per call in seconds.
+template <class Fn>
+double MeasureSecondsPerCall(Fn&& fn, std::chrono::milliseconds min_duration = std::chrono::milliseconds(500)) {
+    using clock = std::chrono::steady_clock;
+    fn();
+    size_t calls = 0;
+    auto start = clock::now();
+    clock::duration elapsed{};
+    do {
+        fn();
+        ++calls;
+        elapsed = clock::now() - start;
+    } while (elapsed < min_duration);
+    return std::chrono::duration<double>(elapsed).count() / static_cast<double>(calls);
+}
+
+// For string values in JSON reports and traces. Control characters become spaces.
+inline std::string JsonEscape(std::string_view text) {
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            escaped += ' ';
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+// Nearest-rank percentile (q in [0, 1]) of unsorted samples; 0 for an empty set.
+inline double Percentile(std::vector<double> samples, double q) {
+    if (samples.empty()) return 0.0;
+    size_t rank = static_cast<size_t>(q * static_cast<double>(samples.size() - 1) + 0.5);
+    std::nth_element(samples.begin(), samples.begin() + static_cast<std::ptrdiff_t>(rank), samples.end());
+    return samples[rank];
+}
+
+// Dark BGRA background with short bright horizontal strokes, roughly the texture of UI text.
+inline std::vector<uint8_t> MakeSyntheticFrame(int width, int height, uint32_t seed) {
+    std::vector<uint8_t> frame(static_cast<size_t>(width) * height * 4, 0);
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> x_dist(0, width - 1), y_dist(0, height - 1), len_dist(4, 64);
+    size_t strokes = static_cast<size_t>(width) * height / 200;
+    for (size_t i = 0; i < strokes; ++i) {
+        int x = x_dist(rng), y = y_dist(rng), length = len_dist(rng);
+        uint8_t shade = static_cast<uint8_t>(128 + rng() % 128);
+        for (int dx = 0; dx < length && x + dx < width; ++dx) {
+            uint8_t* pixel = frame.data() + (static_cast<size_t>(y) * width + x + dx) * 4;
+            pixel[0] = pixel[1] = pixel[2] = shade;
+            pixel[3] = 255;
+        }
+    }
+    return frame;
+}
+
+// --- Frame Change Detector Benchmark ---
+
+// Hashes alternating synthetic frames (so every update sees a small change) at common
+// capture sizes, once per available hash kernel.
+inline void RunFrameChangeDetectorBenchmark(std::ostream& out) {
+    struct Resolution { int width, height; };
+    const Resolution resolutions[] = { { 1280, 720 }, { 1920, 1080 }, { 2560, 1440 }, { 3840, 2160 } };
+
+    std::vector<frame_hash::Kernel> kernels = { frame_hash::Kernel::Scalar };
+#ifdef OSL_HAS_X86_SIMD
+    kernels.push_back(frame_hash::Kernel::Sse2);
+    if (frame_hash::CpuSupportsAvx2()) kernels.push_back(frame_hash::Kernel::Avx2);
+#endif
+
+    out << "benchmark\tresolution\tkernel\tms_per_frame\tgb_per_s\tchanged_tiles\n";
+    for (const auto& resolution : resolutions) {
+        auto frame_a = MakeSyntheticFrame(resolution.width, resolution.height, 1);
+        auto frame_b = frame_a;
+        // A caret-sized change in the middle of the frame.
+        for (int y = resolution.height / 2; y < resolution.height / 2 + 20; ++y) {
+            frame_b[(static_cast<size_t>(y) * resolution.width + resolution.width / 2) * 4] ^= 0xFF;
+        }
+        size_t stride = static_cast<size_t>(resolution.width) * 4;
+        double bytes = static_cast<double>(stride) * resolution.height;
+
+        for (auto kernel : kernels) {
+            FrameChangeDetector detector(32, kernel);
+            bool flip = false;
+            size_t changed_tiles = 0;
+            double seconds = MeasureSecondsPerCall([&] {
+                flip = !flip;
+                changed_tiles = detector.Update((flip ? frame_a : frame_b).data(),
+                    resolution.width, resolution.height, stride).changed_tiles;
+            });
+            out << "frame_change\t" << resolution.width << 'x' << resolution.height << '\t'
+                << frame_hash::KernelName(kernel) << '\t' << seconds * 1e3 << '\t'
+                << bytes / seconds / 1e9 << '\t' << changed_tiles << '\n';
+        }
+    }
+}
+
+// --- Replay Benchmark ---
+
+// Writes a synthetic session to replay where no recorded one is at hand: `frames` frames, 100 ms
+// apart, of a static screen on which one line of text is redrawn every tenth frame and a small
+// caret blinks every other frame.
+inline bool WriteSyntheticRecording(const std::filesystem::path& path, int width, int height, int frames) {
+    FrameRecorder recorder;
+    if (!recorder.Open(path)) return false;
+    auto pixels = MakeSyntheticFrame(width, height, 1);
+    const size_t stride = static_cast<size_t>(width) * 4;
+    const int line_top = height * 3 / 4, line_height = (std::min)(24, height - line_top);
+    const int caret_x = width / 4, caret_y = height / 4, caret_width = (std::min)(2, width - caret_x);
+    const int caret_height = (std::min)(16, height - caret_y);
+    for (int i = 0; i < frames; ++i) {
+        if (i % 10 == 0) {
+            auto line = MakeSyntheticFrame(width / 2, line_height, static_cast<uint32_t>(i + 2));
+            for (int y = 0; y < line_height; ++y) {
+                std::memcpy(pixels.data() + static_cast<size_t>(line_top + y) * stride + static_cast<size_t>(width / 4) * 4,
+                    line.data() + static_cast<size_t>(y) * static_cast<size_t>(width / 2) * 4, static_cast<size_t>(width / 2) * 4);
+            }
+        }
+        uint8_t caret = (i % 2) ? 255 : 0;
+        for (int y = caret_y; y < caret_y + caret_height; ++y) {
+            std::memset(pixels.data() + static_cast<size_t>(y) * stride + static_cast<size_t>(caret_x) * 4, caret, static_cast<size_t>(caret_width) * 4);
+        }
+        Frame frame;
+        frame.pixels = pixels.data();
+        frame.width = width;
+        frame.height = height;
+        frame.stride = stride;
+        frame.sequence = static_cast<uint64_t>(i);
+        frame.timestamp_us = static_cast<int64_t>(i) * 100000;
+        recorder.Write(frame);
+    }
+    return true;
+}
+
+// Streams a recorded session through change detection, once per available hash kernel. Needs
+// nothing but the recording, so capture-side changes can be measured on headless machines.
+inline bool RunReplayBenchmark(const std::filesystem::path& recording, std::ostream& out,
+    int tile_size, size_t min_changed_tiles) {
+    ReplayFrameSource replay(ReplayFrameSource::Pacing::Sequential);
+    if (!replay.Open(recording) || replay.frame_count() == 0) {
+        out << "Cannot read recording: " << recording.string() << "\n";
+        return false;
+    }
+
+    std::vector<frame_hash::Kernel> kernels = { frame_hash::Kernel::Scalar };
+#ifdef OSL_HAS_X86_SIMD
+    kernels.push_back(frame_hash::Kernel::Sse2);
+    if (frame_hash::CpuSupportsAvx2()) kernels.push_back(frame_hash::Kernel::Avx2);
+#endif
+
+    double frames = static_cast<double>(replay.frame_count());
+    double bytes_per_frame = static_cast<double>(replay.width()) * replay.height() * 4;
+    out << "benchmark\tresolution\tkernel\tframes\tms_per_frame\tgb_per_s\tocr_frames\n";
+    for (auto kernel : kernels) {
+        size_t ocr_frames = 0;
+        double seconds_per_pass = MeasureSecondsPerCall([&] {
+            FrameChangeDetector detector(tile_size, kernel);
+            replay.Rewind();
+            ocr_frames = 0;
+            while (Frame frame = replay.Capture()) {
+                auto change = detector.Update(frame.pixels, frame.width, frame.height, frame.stride);
+                if (change.changed_tiles >= min_changed_tiles) ++ocr_frames;
+            }
+        });
+        double seconds = seconds_per_pass / frames;
+        out << "replay\t" << replay.width() << 'x' << replay.height() << '\t'
+            << frame_hash::KernelName(kernel) << '\t' << replay.frame_count() << '\t' << seconds * 1e3 << '\t'
+            << bytes_per_frame / seconds / 1e9 << '\t' << ocr_frames << '\n';
+    }
+    return true;
+}
+
+// --- OCR Preprocessing Benchmark ---
+
+// Geometry followed by the packed rows, for comparing preprocessor results.
+inline std::vector<uint8_t> CopyPreprocessedImage(const PreprocessedImage& image) {
+    std::vector<uint8_t> bytes;
+    bytes.reserve(5 * sizeof(int) + static_cast<size_t>(image.width) * static_cast<size_t>(image.height));
+    for (int value : { image.width, image.height, image.origin_x, image.origin_y, image.scale }) {
+        bytes.insert(bytes.end(), reinterpret_cast<const uint8_t*>(&value), reinterpret_cast<const uint8_t*>(&value) + sizeof(value));
+    }
+    for (int y = 0; y < image.height; ++y) {
+        const uint8_t* row = image.pixels + static_cast<size_t>(y) * image.stride;
+        bytes.insert(bytes.end(), row, row + image.width);
+    }
+    return bytes;
+}
+
+// Times each preprocessing kernel per capture megapixel at common capture sizes, and the whole
+// OcrPreprocessor pass at 96 and 192 DPI. SIMD outputs are compared against the scalar kernel;
+// `matches_scalar` must always be 1.
+inline void RunOcrPreprocessBenchmark(std::ostream& out) {
+    struct Resolution { int width, height; };
+    const Resolution resolutions[] = { { 1920, 1080 }, { 2560, 1440 }, { 3840, 2160 } };
+
+    std::vector<image_kernels::Kernel> kernels = { image_kernels::Kernel::Scalar };
+#ifdef OSL_HAS_X86_SIMD
+    kernels.push_back(image_kernels::Kernel::Sse2);
+    if (frame_hash::CpuSupportsAvx2()) kernels.push_back(image_kernels::Kernel::Avx2);
+#endif
+
+    out << "benchmark\tresolution\tstage\tkernel\tms_per_frame\tms_per_megapixel\tmegapixels_per_s\tmatches_scalar\n";
+    for (const auto& resolution : resolutions) {
+        int width = resolution.width, height = resolution.height;
+        auto frame = MakeSyntheticFrame(width, height, 1);
+        size_t stride = static_cast<size_t>(width) * 4;
+        double megapixels = static_cast<double>(width) * height / 1e6;
+
+        std::vector<uint8_t> reference_gray(static_cast<size_t>(width) * height);
+        std::vector<uint8_t> reference_half(static_cast<size_t>(width / 2) * (height / 2));
+        std::vector<uint16_t> reference_cells;
+        image_kernels::BgraToGray(frame.data(), stride, width, height, reference_gray.data(), static_cast<size_t>(width), image_kernels::Kernel::Scalar);
+        image_kernels::Downscale2x(reference_gray.data(), static_cast<size_t>(width), width, height,
+            reference_half.data(), static_cast<size_t>(width / 2), image_kernels::Kernel::Scalar);
+        image_kernels::CountCellEdges(reference_gray.data(), static_cast<size_t>(width), width, height, 40, reference_cells, image_kernels::Kernel::Scalar);
+
+        auto report = [&](const char* stage, image_kernels::Kernel kernel, double seconds, bool matches) {
+            out << "ocr_preprocess\t" << width << 'x' << height << '\t' << stage << '\t' << image_kernels::KernelName(kernel) << '\t'
+                << seconds * 1e3 << '\t' << seconds * 1e3 / megapixels << '\t' << megapixels / seconds << '\t' << (matches ? 1 : 0) << '\n';
+        };
+
+        for (auto kernel : kernels) {
+            std::vector<uint8_t> gray(reference_gray.size());
+            double seconds = MeasureSecondsPerCall([&] {
+                image_kernels::BgraToGray(frame.data(), stride, width, height, gray.data(), static_cast<size_t>(width), kernel);
+            });
+            report("gray", kernel, seconds, gray == reference_gray);
+
+            std::vector<uint8_t> half(reference_half.size());
+            seconds = MeasureSecondsPerCall([&] {
+                image_kernels::Downscale2x(reference_gray.data(), static_cast<size_t>(width), width, height,
+                    half.data(), static_cast<size_t>(width / 2), kernel);
+            });
+            report("downscale_2x", kernel, seconds, half == reference_half);
+
+            std::vector<uint16_t> cells;
+            seconds = MeasureSecondsPerCall([&] {
+                image_kernels::CountCellEdges(reference_gray.data(), static_cast<size_t>(width), width, height, 40, cells, kernel);
+            });
+            report("edge_cells", kernel, seconds, cells == reference_cells);
+
+            for (int dpi : { 96, 192 }) {
+                OcrPreprocessor reference({ .kernel = image_kernels::Kernel::Scalar });
+                std::vector<uint8_t> expected = CopyPreprocessedImage(reference.Process(frame.data(), width, height, stride, dpi));
+                OcrPreprocessor preprocessor({ .kernel = kernel });
+                PreprocessedImage image;
+                seconds = MeasureSecondsPerCall([&] { image = preprocessor.Process(frame.data(), width, height, stride, dpi); });
+                report(dpi == 96 ? "full_96dpi" : "full_192dpi", kernel, seconds, CopyPreprocessedImage(image) == expected);
+            }
+        }
+    }
+}
+
+// --- OCR Jitter Benchmark ---
+
+// One reading of a line as OCR might return it on a later frame: with `real` set, a word or number
+// really changed; otherwise only recognition noise (confused glyphs, punctuation, spacing).
+inline std::wstring MakeOcrReading(const std::wstring& line, bool real, std::mt19937& rng) {
+    std::wstring reading = line;
+    if (real) {
+        size_t digit = reading.find_first_of(L"0123456789");
+        if (digit != std::wstring::npos && rng() % 2) {
+            reading[digit] = static_cast<wchar_t>(L'0' + (reading[digit] - L'0' + 1 + rng() % 9) % 10);
+            return reading;
+        }
+        static const wchar_t* const replacements[] = { L"north", L"sword", L"quest", L"gold", L"door", L"ally" };
+        size_t space = reading.find(L' ', rng() % reading.size());
+        size_t word_start = space == std::wstring::npos ? 0 : space + 1;
+        size_t word_end = reading.find(L' ', word_start);
+        if (word_end == std::wstring::npos) word_end = reading.size();
+        std::wstring_view replacement = replacements[rng() % std::size(replacements)];
+        if (NormalizeOcrLine(reading.substr(word_start, word_end - word_start)) == replacement) replacement = L"river";
+        reading.replace(word_start, word_end - word_start, replacement);
+        return reading;
+    }
+    int edits = 1 + static_cast<int>(rng() % 2);
+    for (int i = 0; i < edits; ++i) {
+        size_t at = rng() % reading.size();
+        switch (rng() % 5) {
+        case 0: // glyphs OCR folds together
+            for (size_t k = 0; k < reading.size(); ++k) {
+                wchar_t& c = reading[(at + k) % reading.size()];
+                if (c == L'l') { c = L'I'; break; }
+                if (c == L'I') { c = L'l'; break; }
+                if (c == L'O') { c = L'0'; break; }
+            }
+            break;
+        case 1: // glyphs it doesn't: m read as rn, d as cl, e as c
+            if (size_t k = reading.find_first_of(L"mde", at); k != std::wstring::npos) {
+                reading.replace(k, 1, reading[k] == L'm' ? L"rn" : reading[k] == L'd' ? L"cl" : L"c");
+            }
+            break;
+        case 2: // punctuation lost
+            if (size_t mark = reading.find_first_of(L".,:!?"); mark != std::wstring::npos) reading.erase(mark, 1);
+            break;
+        case 3: // punctuation picked up from a nearby glyph
+            reading.insert(at, 1, L'.');
+            break;
+        default: // spacing
+            if (size_t space = reading.find(L' ', at); space != std::wstring::npos) reading.insert(space, 1, L' ');
+            break;
+        }
+    }
+    return reading;
+}
+
+// Times the edit-distance kernels on string pairs a few percent apart, at line to paragraph lengths
+// (`matches_reference` must be 1), then runs a synthetic OCR trace of game and UI lines through the
+// jitter filter: noisy readings it lets through would each have cost a translation, and real
+// changes it holds back would leave a stale one on screen.
+inline void RunOcrJitterBenchmark(std::ostream& out) {
+    std::mt19937 rng(1);
+    out << "benchmark\tlength\tkernel\tus_per_pair\tmatches_reference\n";
+    for (size_t length : { 16, 64, 256, 1024, 4096 }) {
+        std::wstring a(length, L' ');
+        for (auto& c : a) c = static_cast<wchar_t>(L'a' + rng() % 26);
+        std::wstring b = a;
+        for (size_t edit = 0; edit < (std::max)(length / 20, size_t{ 1 }); ++edit) b[rng() % length] = static_cast<wchar_t>(L'a' + rng() % 26);
+        size_t reference = edit_distance::DynamicProgramming(a, b);
+        for (auto kernel : { edit_distance::Kernel::DynamicProgramming, edit_distance::Kernel::BitParallel }) {
+            size_t distance = 0;
+            double seconds = MeasureSecondsPerCall([&] { distance = edit_distance::Levenshtein(a, b, kernel); },
+                std::chrono::milliseconds(200));
+            out << "edit_distance\t" << length << '\t' << edit_distance::KernelName(kernel) << '\t' << seconds * 1e6 << '\t'
+                << (distance == reference ? 1 : 0) << '\n';
+        }
+    }
+
+    const std::wstring lines[] = {
+        L"Quest updated: Find the lost sword in the Old Mill.",
+        L"Gold: 1250   Level 14   HP 320/450",
+        L"Press E to open the door.",
+        L"Do you want to save your progress before leaving?",
+        L"The merchant will return at dawn. Until then, the gates stay closed.",
+        L"Settings > Display > Resolution: 1920 x 1080",
+        L"Loading... 45%",
+        L"I told you, the bridge is out! We need another way across the river.",
+    };
+    constexpr int READINGS = 20000;
+    for (double threshold : { 0.0, 0.05, 0.1, 0.2 }) {
+        OcrJitterFilter filter(threshold);
+        size_t noisy = 0, noisy_passed = 0, real = 0, real_held = 0;
+        rng.seed(2);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < READINGS; ++i) {
+            const auto& line = lines[rng() % std::size(lines)];
+            bool is_real = rng() % 4 == 0;
+            auto reading = MakeOcrReading(line, is_real, rng);
+            bool same = filter.SameLine(line, reading);
+            if (is_real) {
+                ++real;
+                real_held += same ? 1 : 0;
+            } else {
+                ++noisy;
+                noisy_passed += same ? 0 : 1;
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (threshold == 0.0) {
+            out << "\nbenchmark\tthreshold\treadings\tnoisy\tnoisy_passed\ttranslations_avoided\treal\treal_held\tus_per_reading\n";
+        }
+        out << "ocr_jitter_trace\t" << threshold << '\t' << READINGS << '\t' << noisy << '\t' << noisy_passed << '\t'
+            << noisy - noisy_passed << '\t' << real << '\t' << real_held << '\t' << seconds / READINGS * 1e6 << '\n';
+    }
+}
+
+// --- Vocabulary Shortlist Benchmark ---
+
+// Times one greedy pick through a synthetic output projection the size of a MarianMT model's
+// (58101 tokens, hidden size 512), over the whole vocabulary and over random shortlists of
+// typical sizes, once per available kernel. `matches_reference` is 1 when the kernel picks the
+// same token with a bit-identical score as the scalar one.
+inline void RunShortlistKernelBenchmark(std::ostream& out) {
+    constexpr size_t VOCAB_SIZE = 58101;
+    constexpr size_t HIDDEN_SIZE = 512;
+    std::mt19937 rng(1);
+    std::normal_distribution<float> weight(0.0f, 0.05f);
+    std::vector<float> weights(VOCAB_SIZE * HIDDEN_SIZE + VOCAB_SIZE);
+    for (auto& value : weights) value = weight(rng);
+    std::vector<float> hidden(HIDDEN_SIZE);
+    for (auto& value : hidden) value = weight(rng) * 20.0f;
+    OutputProjection projection{ weights.data(), weights.data() + VOCAB_SIZE * HIDDEN_SIZE, VOCAB_SIZE, HIDDEN_SIZE };
+
+    std::vector<frame_hash::Kernel> kernels = { frame_hash::Kernel::Scalar };
+#ifdef OSL_HAS_X86_SIMD
+    kernels.push_back(frame_hash::Kernel::Sse2);
+    if (frame_hash::CpuSupportsAvx2()) kernels.push_back(frame_hash::Kernel::Avx2);
+#endif
+
+    out << "benchmark\tcandidates\tkernel\tus_per_pick\tgb_per_s\tmatches_reference\n";
+    for (size_t size : { size_t{ 1000 }, size_t{ 2000 }, size_t{ 4000 }, size_t{ 8000 }, VOCAB_SIZE }) {
+        std::vector<int32_t> candidates;
+        if (size < VOCAB_SIZE) {
+            while (candidates.size() < size) candidates.push_back(static_cast<int32_t>(rng() % VOCAB_SIZE));
+            std::sort(candidates.begin(), candidates.end());
+            candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+        }
+        const int32_t* chosen = candidates.empty() ? nullptr : candidates.data();
+        size_t count = chosen ? candidates.size() : VOCAB_SIZE;
+        auto reference = ProjectArgmax(projection, hidden.data(), chosen, count, frame_hash::Kernel::Scalar);
+        for (auto kernel : kernels) {
+            ProjectedPick pick;
+            double seconds = MeasureSecondsPerCall([&] { pick = ProjectArgmax(projection, hidden.data(), chosen, count, kernel); },
+                std::chrono::milliseconds(200));
+            bool matches = pick.token == reference.token && std::memcmp(&pick.score, &reference.score, sizeof(float)) == 0;
+            out << "shortlist_pick\t" << count << '\t' << frame_hash::KernelName(kernel) << '\t' << seconds * 1e6 << '\t'
+                << static_cast<double>(count) * (HIDDEN_SIZE + 1) * sizeof(float) / seconds / 1e9 << '\t' << (matches ? 1 : 0) << '\n';
+        }
+    }
+
+    // Whole-vocabulary picks for a decoder step's rows: one ProjectArgmax per row streams the
+    // projection once per row, ProjectArgmaxRows once per step.
+    out << "\nbenchmark\trows\tmethod\tus_per_step\tus_per_row\tmatches_reference\n";
+    for (size_t rows : { size_t{ 1 }, size_t{ 4 }, size_t{ 16 } }) {
+        std::vector<float> states(rows * HIDDEN_SIZE);
+        for (auto& value : states) value = weight(rng) * 20.0f;
+        std::vector<const float*> row_states;
+        for (size_t row = 0; row < rows; ++row) row_states.push_back(states.data() + row * HIDDEN_SIZE);
+        std::vector<ProjectedPick> reference(rows), picks(rows);
+        double per_row = MeasureSecondsPerCall([&] {
+            for (size_t row = 0; row < rows; ++row) reference[row] = ProjectArgmax(projection, row_states[row], nullptr, 0);
+        }, std::chrono::milliseconds(200));
+        double blocked = MeasureSecondsPerCall([&] { ProjectArgmaxRows(projection, row_states.data(), rows, picks.data()); },
+            std::chrono::milliseconds(200));
+        bool matches = true;
+        for (size_t row = 0; row < rows; ++row) {
+            matches = matches && picks[row].token == reference[row].token
+                && std::memcmp(&picks[row].score, &reference[row].score, sizeof(float)) == 0;
+        }
+        for (auto [method, seconds] : { std::pair{ "per_row", per_row }, std::pair{ "blocked", blocked } }) {
+            out << "projection_rows\t" << rows << '\t' << method << '\t' << seconds * 1e6 << '\t'
+                << seconds * 1e6 / static_cast<double>(rows) << '\t' << (matches ? 1 : 0) << '\n';
+        }
+    }
+}
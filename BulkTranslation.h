@@ -0,0 +1,470 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// --- Bulk Translation ---
+
+struct BulkLine {
+    std::string text; // UTF-8
+    size_t sink = 0;  // which output the line's translation goes to
+};
+
+struct BulkTranslation {
+    bool ok = true;
+    std::string text; // the translation, or what went wrong
+};
+
+struct BulkOptions {
+    size_t workers = 2;             // batches translated at once
+    size_t max_batch = 16;          // segments per batch
+    size_t max_batch_tokens = 1024; // segments times the longest one's tokens, per batch
+    size_t window = 1024;           // lines read ahead and sorted by length at a time
+};
+
+struct BulkStats {
+    uint64_t lines = 0;    // written this run, translated or copied through
+    uint64_t segments = 0; // of those, sent for translation
+    uint64_t errors = 0;
+    uint64_t source_tokens = 0;
+    uint64_t batches = 0;
+    double seconds = 0;
+    double read_seconds = 0; // including OCR of screenshots
+    double tokenize_seconds = 0;
+    double translate_seconds = 0; // summed over workers, so it can exceed `seconds`
+    double write_seconds = 0;
+};
+
+using BulkTranslateBatch = std::function<std::vector<BulkTranslation>(const std::vector<std::string>& texts)>;
+using BulkCountTokens = std::function<size_t(const std::string& text)>;
+
+// Lines worth translating: those with a letter in them (any non-ASCII character counts, since most
+// scripts have no case). Subtitle numbers and timestamps, rules and blank lines are copied as is.
+inline bool NeedsTranslation(std::string_view line) {
+    for (unsigned char c : line) {
+        if (c >= 0x80 || ((c | 0x20) >= 'a' && (c | 0x20) <= 'z')) return true;
+    }
+    return false;
+}
+
+// Whitespace-separated words, standing in for a token count when no tokenizer is at hand.
+inline size_t CountWords(const std::string& text) {
+    size_t words = 0;
+    bool in_word = false;
+    for (char c : text) {
+        bool space = c == ' ' || c == '\t' || c == '\n' || c == '\r';
+        words += (!space && !in_word) ? 1 : 0;
+        in_word = !space;
+    }
+    return words;
+}
+
+// Streams lines from `read` (nullopt at the end) through `translate` and passes each line with its
+// result to `write`, in input order. Lines are read a window at a time. Within a window, the lines
+// to translate are sorted by token count and cut into batches of similar length, so batches carry
+// little padding. `options.workers` threads translate the batches while the next window is read.
+// At most two windows are held at once, so memory stays bounded however long the input is.
+// `read` and `write` are only ever called on the calling thread.
+inline BulkStats BulkTranslate(const std::function<std::optional<BulkLine>()>& read,
+    const std::function<void(const BulkLine& line, const BulkTranslation& result)>& write,
+    const BulkTranslateBatch& translate, const BulkCountTokens& count_tokens = CountWords, const BulkOptions& options = {}) {
+    using clock = std::chrono::steady_clock;
+    auto seconds_since = [](clock::time_point start) { return std::chrono::duration<double>(clock::now() - start).count(); };
+    constexpr size_t MAX_WINDOWS_IN_FLIGHT = 2;
+
+    struct Window {
+        std::vector<BulkLine> lines;
+        std::vector<BulkTranslation> results;
+        size_t pending_batches = 0;
+    };
+    struct Batch {
+        std::shared_ptr<Window> window;
+        std::vector<size_t> lines;
+    };
+
+    BulkStats stats;
+    std::mutex mutex;
+    std::condition_variable work_ready, batch_done;
+    std::deque<Batch> queue;
+    bool input_done = false;
+    auto start = clock::now();
+
+    std::vector<std::thread> workers;
+    for (size_t w = 0; w < (std::max)(options.workers, size_t{ 1 }); ++w) {
+        workers.emplace_back([&] {
+            std::unique_lock lock(mutex);
+            while (true) {
+                work_ready.wait(lock, [&] { return input_done || !queue.empty(); });
+                if (queue.empty()) return;
+                Batch batch = std::move(queue.front());
+                queue.pop_front();
+                lock.unlock();
+
+                std::vector<std::string> texts;
+                texts.reserve(batch.lines.size());
+                for (size_t i : batch.lines) texts.push_back(batch.window->lines[i].text);
+                auto translate_start = clock::now();
+                std::vector<BulkTranslation> results;
+                try {
+                    results = translate(texts);
+                } catch (const std::exception& e) {
+                    results.assign(texts.size(), { false, e.what() });
+                }
+                double elapsed = seconds_since(translate_start);
+
+                lock.lock();
+                stats.translate_seconds += elapsed;
+                for (size_t k = 0; k < batch.lines.size(); ++k) {
+                    batch.window->results[batch.lines[k]] = k < results.size() ? std::move(results[k]) : BulkTranslation{ false, "no translation returned" };
+                }
+                if (--batch.window->pending_batches == 0) batch_done.notify_all();
+            }
+        });
+    }
+
+    std::deque<std::shared_ptr<Window>> in_flight;
+    bool more_input = true;
+    while (more_input || !in_flight.empty()) {
+        if (more_input) {
+            auto window = std::make_shared<Window>();
+            auto read_start = clock::now();
+            while (window->lines.size() < (std::max)(options.window, size_t{ 1 })) {
+                auto line = read();
+                if (!line) {
+                    more_input = false;
+                    break;
+                }
+                window->lines.push_back(std::move(*line));
+            }
+            stats.read_seconds += seconds_since(read_start);
+
+            auto tokenize_start = clock::now();
+            window->results.resize(window->lines.size());
+            std::vector<std::pair<size_t, size_t>> by_length; // tokens, line
+            for (size_t i = 0; i < window->lines.size(); ++i) {
+                if (NeedsTranslation(window->lines[i].text)) {
+                    by_length.emplace_back(count_tokens(window->lines[i].text), i);
+                } else {
+                    window->results[i] = { true, window->lines[i].text };
+                }
+            }
+            std::stable_sort(by_length.begin(), by_length.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+            std::vector<Batch> batches;
+            for (size_t begin = 0; begin < by_length.size();) {
+                // Sorted shortest first, so the segment being added is always the batch's longest.
+                size_t end = begin + 1;
+                while (end < by_length.size() && end - begin < options.max_batch
+                    && (end - begin + 1) * (std::max)(by_length[end].first, size_t{ 1 }) <= options.max_batch_tokens) {
+                    ++end;
+                }
+                Batch batch{ window, {} };
+                for (size_t k = begin; k < end; ++k) {
+                    batch.lines.push_back(by_length[k].second);
+                    stats.source_tokens += by_length[k].first;
+                }
+                batches.push_back(std::move(batch));
+                begin = end;
+            }
+            stats.tokenize_seconds += seconds_since(tokenize_start);
+
+            if (!window->lines.empty()) {
+                {
+                    std::lock_guard lock(mutex);
+                    window->pending_batches = batches.size();
+                    stats.batches += batches.size();
+                    stats.segments += by_length.size();
+                    for (auto& batch : batches) queue.push_back(std::move(batch));
+                }
+                work_ready.notify_all();
+                in_flight.push_back(std::move(window));
+            }
+        }
+
+        // Write finished windows in order. Reading goes on while only one window is in flight.
+        while (!in_flight.empty()) {
+            {
+                std::unique_lock lock(mutex);
+                if (!more_input || in_flight.size() >= MAX_WINDOWS_IN_FLIGHT) {
+                    batch_done.wait(lock, [&] { return in_flight.front()->pending_batches == 0; });
+                } else if (in_flight.front()->pending_batches != 0) {
+                    break;
+                }
+            }
+            auto write_start = clock::now();
+            const Window& window = *in_flight.front();
+            for (size_t i = 0; i < window.lines.size(); ++i) {
+                stats.errors += window.results[i].ok ? 0 : 1;
+                write(window.lines[i], window.results[i]);
+            }
+            stats.lines += window.lines.size();
+            stats.write_seconds += seconds_since(write_start);
+            in_flight.pop_front();
+        }
+    }
+
+    {
+        std::lock_guard lock(mutex);
+        input_done = true;
+    }
+    work_ready.notify_all();
+    for (auto& worker : workers) worker.join();
+    stats.seconds = seconds_since(start);
+    return stats;
+}
+
+// --- Bulk File Jobs ---
+
+struct BulkFile {
+    std::filesystem::path input;
+    std::filesystem::path output; // written as output + ".partial" and renamed once complete without errors
+    bool with_source = false;     // write "source<TAB>translation", for inputs that aren't text themselves
+};
+
+// Lines for inputs that aren't text files, e.g. OCR of a screenshot. nullopt if the file can't be read.
+using BulkExtractLines = std::function<std::optional<std::vector<std::string>>(const std::filesystem::path& file)>;
+
+inline bool IsBulkTextFile(const std::filesystem::path& path) {
+    auto extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(c | 0x20); });
+    return extension == ".txt" || extension == ".srt" || extension == ".vtt";
+}
+
+inline std::filesystem::path PartialOutputPath(const std::filesystem::path& output) {
+    auto partial = output;
+    partial += ".partial";
+    return partial;
+}
+
+// Beside a partial output whose translation failed somewhere: the number of its first failed line.
+inline std::filesystem::path FailedLinePath(const std::filesystem::path& output) {
+    auto failed = PartialOutputPath(output);
+    failed += ".failed";
+    return failed;
+}
+
+inline std::optional<size_t> ReadFailedLine(const std::filesystem::path& output) {
+    std::ifstream file(FailedLinePath(output));
+    size_t line = 0;
+    if (file >> line) return line;
+    return std::nullopt;
+}
+
+// Lines completely written to `path` by an interrupted run, keeping at most `max_lines` of them. A
+// last line cut off mid-way, and any beyond `max_lines`, are removed, so appending carries on
+// cleanly. 0 if there is no such file.
+inline size_t ResumeOutputFile(const std::filesystem::path& path, size_t max_lines = SIZE_MAX) {
+    std::error_code ec;
+    if (!std::filesystem::exists(path, ec)) return 0;
+    size_t lines = 0;
+    uint64_t bytes = 0, complete_bytes = 0;
+    {
+        std::ifstream file(path, std::ios::binary);
+        std::vector<char> buffer(64 * 1024);
+        while (lines < max_lines && (file.read(buffer.data(), static_cast<std::streamsize>(buffer.size())) || file.gcount() > 0)) {
+            for (std::streamsize i = 0; i < file.gcount() && lines < max_lines; ++i) {
+                ++bytes;
+                if (buffer[static_cast<size_t>(i)] == '\n') {
+                    ++lines;
+                    complete_bytes = bytes;
+                }
+            }
+        }
+    }
+    if (complete_bytes != std::filesystem::file_size(path, ec)) std::filesystem::resize_file(path, complete_bytes, ec);
+    return lines;
+}
+
+// The files to translate under `input`, a text file or a directory searched recursively, with
+// outputs at the same relative paths under `output`. Text files keep their name; files that
+// `extractable` accepts get ".txt" appended to theirs. Sorted, so runs resume in the same order.
+inline std::vector<BulkFile> CollectBulkFiles(const std::filesystem::path& input, const std::filesystem::path& output,
+    const std::function<bool(const std::filesystem::path&)>& extractable = {}) {
+    std::vector<BulkFile> files;
+    std::error_code ec;
+    auto add = [&](const std::filesystem::path& file, std::filesystem::path destination) {
+        if (IsBulkTextFile(file)) {
+            files.push_back({ file, std::move(destination), false });
+        } else if (extractable && extractable(file)) {
+            destination += ".txt";
+            files.push_back({ file, std::move(destination), true });
+        }
+    };
+    if (!std::filesystem::is_directory(input, ec)) {
+        add(input, std::filesystem::is_directory(output, ec) ? output / input.filename() : output);
+        return files;
+    }
+    for (std::filesystem::recursive_directory_iterator it(input, ec), end; it != end; it.increment(ec)) {
+        if (ec) break;
+        if (it->is_regular_file(ec)) add(it->path(), output / std::filesystem::relative(it->path(), input, ec));
+    }
+    std::sort(files.begin(), files.end(), [](const BulkFile& a, const BulkFile& b) { return a.input < b.input; });
+    return files;
+}
+
+struct BulkJobStats {
+    BulkStats translation;
+    size_t files = 0;
+    size_t files_done = 0;        // already complete from an earlier run, not read at all
+    size_t files_failed = 0;      // couldn't be read
+    size_t files_with_errors = 0; // some line failed to translate; left as .partial
+    uint64_t lines_resumed = 0;
+};
+
+// Translates every file into its output, picking up where an interrupted run stopped: finished
+// outputs are skipped and partial ones continued after their last complete line. Translations are
+// appended as they are made, one output line per input line; a line that failed to translate gets
+// the error text instead, and its file keeps the .partial name with the first failed line recorded
+// beside it, so the next run translates it again from that line on.
+inline BulkJobStats RunBulkJob(const std::vector<BulkFile>& files, const BulkExtractLines& extract,
+    const BulkTranslateBatch& translate, const BulkCountTokens& count_tokens = CountWords, const BulkOptions& options = {}) {
+    BulkJobStats job;
+    job.files = files.size();
+
+    // Reader: the next unwritten line of the current file, opening the next file at its end.
+    size_t next_file = 0, sink = 0, skip = 0, emitted = 0, extracted_line = 0;
+    std::vector<size_t> resumed(files.size(), 0); // lines kept from an earlier run, per file
+    std::ifstream text;
+    std::vector<std::string> extracted;
+    bool open = false, from_text = false, first_line = false;
+    auto finish_unwritten = [&] {
+        // A file none of whose lines went out this run gets no Write to complete it; rename it here.
+        // Resuming already dropped everything from its first failed line on, so it has no errors.
+        if (emitted > 0) return;
+        std::error_code ec;
+        std::filesystem::create_directories(files[sink].output.parent_path(), ec);
+        auto partial = PartialOutputPath(files[sink].output);
+        if (!std::filesystem::exists(partial, ec)) std::ofstream(partial, std::ios::binary).close();
+        std::filesystem::rename(partial, files[sink].output, ec);
+    };
+    auto read = [&]() -> std::optional<BulkLine> {
+        while (true) {
+            if (!open) {
+                if (next_file == files.size()) return std::nullopt;
+                sink = next_file++;
+                std::error_code ec;
+                if (std::filesystem::exists(files[sink].output, ec)) {
+                    ++job.files_done;
+                    continue;
+                }
+                from_text = IsBulkTextFile(files[sink].input);
+                if (from_text) {
+                    text = std::ifstream(files[sink].input, std::ios::binary);
+                    open = text.is_open();
+                } else {
+                    auto lines = extract ? extract(files[sink].input) : std::nullopt;
+                    open = lines.has_value();
+                    extracted = lines ? std::move(*lines) : std::vector<std::string>();
+                    extracted_line = 0;
+                }
+                if (!open) {
+                    ++job.files_failed;
+                    continue;
+                }
+                // Lines from the first failed one on are translated again.
+                auto failed_line = ReadFailedLine(files[sink].output);
+                skip = ResumeOutputFile(PartialOutputPath(files[sink].output), failed_line.value_or(SIZE_MAX));
+                if (failed_line) std::filesystem::remove(FailedLinePath(files[sink].output), ec);
+                resumed[sink] = skip;
+                emitted = 0;
+                first_line = true;
+            }
+            std::string line;
+            if (from_text ? !std::getline(text, line) : extracted_line == extracted.size()) {
+                finish_unwritten();
+                open = false;
+                continue;
+            }
+            if (from_text) {
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                if (first_line && line.starts_with("\xEF\xBB\xBF")) line.erase(0, 3);
+            } else {
+                line = std::move(extracted[extracted_line++]);
+            }
+            first_line = false;
+            if (skip > 0) {
+                --skip;
+                ++job.lines_resumed;
+                continue;
+            }
+            ++emitted;
+            return BulkLine{ std::move(line), sink };
+        }
+    };
+
+    // Writer: appends to the current output, completing the previous one when the sink changes.
+    std::ofstream out;
+    size_t out_sink = files.size(), out_line = 0;
+    bool out_failed = false;
+    auto complete_output = [&] {
+        if (out_sink == files.size()) return;
+        out.close();
+        if (out_failed) {
+            ++job.files_with_errors;
+        } else {
+            std::error_code ec;
+            std::filesystem::rename(PartialOutputPath(files[out_sink].output), files[out_sink].output, ec);
+        }
+        out_sink = files.size();
+    };
+    auto write = [&](const BulkLine& line, const BulkTranslation& result) {
+        if (line.sink != out_sink) {
+            complete_output();
+            std::error_code ec;
+            std::filesystem::create_directories(files[line.sink].output.parent_path(), ec);
+            out.open(PartialOutputPath(files[line.sink].output), std::ios::binary | std::ios::app);
+            out_sink = line.sink;
+            out_line = resumed[line.sink];
+            out_failed = false;
+        }
+        if (!result.ok && !out_failed) {
+            // Recorded right away, so a run interrupted after this still retries the line.
+            std::ofstream(FailedLinePath(files[line.sink].output)) << out_line << '\n';
+            out_failed = true;
+        }
+        ++out_line;
+        // One output line per input line, whatever the translator returned.
+        std::string translation = result.text;
+        std::replace(translation.begin(), translation.end(), '\n', ' ');
+        std::replace(translation.begin(), translation.end(), '\r', ' ');
+        if (files[line.sink].with_source) out << line.text << '\t';
+        out << translation << '\n';
+    };
+
+    job.translation = BulkTranslate(read, write, translate, count_tokens, options);
+    complete_output();
+    return job;
+}
+
+inline void WriteBulkReport(const BulkJobStats& job, std::ostream& out) {
+    const BulkStats& stats = job.translation;
+    double seconds = (std::max)(stats.seconds, 1e-9);
+    out << "benchmark\tfiles\tfiles_done_before\tfiles_failed\tfiles_with_errors\tlines\tlines_resumed\tsegments\terrors\tbatches\tsource_tokens\t"
+           "seconds\tsegments_per_s\ttokens_per_s\n"
+        << "bulk\t" << job.files << '\t' << job.files_done << '\t' << job.files_failed << '\t' << job.files_with_errors << '\t' << stats.lines << '\t'
+        << job.lines_resumed << '\t' << stats.segments << '\t' << stats.errors << '\t' << stats.batches << '\t'
+        << stats.source_tokens << '\t' << stats.seconds << '\t' << static_cast<double>(stats.segments) / seconds << '\t'
+        << static_cast<double>(stats.source_tokens) / seconds << '\n';
+    out << "\nstage\tseconds\tms_per_segment\n";
+    double segments = static_cast<double>((std::max)(stats.segments, uint64_t{ 1 }));
+    for (const auto& [stage, stage_seconds] : { std::pair{ "read", stats.read_seconds }, std::pair{ "tokenize", stats.tokenize_seconds },
+             std::pair{ "translate", stats.translate_seconds }, std::pair{ "write", stats.write_seconds } }) {
+        out << stage << '\t' << stage_seconds << '\t' << stage_seconds / segments * 1e3 << '\n';
+    }
+}
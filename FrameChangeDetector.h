@@ -0,0 +1,294 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define OSL_HAS_X86_SIMD 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(OSL_HAS_X86_SIMD) && !defined(_MSC_VER)
+#define OSL_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define OSL_TARGET_AVX2
+#endif
+
+// --- Tile Hashing ---
+
+// 64-bit hash of a rectangular pixel block, in the style of XXH3's accumulate loop: every row is
+// read in 32-byte blocks that feed four 64-bit lanes with acc += lo32(d ^ k) * hi32(d ^ k) + d,
+// and the lanes are scrambled (acc ^= acc >> 47, acc *= PRIME32_1) after each row so the hash
+// depends on row order. Both steps map one-to-one onto SSE2/AVX2 _mm_mul_epu32, so every kernel
+// produces bit-identical hashes; only speed differs.
+namespace frame_hash {
+
+enum class Kernel { Scalar, Sse2, Avx2 };
+
+constexpr size_t BLOCK_BYTES = 32;
+alignas(32) constexpr uint64_t KEYS[4] = {
+    0xbe4ba423396cfeb8ull, 0x1cad21f72c81017cull, 0xdb979083e96dd4deull, 0x1f67b3b7a4a44072ull };
+constexpr uint64_t PRIME32_1 = 0x9E3779B1ull;
+
+inline void AccumulateLane(uint64_t& acc, uint64_t value, uint64_t key) {
+    uint64_t keyed = value ^ key;
+    acc += (keyed & 0xFFFFFFFFull) * (keyed >> 32) + value;
+}
+
+// Handles any row width; bytes past the last whole block are zero-padded 8-byte words.
+inline void AccumulateTileScalar(uint64_t acc[4], const uint8_t* data, size_t row_bytes, size_t rows, size_t stride) {
+    for (size_t row = 0; row < rows; ++row, data += stride) {
+        size_t offset = 0;
+        for (; offset + BLOCK_BYTES <= row_bytes; offset += BLOCK_BYTES) {
+            for (int lane = 0; lane < 4; ++lane) {
+                uint64_t value;
+                std::memcpy(&value, data + offset + lane * 8, 8);
+                AccumulateLane(acc[lane], value, KEYS[lane]);
+            }
+        }
+        for (int lane = 0; offset < row_bytes; ++lane, offset += 8) {
+            uint64_t value = 0;
+            std::memcpy(&value, data + offset, std::min<size_t>(8, row_bytes - offset));
+            AccumulateLane(acc[lane], value, KEYS[lane]);
+        }
+        for (int lane = 0; lane < 4; ++lane) {
+            acc[lane] ^= acc[lane] >> 47;
+            acc[lane] *= PRIME32_1;
+        }
+    }
+}
+
+#ifdef OSL_HAS_X86_SIMD
+// SIMD kernels require row_bytes to be a multiple of BLOCK_BYTES (tiles a multiple of 8 pixels wide).
+inline void AccumulateTileSse2(uint64_t acc[4], const uint8_t* data, size_t row_bytes, size_t rows, size_t stride) {
+    __m128i acc_lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&acc[0]));
+    __m128i acc_hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&acc[2]));
+    const __m128i key_lo = _mm_load_si128(reinterpret_cast<const __m128i*>(&KEYS[0]));
+    const __m128i key_hi = _mm_load_si128(reinterpret_cast<const __m128i*>(&KEYS[2]));
+    const __m128i prime = _mm_set1_epi64x(static_cast<long long>(PRIME32_1));
+    auto scramble = [&](__m128i a) {
+        __m128i mixed = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+        __m128i product_lo = _mm_mul_epu32(mixed, prime);
+        __m128i product_hi = _mm_mul_epu32(_mm_srli_epi64(mixed, 32), prime);
+        return _mm_add_epi64(product_lo, _mm_slli_epi64(product_hi, 32));
+    };
+    for (size_t row = 0; row < rows; ++row, data += stride) {
+        for (size_t offset = 0; offset < row_bytes; offset += BLOCK_BYTES) {
+            __m128i value_lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset));
+            __m128i value_hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset + 16));
+            __m128i keyed_lo = _mm_xor_si128(value_lo, key_lo);
+            __m128i keyed_hi = _mm_xor_si128(value_hi, key_hi);
+            acc_lo = _mm_add_epi64(acc_lo, _mm_add_epi64(_mm_mul_epu32(keyed_lo, _mm_srli_epi64(keyed_lo, 32)), value_lo));
+            acc_hi = _mm_add_epi64(acc_hi, _mm_add_epi64(_mm_mul_epu32(keyed_hi, _mm_srli_epi64(keyed_hi, 32)), value_hi));
+        }
+        acc_lo = scramble(acc_lo);
+        acc_hi = scramble(acc_hi);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&acc[0]), acc_lo);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&acc[2]), acc_hi);
+}
+
+OSL_TARGET_AVX2 inline void AccumulateTileAvx2(uint64_t acc[4], const uint8_t* data, size_t row_bytes, size_t rows, size_t stride) {
+    __m256i lanes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc));
+    const __m256i key = _mm256_load_si256(reinterpret_cast<const __m256i*>(KEYS));
+    const __m256i prime = _mm256_set1_epi64x(static_cast<long long>(PRIME32_1));
+    for (size_t row = 0; row < rows; ++row, data += stride) {
+        for (size_t offset = 0; offset < row_bytes; offset += BLOCK_BYTES) {
+            __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + offset));
+            __m256i keyed = _mm256_xor_si256(value, key);
+            lanes = _mm256_add_epi64(lanes, _mm256_add_epi64(_mm256_mul_epu32(keyed, _mm256_srli_epi64(keyed, 32)), value));
+        }
+        __m256i mixed = _mm256_xor_si256(lanes, _mm256_srli_epi64(lanes, 47));
+        __m256i product_lo = _mm256_mul_epu32(mixed, prime);
+        __m256i product_hi = _mm256_mul_epu32(_mm256_srli_epi64(mixed, 32), prime);
+        lanes = _mm256_add_epi64(product_lo, _mm256_slli_epi64(product_hi, 32));
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc), lanes);
+}
+#endif
+
+inline uint64_t Finish(const uint64_t acc[4], uint64_t length) {
+    uint64_t hash = length * 0x9E3779B185EBCA87ull;
+    for (int lane = 0; lane < 4; ++lane) {
+        hash ^= acc[lane];
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdull;
+        hash ^= hash >> 33;
+        hash *= 0xc4ceb9fe1a85ec53ull;
+        hash ^= hash >> 33;
+    }
+    return hash;
+}
+
+// Hashes `rows` rows of `row_bytes` bytes each, `stride` bytes apart.
+inline uint64_t HashTile(const uint8_t* data, size_t row_bytes, size_t rows, size_t stride, Kernel kernel) {
+    uint64_t acc[4] = { KEYS[0], KEYS[1], KEYS[2], KEYS[3] };
+    bool whole_blocks = (row_bytes % BLOCK_BYTES == 0);
+#ifdef OSL_HAS_X86_SIMD
+    if (whole_blocks && kernel == Kernel::Avx2) {
+        AccumulateTileAvx2(acc, data, row_bytes, rows, stride);
+    } else if (whole_blocks && kernel == Kernel::Sse2) {
+        AccumulateTileSse2(acc, data, row_bytes, rows, stride);
+    } else
+#endif
+    {
+        AccumulateTileScalar(acc, data, row_bytes, rows, stride);
+    }
+    return Finish(acc, static_cast<uint64_t>(row_bytes) * rows);
+}
+
+inline bool CpuSupportsAvx2() {
+#if defined(OSL_HAS_X86_SIMD) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    bool os_saves_ymm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+    __cpuidex(info, 7, 0);
+    return os_saves_ymm && (info[1] & (1 << 5));
+#elif defined(OSL_HAS_X86_SIMD)
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+inline Kernel BestKernel() {
+#ifdef OSL_HAS_X86_SIMD
+    static const Kernel kernel = CpuSupportsAvx2() ? Kernel::Avx2 : Kernel::Sse2;
+    return kernel;
+#else
+    return Kernel::Scalar;
+#endif
+}
+
+inline const char* KernelName(Kernel kernel) {
+    switch (kernel) {
+    case Kernel::Avx2: return "avx2";
+    case Kernel::Sse2: return "sse2";
+    default: return "scalar";
+    }
+}
+
+} // namespace frame_hash
+
+// --- Frame Change Detection ---
+
+// Used by the capture pipeline and the replay benchmarks alike, so replays count the OCR passes
+// the pipeline would run. One changed tile is enough: a short subtitle or a counter can change
+// inside a single tile. Changes that leave the text alone, such as a blinking caret, cost one
+// small region OCR pass and are dropped before translation.
+constexpr int CHANGE_DETECTION_TILE_SIZE = 32;
+constexpr size_t MIN_CHANGED_TILES_FOR_OCR = 1;
+
+struct FrameChange {
+    size_t changed_tiles = 0;
+    size_t total_tiles = 0;
+    // Pixel bounds of the changed tiles, right/bottom exclusive. Empty when nothing changed.
+    int left = 0, top = 0, right = 0, bottom = 0;
+
+    double changed_fraction() const {
+        return total_tiles ? static_cast<double>(changed_tiles) / static_cast<double>(total_tiles) : 0.0;
+    }
+};
+
+// Splits each BGRA frame into square tiles, hashes them and reports which tiles differ from the
+// previous frame. The first frame, or a frame of a different size, counts as fully changed.
+class FrameChangeDetector {
+public:
+    explicit FrameChangeDetector(int tile_size = CHANGE_DETECTION_TILE_SIZE, frame_hash::Kernel kernel = frame_hash::BestKernel())
+        : tile_size_(tile_size), kernel_(kernel) {}
+
+    FrameChange Update(const uint8_t* bgra, int width, int height, size_t stride) {
+        int tiles_x = (width + tile_size_ - 1) / tile_size_;
+        int tiles_y = (height + tile_size_ - 1) / tile_size_;
+        bool resized = (width != width_ || height != height_);
+        width_ = width;
+        height_ = height;
+        tiles_x_ = tiles_x;
+        tiles_y_ = tiles_y;
+        hashes_.resize(static_cast<size_t>(tiles_x) * tiles_y);
+        changed_.assign(hashes_.size(), 0);
+
+        FrameChange change;
+        change.total_tiles = hashes_.size();
+        change.left = width;
+        change.top = height;
+
+        for (int ty = 0; ty < tiles_y; ++ty) {
+            int y_begin = ty * tile_size_;
+            int y_end = (std::min)(height, y_begin + tile_size_);
+            for (int tx = 0; tx < tiles_x; ++tx) {
+                int x_begin = tx * tile_size_;
+                int x_end = (std::min)(width, x_begin + tile_size_);
+                uint64_t hash = frame_hash::HashTile(
+                    bgra + static_cast<size_t>(y_begin) * stride + static_cast<size_t>(x_begin) * 4,
+                    static_cast<size_t>(x_end - x_begin) * 4, static_cast<size_t>(y_end - y_begin), stride, kernel_);
+
+                size_t index = static_cast<size_t>(ty) * tiles_x + tx;
+                if (!resized && hashes_[index] == hash) continue;
+                hashes_[index] = hash;
+                changed_[index] = 1;
+                ++change.changed_tiles;
+                change.left = (std::min)(change.left, x_begin);
+                change.top = (std::min)(change.top, y_begin);
+                change.right = (std::max)(change.right, x_end);
+                change.bottom = (std::max)(change.bottom, y_end);
+            }
+        }
+        if (change.changed_tiles == 0) change.left = change.top = 0;
+        return change;
+    }
+
+    // Forgets the previous frame, so the next Update reports everything as changed.
+    void Reset() { width_ = height_ = -1; }
+
+    int tile_size() const { return tile_size_; }
+    int tiles_x() const { return tiles_x_; }
+    int tiles_y() const { return tiles_y_; }
+    // Per-tile flags from the last Update, row-major.
+    const std::vector<uint8_t>& changed_tiles() const { return changed_; }
+
+private:
+    int tile_size_;
+    frame_hash::Kernel kernel_;
+    int width_ = -1, height_ = -1;
+    int tiles_x_ = 0, tiles_y_ = 0;
+    std::vector<uint64_t> hashes_;
+    std::vector<uint8_t> changed_;
+};
+
+// --- Adaptive Polling ---
+
+// Capture period that drops to `fastest` as soon as the screen changes and backs off
+// geometrically towards `slowest` while it stays idle.
+class AdaptivePollInterval {
+public:
+    AdaptivePollInterval(std::chrono::milliseconds fastest, std::chrono::milliseconds slowest, double backoff = 1.5)
+        : fastest_(fastest), slowest_(slowest), backoff_(backoff), current_(fastest) {}
+
+    std::chrono::milliseconds Next(bool activity) {
+        if (activity) {
+            current_ = fastest_;
+        } else {
+            auto backed_off = std::chrono::milliseconds(static_cast<int64_t>(static_cast<double>(current_.count()) * backoff_));
+            current_ = (std::min)(slowest_, (std::max)(backed_off, current_ + std::chrono::milliseconds(1)));
+        }
+        return current_;
+    }
+
+    std::chrono::milliseconds current() const { return current_; }
+
+private:
+    std::chrono::milliseconds fastest_;
+    std::chrono::milliseconds slowest_;
+    double backoff_;
+    std::chrono::milliseconds current_;
+};
@@ -0,0 +1,271 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "MappedFile.h"
+
+// --- Frames ---
+
+// Read-only view of one captured BGRA frame with top-down rows. `owner` keeps the pixels alive:
+// a pooled capture buffer for live sources, the file mapping for replay. Copying a Frame only
+// copies the view, so frames travel through the pipeline without their pixels being copied.
+struct Frame {
+    const uint8_t* pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    size_t stride = 0;
+    uint64_t sequence = 0;
+    int64_t timestamp_us = 0;
+    int dpi = 96; // of the captured monitor, as seen by this process
+    std::shared_ptr<const void> owner;
+
+    explicit operator bool() const { return pixels != nullptr; }
+};
+
+// --- Recycling Pool ---
+
+struct RecyclingPoolStats {
+    uint64_t created = 0;
+    uint64_t reused = 0;
+};
+
+// Hands out objects through shared_ptrs that return them to the pool, instead of destroying
+// them, when the last reference goes away. Up to `max_idle` objects are kept for reuse. The pool's
+// state is shared with outstanding objects, so they may outlive the pool itself.
+template <class T>
+class RecyclingPool {
+public:
+    explicit RecyclingPool(size_t max_idle = 4) : state_(std::make_shared<State>()) {
+        state_->max_idle = max_idle;
+    }
+
+    // Returns an idle object for which `fits` holds, or a new one from `create` (nullptr if it fails).
+    std::shared_ptr<T> Acquire(const std::function<bool(const T&)>& fits, const std::function<std::unique_ptr<T>()>& create) {
+        std::unique_ptr<T> object;
+        {
+            std::lock_guard lock(state_->mutex);
+            for (auto it = state_->idle.begin(); it != state_->idle.end(); ++it) {
+                if (fits(**it)) {
+                    object = std::move(*it);
+                    state_->idle.erase(it);
+                    ++state_->stats.reused;
+                    break;
+                }
+            }
+        }
+        if (!object) {
+            object = create();
+            if (!object) return nullptr;
+            std::lock_guard lock(state_->mutex);
+            ++state_->stats.created;
+        }
+        return std::shared_ptr<T>(object.release(), [state = state_](T* released) {
+            std::unique_ptr<T> returned(released);
+            std::lock_guard lock(state->mutex);
+            if (state->idle.size() < state->max_idle) state->idle.push_back(std::move(returned));
+        });
+    }
+
+    RecyclingPoolStats Stats() const {
+        std::lock_guard lock(state_->mutex);
+        return state_->stats;
+    }
+
+private:
+    struct State {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<T>> idle;
+        size_t max_idle = 4;
+        RecyclingPoolStats stats;
+    };
+    std::shared_ptr<State> state_;
+};
+
+// --- Frame Sources ---
+
+class FrameSource {
+public:
+    virtual ~FrameSource() = default;
+    // Next frame, or an empty Frame when none is available (capture failure, end of a replay).
+    virtual Frame Capture() = 0;
+    // True once a replay has delivered its last frame. Live sources never finish.
+    virtual bool Finished() const { return false; }
+};
+
+// Recorded sessions are one file per capture region:
+//   64-byte header: "OSLFRM01", u32 width, u32 height, u32 stride, u32 dpi (0 = 96), rest zero
+//   records: 64-byte header (i64 timestamp in microseconds, rest zero) + stride * height pixel
+//            bytes, padded to a multiple of 64 bytes
+// Everything stays 64-byte aligned, so mapped pixels can go straight to the SIMD kernels.
+namespace frame_file {
+
+constexpr char MAGIC[8] = { 'O', 'S', 'L', 'F', 'R', 'M', '0', '1' };
+constexpr size_t HEADER_BYTES = 64;
+constexpr size_t RECORD_HEADER_BYTES = 64;
+
+struct Header {
+    char magic[8];
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    uint32_t dpi;
+    uint8_t reserved[40];
+};
+static_assert(sizeof(Header) == HEADER_BYTES);
+
+inline size_t RecordBytes(size_t stride, size_t height) {
+    return (RECORD_HEADER_BYTES + stride * height + 63) / 64 * 64;
+}
+
+} // namespace frame_file
+
+// Appends frames to a recording. Frames whose size differs from the first one are skipped.
+class FrameRecorder {
+public:
+    bool Open(const std::filesystem::path& path) {
+        file_.open(path, std::ios::binary | std::ios::trunc);
+        header_written_ = false;
+        return file_.is_open();
+    }
+
+    bool is_open() const { return file_.is_open(); }
+
+    void Write(const Frame& frame) {
+        if (!file_.is_open() || !frame) return;
+        size_t row_bytes = static_cast<size_t>(frame.width) * 4;
+        if (!header_written_) {
+            frame_file::Header header{};
+            std::memcpy(header.magic, frame_file::MAGIC, sizeof(header.magic));
+            header.width = static_cast<uint32_t>(frame.width);
+            header.height = static_cast<uint32_t>(frame.height);
+            header.stride = static_cast<uint32_t>(row_bytes);
+            header.dpi = static_cast<uint32_t>(frame.dpi);
+            file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            width_ = frame.width;
+            height_ = frame.height;
+            header_written_ = true;
+        }
+        if (frame.width != width_ || frame.height != height_) return;
+
+        char record_header[frame_file::RECORD_HEADER_BYTES] = {};
+        std::memcpy(record_header, &frame.timestamp_us, sizeof(frame.timestamp_us));
+        file_.write(record_header, sizeof(record_header));
+        for (int y = 0; y < frame.height; ++y) {
+            file_.write(reinterpret_cast<const char*>(frame.pixels + static_cast<size_t>(y) * frame.stride), static_cast<std::streamsize>(row_bytes));
+        }
+        size_t padding = frame_file::RecordBytes(row_bytes, static_cast<size_t>(frame.height))
+            - frame_file::RECORD_HEADER_BYTES - row_bytes * static_cast<size_t>(frame.height);
+        static const char zeros[64] = {};
+        file_.write(zeros, static_cast<std::streamsize>(padding));
+    }
+
+private:
+    std::ofstream file_;
+    bool header_written_ = false;
+    int width_ = 0;
+    int height_ = 0;
+};
+
+// Streams a recording straight out of a read-only file mapping; frames point into the mapping.
+// Sequential pacing returns every frame once, in order, for deterministic benchmarks. Realtime
+// pacing follows the recorded timestamps: each Capture returns the latest frame due by now, so a
+// slow consumer skips frames just as it would on a live screen.
+class ReplayFrameSource : public FrameSource {
+public:
+    enum class Pacing { Sequential, Realtime };
+
+    explicit ReplayFrameSource(Pacing pacing = Pacing::Sequential) : pacing_(pacing) {}
+
+    bool Open(const std::filesystem::path& path) {
+        auto file = std::make_shared<MappedFile>();
+        if (!file->OpenReadOnly(path) || file->size() < frame_file::HEADER_BYTES) return false;
+        frame_file::Header header;
+        std::memcpy(&header, file->data(), sizeof(header));
+        if (std::memcmp(header.magic, frame_file::MAGIC, sizeof(header.magic)) != 0) return false;
+        if (header.width == 0 || header.height == 0 || header.stride < header.width * 4ull) return false;
+
+        file_ = std::move(file);
+        width_ = static_cast<int>(header.width);
+        height_ = static_cast<int>(header.height);
+        stride_ = header.stride;
+        dpi_ = header.dpi ? static_cast<int>(header.dpi) : 96;
+        record_bytes_ = frame_file::RecordBytes(stride_, static_cast<size_t>(height_));
+        frame_count_ = (file_->size() - frame_file::HEADER_BYTES) / record_bytes_;
+        next_index_ = 0;
+        started_ = false;
+        return true;
+    }
+
+    Frame Capture() override {
+        if (!file_ || frame_count_ == 0) return {};
+        size_t index = next_index_;
+        if (pacing_ == Pacing::Realtime) {
+            auto now = std::chrono::steady_clock::now();
+            if (!started_) {
+                started_ = true;
+                start_time_ = now;
+            }
+            int64_t elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(now - start_time_).count();
+            int64_t due_us = TimestampAt(0) + elapsed_us;
+            index = (next_index_ == 0) ? 0 : next_index_ - 1;
+            while (index + 1 < frame_count_ && TimestampAt(index + 1) <= due_us) ++index;
+        } else if (index >= frame_count_) {
+            return {};
+        }
+        next_index_ = index + 1;
+
+        Frame frame;
+        frame.pixels = RecordAt(index) + frame_file::RECORD_HEADER_BYTES;
+        frame.width = width_;
+        frame.height = height_;
+        frame.stride = stride_;
+        frame.sequence = index;
+        frame.timestamp_us = TimestampAt(index);
+        frame.dpi = dpi_;
+        frame.owner = file_;
+        return frame;
+    }
+
+    bool Finished() const override { return next_index_ >= frame_count_; }
+
+    void Rewind() {
+        next_index_ = 0;
+        started_ = false;
+    }
+
+    size_t frame_count() const { return frame_count_; }
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+private:
+    const uint8_t* RecordAt(size_t index) const {
+        return file_->data() + frame_file::HEADER_BYTES + index * record_bytes_;
+    }
+
+    int64_t TimestampAt(size_t index) const {
+        int64_t timestamp;
+        std::memcpy(&timestamp, RecordAt(index), sizeof(timestamp));
+        return timestamp;
+    }
+
+    Pacing pacing_;
+    std::shared_ptr<MappedFile> file_;
+    int width_ = 0;
+    int height_ = 0;
+    size_t stride_ = 0;
+    int dpi_ = 96;
+    size_t record_bytes_ = 0;
+    size_t frame_count_ = 0;
+    size_t next_index_ = 0;
+    bool started_ = false;
+    std::chrono::steady_clock::time_point start_time_;
+};
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// --- Memory-Mapped File ---
+
+// Mapping of a whole file. Open() maps it read/write and can grow it; the file is opened
+// exclusively, so a second process sharing the same cache directory simply runs without the
+// on-disk store. OpenReadOnly() maps an existing file shared and read-only.
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { Close(); }
+
+    bool Open(const std::filesystem::path& path, uint64_t min_size) {
+        Close();
+        read_only_ = false;
+#ifdef _WIN32
+        file_ = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE) {
+            file_ = nullptr;
+            return false;
+        }
+        LARGE_INTEGER file_size{};
+        GetFileSizeEx(file_, &file_size);
+        size_ = static_cast<uint64_t>(file_size.QuadPart);
+#else
+        fd_ = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd_ < 0) return false;
+        if (flock(fd_, LOCK_EX | LOCK_NB) != 0) {
+            close(fd_);
+            fd_ = -1;
+            return false;
+        }
+        struct stat st {};
+        fstat(fd_, &st);
+        size_ = static_cast<uint64_t>(st.st_size);
+#endif
+        if (!Map(size_ < min_size ? min_size : size_)) {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    bool OpenReadOnly(const std::filesystem::path& path) {
+        Close();
+        read_only_ = true;
+#ifdef _WIN32
+        file_ = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE) {
+            file_ = nullptr;
+            return false;
+        }
+        LARGE_INTEGER file_size{};
+        GetFileSizeEx(file_, &file_size);
+        size_ = static_cast<uint64_t>(file_size.QuadPart);
+#else
+        fd_ = open(path.c_str(), O_RDONLY);
+        if (fd_ < 0) return false;
+        struct stat st {};
+        fstat(fd_, &st);
+        size_ = static_cast<uint64_t>(st.st_size);
+#endif
+        if (!Map(size_)) {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    // Remaps at `new_size` bytes; pointers previously returned by data() are invalidated.
+    bool Resize(uint64_t new_size) {
+        Unmap();
+        return Map(new_size);
+    }
+
+    void Flush() {
+        if (!data_) return;
+#ifdef _WIN32
+        FlushViewOfFile(data_, 0);
+#else
+        msync(data_, size_, MS_ASYNC);
+#endif
+    }
+
+    void Close() {
+        Unmap();
+#ifdef _WIN32
+        if (file_) CloseHandle(file_);
+        file_ = nullptr;
+#else
+        if (fd_ >= 0) close(fd_);
+        fd_ = -1;
+#endif
+        size_ = 0;
+    }
+
+    uint8_t* data() const { return data_; }
+    uint64_t size() const { return size_; }
+    bool is_open() const { return data_ != nullptr; }
+
+private:
+    bool Map(uint64_t size) {
+        if (size == 0) return false;
+#ifdef _WIN32
+        mapping_ = CreateFileMappingW(file_, nullptr, read_only_ ? PAGE_READONLY : PAGE_READWRITE,
+            static_cast<DWORD>(size >> 32), static_cast<DWORD>(size & 0xFFFFFFFFull), nullptr);
+        if (!mapping_) return false;
+        data_ = static_cast<uint8_t*>(MapViewOfFile(mapping_, read_only_ ? FILE_MAP_READ : FILE_MAP_WRITE, 0, 0, static_cast<SIZE_T>(size)));
+        if (!data_) {
+            CloseHandle(mapping_);
+            mapping_ = nullptr;
+            return false;
+        }
+#else
+        if (!read_only_ && size > size_ && ftruncate(fd_, static_cast<off_t>(size)) != 0) return false;
+        void* view = mmap(nullptr, static_cast<size_t>(size), read_only_ ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (view == MAP_FAILED) return false;
+        data_ = static_cast<uint8_t*>(view);
+#endif
+        size_ = size;
+        return true;
+    }
+
+    void Unmap() {
+        if (!data_) return;
+#ifdef _WIN32
+        UnmapViewOfFile(data_);
+        CloseHandle(mapping_);
+        mapping_ = nullptr;
+#else
+        munmap(data_, static_cast<size_t>(size_));
+#endif
+        data_ = nullptr;
+    }
+
+#ifdef _WIN32
+    HANDLE file_ = nullptr;
+    HANDLE mapping_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+    uint8_t* data_ = nullptr;
+    uint64_t size_ = 0;
+    bool read_only_ = false;
+};
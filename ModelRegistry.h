@@ -0,0 +1,224 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// --- Language Pairs ---
+
+struct LanguagePair {
+    std::string source;  // lowercase primary language subtag, e.g. "en"
+    std::string target;
+};
+
+// "en", "zh" from "en-US", "zh_Hans" or "EN": the lowercase primary subtag, or empty if `tag`
+// doesn't start with two or three ASCII letters.
+inline std::string PrimaryLanguageSubtag(std::wstring_view tag) {
+    std::string subtag;
+    for (wchar_t c : tag) {
+        if (c == L'-' || c == L'_') break;
+        if (!((c >= L'a' && c <= L'z') || (c >= L'A' && c <= L'Z'))) return {};
+        subtag += static_cast<char>(c | 0x20);
+    }
+    return subtag.size() == 2 || subtag.size() == 3 ? subtag : std::string();
+}
+
+// Pair named by a model directory: "en-de", "ja_en", or an export name ending in one such as
+// "opus-mt-en-de". Returns nullopt for anything else.
+inline std::optional<LanguagePair> ParseLanguagePair(std::wstring_view name) {
+    std::vector<std::wstring_view> parts;
+    size_t start = 0;
+    for (size_t i = 0; i <= name.size(); ++i) {
+        if (i == name.size() || name[i] == L'-' || name[i] == L'_') {
+            parts.push_back(name.substr(start, i - start));
+            start = i + 1;
+        }
+    }
+    if (parts.size() < 2) return std::nullopt;
+    LanguagePair pair{ PrimaryLanguageSubtag(parts[parts.size() - 2]), PrimaryLanguageSubtag(parts.back()) };
+    if (pair.source.empty() || pair.target.empty() || pair.source == pair.target) return std::nullopt;
+    return pair;
+}
+
+// --- Source Language Detection ---
+
+enum class Script { Other, Latin, Cyrillic, Greek, Arabic, Hebrew, Devanagari, Thai, Hangul, Kana, Han };
+
+inline Script CharacterScript(wchar_t c) {
+    if ((c >= L'A' && c <= L'Z') || (c >= L'a' && c <= L'z') || (c >= L'\u00C0' && c <= L'\u024F' && c != L'\u00D7' && c != L'\u00F7')) return Script::Latin;
+    if (c >= L'\u0370' && c <= L'\u03FF') return Script::Greek;
+    if (c >= L'\u0400' && c <= L'\u052F') return Script::Cyrillic;
+    if (c >= L'\u0590' && c <= L'\u05FF') return Script::Hebrew;
+    if ((c >= L'\u0600' && c <= L'\u06FF') || (c >= L'\u0750' && c <= L'\u077F')) return Script::Arabic;
+    if (c >= L'\u0900' && c <= L'\u097F') return Script::Devanagari;
+    if (c >= L'\u0E00' && c <= L'\u0E7F') return Script::Thai;
+    if ((c >= L'\u1100' && c <= L'\u11FF') || (c >= L'\u3130' && c <= L'\u318F') || (c >= L'\uAC00' && c <= L'\uD7AF')) return Script::Hangul;
+    if ((c >= L'\u3040' && c <= L'\u30FF') || (c >= L'\u31F0' && c <= L'\u31FF') || (c >= L'\uFF66' && c <= L'\uFF9F')) return Script::Kana;
+    if ((c >= L'\u3400' && c <= L'\u4DBF') || (c >= L'\u4E00' && c <= L'\u9FFF') || (c >= L'\uF900' && c <= L'\uFAFF')) return Script::Han;
+    return Script::Other;
+}
+
+// Languages written in `script`, most widely used first. Latin is everything not listed here.
+inline std::vector<std::string_view> ScriptLanguages(Script script) {
+    switch (script) {
+    case Script::Cyrillic: return { "ru", "uk", "bg", "sr", "mk", "be", "kk" };
+    case Script::Greek: return { "el" };
+    case Script::Arabic: return { "ar", "fa", "ur" };
+    case Script::Hebrew: return { "he" };
+    case Script::Devanagari: return { "hi", "mr", "ne" };
+    case Script::Thai: return { "th" };
+    case Script::Hangul: return { "ko" };
+    case Script::Kana: return { "ja" };
+    case Script::Han: return { "zh", "ja" };
+    default: return {};
+    }
+}
+
+// Short, frequent words that tell Latin-script languages apart.
+inline const std::vector<std::pair<std::string_view, std::vector<std::wstring_view>>>& LatinFunctionWords() {
+    static const std::vector<std::pair<std::string_view, std::vector<std::wstring_view>>> words = {
+        { "en", { L"the", L"and", L"of", L"to", L"is", L"you", L"it", L"that", L"for", L"with" } },
+        { "de", { L"der", L"die", L"und", L"das", L"ist", L"nicht", L"ich", L"zu", L"ein", L"mit" } },
+        { "fr", { L"le", L"les", L"et", L"est", L"un", L"une", L"pas", L"vous", L"des", L"du" } },
+        { "es", { L"el", L"los", L"que", L"y", L"es", L"por", L"con", L"las", L"del", L"una" } },
+        { "it", { L"il", L"che", L"di", L"non", L"per", L"sono", L"una", L"gli", L"della", L"questo" } },
+        { "pt", { L"o", L"que", L"n\u00E3o", L"um", L"com", L"para", L"os", L"uma", L"do", L"voc\u00EA" } },
+        { "nl", { L"het", L"een", L"en", L"van", L"ik", L"niet", L"is", L"dat", L"op", L"je" } },
+    };
+    return words;
+}
+
+// Best guess at the language of `text` among `candidates` (primary subtags). The dominant script
+// decides between scripts; Japanese is told from Chinese by kana; within Latin script, function
+// word counts decide, and the first candidate wins when nothing matches. Empty if no candidate
+// is written in the text's script.
+inline std::string DetectSourceLanguage(std::wstring_view text, const std::vector<std::string>& candidates) {
+    if (candidates.empty()) return {};
+    std::array<size_t, static_cast<size_t>(Script::Han) + 1> counts{};
+    for (wchar_t c : text) ++counts[static_cast<size_t>(CharacterScript(c))];
+    counts[static_cast<size_t>(Script::Other)] = 0;
+    // Japanese mixes kana with kanji; any real share of kana makes the Han text Japanese too.
+    if (counts[static_cast<size_t>(Script::Kana)] * 10 >= counts[static_cast<size_t>(Script::Han)]) {
+        counts[static_cast<size_t>(Script::Kana)] += counts[static_cast<size_t>(Script::Han)];
+        counts[static_cast<size_t>(Script::Han)] = 0;
+    }
+    auto dominant = static_cast<Script>(std::max_element(counts.begin(), counts.end()) - counts.begin());
+    if (counts[static_cast<size_t>(dominant)] == 0) return {};
+
+    auto is_candidate = [&](std::string_view language) {
+        return std::find(candidates.begin(), candidates.end(), language) != candidates.end();
+    };
+    if (dominant != Script::Latin) {
+        for (auto language : ScriptLanguages(dominant)) {
+            if (is_candidate(language)) return std::string(language);
+        }
+        return {};
+    }
+
+    std::vector<std::string> latin;
+    for (const auto& candidate : candidates) {
+        bool other_script = false;
+        for (auto script : { Script::Cyrillic, Script::Greek, Script::Arabic, Script::Hebrew, Script::Devanagari,
+                 Script::Thai, Script::Hangul, Script::Kana, Script::Han }) {
+            auto languages = ScriptLanguages(script);
+            other_script |= std::find(languages.begin(), languages.end(), candidate) != languages.end();
+        }
+        if (!other_script) latin.push_back(candidate);
+    }
+    if (latin.size() <= 1) return latin.empty() ? std::string() : latin.front();
+
+    std::unordered_map<std::string_view, size_t> hits;
+    std::wstring word;
+    auto score_word = [&] {
+        for (const auto& [language, words] : LatinFunctionWords()) {
+            if (std::find(words.begin(), words.end(), word) != words.end()) ++hits[language];
+        }
+        word.clear();
+    };
+    for (wchar_t c : text) {
+        if (CharacterScript(c) == Script::Latin) {
+            word += (c >= L'A' && c <= L'Z') ? static_cast<wchar_t>(c | 0x20) : c;
+        } else if (!word.empty()) {
+            score_word();
+        }
+    }
+    if (!word.empty()) score_word();
+
+    std::string best = latin.front();
+    size_t best_hits = 0;
+    for (const auto& candidate : latin) {
+        if (auto it = hits.find(candidate); it != hits.end() && it->second > best_hits) {
+            best = candidate;
+            best_hits = it->second;
+        }
+    }
+    return best;
+}
+
+// --- Model Residency ---
+
+// Which loaded models to drop to stay within a memory budget, least recently used first. Sizes
+// are whatever the caller estimates a model costs; a budget of 0 keeps everything.
+class ModelResidency {
+public:
+    explicit ModelResidency(uint64_t budget_bytes = 0) : budget_bytes_(budget_bytes) {}
+
+    void set_budget(uint64_t budget_bytes) { budget_bytes_ = budget_bytes; }
+
+    // Marks `name` most recently used, adding it at `bytes` if it isn't resident yet.
+    void Touch(const std::string& name, uint64_t bytes) {
+        if (auto it = index_.find(name); it != index_.end()) {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            return;
+        }
+        lru_.push_front({ name, bytes });
+        index_[name] = lru_.begin();
+        resident_bytes_ += bytes;
+    }
+
+    void Remove(const std::string& name) {
+        auto it = index_.find(name);
+        if (it == index_.end()) return;
+        resident_bytes_ -= it->second->bytes;
+        lru_.erase(it->second);
+        index_.erase(it);
+    }
+
+    // Least recently used first, the models to evict so the rest fit the budget. Models for which
+    // `evictable` returns false (pinned, or still translating) are passed over, so the result may
+    // leave the total above budget until they are released.
+    std::vector<std::string> Evictions(const std::function<bool(const std::string&)>& evictable) const {
+        std::vector<std::string> evictions;
+        if (budget_bytes_ == 0) return evictions;
+        uint64_t remaining = resident_bytes_;
+        for (auto it = lru_.rbegin(); it != lru_.rend() && remaining > budget_bytes_; ++it) {
+            if (!evictable(it->name)) continue;
+            evictions.push_back(it->name);
+            remaining -= it->bytes;
+        }
+        return evictions;
+    }
+
+    uint64_t resident_bytes() const { return resident_bytes_; }
+    uint64_t budget_bytes() const { return budget_bytes_; }
+    size_t resident_count() const { return lru_.size(); }
+
+private:
+    struct Resident {
+        std::string name;
+        uint64_t bytes;
+    };
+
+    uint64_t budget_bytes_;
+    uint64_t resident_bytes_ = 0;
+    std::list<Resident> lru_;  // most recently used first
+    std::unordered_map<std::string, std::list<Resident>::iterator> index_;
+};
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// --- Edit Distance Kernels ---
+
+namespace edit_distance {
+
+enum class Kernel { DynamicProgramming, BitParallel };
+
+inline const char* KernelName(Kernel kernel) {
+    return kernel == Kernel::BitParallel ? "bit_parallel" : "dynamic_programming";
+}
+
+// Textbook O(|a| * |b|) Levenshtein distance, one row at a time. Reference for the bit-parallel kernel.
+inline size_t DynamicProgramming(std::wstring_view a, std::wstring_view b) {
+    std::vector<size_t> row(b.size() + 1);
+    for (size_t j = 0; j <= b.size(); ++j) row[j] = j;
+    for (size_t i = 1; i <= a.size(); ++i) {
+        size_t diagonal = row[0];
+        row[0] = i;
+        for (size_t j = 1; j <= b.size(); ++j) {
+            size_t substitution = diagonal + (a[i - 1] == b[j - 1] ? 0 : 1);
+            diagonal = row[j];
+            row[j] = (std::min)({ row[j] + 1, row[j - 1] + 1, substitution });
+        }
+    }
+    return row[b.size()];
+}
+
+// Myers' bit-vector algorithm, in Hyyro's multi-word form: each column of the DP matrix is kept
+// as +1/-1 vertical deltas packed 64 rows to a word, so a text character costs a handful of word
+// operations per 64 pattern characters. Patterns of any length work; the horizontal delta
+// carries from one word to the next.
+inline size_t BitParallel(std::wstring_view a, std::wstring_view b) {
+    if (a.size() > b.size()) std::swap(a, b); // the shorter string is the pattern
+    if (a.empty()) return b.size();
+    size_t m = a.size();
+    size_t words = (m + 63) / 64;
+
+    // Match masks per pattern character. ASCII indexes a table directly; other characters are
+    // found in a sorted list. Row `alphabet.size()` stays zero for characters not in the pattern.
+    std::vector<wchar_t> alphabet(a.begin(), a.end());
+    std::sort(alphabet.begin(), alphabet.end());
+    alphabet.erase(std::unique(alphabet.begin(), alphabet.end()), alphabet.end());
+    size_t missing = alphabet.size();
+    std::vector<uint32_t> ascii_index(128, static_cast<uint32_t>(missing));
+    for (size_t k = 0; k < alphabet.size(); ++k) {
+        if (static_cast<uint32_t>(alphabet[k]) < 128) ascii_index[static_cast<size_t>(alphabet[k])] = static_cast<uint32_t>(k);
+    }
+    auto index_of = [&](wchar_t c) -> size_t {
+        if (static_cast<uint32_t>(c) < 128) return ascii_index[static_cast<size_t>(c)];
+        auto it = std::lower_bound(alphabet.begin(), alphabet.end(), c);
+        return (it != alphabet.end() && *it == c) ? static_cast<size_t>(it - alphabet.begin()) : missing;
+    };
+    std::vector<uint64_t> peq((alphabet.size() + 1) * words, 0);
+    for (size_t i = 0; i < m; ++i) {
+        peq[index_of(a[i]) * words + i / 64] |= uint64_t{ 1 } << (i % 64);
+    }
+
+    std::vector<uint64_t> pv(words, ~uint64_t{ 0 }), mv(words, 0);
+    const uint64_t last_row = uint64_t{ 1 } << ((m - 1) % 64);
+    size_t distance = m;
+    for (wchar_t c : b) {
+        const uint64_t* eq_row = &peq[index_of(c) * words];
+        int carry = 1; // the top row of the matrix grows by one per text character
+        for (size_t w = 0; w < words; ++w) {
+            uint64_t eq = eq_row[w];
+            uint64_t p = pv[w], n = mv[w];
+            uint64_t carry_negative = carry < 0 ? 1 : 0;
+            uint64_t xv = eq | n;
+            eq |= carry_negative;
+            uint64_t xh = (((eq & p) + p) ^ p) | eq;
+            uint64_t ph = n | ~(xh | p);
+            uint64_t mh = p & xh;
+            uint64_t high = (w + 1 == words) ? last_row : uint64_t{ 1 } << 63;
+            int carry_out = (ph & high) ? 1 : (mh & high) ? -1 : 0;
+            ph = (ph << 1) | (carry > 0 ? 1 : 0);
+            mh = (mh << 1) | carry_negative;
+            pv[w] = mh | ~(xv | ph);
+            mv[w] = ph & xv;
+            carry = carry_out;
+        }
+        distance = static_cast<size_t>(static_cast<std::ptrdiff_t>(distance) + carry);
+    }
+    return distance;
+}
+
+inline size_t Levenshtein(std::wstring_view a, std::wstring_view b, Kernel kernel = Kernel::BitParallel) {
+    return kernel == Kernel::BitParallel ? BitParallel(a, b) : DynamicProgramming(a, b);
+}
+
+} // namespace edit_distance
+
+// --- OCR Jitter Filter ---
+
+inline bool IsAsciiPunctuation(wchar_t c) {
+    return (c > L' ' && c < L'0') || (c > L'9' && c < L'A') || (c > L'Z' && c < L'a') || (c > L'z' && c < 127);
+}
+
+// Canonical form for comparing OCR lines: punctuation dropped (OCR loses and invents it far more
+// often than text changes only in punctuation), whitespace collapsed and trimmed, and characters OCR
+// confuses with each other (I/l/|/1, O/0) folded together.
+inline std::wstring NormalizeOcrLine(std::wstring_view line) {
+    std::wstring normalized;
+    normalized.reserve(line.size());
+    bool pending_space = false;
+    for (wchar_t c : line) {
+        switch (c) {
+        case L'I': case L'|': case L'1': c = L'l'; break;
+        case L'0': c = L'O'; break;
+        case L'\u00A0': case L'\u2007': case L'\u202F': c = L' '; break; // no-break spaces
+        case L'\u2010': case L'\u2011': case L'\u2012': case L'\u2013': case L'\u2014': case L'\u2212': // dashes
+        case L'\u2018': case L'\u2019': case L'\u201A': case L'\u201C': case L'\u201D': case L'\u201E': // quotes
+        case L'\u2026': case L'\u00B7': case L'\u2022': // ellipsis, dots
+            continue;
+        default:
+            if (IsAsciiPunctuation(c)) continue;
+            break;
+        }
+        if (c == L' ' || c == L'\t' || c == L'\n' || c == L'\r') {
+            pending_space = !normalized.empty();
+            continue;
+        }
+        if (pending_space) normalized += L' ';
+        pending_space = false;
+        normalized += c;
+    }
+    return normalized;
+}
+
+// The numbers in `line`, with O/o read as 0 and I/l/| as 1 inside them. A run of digits and those
+// look-alikes counts as a number only if it has a real digit, so words are left alone.
+inline std::vector<std::wstring> ExtractOcrNumbers(std::wstring_view line) {
+    auto digit_like = [](wchar_t c) {
+        return (c >= L'0' && c <= L'9') || c == L'O' || c == L'o' || c == L'I' || c == L'l' || c == L'|';
+    };
+    std::vector<std::wstring> numbers;
+    for (size_t i = 0; i < line.size();) {
+        if (!digit_like(line[i])) {
+            ++i;
+            continue;
+        }
+        std::wstring number;
+        bool has_digit = false;
+        for (; i < line.size() && digit_like(line[i]); ++i) {
+            wchar_t c = line[i];
+            has_digit |= (c >= L'0' && c <= L'9');
+            number += (c == L'O' || c == L'o') ? L'0' : (c == L'I' || c == L'l' || c == L'|') ? L'1' : c;
+        }
+        if (has_digit) numbers.push_back(std::move(number));
+    }
+    return numbers;
+}
+
+// Decides whether a new OCR reading of a line is a real change or recognition noise (an "l" read as
+// "I", punctuation dropped or picked up, "m" read as "rn"). Lines are the same if they contain the
+// same numbers, since a changed counter or price is small in edit distance but always real, and
+// their normalized forms are within `threshold` * their length in edits. With a threshold of 0 only
+// the differences normalization removes are ignored.
+class OcrJitterFilter {
+public:
+    explicit OcrJitterFilter(double threshold = 0.1, edit_distance::Kernel kernel = edit_distance::Kernel::BitParallel)
+        : threshold_((std::max)(threshold, 0.0)), kernel_(kernel) {}
+
+    bool SameLine(std::wstring_view a, std::wstring_view b) const {
+        if (a == b) return true;
+        std::wstring normalized_a = NormalizeOcrLine(a), normalized_b = NormalizeOcrLine(b);
+        if (ExtractOcrNumbers(a) != ExtractOcrNumbers(b)) return false;
+        if (normalized_a == normalized_b) return true;
+        size_t longest = (std::max)(normalized_a.size(), normalized_b.size());
+        auto allowed = static_cast<size_t>(threshold_ * static_cast<double>(longest));
+        size_t length_gap = longest - (std::min)(normalized_a.size(), normalized_b.size());
+        if (allowed == 0 || length_gap > allowed) return false;
+        return edit_distance::Levenshtein(normalized_a, normalized_b, kernel_) <= allowed;
+    }
+
+    // Same number of lines, each the same as its counterpart.
+    bool SameLines(const std::vector<std::wstring>& a, const std::vector<std::wstring>& b) const {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (!SameLine(a[i], b[i])) return false;
+        }
+        return true;
+    }
+
+    double threshold() const { return threshold_; }
+
+private:
+    double threshold_;
+    edit_distance::Kernel kernel_;
+};
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "OcrPreprocessor.h"
+
+// --- Pixel Rectangles ---
+
+// Right/bottom exclusive.
+struct PixelRect {
+    int left = 0, top = 0, right = 0, bottom = 0;
+
+    int width() const { return right - left; }
+    int height() const { return bottom - top; }
+    int64_t area() const { return empty() ? 0 : static_cast<int64_t>(width()) * height(); }
+    bool empty() const { return right <= left || bottom <= top; }
+
+    bool Intersects(const PixelRect& other) const {
+        return left < other.right && other.left < right && top < other.bottom && other.top < bottom;
+    }
+
+    bool Contains(const PixelRect& other) const {
+        return left <= other.left && top <= other.top && other.right <= right && other.bottom <= bottom;
+    }
+
+    PixelRect Union(const PixelRect& other) const {
+        if (empty()) return other;
+        if (other.empty()) return *this;
+        return { (std::min)(left, other.left), (std::min)(top, other.top), (std::max)(right, other.right), (std::max)(bottom, other.bottom) };
+    }
+
+    // Grown by `margin` on every side, clamped to [0, width) x [0, height).
+    PixelRect Inflated(int margin, int max_width, int max_height) const {
+        return { (std::max)(left - margin, 0), (std::max)(top - margin, 0),
+            (std::min)(right + margin, max_width), (std::min)(bottom + margin, max_height) };
+    }
+};
+
+// --- OCR Layout Cache ---
+
+// One recognized line; `box` is the union of its word boxes in capture pixels.
+struct RecognizedLine {
+    std::wstring text;
+    PixelRect box;
+};
+
+struct OcrLayoutStats {
+    uint64_t full_passes = 0;
+    uint64_t partial_passes = 0;
+    uint64_t regions = 0;
+    uint64_t ocr_pixels = 0;    // area sent to OCR
+    uint64_t frame_pixels = 0;  // area of the frames that needed OCR
+};
+
+// Text layout of the capture region from earlier OCR passes. When a frame changes, PlanRegions
+// picks the rectangles that need OCR: the changed tiles plus a margin, grown to cover every cached
+// line they touch so a line is never recognized in pieces. Splice then replaces the cached lines
+// inside each rectangle with the fresh ones and leaves the rest alone, so an update costs OCR time
+// in proportion to the changed area instead of the capture size.
+class OcrLayoutCache {
+public:
+    struct Options {
+        int margin = 32;                  // pixels of context around changed tiles
+        double full_pass_fraction = 0.5;  // above this share of the frame, recognize everything
+        size_t max_regions = 8;
+    };
+
+    OcrLayoutCache() = default;
+    explicit OcrLayoutCache(Options options) : options_(options) {}
+
+    // `changed` is a row-major per-tile flag grid such as FrameChangeDetector::changed_tiles().
+    // Returns no rectangles if nothing changed, and the whole frame on the first call, after a
+    // resize, or when a partial update would not save much.
+    std::vector<PixelRect> PlanRegions(const std::vector<uint8_t>& changed, int tiles_x, int tiles_y, int tile_size,
+        int width, int height) {
+        PixelRect frame{ 0, 0, width, height };
+        if (width != width_ || height != height_) {
+            Reset();
+            width_ = width;
+            height_ = height;
+            return FullPass(frame);
+        }
+
+        std::vector<PixelRect> regions;
+        for (const auto& cells : FindCellRegions<uint8_t>(changed, tiles_x, tiles_y, 1, 1)) {
+            PixelRect tiles{ cells.left * tile_size, cells.top * tile_size,
+                (std::min)(cells.right * tile_size, width), (std::min)(cells.bottom * tile_size, height) };
+            regions.push_back(tiles.Inflated(options_.margin, width, height));
+        }
+        if (regions.empty()) return {};
+
+        // Growing a rectangle over a line can make it overlap another one, so repeat until stable.
+        for (bool grown = true; grown;) {
+            grown = false;
+            for (auto& region : regions) {
+                for (const auto& line : lines_) {
+                    if (region.Intersects(line.box) && !region.Contains(line.box)) {
+                        region = region.Union(line.box);
+                        grown = true;
+                    }
+                }
+            }
+            for (size_t i = 0; i < regions.size(); ++i) {
+                for (size_t j = i + 1; j < regions.size();) {
+                    if (regions[i].Intersects(regions[j])) {
+                        regions[i] = regions[i].Union(regions[j]);
+                        regions.erase(regions.begin() + static_cast<std::ptrdiff_t>(j));
+                        grown = true;
+                    } else {
+                        ++j;
+                    }
+                }
+            }
+        }
+
+        int64_t area = 0;
+        for (const auto& region : regions) area += region.area();
+        if (regions.size() > options_.max_regions || static_cast<double>(area) > options_.full_pass_fraction * static_cast<double>(frame.area())) {
+            return FullPass(frame);
+        }
+        ++stats_.partial_passes;
+        stats_.regions += regions.size();
+        stats_.ocr_pixels += static_cast<uint64_t>(area);
+        stats_.frame_pixels += static_cast<uint64_t>(frame.area());
+        return regions;
+    }
+
+    // Replaces the cached lines overlapping `region` with `lines`, which were recognized inside it.
+    void Splice(const PixelRect& region, std::vector<RecognizedLine> lines) {
+        std::erase_if(lines_, [&](const RecognizedLine& line) { return region.Intersects(line.box); });
+        for (auto& line : lines) {
+            if (!line.text.empty() && !line.box.empty()) lines_.push_back(std::move(line));
+        }
+        std::stable_sort(lines_.begin(), lines_.end(), [](const RecognizedLine& a, const RecognizedLine& b) {
+            return a.box.top != b.box.top ? a.box.top < b.box.top : a.box.left < b.box.left;
+        });
+    }
+
+    // Cached lines in reading order (top to bottom, then left to right).
+    std::vector<std::wstring> Text() const {
+        std::vector<std::wstring> text;
+        text.reserve(lines_.size());
+        for (const auto& line : lines_) text.push_back(line.text);
+        return text;
+    }
+
+    const std::vector<RecognizedLine>& lines() const { return lines_; }
+
+    // Forgets the layout, so the next PlanRegions asks for a full pass.
+    void Reset() {
+        lines_.clear();
+        width_ = height_ = -1;
+    }
+
+    OcrLayoutStats Stats() const { return stats_; }
+
+private:
+    std::vector<PixelRect> FullPass(const PixelRect& frame) {
+        ++stats_.full_passes;
+        ++stats_.regions;
+        stats_.ocr_pixels += static_cast<uint64_t>(frame.area());
+        stats_.frame_pixels += static_cast<uint64_t>(frame.area());
+        return { frame };
+    }
+
+    Options options_;
+    std::vector<RecognizedLine> lines_;
+    int width_ = -1, height_ = -1;
+    OcrLayoutStats stats_;
+};
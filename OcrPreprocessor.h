@@ -0,0 +1,378 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "FrameChangeDetector.h"
+
+// --- Image Kernels ---
+
+// Grayscale conversion, 2x box downscaling and edge counting for OCR input. Every kernel does the
+// same integer arithmetic, so scalar and SIMD results are bit-identical; only speed differs.
+namespace image_kernels {
+
+using frame_hash::Kernel;
+using frame_hash::KernelName;
+
+// Edge statistics are gathered per CELL_SIZE x CELL_SIZE block; one SSE2 register per cell row.
+constexpr int CELL_SIZE = 16;
+
+// BT.601 luma with weights summing to 256: (29 B + 150 G + 77 R + 128) >> 8.
+constexpr uint32_t GRAY_WEIGHT_B = 29;
+constexpr uint32_t GRAY_WEIGHT_G = 150;
+constexpr uint32_t GRAY_WEIGHT_R = 77;
+
+inline uint8_t GrayPixel(const uint8_t* bgra) {
+    return static_cast<uint8_t>((GRAY_WEIGHT_B * bgra[0] + GRAY_WEIGHT_G * bgra[1] + GRAY_WEIGHT_R * bgra[2] + 128) >> 8);
+}
+
+inline void BgraToGrayRowScalar(const uint8_t* bgra, uint8_t* gray, int begin, int width) {
+    for (int x = begin; x < width; ++x) gray[x] = GrayPixel(bgra + static_cast<size_t>(x) * 4);
+}
+
+inline void Downscale2xRowScalar(const uint8_t* row0, const uint8_t* row1, uint8_t* out, int begin, int out_width) {
+    for (int x = begin; x < out_width; ++x) {
+        out[x] = static_cast<uint8_t>((row0[2 * x] + row0[2 * x + 1] + row1[2 * x] + row1[2 * x + 1] + 2) >> 2);
+    }
+}
+
+// Adds, for each cell starting at or after column `begin`, the number of x in the row where
+// |g[x+1] - g[x]| > threshold. The last column has no right neighbour and never counts.
+inline void CountRowEdgesScalar(const uint8_t* gray, int width, uint8_t threshold, uint16_t* cell_counts, int begin) {
+    for (int x = begin; x + 1 < width; ++x) {
+        int diff = gray[x + 1] - gray[x];
+        if (diff > threshold || -diff > threshold) ++cell_counts[x / CELL_SIZE];
+    }
+}
+
+#ifdef OSL_HAS_X86_SIMD
+// Luma of four BGRA pixels, one per 32-bit lane. Channel products fit in the low 16 bits, so
+// 16-bit multiplies and adds give the exact 32-bit result.
+inline __m128i GrayLanesSse2(__m128i pixels) {
+    const __m128i byte_mask = _mm_set1_epi32(0xFF);
+    __m128i b = _mm_and_si128(pixels, byte_mask);
+    __m128i g = _mm_and_si128(_mm_srli_epi32(pixels, 8), byte_mask);
+    __m128i r = _mm_and_si128(_mm_srli_epi32(pixels, 16), byte_mask);
+    __m128i sum = _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi32(GRAY_WEIGHT_B)), _mm_mullo_epi16(g, _mm_set1_epi32(GRAY_WEIGHT_G)));
+    sum = _mm_add_epi16(sum, _mm_mullo_epi16(r, _mm_set1_epi32(GRAY_WEIGHT_R)));
+    return _mm_srli_epi32(_mm_add_epi16(sum, _mm_set1_epi32(128)), 8);
+}
+
+inline int BgraToGrayRowSse2(const uint8_t* bgra, uint8_t* gray, int width) {
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const __m128i* source = reinterpret_cast<const __m128i*>(bgra + static_cast<size_t>(x) * 4);
+        __m128i g0 = GrayLanesSse2(_mm_loadu_si128(source));
+        __m128i g1 = GrayLanesSse2(_mm_loadu_si128(source + 1));
+        __m128i g2 = GrayLanesSse2(_mm_loadu_si128(source + 2));
+        __m128i g3 = GrayLanesSse2(_mm_loadu_si128(source + 3));
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(g0, g1), _mm_packs_epi32(g2, g3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(gray + x), packed);
+    }
+    return x;
+}
+
+OSL_TARGET_AVX2 inline __m256i GrayLanesAvx2(__m256i pixels) {
+    const __m256i byte_mask = _mm256_set1_epi32(0xFF);
+    __m256i b = _mm256_and_si256(pixels, byte_mask);
+    __m256i g = _mm256_and_si256(_mm256_srli_epi32(pixels, 8), byte_mask);
+    __m256i r = _mm256_and_si256(_mm256_srli_epi32(pixels, 16), byte_mask);
+    __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(b, _mm256_set1_epi32(GRAY_WEIGHT_B)), _mm256_mullo_epi16(g, _mm256_set1_epi32(GRAY_WEIGHT_G)));
+    sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(r, _mm256_set1_epi32(GRAY_WEIGHT_R)));
+    return _mm256_srli_epi32(_mm256_add_epi16(sum, _mm256_set1_epi32(128)), 8);
+}
+
+OSL_TARGET_AVX2 inline int BgraToGrayRowAvx2(const uint8_t* bgra, uint8_t* gray, int width) {
+    // The packs work per 128-bit lane; the final permute puts the four 8-pixel groups back in order.
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        const __m256i* source = reinterpret_cast<const __m256i*>(bgra + static_cast<size_t>(x) * 4);
+        __m256i g0 = GrayLanesAvx2(_mm256_loadu_si256(source));
+        __m256i g1 = GrayLanesAvx2(_mm256_loadu_si256(source + 1));
+        __m256i g2 = GrayLanesAvx2(_mm256_loadu_si256(source + 2));
+        __m256i g3 = GrayLanesAvx2(_mm256_loadu_si256(source + 3));
+        __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(g0, g1), _mm256_packs_epi32(g2, g3));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(gray + x), _mm256_permutevar8x32_epi32(packed, order));
+    }
+    return x;
+}
+
+// 16 output pixels from 32 columns of two rows: vertical sums in 16 bits, then horizontal pairs.
+inline __m128i Downscale2xBlockSse2(__m128i top, __m128i bottom) {
+    const __m128i low_byte = _mm_set1_epi16(0xFF);
+    __m128i sum_lo = _mm_add_epi16(_mm_and_si128(top, low_byte), _mm_and_si128(bottom, low_byte));
+    __m128i sum_hi = _mm_add_epi16(_mm_srli_epi16(top, 8), _mm_srli_epi16(bottom, 8));
+    return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(sum_lo, sum_hi), _mm_set1_epi16(2)), 2);
+}
+
+inline int Downscale2xRowSse2(const uint8_t* row0, const uint8_t* row1, uint8_t* out, int out_width) {
+    int x = 0;
+    for (; x + 16 <= out_width; x += 16) {
+        __m128i a = Downscale2xBlockSse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 2 * x)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 2 * x)));
+        __m128i b = Downscale2xBlockSse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 2 * x + 16)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 2 * x + 16)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_packus_epi16(a, b));
+    }
+    return x;
+}
+
+OSL_TARGET_AVX2 inline __m256i Downscale2xBlockAvx2(__m256i top, __m256i bottom) {
+    const __m256i low_byte = _mm256_set1_epi16(0xFF);
+    __m256i sum_lo = _mm256_add_epi16(_mm256_and_si256(top, low_byte), _mm256_and_si256(bottom, low_byte));
+    __m256i sum_hi = _mm256_add_epi16(_mm256_srli_epi16(top, 8), _mm256_srli_epi16(bottom, 8));
+    return _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(sum_lo, sum_hi), _mm256_set1_epi16(2)), 2);
+}
+
+OSL_TARGET_AVX2 inline int Downscale2xRowAvx2(const uint8_t* row0, const uint8_t* row1, uint8_t* out, int out_width) {
+    int x = 0;
+    for (; x + 32 <= out_width; x += 32) {
+        __m256i a = Downscale2xBlockAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(row0 + 2 * x)),
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row1 + 2 * x)));
+        __m256i b = Downscale2xBlockAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(row0 + 2 * x + 32)),
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row1 + 2 * x + 32)));
+        __m256i packed = _mm256_packus_epi16(a, b);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), _mm256_permute4x64_epi64(packed, 0xD8));
+    }
+    return x;
+}
+
+// Returns the first column left for the scalar tail. Needs x + CELL_SIZE < width so the
+// right-neighbour load stays inside the row.
+inline int CountRowEdgesSse2(const uint8_t* gray, int width, uint8_t threshold, uint16_t* cell_counts) {
+    const __m128i limit = _mm_set1_epi8(static_cast<char>(threshold));
+    const __m128i zero = _mm_setzero_si128();
+    int x = 0;
+    for (; x + CELL_SIZE < width; x += CELL_SIZE) {
+        __m128i left = _mm_loadu_si128(reinterpret_cast<const __m128i*>(gray + x));
+        __m128i right = _mm_loadu_si128(reinterpret_cast<const __m128i*>(gray + x + 1));
+        __m128i diff = _mm_or_si128(_mm_subs_epu8(left, right), _mm_subs_epu8(right, left));
+        int quiet = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_subs_epu8(diff, limit), zero));
+        cell_counts[x / CELL_SIZE] += static_cast<uint16_t>(std::popcount(static_cast<uint32_t>(~quiet & 0xFFFF)));
+    }
+    return x;
+}
+
+OSL_TARGET_AVX2 inline int CountRowEdgesAvx2(const uint8_t* gray, int width, uint8_t threshold, uint16_t* cell_counts) {
+    const __m256i limit = _mm256_set1_epi8(static_cast<char>(threshold));
+    const __m256i zero = _mm256_setzero_si256();
+    int x = 0;
+    for (; x + 2 * CELL_SIZE < width; x += 2 * CELL_SIZE) {
+        __m256i left = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(gray + x));
+        __m256i right = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(gray + x + 1));
+        __m256i diff = _mm256_or_si256(_mm256_subs_epu8(left, right), _mm256_subs_epu8(right, left));
+        uint32_t edges = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_subs_epu8(diff, limit), zero)));
+        cell_counts[x / CELL_SIZE] += static_cast<uint16_t>(std::popcount(edges & 0xFFFFu));
+        cell_counts[x / CELL_SIZE + 1] += static_cast<uint16_t>(std::popcount(edges >> 16));
+    }
+    return x;
+}
+#endif
+
+// Converts top-down BGRA to 8-bit gray. Alpha is ignored.
+inline void BgraToGray(const uint8_t* bgra, size_t bgra_stride, int width, int height,
+    uint8_t* gray, size_t gray_stride, Kernel kernel) {
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* source = bgra + static_cast<size_t>(y) * bgra_stride;
+        uint8_t* target = gray + static_cast<size_t>(y) * gray_stride;
+        int done = 0;
+#ifdef OSL_HAS_X86_SIMD
+        if (kernel == Kernel::Avx2) done = BgraToGrayRowAvx2(source, target, width);
+        else if (kernel == Kernel::Sse2) done = BgraToGrayRowSse2(source, target, width);
+#endif
+        BgraToGrayRowScalar(source, target, done, width);
+    }
+}
+
+// Halves both dimensions with a rounded 2x2 box average. An odd last row or column is dropped.
+inline void Downscale2x(const uint8_t* source, size_t source_stride, int width, int height,
+    uint8_t* target, size_t target_stride, Kernel kernel) {
+    int out_width = width / 2;
+    int out_height = height / 2;
+    for (int y = 0; y < out_height; ++y) {
+        const uint8_t* row0 = source + static_cast<size_t>(2 * y) * source_stride;
+        const uint8_t* row1 = row0 + source_stride;
+        uint8_t* out = target + static_cast<size_t>(y) * target_stride;
+        int done = 0;
+#ifdef OSL_HAS_X86_SIMD
+        if (kernel == Kernel::Avx2) done = Downscale2xRowAvx2(row0, row1, out, out_width);
+        else if (kernel == Kernel::Sse2) done = Downscale2xRowSse2(row0, row1, out, out_width);
+#endif
+        Downscale2xRowScalar(row0, row1, out, done, out_width);
+    }
+}
+
+// Horizontal edge counts per cell, row-major, `cells_x` = ceil(width / CELL_SIZE) per row.
+inline void CountCellEdges(const uint8_t* gray, size_t stride, int width, int height, uint8_t threshold,
+    std::vector<uint16_t>& cell_counts, Kernel kernel) {
+    int cells_x = (width + CELL_SIZE - 1) / CELL_SIZE;
+    int cells_y = (height + CELL_SIZE - 1) / CELL_SIZE;
+    cell_counts.assign(static_cast<size_t>(cells_x) * cells_y, 0);
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* row = gray + static_cast<size_t>(y) * stride;
+        uint16_t* counts = cell_counts.data() + static_cast<size_t>(y / CELL_SIZE) * cells_x;
+        int done = 0;
+#ifdef OSL_HAS_X86_SIMD
+        if (kernel == Kernel::Avx2) done = CountRowEdgesAvx2(row, width, threshold, counts);
+        else if (kernel == Kernel::Sse2) done = CountRowEdgesSse2(row, width, threshold, counts);
+#endif
+        CountRowEdgesScalar(row, width, threshold, counts, done);
+    }
+}
+
+} // namespace image_kernels
+
+// --- Text Regions ---
+
+// Pixel rectangle, right/bottom exclusive.
+struct TextRegion {
+    int left = 0, top = 0, right = 0, bottom = 0;
+    int cells = 0;
+};
+
+// Groups grid cells whose value is at least `min_value` into 8-connected components and returns
+// the bounding box of each component of at least `min_cells` cells, in cell units.
+template <class T>
+std::vector<TextRegion> FindCellRegions(const std::vector<T>& cells, int cells_x, int cells_y, T min_value, int min_cells) {
+    std::vector<TextRegion> regions;
+    std::vector<uint8_t> visited(cells.size(), 0);
+    std::vector<int> stack;
+    for (int start = 0; start < static_cast<int>(cells.size()); ++start) {
+        if (visited[start] || cells[start] < min_value) continue;
+        TextRegion region{ cells_x, cells_y, 0, 0, 0 };
+        visited[start] = 1;
+        stack.push_back(start);
+        while (!stack.empty()) {
+            int cell = stack.back();
+            stack.pop_back();
+            int cx = cell % cells_x, cy = cell / cells_x;
+            region.left = (std::min)(region.left, cx);
+            region.top = (std::min)(region.top, cy);
+            region.right = (std::max)(region.right, cx + 1);
+            region.bottom = (std::max)(region.bottom, cy + 1);
+            ++region.cells;
+            for (int ny = (std::max)(cy - 1, 0); ny <= (std::min)(cy + 1, cells_y - 1); ++ny) {
+                for (int nx = (std::max)(cx - 1, 0); nx <= (std::min)(cx + 1, cells_x - 1); ++nx) {
+                    int neighbour = ny * cells_x + nx;
+                    if (visited[neighbour] || cells[neighbour] < min_value) continue;
+                    visited[neighbour] = 1;
+                    stack.push_back(neighbour);
+                }
+            }
+        }
+        if (region.cells >= min_cells) regions.push_back(region);
+    }
+    return regions;
+}
+
+// --- OCR Preprocessor ---
+
+// Gray view handed to OCR. Maps back to capture pixels as frame = origin + image * scale.
+struct PreprocessedImage {
+    const uint8_t* pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    size_t stride = 0;
+    int origin_x = 0;
+    int origin_y = 0;
+    int scale = 1;
+
+    explicit operator bool() const { return pixels != nullptr && width > 0 && height > 0; }
+};
+
+// Shrinks a BGRA capture before OCR: converts it to gray, downscales high-DPI captures back to
+// roughly 96-DPI glyph sizes, and crops to the union of regions dense in horizontal edges (text).
+// Buffers are reused across calls; the returned image is valid until the next Process.
+class OcrPreprocessor {
+public:
+    struct Options {
+        // Power-of-two downscale (1, 2 or 4); 0 derives it from the capture DPI.
+        int downscale = 0;
+        bool crop_to_text = true;
+        uint8_t edge_threshold = 40;
+        uint16_t min_cell_edges = 8;   // of CELL_SIZE * CELL_SIZE comparisons
+        int min_region_cells = 2;      // drops isolated specks such as a caret
+        int crop_padding = image_kernels::CELL_SIZE;
+        image_kernels::Kernel kernel = frame_hash::BestKernel();
+    };
+
+    OcrPreprocessor() = default;
+    explicit OcrPreprocessor(Options options) : options_(options) {}
+
+    // Empty result when cropping finds no text-like region.
+    PreprocessedImage Process(const uint8_t* bgra, int width, int height, size_t stride, int dpi) {
+        regions_.clear();
+        if (width <= 0 || height <= 0) return {};
+        gray_.resize(static_cast<size_t>(width) * height);
+        image_kernels::BgraToGray(bgra, stride, width, height, gray_.data(), static_cast<size_t>(width), options_.kernel);
+
+        const uint8_t* image = gray_.data();
+        int image_width = width, image_height = height;
+        int scale = 1;
+        for (int target = DownscaleFor(dpi); scale < target && image_width >= 2 && image_height >= 2; scale *= 2) {
+            std::vector<uint8_t>& output = (image == scaled_.data()) ? scaled_spare_ : scaled_;
+            output.resize(static_cast<size_t>(image_width / 2) * (image_height / 2));
+            image_kernels::Downscale2x(image, static_cast<size_t>(image_width), image_width, image_height,
+                output.data(), static_cast<size_t>(image_width / 2), options_.kernel);
+            image = output.data();
+            image_width /= 2;
+            image_height /= 2;
+        }
+
+        PreprocessedImage result{ image, image_width, image_height, static_cast<size_t>(image_width), 0, 0, scale };
+        if (!options_.crop_to_text) return result;
+
+        constexpr int cell = image_kernels::CELL_SIZE;
+        image_kernels::CountCellEdges(image, static_cast<size_t>(image_width), image_width, image_height,
+            options_.edge_threshold, cell_counts_, options_.kernel);
+        int cells_x = (image_width + cell - 1) / cell;
+        int cells_y = (image_height + cell - 1) / cell;
+        auto cell_regions = FindCellRegions(cell_counts_, cells_x, cells_y, options_.min_cell_edges, options_.min_region_cells);
+        if (cell_regions.empty()) return {};
+
+        TextRegion crop{ image_width, image_height, 0, 0, 0 };
+        for (const auto& region : cell_regions) {
+            TextRegion pixels{ region.left * cell, region.top * cell,
+                (std::min)(region.right * cell, image_width), (std::min)(region.bottom * cell, image_height), region.cells };
+            crop.left = (std::min)(crop.left, pixels.left);
+            crop.top = (std::min)(crop.top, pixels.top);
+            crop.right = (std::max)(crop.right, pixels.right);
+            crop.bottom = (std::max)(crop.bottom, pixels.bottom);
+            regions_.push_back({ pixels.left * scale, pixels.top * scale, pixels.right * scale, pixels.bottom * scale, pixels.cells });
+        }
+        crop.left = (std::max)(crop.left - options_.crop_padding, 0);
+        crop.top = (std::max)(crop.top - options_.crop_padding, 0);
+        crop.right = (std::min)(crop.right + options_.crop_padding, image_width);
+        crop.bottom = (std::min)(crop.bottom + options_.crop_padding, image_height);
+
+        result.pixels = image + static_cast<size_t>(crop.top) * result.stride + crop.left;
+        result.width = crop.right - crop.left;
+        result.height = crop.bottom - crop.top;
+        result.origin_x = crop.left * scale;
+        result.origin_y = crop.top * scale;
+        return result;
+    }
+
+    // Candidate text regions from the last Process, in capture pixels.
+    const std::vector<TextRegion>& regions() const { return regions_; }
+
+    const Options& options() const { return options_; }
+
+private:
+    int DownscaleFor(int dpi) const {
+        int factor = options_.downscale;
+        if (factor <= 0) factor = (std::max)(dpi, 96) / 96;
+        return factor >= 4 ? 4 : factor >= 2 ? 2 : 1;
+    }
+
+    Options options_;
+    std::vector<uint8_t> gray_;
+    std::vector<uint8_t> scaled_;
+    std::vector<uint8_t> scaled_spare_;
+    std::vector<uint16_t> cell_counts_;
+    std::vector<TextRegion> regions_;
+};
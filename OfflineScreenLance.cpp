@@ -1,23 +1,75 @@
 #include <onnxruntime_c_api.h>
 #include <onnxruntime_cxx_api.h>
 #include <sentencepiece_processor.h>
-#include <dwmapi.h>
 #include <iostream>
+#include <fstream>
+#include <chrono>
+#include <random>
 #include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <stop_token>
+#include <future>
 #include <vector>
 #include <string>
 #include <memory>
+#include <unordered_map>
+#include <map>
+#include <string_view>
 #include <filesystem>
 #include <optional>
 #include <algorithm>
+#include <numeric>
+#include <array>
+#include <new>
+#include <cmath>
+#include <limits>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <cwctype>
 #include <stdexcept>
 #include <format>
+#ifdef _WIN32
+#include <dwmapi.h>
 #include <windows.h>
 #include <shellapi.h> // For SHGetKnownFolderPath
 #include <ShlObj_core.h> // For FOLDERID_RoamingAppData
+#include <psapi.h> // For GetProcessMemoryInfo
+#include <ShellScalingApi.h> // For GetDpiForMonitor
+#else
+#include <sched.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
+#ifdef _WIN32
 #include "resource.h"
+#endif
+#include "TranslationCache.h"
+#include "MappedFile.h"
+#include "FrameChangeDetector.h"
+#include "Benchmarks.h"
+#include "Pipeline.h"
+#include "FrameSource.h"
+#include "OcrPreprocessor.h"
+#include "OcrLayoutCache.h"
+#include "ThreadBudget.h"
+#include "Tracing.h"
+#include "OcrJitter.h"
+#include "ModelRegistry.h"
+#include "TranslationService.h"
+#include "BulkTranslation.h"
+#include "VocabularyShortlist.h"
+#include "SpeculativeDecoding.h"
 
+#ifdef _WIN32
 #include <winrt/base.h>
 #include <winrt/Windows.Foundation.h>
 #include <winrt/Windows.Globalization.h>
@@ -28,6 +80,7 @@
 #pragma comment(lib, "Dwmapi.lib")
 #pragma comment(lib, "WindowsApp.lib")
 #pragma comment(lib, "Shell32.lib") // For SHGetKnownFolderPath
+#pragma comment(lib, "Shcore.lib") // For GetDpiForMonitor
 
 using namespace winrt;
 using namespace winrt::Windows::Foundation;
@@ -35,12 +88,20 @@ using namespace winrt::Windows::Globalization;
 using namespace winrt::Windows::Media::Ocr;
 using namespace winrt::Windows::Graphics::Imaging;
 using namespace winrt::Windows::Storage::Streams;
+#endif
+
+// --- Tracing ---
+
+// Spans from every stage of the pipeline; see Tracing.h. Off unless [Trace] Enabled=1 or --trace.
+Tracer g_tracer;
 
 // --- Modern C++ Helper Functions ---
 
+#ifdef _WIN32
 // UTF-16 (wstring) -> UTF-8 (string)
 inline std::string wstring_to_utf8(const std::wstring& wstr) {
     if (wstr.empty()) return {};
+    TraceScope trace(g_tracer, "utf16_to_utf8");
     int size_needed = WideCharToMultiByte(CP_UTF8, 0, wstr.data(), static_cast<int>(wstr.size()), nullptr, 0, nullptr, nullptr);
     std::string strTo(size_needed, 0);
     WideCharToMultiByte(CP_UTF8, 0, wstr.data(), static_cast<int>(wstr.size()), &strTo[0], size_needed, nullptr, nullptr);
@@ -50,6 +111,7 @@ inline std::string wstring_to_utf8(const std::wstring& wstr) {
 // UTF-8 (string) -> UTF-16 (wstring)
 inline std::wstring utf8_to_wstring(const std::string& str) {
     if (str.empty()) return {};
+    TraceScope trace(g_tracer, "utf8_to_utf16");
     int size_needed = MultiByteToWideChar(CP_UTF8, 0, str.c_str(), static_cast<int>(str.size()), nullptr, 0);
     std::wstring wstrTo(size_needed, 0);
     MultiByteToWideChar(CP_UTF8, 0, str.c_str(), static_cast<int>(str.size()), &wstrTo[0], size_needed);
@@ -60,6 +122,73 @@ inline std::wstring utf8_to_wstring(const std::string& str) {
 inline void show_message_box(const std::wstring& text, const std::wstring& caption = L"Hata", UINT type = MB_OK | MB_ICONERROR) {
     MessageBoxW(nullptr, text.c_str(), caption.c_str(), type);
 }
+#else
+// wchar_t holds UTF-32 here. Malformed input becomes U+FFFD, as with MultiByteToWideChar.
+inline std::string wstring_to_utf8(const std::wstring& wstr) {
+    if (wstr.empty()) return {};
+    TraceScope trace(g_tracer, "utf16_to_utf8");
+    std::string strTo;
+    strTo.reserve(wstr.size());
+    for (wchar_t wc : wstr) {
+        auto c = static_cast<uint32_t>(wc);
+        if (c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF)) c = 0xFFFD;
+        if (c < 0x80) {
+            strTo += static_cast<char>(c);
+        } else if (c < 0x800) {
+            strTo += static_cast<char>(0xC0 | (c >> 6));
+            strTo += static_cast<char>(0x80 | (c & 0x3F));
+        } else if (c < 0x10000) {
+            strTo += static_cast<char>(0xE0 | (c >> 12));
+            strTo += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            strTo += static_cast<char>(0x80 | (c & 0x3F));
+        } else {
+            strTo += static_cast<char>(0xF0 | (c >> 18));
+            strTo += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+            strTo += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            strTo += static_cast<char>(0x80 | (c & 0x3F));
+        }
+    }
+    return strTo;
+}
+
+inline std::wstring utf8_to_wstring(const std::string& str) {
+    if (str.empty()) return {};
+    TraceScope trace(g_tracer, "utf8_to_utf16");
+    static constexpr uint32_t SMALLEST[] = { 0, 0, 0x80, 0x800, 0x10000 }; // by sequence length, to reject overlong forms
+    std::wstring wstrTo;
+    wstrTo.reserve(str.size());
+    for (size_t i = 0; i < str.size();) {
+        auto lead = static_cast<unsigned char>(str[i]);
+        size_t length = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 : (lead >> 3) == 0x1E ? 4 : 0;
+        uint32_t c = length == 1 ? lead : lead & (0x7F >> length);
+        size_t read = 1;
+        for (; read < length && i + read < str.size() && (static_cast<unsigned char>(str[i + read]) & 0xC0) == 0x80; ++read) {
+            c = (c << 6) | (static_cast<unsigned char>(str[i + read]) & 0x3F);
+        }
+        if (length == 0 || read < length || c < SMALLEST[length] || c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF)) {
+            wstrTo += L'\uFFFD';
+        } else {
+            wstrTo += static_cast<wchar_t>(c);
+        }
+        i += read;
+    }
+    return wstrTo;
+}
+
+// No desktop to show it on; the message goes to stderr.
+inline void show_message_box(const std::wstring& text, const std::wstring& caption = L"Hata") {
+    std::cerr << wstring_to_utf8(caption) << ": " << wstring_to_utf8(text) << std::endl;
+}
+#endif
+
+// Diagnostics for a debugger or DebugView; stderr where there is no debug output channel.
+inline void DebugReport(const std::wstring& text) {
+#ifdef _WIN32
+    OutputDebugStringW(text.c_str());
+#else
+    std::cerr << wstring_to_utf8(text);
+#endif
+}
 
 // --- ONNX Runtime Helper ---
 
@@ -86,371 +215,3100 @@ namespace Ort {
     }
 }
 
-// --- Global State ---
-
-Ort::SessionOptions session_options;
-Ort::MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
-std::unique_ptr<Ort::Session> encoder_session;
-std::unique_ptr<Ort::Session> decoder_session;
-sentencepiece::SentencePieceProcessor sp_source_processor;
-sentencepiece::SentencePieceProcessor sp_target_processor;
-Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "ocr-translator-env");
-
-bool g_fullscreen_mode = true;
-std::wstring g_current_overlay_text;
-HWND g_overlay_hwnd = nullptr;
-const wchar_t OVERLAY_WINDOW_CLASS[] = L"OcrTranslationOverlayWindowClass";
-HINSTANCE g_hinstance = nullptr;
+// --- Decoder Variants ---
 
-// --- Forward Declarations ---
-LRESULT CALLBACK OverlayWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
-void RegisterOverlayWindowClass(HINSTANCE hInstance);
-void UnregisterOverlayWindowClass(HINSTANCE hInstance);
-std::filesystem::path GetModelsDirectoryPath();
-void CreateOrUpdateOverlayWindow(const std::wstring& text, const RECT& target_region);
+// How the decoder graph exposes its key/value cache. Detected from the session's input names.
+enum class DecoderVariant {
+    FullPrefix, // decoder_model.onnx without past inputs: the whole prefix is re-run every step
+    WithPast,   // decoder_model.onnx for the first step, decoder_with_past_model.onnx afterwards
+    Merged      // decoder_model_merged.onnx, switched by its use_cache_branch input
+};
 
-// --- Implementation ---
+struct DecoderLayout {
+    DecoderVariant variant = DecoderVariant::FullPrefix;
+    std::vector<std::string> first_step_inputs;
+    std::vector<std::string> first_step_outputs;  // "logits" (or "last_hidden_state") followed by present.* names
+    std::vector<std::string> next_step_inputs;
+    std::vector<std::string> next_step_outputs;
+    std::unordered_map<std::string, std::string> present_to_past;
+    // Merged graphs still need past inputs on the first step; these describe the empty tensors.
+    std::vector<std::pair<std::string, std::vector<int64_t>>> empty_past_shapes;
+    ONNXTensorElementDataType past_type = ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT;
+    bool needs_encoder_attention_mask = false;
+    ONNXTensorElementDataType mask_type = ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64;
+    int64_t vocab_size = -1;  // last dimension of logits, when the export declares it statically
+    ONNXTensorElementDataType logits_type = ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT; // of the first output, logits or not
+    // Set when the decoder ends at last_hidden_state, which the model's output projection turns
+    // into token scores (see PickProjectedToken); first_step_outputs[0] then names that output.
+    bool hidden_state_output = false;
+    int64_t hidden_size = -1;  // last dimension of last_hidden_state, when declared statically
+    // Whether later steps take several input_ids at once, as speculative decoding needs. Some
+    // with-past exports fix their sequence length to 1.
+    bool step_accepts_blocks = true;
+};
 
-std::filesystem::path GetModelsDirectoryPath() {
-    std::vector<wchar_t> exePathBuffer(MAX_PATH);
-    DWORD len = GetModuleFileNameW(nullptr, exePathBuffer.data(), static_cast<DWORD>(exePathBuffer.size()));
-    std::wstring exePath(exePathBuffer.data(), len);
-    auto path = std::filesystem::path(exePath).parent_path() / L"models";
-    return path;
+// Whether DecodeSpeculative can check drafts with this export: it needs several input_ids per step
+// and reads every position's logits, which a hidden-state export doesn't produce.
+inline bool AcceptsDrafts(const DecoderLayout& layout) {
+    return layout.step_accepts_blocks && !layout.hidden_state_output;
 }
 
-bool InitTranslationEngine() {
-    session_options.SetIntraOpNumThreads(static_cast<int>(std::thread::hardware_concurrency()));
-    session_options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+inline const char* DecoderVariantName(DecoderVariant variant) {
+    switch (variant) {
+    case DecoderVariant::WithPast: return "with-past";
+    case DecoderVariant::Merged: return "merged";
+    default: return "full-prefix";
+    }
+}
 
-    auto models_dir = GetModelsDirectoryPath();
-    auto source_spm_path = models_dir / L"source.spm";
-    auto target_spm_path = models_dir / L"target.spm";
-    auto encoder_model_path = models_dir / L"encoder_model.onnx";
-    auto decoder_model_path = models_dir / L"decoder_model.onnx";
+// --- Model Precision ---
 
-    // SentencePiece: wstring -> utf8 string
-    auto source_spm_path_s = wstring_to_utf8(source_spm_path.wstring());
-    auto target_spm_path_s = wstring_to_utf8(target_spm_path.wstring());
+// Which export of the encoder/decoder graphs to load. Auto prefers an int8 export when present.
+enum class ModelPrecision { Auto, Fp32, Fp16, Int8 };
 
-    auto source_status = sp_source_processor.Load(source_spm_path_s.c_str());
-    if (!source_status.ok()) {
-        std::wstring error_message = utf8_to_wstring("Failed to load source SentencePiece model (" + source_spm_path_s + "): " + source_status.ToString());
-        show_message_box(error_message, L"Model Error");
-        return false;
-    }
-    auto target_status = sp_target_processor.Load(target_spm_path_s.c_str());
-    if (!target_status.ok()) {
-        std::wstring error_message = utf8_to_wstring("Failed to load target SentencePiece model (" + target_spm_path_s + "): " + target_status.ToString());
-        show_message_box(error_message, L"Model Error");
-        return false;
+inline const char* ModelPrecisionName(ModelPrecision precision) {
+    switch (precision) {
+    case ModelPrecision::Fp32: return "fp32";
+    case ModelPrecision::Fp16: return "fp16";
+    case ModelPrecision::Int8: return "int8";
+    default: return "auto";
     }
+}
 
-    try {
-        encoder_session = std::make_unique<Ort::Session>(env, encoder_model_path.c_str(), session_options);
-        decoder_session = std::make_unique<Ort::Session>(env, decoder_model_path.c_str(), session_options);
-    } catch (const Ort::Exception& e) {
-        show_message_box(utf8_to_wstring(std::format("Failed to load ONNX models from {}: {}", models_dir.wstring(), e.what())), L"ONNX Error");
-        return false;
-    }
-    return true;
+// Case-insensitive match of a setting or option value against a lower-case ASCII name.
+inline bool MatchesName(std::wstring_view text, std::string_view name) {
+    return text.size() == name.size() && std::equal(name.begin(), name.end(), text.begin(),
+        [](char a, wchar_t b) { return static_cast<wchar_t>(a) == static_cast<wchar_t>(towlower(b)); });
 }
 
-std::wstring TranslateText(const std::wstring& input_text) {
-    if (input_text.empty()) return L"";
+inline std::optional<ModelPrecision> ParseModelPrecision(std::wstring_view text) {
+    for (auto precision : { ModelPrecision::Auto, ModelPrecision::Fp32, ModelPrecision::Fp16, ModelPrecision::Int8 }) {
+        if (MatchesName(text, ModelPrecisionName(precision))) return precision;
+    }
+    return std::nullopt;
+}
 
-    auto utf8_input_str = wstring_to_utf8(input_text);
-    std::vector<int32_t> input_ids_vec;
-    sp_source_processor.Encode(utf8_input_str, &input_ids_vec);
+// The graph files making up one precision variant. Only one of decoder / decoder_merged has to exist.
+struct ModelFiles {
+    ModelPrecision precision = ModelPrecision::Fp32;
+    std::filesystem::path encoder;
+    std::filesystem::path decoder;
+    std::filesystem::path decoder_merged;
+    std::filesystem::path decoder_with_past;
+};
 
-    if (input_ids_vec.empty()) return L"";
+// --- Configuration ---
 
-    int64_t input_length = static_cast<int64_t>(input_ids_vec.size());
-    std::vector<int64_t> input_shape = { 1, input_length };
+// Optional settings from OfflineScreenLance.ini next to the executable:
+//   [Translation]
+//   Precision=auto   ; auto, fp32, fp16 or int8
+//   Speculative=1    ; 0 decodes edited lines from scratch instead of checking the old translation
+//   Streaming=1      ; 0 shows each translation only once it is complete
+//   Shortlist=1      ; for a decoder exported to end at last_hidden_state, with output_projection.bin
+//                    ; and a lex.s2t table beside it: score only each input's likely target tokens
+//   ShortlistFirst=100 ; the most frequent target tokens, always scored
+//   ShortlistBest=100  ; likeliest translations of each source token from lex.s2t, scored as well
+//   ShortlistCheck=4 ; also score the whole vocabulary at every Nth output position (1 = every pick);
+//                    ; 0 turns the shortlist off rather than decode from it unchecked
+//   ShortlistTolerance=0 ; logit margin a token outside the shortlist must win such a check by to
+//                        ; replace the pick; 0 with ShortlistCheck=1 matches full decoding exactly
+//   [Models]
+//   Pair=            ; models\ subdirectory to load first and fall back on, e.g. en-de; empty picks
+//                    ; models\ itself if it holds a model, else the first pair matching Source/Target
+//   Source=auto      ; source language to route by (en, ja, ...), also used for OCR; auto detects it
+//                    ; from each screen's text, with OCR in the source language of an installed pair
+//   Target=          ; target language, when several pairs translate from the same source
+//   MemoryBudgetMB=1024 ; least recently used pairs are unloaded past this; 0 keeps them all loaded
+//   [Memory]
+//   SharedWeights=0  ; 1 runs cached graphs from read-only mapped ORT-format files, so instances on one
+//                    ; machine share the weights, at the cost of weight prepacking; 0 loads private copies
+//   Arena=1          ; 0 disables ONNX Runtime's CPU memory arena
+//   ArenaLimitMB=0   ; caps one arena shared by every session; 0 leaves each session its own, unbounded
+//   [Service]
+//   Connect=0        ; 1 translates through a running --serve instance when there is one, sharing its
+//                    ; loaded models with other clients; otherwise models load in this process
+//   Name=OfflineScreenLance ; the pipe \\.\pipe\<Name> that --serve listens on and clients connect to
+//                    ; (a Unix socket elsewhere; see LocalEndpoint)
+//   BatchDelayMs=5   ; longest --serve holds a request to batch it with other clients' requests
+//   [Ocr]
+//   Preprocess=1     ; 0 sends the raw BGRA capture to OCR
+//   Downscale=auto   ; auto (from the monitor DPI), 1, 2 or 4
+//   DirtyRegions=1   ; 0 re-recognizes the whole capture after every change
+//   JitterThreshold=0.05 ; edits, per character, a re-read line may differ by and still count as
+//                        ; unchanged; 0 ignores only punctuation, spacing and I/l/1, O/0 swaps
+//   [Threads]
+//   Translate=auto   ; ONNX Runtime intra-op threads shared by all sessions; auto = physical cores
+//   Cores=any        ; any, efficiency or performance: where worker threads may run
+//   Adaptive=1       ; 0 keeps every allowed core even while the foreground app is busy
+//   Spin=0           ; 1 lets idle ONNX Runtime threads spin: lower latency, more CPU burned
+//   CapturePriority=normal        ; idle, below_normal or normal, per pipeline stage
+//   OcrPriority=below_normal
+//   TranslatePriority=below_normal
+//   [Trace]
+//   Enabled=0        ; 1 records per-stage spans; off, each instrumented scope costs one branch
+//   ChromeTrace=OfflineScreenLance.trace.json  ; written on exit, for chrome://tracing or Perfetto
+//   StatsLog=OfflineScreenLance.stats.log      ; p50/p95/p99 per stage and skip counters, every 10 s
+// Relative trace paths are next to the executable.
+enum class StagePriority { Idle, BelowNormal, Normal };
 
-    auto encoder_input_tensor = Ort::Value::CreateTensor<int32_t>(
-        memory_info, input_ids_vec.data(), input_ids_vec.size(),
-        input_shape.data(), input_shape.size());
+inline const char* StagePriorityName(StagePriority priority) {
+    switch (priority) {
+    case StagePriority::Idle: return "idle";
+    case StagePriority::BelowNormal: return "below_normal";
+    default: return "normal";
+    }
+}
 
-    const char* encoder_input_names[] = { "input_ids" };
-    const char* encoder_output_names[] = { "last_hidden_state" };
+inline std::optional<StagePriority> ParseStagePriority(std::wstring_view text) {
+    for (auto priority : { StagePriority::Idle, StagePriority::BelowNormal, StagePriority::Normal }) {
+        if (MatchesName(text, StagePriorityName(priority))) return priority;
+    }
+    return std::nullopt;
+}
 
-    std::vector<Ort::Value> encoder_outputs;
-    try {
-        encoder_outputs = encoder_session->Run(
-            Ort::RunOptions{ nullptr },
-            encoder_input_names, &encoder_input_tensor, 1,
-            encoder_output_names, 1);
-    } catch (const Ort::Exception& e) {
-        return L"[Translation Error: Encoder Failed]";
+inline std::optional<CorePreference> ParseCorePreference(std::wstring_view text) {
+    for (auto preference : { CorePreference::Any, CorePreference::Efficiency, CorePreference::Performance }) {
+        if (MatchesName(text, CorePreferenceName(preference))) return preference;
     }
+    return std::nullopt;
+}
 
-    auto& encoder_hidden_state = encoder_outputs[0];
+struct AppConfig {
+    ModelPrecision precision = ModelPrecision::Auto;
+    bool speculative_decoding = true;
+    bool streaming_overlay = true;
+    bool shortlist = true;
+    size_t shortlist_first = 100;
+    size_t shortlist_best = 100;
+    uint64_t shortlist_check = 4; // the shortlist is only used with a check
+    float shortlist_tolerance = 0.0f;
+    std::wstring model_pair;
+    std::string source_language; // empty = auto
+    std::string target_language; // empty = any
+    uint64_t model_memory_budget = 1024ull << 20;
+    bool shared_weights = false;
+    bool ort_arena = true;
+    uint64_t ort_arena_limit = 0; // 0 = unbounded
+    bool use_service = false;
+    std::string service_name = "OfflineScreenLance";
+    std::chrono::milliseconds service_batch_delay{ 5 };
+    bool ocr_preprocess = true;
+    int ocr_downscale = 0; // 0 = auto
+    bool ocr_dirty_regions = true;
+    double ocr_jitter_threshold = 0.05;
+    int translate_threads = 0; // 0 = auto
+    CorePreference cores = CorePreference::Any;
+    bool threads_adaptive = true;
+    bool ort_spinning = false;
+    StagePriority capture_priority = StagePriority::Normal;
+    StagePriority ocr_priority = StagePriority::BelowNormal;
+    StagePriority translate_priority = StagePriority::BelowNormal;
+    bool trace = false;
+    std::filesystem::path trace_file;
+    std::filesystem::path trace_stats_log;
+};
 
-    std::vector<int32_t> decoder_input_ids = { 0 }; // BOS
-    std::vector<int32_t> output_tokens;
-    constexpr int MAX_DECODE_STEPS = 128;
+// --- Startup Metrics ---
 
-    for (int step = 0; step < MAX_DECODE_STEPS; ++step) {
-        std::vector<int64_t> decoder_input_shape = { 1, static_cast<int64_t>(decoder_input_ids.size()) };
-        auto decoder_input_tensor = Ort::Value::CreateTensor<int32_t>(
-            memory_info, decoder_input_ids.data(), decoder_input_ids.size(),
-            decoder_input_shape.data(), decoder_input_shape.size());
+struct StartupMetrics {
+    // Static initialization runs at process start, so this approximates launch time.
+    std::chrono::steady_clock::time_point launch_time = std::chrono::steady_clock::now();
+    std::atomic<int64_t> engine_ready_ms{ -1 };
+    std::atomic<int64_t> first_translation_ms{ -1 };
+    std::atomic<int> graphs_reused{ 0 };
+    std::atomic<int> graphs_optimized{ 0 };
 
-        auto& enc_out_val = encoder_outputs[0];
-        auto enc_tensor_info = enc_out_val.GetTensorTypeAndShapeInfo();
-        void* enc_tensor_data = enc_out_val.GetTensorMutableData<void>();
-        auto enc_tensor_shape = enc_tensor_info.GetShape();
-        auto enc_tensor_element_type = enc_tensor_info.GetElementType();
+    int64_t ElapsedMs() const {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - launch_time).count();
+    }
+};
 
-        auto encoder_hidden_state_wrapper = Ort::Value::CreateTensor(
-            memory_info,
-            enc_tensor_data,
-            enc_out_val.GetTensorTypeAndShapeInfo().GetElementCount() * Ort::GetTensorElementSize(enc_tensor_info.GetElementType()),
-            enc_tensor_shape.data(),
-            enc_tensor_shape.size(),
-            enc_tensor_element_type
-        );
+struct EncoderLayout {
+    std::vector<std::string> input_names;
+    // Without an attention mask padding would leak into attention, so only equal-length rows are batched.
+    bool has_attention_mask = false;
+    ONNXTensorElementDataType mask_type = ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64;
+};
 
-        std::vector<Ort::Value> ort_decoder_inputs;
-        ort_decoder_inputs.reserve(2);
-        ort_decoder_inputs.emplace_back(std::move(decoder_input_tensor));
-        ort_decoder_inputs.emplace_back(std::move(encoder_hidden_state_wrapper));
+// --- Thread Budget ---
 
-        const char* decoder_input_names[] = { "input_ids", "encoder_hidden_states" };
-        const char* decoder_output_names[] = { "logits" };
+enum class ThreadRole { Capture, Ocr, Translate };
 
-        std::vector<Ort::Value> decoder_outputs;
-        try {
-            decoder_outputs = decoder_session->Run(
-                Ort::RunOptions{ nullptr },
-                decoder_input_names, ort_decoder_inputs.data(), ort_decoder_inputs.size(),
-                decoder_output_names, 1);
-        } catch (const Ort::Exception&) {
-            return L"[Translation Error: Decoder Failed]";
+#ifdef _WIN32
+// Cores' worth of CPU time the foreground window's process used since the previous sample. When
+// that process can't be opened (elevated or protected games), every process but this one counts.
+class ForegroundLoadSampler {
+public:
+    ForegroundLoadSampler() = default;
+    ForegroundLoadSampler(const ForegroundLoadSampler&) = delete;
+    ForegroundLoadSampler& operator=(const ForegroundLoadSampler&) = delete;
+    ~ForegroundLoadSampler() { CloseProcess(); }
+
+    // nullopt on the first sample after the foreground application changes. Our own windows
+    // (region selection, overlay) count as an idle foreground.
+    std::optional<double> Sample() {
+        DWORD process_id = 0;
+        if (HWND window = GetForegroundWindow()) GetWindowThreadProcessId(window, &process_id);
+        auto now = std::chrono::steady_clock::now();
+        if (process_id != process_id_ || !last_busy_) {
+            CloseProcess();
+            process_id_ = process_id;
+            if (process_id != 0 && process_id != GetCurrentProcessId()) {
+                process_ = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, process_id);
+            }
+            last_busy_ = BusyTime();
+            last_sample_ = now;
+            return std::nullopt;
         }
+        if (process_id == GetCurrentProcessId()) return 0.0;
 
-        auto& logits_tensor = decoder_outputs[0];
-        auto tensor_shape_info = logits_tensor.GetTensorTypeAndShapeInfo();
-        auto shape = tensor_shape_info.GetShape();
-        float* logits_data = logits_tensor.GetTensorMutableData<float>();
-        int64_t vocab_size = shape[2];
+        auto busy = BusyTime();
+        double seconds = std::chrono::duration<double>(now - last_sample_).count();
+        std::optional<double> cpus;
+        if (busy && seconds > 0) {
+            uint64_t used = *busy > *last_busy_ ? *busy - *last_busy_ : 0;
+            cpus = static_cast<double>(used) / 1e7 / seconds;
+        }
+        last_busy_ = busy;
+        last_sample_ = now;
+        return cpus;
+    }
 
-        float* last_token_logits = logits_data + (shape[1] - 1) * vocab_size;
-        int32_t next_token_id = static_cast<int32_t>(std::distance(last_token_logits,
-            std::max_element(last_token_logits, last_token_logits + vocab_size)));
+private:
+    static uint64_t ToUint64(const FILETIME& time) {
+        return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+    }
 
-        if (next_token_id == 2) break; // EOS
-        output_tokens.push_back(next_token_id);
-        decoder_input_ids.push_back(next_token_id);
+    // CPU time in 100 ns units: the foreground process's, or every other process's.
+    std::optional<uint64_t> BusyTime() const {
+        FILETIME creation, exit, kernel, user;
+        if (process_) {
+            if (!GetProcessTimes(process_, &creation, &exit, &kernel, &user)) return std::nullopt;
+            return ToUint64(kernel) + ToUint64(user);
+        }
+        FILETIME idle, system_kernel, system_user;
+        if (!GetSystemTimes(&idle, &system_kernel, &system_user) ||
+            !GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+            return std::nullopt;
+        }
+        // System kernel time includes idle time.
+        uint64_t everyone = ToUint64(system_kernel) - ToUint64(idle) + ToUint64(system_user);
+        uint64_t own = ToUint64(kernel) + ToUint64(user);
+        return everyone > own ? everyone - own : 0;
+    }
 
-        if (output_tokens.size() >= MAX_DECODE_STEPS) break;
+    void CloseProcess() {
+        if (process_) CloseHandle(process_);
+        process_ = nullptr;
     }
 
-    std::string decoded_text;
-    sp_target_processor.Decode(output_tokens, &decoded_text);
+    DWORD process_id_ = 0;
+    HANDLE process_ = nullptr;
+    std::optional<uint64_t> last_busy_;
+    std::chrono::steady_clock::time_point last_sample_;
+};
 
-    return utf8_to_wstring(decoded_text);
-}
+// Places the worker threads, pipeline stages and ONNX Runtime's shared intra-op pool alike, on the
+// CPUs allowed by [Threads] Cores at each stage's priority. While adaptive, a monitor thread samples
+// the foreground application's CPU use and narrows the workers to the CPUs it leaves idle. ONNX
+// Runtime sizes its pool once, so the budget limits where those threads run, not how many exist.
+class ThreadBudget {
+public:
+    static constexpr std::chrono::milliseconds SAMPLE_INTERVAL{ 1000 };
 
-INT_PTR CALLBACK MainDlgProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM) {
-    switch (message) {
-    case WM_INITDIALOG:
-        CheckRadioButton(hDlg, IDC_RADIO_FULLSCREEN, IDC_RADIO_REGION, IDC_RADIO_FULLSCREEN);
-        return TRUE;
-    case WM_COMMAND:
-        switch (LOWORD(wParam)) {
-        case IDOK:
-            g_fullscreen_mode = (IsDlgButtonChecked(hDlg, IDC_RADIO_FULLSCREEN) == BST_CHECKED);
-            EndDialog(hDlg, IDOK);
-            return TRUE;
-        case IDCANCEL:
-            EndDialog(hDlg, IDCANCEL);
-            return TRUE;
+    ~ThreadBudget() { StopMonitor(); }
+
+    // Call before the ONNX Runtime environment exists; threads registered earlier are updated.
+    void Configure(const AppConfig& config) {
+        StopMonitor();
+        auto all_cpus = EnumerateCpus();
+        {
+            std::lock_guard lock(mutex_);
+            priorities_ = { config.capture_priority, config.ocr_priority, config.translate_priority };
+            cpus_ = OrderCpusForBudget(all_cpus, config.cores);
+            total_cpus_ = static_cast<int>(all_cpus.size());
+            int physical_cores = CountPhysicalCores(cpus_);
+            if (physical_cores == 0) physical_cores = static_cast<int>((std::max)(std::thread::hardware_concurrency(), 1u));
+            translate_threads_ = config.translate_threads > 0 ? config.translate_threads : physical_cores;
+            policy_ = ThreadBudgetPolicy(1, static_cast<int>(cpus_.size()), total_cpus_);
+            budget_ = static_cast<int>(cpus_.size());
+            for (const auto& [id, thread] : threads_) ApplyLocked(thread);
+        }
+        if (config.threads_adaptive && !cpus_.empty()) {
+            monitor_ = std::jthread([this](std::stop_token stop) { MonitorLoop(stop); });
         }
-        break;
     }
-    return FALSE;
-}
 
-RECT SelectScreenRegion() {
-    HWND hSelectionOverlay = CreateWindowExW(
-        WS_EX_TOPMOST | WS_EX_LAYERED | WS_EX_TRANSPARENT,
-        L"STATIC", L"Drag to select region", WS_POPUP | WS_BORDER,
-        0, 0, GetSystemMetrics(SM_CXSCREEN), GetSystemMetrics(SM_CYSCREEN),
-        nullptr, nullptr, g_hinstance, nullptr);
+    int translate_threads() const {
+        std::lock_guard lock(mutex_);
+        return translate_threads_;
+    }
 
-    SetLayeredWindowAttributes(hSelectionOverlay, 0, 180, LWA_ALPHA);
-    ShowWindow(hSelectionOverlay, SW_SHOW);
-    UpdateWindow(hSelectionOverlay);
+    // Logical CPUs the workers may use when nothing else is busy.
+    int allowed_cpus() const {
+        std::lock_guard lock(mutex_);
+        return static_cast<int>(cpus_.size());
+    }
 
-    POINT start_pt{}, end_pt{};
-    bool selecting_region = false;
-    HDC hdc = GetDC(hSelectionOverlay);
-    auto hPen = std::unique_ptr<HPEN, decltype(&DeleteObject)>(
-        CreatePen(PS_SOLID, 2, RGB(255, 0, 0)), DeleteObject);
-    SelectObject(hdc, GetStockObject(NULL_BRUSH));
-    SelectObject(hdc, hPen.get());
+    int budget() const {
+        std::lock_guard lock(mutex_);
+        return budget_;
+    }
 
-    MSG msg;
-    while (true) {
-        if (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
-            TranslateMessage(&msg);
-            DispatchMessage(&msg);
+    void RegisterCurrentThread(ThreadRole role) {
+        HANDLE handle = nullptr;
+        if (!DuplicateHandle(GetCurrentProcess(), GetCurrentThread(), GetCurrentProcess(), &handle, 0, FALSE, DUPLICATE_SAME_ACCESS)) {
+            return;
         }
+        std::lock_guard lock(mutex_);
+        auto& thread = threads_[GetCurrentThreadId()];
+        thread = { handle, role };
+        ApplyLocked(thread);
+    }
 
-        if (GetAsyncKeyState(VK_LBUTTON) & 0x8000) {
-            if (!selecting_region) {
-                GetCursorPos(&start_pt);
-                ScreenToClient(hSelectionOverlay, &start_pt);
-                end_pt = start_pt;
-                selecting_region = true;
-                SetCapture(hSelectionOverlay);
-            } else {
-                GetCursorPos(&end_pt);
-                ScreenToClient(hSelectionOverlay, &end_pt);
-                InvalidateRect(hSelectionOverlay, NULL, TRUE);
-                UpdateWindow(hSelectionOverlay);
-            }
-        } else {
-            if (selecting_region) {
-                ReleaseCapture();
-                GetCursorPos(&end_pt);
-                break;
-            }
-        }
-        if (GetAsyncKeyState(VK_ESCAPE) & 0x8000) {
-            ReleaseCapture();
-            DestroyWindow(hSelectionOverlay);
-            ReleaseDC(hSelectionOverlay, hdc);
-            return RECT{ 0,0,0,0 };
+    void UnregisterCurrentThread() {
+        std::lock_guard lock(mutex_);
+        if (auto it = threads_.find(GetCurrentThreadId()); it != threads_.end()) {
+            CloseHandle(it->second.handle);
+            threads_.erase(it);
         }
-        Sleep(10);
     }
 
-    ReleaseCapture();
-    ReleaseDC(hSelectionOverlay, hdc);
-    DestroyWindow(hSelectionOverlay);
-
-    return RECT{
-        min(start_pt.x, end_pt.x),
-        min(start_pt.y, end_pt.y),
-        max(start_pt.x, end_pt.x),
-        max(start_pt.y, end_pt.y)
+private:
+    struct RegisteredThread {
+        HANDLE handle = nullptr;
+        ThreadRole role = ThreadRole::Translate;
     };
-}
 
-// Interface for IBufferByteAccess
-#include <robuffer.h> // For Windows::Storage::Streams::IBufferByteAccess
+    static std::vector<LogicalCpu> EnumerateCpus() {
+        ULONG length = 0;
+        GetSystemCpuSetInformation(nullptr, 0, &length, GetCurrentProcess(), 0);
+        if (length == 0) return {};
+        std::vector<uint8_t> buffer(length);
+        if (!GetSystemCpuSetInformation(reinterpret_cast<PSYSTEM_CPU_SET_INFORMATION>(buffer.data()), length, &length, GetCurrentProcess(), 0)) {
+            return {};
+        }
+        std::vector<LogicalCpu> cpus;
+        for (ULONG offset = 0; offset + sizeof(SYSTEM_CPU_SET_INFORMATION) <= length;) {
+            const auto* info = reinterpret_cast<const SYSTEM_CPU_SET_INFORMATION*>(buffer.data() + offset);
+            if (info->Size == 0) break;
+            if (info->Type == CpuSetInformation) {
+                cpus.push_back({ static_cast<uint32_t>(info->CpuSet.Id), (info->CpuSet.Group << 8) | info->CpuSet.CoreIndex, info->CpuSet.EfficiencyClass });
+            }
+            offset += info->Size;
+        }
+        return cpus;
+    }
 
-SoftwareBitmap CaptureScreen(int x, int y, int width, int height) {
-    if (width <= 0 || height <= 0) return nullptr;
+    static int WindowsPriority(StagePriority priority) {
+        switch (priority) {
+        case StagePriority::Idle: return THREAD_PRIORITY_IDLE;
+        case StagePriority::BelowNormal: return THREAD_PRIORITY_BELOW_NORMAL;
+        default: return THREAD_PRIORITY_NORMAL;
+        }
+    }
 
-    HDC dcScreen = GetDC(nullptr);
-    HDC dcMem = CreateCompatibleDC(dcScreen);
-    HBITMAP bmp = CreateCompatibleBitmap(dcScreen, width, height);
-    HGDIOBJ oldBmp = SelectObject(dcMem, bmp);
+    void ApplyLocked(const RegisteredThread& thread) const {
+        SetThreadPriority(thread.handle, WindowsPriority(priorities_[static_cast<size_t>(thread.role)]));
+        if (cpus_.empty()) return;
+        if (budget_ >= total_cpus_) {
+            SetThreadSelectedCpuSets(thread.handle, nullptr, 0); // the whole machine: leave it to the scheduler
+            return;
+        }
+        std::vector<ULONG> ids;
+        for (int i = 0; i < budget_; ++i) ids.push_back(cpus_[static_cast<size_t>(i)].id);
+        SetThreadSelectedCpuSets(thread.handle, ids.data(), static_cast<ULONG>(ids.size()));
+    }
 
-    BitBlt(dcMem, 0, 0, width, height, dcScreen, x, y, SRCCOPY);
+    void MonitorLoop(std::stop_token stop) {
+        ForegroundLoadSampler sampler;
+        while (InterruptibleSleep(stop, SAMPLE_INTERVAL)) {
+            auto foreground_cpus = sampler.Sample();
+            if (!foreground_cpus) continue;
+            std::lock_guard lock(mutex_);
+            int budget = policy_.Update(*foreground_cpus);
+            if (budget == budget_) continue;
+            budget_ = budget;
+            for (const auto& [id, thread] : threads_) ApplyLocked(thread);
+            auto report = std::format(L"Thread budget: {} of {} CPUs (foreground app using {:.1f})\n",
+                budget_, cpus_.size(), *foreground_cpus);
+            DebugReport(report);
+        }
+    }
 
-    BITMAPINFOHEADER bi = { sizeof(bi), width, -height, 1, 32, BI_RGB };
-    std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
-    GetDIBits(dcMem, bmp, 0, height, pixels.data(), reinterpret_cast<BITMAPINFO*>(&bi), DIB_RGB_COLORS);
+    void StopMonitor() {
+        if (!monitor_.joinable()) return;
+        monitor_.request_stop();
+        monitor_.join();
+    }
 
-    SelectObject(dcMem, oldBmp);
-    ReleaseDC(nullptr, dcScreen);
-    DeleteDC(dcMem);
-    DeleteObject(bmp);
+    mutable std::mutex mutex_;
+    std::array<StagePriority, 3> priorities_ = { StagePriority::Normal, StagePriority::BelowNormal, StagePriority::BelowNormal };
+    std::vector<LogicalCpu> cpus_;  // allowed CPUs in budget order
+    int total_cpus_ = 0;
+    int translate_threads_ = 1;
+    ThreadBudgetPolicy policy_;
+    int budget_ = 0;
+    std::unordered_map<DWORD, RegisteredThread> threads_;
+    std::jthread monitor_;
+};
+#else
+// Headless builds elsewhere have no foreground application to make room for, so the budget stays
+// fixed: workers run on the CPUs [Threads] Cores allows, each stage's priority mapped to a nice value.
+class ThreadBudget {
+public:
+    void Configure(const AppConfig& config) {
+        auto all_cpus = EnumerateCpus();
+        std::lock_guard lock(mutex_);
+        priorities_ = { config.capture_priority, config.ocr_priority, config.translate_priority };
+        cpus_ = OrderCpusForBudget(all_cpus, config.cores);
+        int physical_cores = CountPhysicalCores(cpus_);
+        if (physical_cores == 0) physical_cores = static_cast<int>((std::max)(std::thread::hardware_concurrency(), 1u));
+        translate_threads_ = config.translate_threads > 0 ? config.translate_threads : physical_cores;
+        for (const auto& [id, role] : threads_) ApplyLocked(id, role);
+    }
 
-    try {
-        SoftwareBitmap softwareBitmap(BitmapPixelFormat::Bgra8, width, height, BitmapAlphaMode::Ignore);
+    int translate_threads() const {
+        std::lock_guard lock(mutex_);
+        return translate_threads_;
+    }
 
-        BitmapBuffer buffer = softwareBitmap.LockBuffer(BitmapBufferAccessMode::Write);
-        IMemoryBufferReference reference = buffer.CreateReference();
+    int allowed_cpus() const {
+        std::lock_guard lock(mutex_);
+        return static_cast<int>(cpus_.size());
+    }
 
-        uint8_t* destPixels = nullptr;
-        uint32_t capacity = 0;
+    int budget() const { return allowed_cpus(); }
 
-        auto byteAccess = reference.as<::Windows::Storage::Streams::IBufferByteAccess>();
-        winrt::check_hresult(byteAccess->Buffer(&destPixels));
-        capacity = reference.Capacity();
+    void RegisterCurrentThread(ThreadRole role) {
+        auto id = static_cast<pid_t>(syscall(SYS_gettid));
+        std::lock_guard lock(mutex_);
+        threads_[id] = role;
+        ApplyLocked(id, role);
+    }
 
-        if (capacity >= pixels.size()) {
-            std::copy(pixels.begin(), pixels.end(), destPixels);
-        } else {
-            reference.Close();
-            buffer.Close();
-            return nullptr;
+    void UnregisterCurrentThread() {
+        std::lock_guard lock(mutex_);
+        threads_.erase(static_cast<pid_t>(syscall(SYS_gettid)));
+    }
+
+private:
+    // The CPUs this process may run on, with their topology from sysfs. A higher cpu_capacity (on
+    // big.LITTLE and hybrid parts) is a faster core, as a higher efficiency class is on Windows.
+    static std::vector<LogicalCpu> EnumerateCpus() {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return {};
+        std::vector<LogicalCpu> cpus;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (!CPU_ISSET(cpu, &allowed)) continue;
+            auto directory = std::filesystem::path("/sys/devices/system/cpu") / ("cpu" + std::to_string(cpu));
+            auto read = [&](const char* file, int fallback) {
+                std::ifstream in(directory / file);
+                int value = 0;
+                return (in >> value) ? value : fallback;
+            };
+            int core = (read("topology/physical_package_id", 0) << 16) | read("topology/core_id", cpu);
+            cpus.push_back({ static_cast<uint32_t>(cpu), core, read("cpu_capacity", 0) });
         }
+        return cpus;
+    }
 
-        reference.Close();
-        buffer.Close();
-        return softwareBitmap;
+    static int NiceValue(StagePriority priority) {
+        switch (priority) {
+        case StagePriority::Idle: return 19;
+        case StagePriority::BelowNormal: return 5;
+        default: return 0;
+        }
+    }
 
-    } catch (winrt::hresult_error const&) {
-        return nullptr;
+    // Raising a thread back to nice 0 needs CAP_SYS_NICE; without it the thread keeps its lower priority.
+    void ApplyLocked(pid_t thread, ThreadRole role) const {
+        setpriority(PRIO_PROCESS, static_cast<id_t>(thread), NiceValue(priorities_[static_cast<size_t>(role)]));
+        if (cpus_.empty()) return;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (const auto& cpu : cpus_) CPU_SET(cpu.id, &set);
+        sched_setaffinity(thread, sizeof(set), &set);
     }
-}
 
-LRESULT CALLBACK OverlayWndProc(HWND hwnd, UINT msg, WPARAM wp, LPARAM lp) {
-    switch (msg) {
-    case WM_PAINT: {
-        PAINTSTRUCT ps;
-        HDC hdc = BeginPaint(hwnd, &ps);
-        SetBkMode(hdc, TRANSPARENT);
-        SetTextColor(hdc, RGB(255, 255, 0));
-        RECT client_rect;
-        GetClientRect(hwnd, &client_rect);
+    mutable std::mutex mutex_;
+    std::array<StagePriority, 3> priorities_ = { StagePriority::Normal, StagePriority::BelowNormal, StagePriority::BelowNormal };
+    std::vector<LogicalCpu> cpus_;  // allowed CPUs in budget order
+    int translate_threads_ = 1;
+    std::unordered_map<pid_t, ThreadRole> threads_;
+};
+#endif
 
-        HFONT hFont = CreateFontW(24, 0, 0, 0, FW_BOLD, FALSE, FALSE, FALSE, DEFAULT_CHARSET,
-            OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS, DEFAULT_QUALITY,
-            DEFAULT_PITCH | FF_SWISS, L"Arial");
-        HFONT oldFont = static_cast<HFONT>(SelectObject(hdc, hFont));
-        DrawTextW(hdc, g_current_overlay_text.c_str(), -1, &client_rect, DT_CENTER | DT_VCENTER | DT_WORDBREAK | DT_NOCLIP);
-        SelectObject(hdc, oldFont);
-        DeleteObject(hFont);
-        EndPaint(hwnd, &ps);
-        return 0;
-    }
-    }
-    return DefWindowProc(hwnd, msg, wp, lp);
+// OrtCustomCreateThreadFn / OrtCustomJoinThreadFn for the shared pool; `budget` is a ThreadBudget.
+OrtCustomThreadHandle CreateBudgetedOrtThread(void* budget, OrtThreadWorkerFn worker, void* worker_param) {
+    auto* thread = new std::thread([budget, worker, worker_param] {
+        auto& thread_budget = *static_cast<ThreadBudget*>(budget);
+        thread_budget.RegisterCurrentThread(ThreadRole::Translate);
+        worker(worker_param);
+        thread_budget.UnregisterCurrentThread();
+    });
+    return reinterpret_cast<OrtCustomThreadHandle>(thread);
 }
 
-void RegisterOverlayWindowClass(HINSTANCE hInstance) {
-    WNDCLASSW wc = { 0 };
-    wc.lpfnWndProc = OverlayWndProc;
-    wc.hInstance = hInstance;
-    wc.lpszClassName = OVERLAY_WINDOW_CLASS;
-    wc.hbrBackground = static_cast<HBRUSH>(GetStockObject(BLACK_BRUSH));
-    wc.style = CS_HREDRAW | CS_VREDRAW;
-    if (!RegisterClassW(&wc)) {
-        show_message_box(L"Failed to register overlay window class.", L"Error");
-    }
+void JoinBudgetedOrtThread(OrtCustomThreadHandle handle) {
+    std::unique_ptr<std::thread> thread(reinterpret_cast<std::thread*>(const_cast<OrtCustomHandleType*>(handle)));
+    thread->join();
 }
 
-void UnregisterOverlayWindowClass(HINSTANCE hInstance) {
-    UnregisterClassW(OVERLAY_WINDOW_CLASS, hInstance);
-}
+// --- Global State ---
 
-void CreateOrUpdateOverlayWindow(const std::wstring& text, const RECT& target_ocr_region) {
-    g_current_overlay_text = text;
+ThreadBudget g_thread_budget;
+std::unique_ptr<Ort::Env> env; // created by InitTranslationEngine, once g_thread_budget is configured
+Ort::SessionOptions session_options;
+// Describes CPU buffers wrapped as tensors, which it never allocates; also names the shared arena
+// registered by CreateOrtEnvironment under [Memory] ArenaLimitMB.
+Ort::MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+AppConfig g_config;
+StartupMetrics g_startup_metrics;
+std::unique_ptr<TranslationClient> g_translation_service; // set when [Service] Connect reached a running service
 
-    if (!g_overlay_hwnd) {
-        int overlay_width = 600;
-        int overlay_height = 100;
-        int overlay_x = target_ocr_region.left;
-        int overlay_y = target_ocr_region.bottom + 5;
+constexpr int32_t BOS_TOKEN_ID = 0;
+constexpr int32_t EOS_TOKEN_ID = 2;
+constexpr int32_t PAD_TOKEN_ID = 0;
+constexpr int MAX_DECODE_STEPS = 128;
+constexpr size_t MAX_BATCH_SEGMENTS = 16;
+constexpr size_t MAX_BATCH_PADDED_TOKENS = 1024;
+constexpr size_t MAX_CHUNK_SOURCE_TOKENS = 96; // leaves the decoder room below MAX_DECODE_STEPS
+constexpr size_t MAX_DRAFT_BLOCK = 8;
+constexpr size_t TRANSLATION_CACHE_MEMORY_BUDGET = 16u << 20;
+constexpr uint64_t TRANSLATION_CACHE_DISK_BUDGET = 256ull << 20;
+constexpr std::chrono::milliseconds FASTEST_POLL_INTERVAL{ 100 };
+constexpr std::chrono::milliseconds SLOWEST_POLL_INTERVAL{ 1000 };
+constexpr std::chrono::milliseconds ENGINE_WAIT_POLL_INTERVAL{ 50 };
+constexpr std::chrono::milliseconds PARTIAL_OVERLAY_INTERVAL{ 100 };
+constexpr std::chrono::milliseconds TRACE_STATS_INTERVAL{ 10000 };
+constexpr GraphOptimizationLevel GRAPH_OPTIMIZATION_LEVEL = GraphOptimizationLevel::ORT_ENABLE_ALL;
+constexpr std::string_view PAST_INPUT_PREFIX = "past_key_values.";
+constexpr std::string_view PRESENT_OUTPUT_PREFIX = "present.";
 
-        HMONITOR hMonitor = MonitorFromRect(&target_ocr_region, MONITOR_DEFAULTTONEAREST);
-        MONITORINFO monitorInfo = { sizeof(monitorInfo) };
-        if (GetMonitorInfo(hMonitor, &monitorInfo)) {
-            if (overlay_x + overlay_width > monitorInfo.rcWork.right)
-                overlay_x = monitorInfo.rcWork.right - overlay_width;
-            if (overlay_y + overlay_height > monitorInfo.rcWork.bottom)
-                overlay_y = monitorInfo.rcWork.bottom - overlay_height;
-            if (overlay_x < monitorInfo.rcWork.left) overlay_x = monitorInfo.rcWork.left;
-            if (overlay_y < monitorInfo.rcWork.top) overlay_y = monitorInfo.rcWork.top;
-        }
+#ifdef _WIN32
+constexpr UINT ESCAPE_POLL_INTERVAL_MS = 50;
+constexpr UINT WM_APP_OVERLAY_READY = WM_APP + 1;
+constexpr UINT WM_APP_ENGINE_FAILED = WM_APP + 2;
+
+bool g_fullscreen_mode = true;
+std::wstring g_current_overlay_text;
+HWND g_overlay_hwnd = nullptr;
+const wchar_t OVERLAY_WINDOW_CLASS[] = L"OcrTranslationOverlayWindowClass";
+HINSTANCE g_hinstance = nullptr;
+#endif
+
+// --- Allocation Counting ---
+
+// Only benchmark builds (OSL_COUNT_ALLOCATIONS, see CMakeLists.txt) replace operator new, so the
+// product pays nothing for the counter.
+#ifdef OSL_COUNT_ALLOCATIONS
+// operator new calls made by this module on the current thread; read by the decode benchmarks.
+// Allocations inside onnxruntime.dll go through its own allocator and are not counted.
+thread_local uint64_t g_thread_allocation_count = 0;
+
+void* operator new(size_t size) {
+    ++g_thread_allocation_count;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+#endif
+
+// Heap allocations `run` makes on this thread, or nullopt in builds that don't count them.
+template <class F>
+std::optional<uint64_t> CountAllocations(F&& run) {
+#ifdef OSL_COUNT_ALLOCATIONS
+    uint64_t before = g_thread_allocation_count;
+    run();
+    return g_thread_allocation_count - before;
+#else
+    run();
+    return std::nullopt;
+#endif
+}
+
+// --- Forward Declarations ---
+#ifdef _WIN32
+LRESULT CALLBACK OverlayWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
+void RegisterOverlayWindowClass(HINSTANCE hInstance);
+void UnregisterOverlayWindowClass(HINSTANCE hInstance);
+void CreateOrUpdateOverlayWindow(const std::wstring& text, const RECT& target_region);
+#endif
+std::filesystem::path GetModelsDirectoryPath();
+std::filesystem::path GetCacheDirectoryPath();
+void ReportTranslationCacheStats();
+
+// --- Implementation ---
+
+std::filesystem::path g_models_directory; // set by --models; empty means models\ next to the executable
+
+std::filesystem::path GetExecutablePath() {
+#ifdef _WIN32
+    std::vector<wchar_t> exePathBuffer(MAX_PATH);
+    DWORD len = GetModuleFileNameW(nullptr, exePathBuffer.data(), static_cast<DWORD>(exePathBuffer.size()));
+    return std::wstring(exePathBuffer.data(), len);
+#else
+    std::error_code ec;
+    return std::filesystem::read_symlink("/proc/self/exe", ec);
+#endif
+}
+
+std::filesystem::path GetModelsDirectoryPath() {
+    if (!g_models_directory.empty()) return g_models_directory;
+    auto path = GetExecutablePath().parent_path() / L"models";
+    return path;
+}
+
+std::filesystem::path GetConfigFilePath() {
+    return GetModelsDirectoryPath().parent_path() / L"OfflineScreenLance.ini";
+}
+
+// Reads OfflineScreenLance.ini: through GetPrivateProfileString on Windows, and elsewhere by
+// parsing it the same way ("[Section]" headers, "Key=value" lines, case-insensitive names, ';'
+// comment lines, surrounding spaces trimmed, the first of repeated keys used).
+class ConfigFile {
+public:
+    explicit ConfigFile(std::filesystem::path path) : path_(std::move(path)) {
+#ifndef _WIN32
+        std::ifstream file(path_);
+        std::string line, section;
+        while (std::getline(file, line)) {
+            auto text = Trim(utf8_to_wstring(line));
+            if (text.empty() || text[0] == L';') continue;
+            if (text.front() == L'[' && text.back() == L']') {
+                section = Lowercase(text.substr(1, text.size() - 2));
+                continue;
+            }
+            auto equals = text.find(L'=');
+            if (equals == std::wstring::npos) continue;
+            values_.emplace(section + "/" + Lowercase(Trim(text.substr(0, equals))), Trim(text.substr(equals + 1)));
+        }
+#endif
+    }
+
+    std::wstring String(const wchar_t* section, const wchar_t* key, const wchar_t* fallback) const {
+#ifdef _WIN32
+        wchar_t value[MAX_PATH] = {};
+        GetPrivateProfileStringW(section, key, fallback, value, MAX_PATH, path_.wstring().c_str());
+        return value;
+#else
+        auto it = values_.find(Lowercase(section) + "/" + Lowercase(key));
+        return it != values_.end() ? it->second : fallback;
+#endif
+    }
+
+    // Like GetPrivateProfileInt: the leading digits of the value, so "auto" reads as 0.
+    unsigned Int(const wchar_t* section, const wchar_t* key, unsigned fallback) const {
+#ifdef _WIN32
+        return GetPrivateProfileIntW(section, key, static_cast<int>(fallback), path_.wstring().c_str());
+#else
+        auto it = values_.find(Lowercase(section) + "/" + Lowercase(key));
+        return it != values_.end() ? static_cast<unsigned>(std::wcstol(it->second.c_str(), nullptr, 10)) : fallback;
+#endif
+    }
+
+    const std::filesystem::path& path() const { return path_; }
+
+private:
+#ifndef _WIN32
+    static std::wstring Trim(std::wstring_view text) {
+        while (!text.empty() && std::iswspace(text.front())) text.remove_prefix(1);
+        while (!text.empty() && std::iswspace(text.back())) text.remove_suffix(1);
+        return std::wstring(text);
+    }
+
+    static std::string Lowercase(std::wstring_view text) {
+        std::string lower;
+        for (wchar_t c : text) lower += static_cast<char>(std::towlower(c));
+        return lower;
+    }
+
+    std::unordered_map<std::string, std::wstring> values_; // "section/key", lowercase
+#endif
+    std::filesystem::path path_;
+};
+
+AppConfig LoadAppConfig() {
+    AppConfig config;
+    ConfigFile ini(GetConfigFilePath());
+    if (auto precision = ParseModelPrecision(ini.String(L"Translation", L"Precision", L"auto"))) config.precision = *precision;
+    config.speculative_decoding = ini.Int(L"Translation", L"Speculative", 1) != 0;
+    config.streaming_overlay = ini.Int(L"Translation", L"Streaming", 1) != 0;
+    config.shortlist = ini.Int(L"Translation", L"Shortlist", 1) != 0;
+    config.shortlist_first = ini.Int(L"Translation", L"ShortlistFirst", 100);
+    config.shortlist_best = ini.Int(L"Translation", L"ShortlistBest", 100);
+    config.shortlist_check = ini.Int(L"Translation", L"ShortlistCheck", 4);
+    if (config.shortlist_check == 0) config.shortlist = false;
+    config.shortlist_tolerance = static_cast<float>((std::max)(std::wcstod(ini.String(L"Translation", L"ShortlistTolerance", L"0").c_str(), nullptr), 0.0));
+    config.model_pair = ini.String(L"Models", L"Pair", L"");
+    config.source_language = PrimaryLanguageSubtag(ini.String(L"Models", L"Source", L"auto")); // "auto" is four letters, so it reads as empty
+    config.target_language = PrimaryLanguageSubtag(ini.String(L"Models", L"Target", L""));
+    config.model_memory_budget = static_cast<uint64_t>(ini.Int(L"Models", L"MemoryBudgetMB", 1024)) << 20;
+    config.shared_weights = ini.Int(L"Memory", L"SharedWeights", 0) != 0;
+    config.ort_arena = ini.Int(L"Memory", L"Arena", 1) != 0;
+    config.ort_arena_limit = static_cast<uint64_t>(ini.Int(L"Memory", L"ArenaLimitMB", 0)) << 20;
+    config.use_service = ini.Int(L"Service", L"Connect", 0) != 0;
+    if (auto name = ini.String(L"Service", L"Name", L"OfflineScreenLance"); !name.empty()) config.service_name = wstring_to_utf8(name);
+    config.service_batch_delay = std::chrono::milliseconds(ini.Int(L"Service", L"BatchDelayMs", 5));
+    config.ocr_preprocess = ini.Int(L"Ocr", L"Preprocess", 1) != 0;
+    // "auto" is not a number, so it reads as 0.
+    config.ocr_downscale = static_cast<int>(ini.Int(L"Ocr", L"Downscale", 0));
+    config.ocr_dirty_regions = ini.Int(L"Ocr", L"DirtyRegions", 1) != 0;
+    config.ocr_jitter_threshold = (std::max)(std::wcstod(ini.String(L"Ocr", L"JitterThreshold", L"0.05").c_str(), nullptr), 0.0);
+
+    config.translate_threads = static_cast<int>(ini.Int(L"Threads", L"Translate", 0));
+    if (auto cores = ParseCorePreference(ini.String(L"Threads", L"Cores", L"any"))) config.cores = *cores;
+    config.threads_adaptive = ini.Int(L"Threads", L"Adaptive", 1) != 0;
+    config.ort_spinning = ini.Int(L"Threads", L"Spin", 0) != 0;
+    auto read_priority = [&](const wchar_t* key, StagePriority fallback) {
+        return ParseStagePriority(ini.String(L"Threads", key, L"")).value_or(fallback);
+    };
+    config.capture_priority = read_priority(L"CapturePriority", config.capture_priority);
+    config.ocr_priority = read_priority(L"OcrPriority", config.ocr_priority);
+    config.translate_priority = read_priority(L"TranslatePriority", config.translate_priority);
+
+    config.trace = ini.Int(L"Trace", L"Enabled", 0) != 0;
+    config.trace_file = ini.path().parent_path() / ini.String(L"Trace", L"ChromeTrace", L"OfflineScreenLance.trace.json");
+    config.trace_stats_log = ini.path().parent_path() / ini.String(L"Trace", L"StatsLog", L"OfflineScreenLance.stats.log");
+    return config;
+}
+
+// File name suffixes used for each precision by Optimum and transformers.js exports, e.g.
+// encoder_model_quantized.onnx or decoder_model_merged_fp16.onnx.
+std::vector<std::wstring> GetPrecisionSuffixes(ModelPrecision precision) {
+    switch (precision) {
+    case ModelPrecision::Fp16: return { L"_fp16" };
+    case ModelPrecision::Int8: return { L"_quantized", L"_int8" };
+    default: return { L"" };
+    }
+}
+
+// Looks for a complete set of graphs at `precision`. Auto tries int8 first, then fp32.
+std::optional<ModelFiles> FindModelFiles(const std::filesystem::path& models_dir, ModelPrecision precision) {
+    if (precision == ModelPrecision::Auto) {
+        if (auto files = FindModelFiles(models_dir, ModelPrecision::Int8)) return files;
+        return FindModelFiles(models_dir, ModelPrecision::Fp32);
+    }
+    for (const auto& suffix : GetPrecisionSuffixes(precision)) {
+        ModelFiles files;
+        files.precision = precision;
+        files.encoder = models_dir / (L"encoder_model" + suffix + L".onnx");
+        files.decoder = models_dir / (L"decoder_model" + suffix + L".onnx");
+        files.decoder_merged = models_dir / (L"decoder_model_merged" + suffix + L".onnx");
+        files.decoder_with_past = models_dir / (L"decoder_with_past_model" + suffix + L".onnx");
+        if (!std::filesystem::exists(files.encoder)) continue;
+        if (!std::filesystem::exists(files.decoder) && !std::filesystem::exists(files.decoder_merged)) continue;
+        return files;
+    }
+    return std::nullopt;
+}
+
+// Translation memo store lives next to the models directory.
+std::filesystem::path GetCacheDirectoryPath() {
+    return GetModelsDirectoryPath().parent_path() / L"cache";
+}
+
+// Identifies the loaded model set by file name, size and modification time, so replacing any
+// model file starts a fresh translation cache.
+uint64_t ComputeModelIdentity(const std::vector<std::filesystem::path>& model_files) {
+    uint64_t identity = Fnv1a64({});
+    for (const auto& file : model_files) {
+        std::error_code ec;
+        if (!std::filesystem::exists(file, ec)) continue;
+        auto size = std::filesystem::file_size(file, ec);
+        auto modified = std::filesystem::last_write_time(file, ec).time_since_epoch().count();
+        identity = Fnv1a64(wstring_to_utf8(file.filename().wstring()), identity);
+        identity = Fnv1a64(std::string_view(reinterpret_cast<const char*>(&size), sizeof(size)), identity);
+        identity = Fnv1a64(std::string_view(reinterpret_cast<const char*>(&modified), sizeof(modified)), identity);
+    }
+    return identity;
+}
+
+// --- Optimized Graph Cache ---
+
+// Optimizing the graphs at ORT_ENABLE_ALL dominates session creation, so the optimized graph is
+// serialized under cache/ort on first load and read back with optimizations disabled afterwards.
+// Cached graphs are named "<stem>_<source>_<version>": `source` hashes the model file's full path,
+// so pairs whose files share a name (every pair has an encoder_model.onnx) keep their own entries,
+// and `version` covers the file's identity, the ORT version and the optimization level.
+// ENABLE_ALL output can contain hardware-specific layouts, which is fine for a per-machine cache.
+// With [Memory] SharedWeights the cache is kept in ORT format (.ort) instead of ONNX.
+std::filesystem::path GetOptimizedGraphPath(const std::filesystem::path& model_path) {
+    std::error_code ec;
+    auto source_path = std::filesystem::absolute(model_path, ec).lexically_normal();
+    uint64_t source = Fnv1a64(wstring_to_utf8((ec ? model_path : source_path).wstring()));
+    uint64_t version = ComputeModelIdentity({ model_path });
+    version = Fnv1a64(Ort::GetVersionString(), version);
+    version = Fnv1a64(std::to_string(static_cast<int>(GRAPH_OPTIMIZATION_LEVEL)), version);
+    return GetCacheDirectoryPath() / L"ort" / std::format(L"{}_{:016x}_{:016x}{}", model_path.stem().wstring(), source, version,
+        g_config.shared_weights ? L".ort" : L".onnx");
+}
+
+// Deletes graphs cached for older versions of the same model file, i.e. entries that differ from
+// `current` only in their last 16 hex digits. Other files, including another pair's graphs and
+// the other format's copy of the current version, are left alone.
+void RemoveStaleOptimizedGraphs(const std::filesystem::path& current) {
+    auto stem = current.stem().wstring();
+    auto source_prefix = stem.substr(0, stem.size() - 16); // "<stem>_<source>_"
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(current.parent_path(), ec)) {
+        auto name = entry.path().stem().wstring();
+        bool same_source = name.size() == stem.size() && name.starts_with(source_prefix);
+        bool same_format = entry.path().extension() == current.extension();
+        if (same_source && same_format && entry.path() != current) {
+            std::filesystem::remove(entry.path(), ec);
+        }
+    }
+}
+
+// A session and, when it runs its graph in place from a mapped file, that mapping. The mapping has
+// to outlive the session.
+struct GraphSession {
+    std::unique_ptr<MappedFile> mapping;
+    std::unique_ptr<Ort::Session> session;
+};
+
+// Opens a cached optimized graph. A truncated or unreadable one is deleted, to be rebuilt.
+std::optional<GraphSession> LoadOptimizedGraph(const std::filesystem::path& optimized_path) {
+    std::error_code ec;
+    if (!std::filesystem::exists(optimized_path, ec)) return std::nullopt;
+    try {
+        Ort::SessionOptions cached_options = session_options.Clone();
+        cached_options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_DISABLE_ALL);
+        GraphSession graph;
+        if (g_config.shared_weights) {
+            // ORT-format graphs run straight from the mapped bytes, initializers included, so every
+            // process loading this file shares one copy of the weights through the page cache.
+            // Prepacking would make private copies of the weights again.
+            graph.mapping = std::make_unique<MappedFile>();
+            if (!graph.mapping->OpenReadOnly(optimized_path)) return std::nullopt;
+            cached_options.AddConfigEntry("session.use_ort_model_bytes_directly", "1");
+            cached_options.AddConfigEntry("session.use_ort_model_bytes_for_initializers", "1");
+            cached_options.AddConfigEntry("session.disable_prepacking", "1");
+            graph.session = std::make_unique<Ort::Session>(*env, graph.mapping->data(), static_cast<size_t>(graph.mapping->size()), cached_options);
+        } else {
+            graph.session = std::make_unique<Ort::Session>(*env, optimized_path.c_str(), cached_options);
+        }
+        return graph;
+    } catch (const Ort::Exception&) {
+        std::filesystem::remove(optimized_path, ec);
+        return std::nullopt;
+    }
+}
+
+GraphSession CreateSessionWithGraphCache(const std::filesystem::path& model_path) {
+    auto optimized_path = GetOptimizedGraphPath(model_path);
+    if (auto graph = LoadOptimizedGraph(optimized_path)) {
+        ++g_startup_metrics.graphs_reused;
+        return std::move(*graph);
+    }
+
+    std::error_code ec;
+    auto partial_path = optimized_path;
+    partial_path += L".partial";
+    Ort::SessionOptions optimizing_options = session_options.Clone();
+    bool write_cache = std::filesystem::create_directories(optimized_path.parent_path(), ec) || !ec;
+    if (write_cache) {
+        optimizing_options.SetOptimizedModelFilePath(partial_path.c_str());
+        // The format would otherwise follow the .partial extension.
+        optimizing_options.AddConfigEntry("session.save_model_format", g_config.shared_weights ? "ORT" : "ONNX");
+    }
+
+    std::unique_ptr<Ort::Session> session;
+    try {
+        session = std::make_unique<Ort::Session>(*env, model_path.c_str(), optimizing_options);
+    } catch (const Ort::Exception&) {
+        if (!write_cache) throw;
+        // Some graphs can't be serialized (in ORT format, for one); run them uncached.
+        std::filesystem::remove(partial_path, ec);
+        write_cache = false;
+        session = std::make_unique<Ort::Session>(*env, model_path.c_str(), session_options);
+    }
+    ++g_startup_metrics.graphs_optimized;
+    if (write_cache) {
+        // Renamed into place only once complete, so a crash never leaves a truncated graph behind.
+        std::filesystem::rename(partial_path, optimized_path, ec);
+        if (!ec) {
+            RemoveStaleOptimizedGraphs(optimized_path);
+            // Trade the private copy of the weights for the shared mapping now rather than next start.
+            if (g_config.shared_weights) {
+                if (auto graph = LoadOptimizedGraph(optimized_path)) return std::move(*graph);
+            }
+        }
+    }
+    return { nullptr, std::move(session) };
+}
+
+std::vector<std::string> GetSessionInputNames(const Ort::Session& session) {
+    Ort::AllocatorWithDefaultOptions allocator;
+    std::vector<std::string> names;
+    for (size_t i = 0; i < session.GetInputCount(); ++i) {
+        names.emplace_back(session.GetInputNameAllocated(i, allocator).get());
+    }
+    return names;
+}
+
+std::vector<std::string> GetSessionOutputNames(const Ort::Session& session) {
+    Ort::AllocatorWithDefaultOptions allocator;
+    std::vector<std::string> names;
+    for (size_t i = 0; i < session.GetOutputCount(); ++i) {
+        names.emplace_back(session.GetOutputNameAllocated(i, allocator).get());
+    }
+    return names;
+}
+
+inline bool ContainsName(const std::vector<std::string>& names, std::string_view name) {
+    return std::find(names.begin(), names.end(), name) != names.end();
+}
+
+// Works out which KV-cache protocol the decoder graph(s) speak. Anything unexpected
+// falls back to FullPrefix, which only needs input_ids/encoder_hidden_states -> logits.
+// Graphs ending at last_hidden_state are read from that output instead when they have no logits
+// output or `prefer_hidden_state` is set (the model has an output projection to score with).
+DecoderLayout DetectDecoderLayout(const Ort::Session& decoder, const Ort::Session* decoder_with_past, bool prefer_hidden_state = false) {
+    auto decoder_inputs = GetSessionInputNames(decoder);
+    auto decoder_outputs = GetSessionOutputNames(decoder);
+
+    DecoderLayout full_prefix;
+    full_prefix.first_step_inputs = decoder_inputs;
+    full_prefix.first_step_outputs = { "logits" };
+    full_prefix.hidden_state_output = ContainsName(decoder_outputs, "last_hidden_state")
+        && (prefer_hidden_state || !ContainsName(decoder_outputs, "logits"));
+    if (full_prefix.hidden_state_output) full_prefix.first_step_outputs = { "last_hidden_state" };
+    for (size_t i = 0; i < decoder.GetOutputCount(); ++i) {
+        if (decoder_outputs[i] == full_prefix.first_step_outputs[0]) {
+            auto output_info = decoder.GetOutputTypeInfo(i).GetTensorTypeAndShapeInfo();
+            auto output_shape = output_info.GetShape();
+            if (!output_shape.empty()) (full_prefix.hidden_state_output ? full_prefix.hidden_size : full_prefix.vocab_size) = output_shape.back();
+            full_prefix.logits_type = output_info.GetElementType();
+        }
+    }
+    for (size_t i = 0; i < decoder.GetInputCount(); ++i) {
+        if (decoder_inputs[i] == "encoder_attention_mask") {
+            full_prefix.needs_encoder_attention_mask = true;
+            full_prefix.mask_type = decoder.GetInputTypeInfo(i).GetTensorTypeAndShapeInfo().GetElementType();
+        }
+    }
+
+    DecoderLayout layout = full_prefix;
+    const Ort::Session* step_session = nullptr;
+    if (ContainsName(decoder_inputs, "use_cache_branch")) {
+        layout.variant = DecoderVariant::Merged;
+        step_session = &decoder;
+    } else if (decoder_with_past) {
+        layout.variant = DecoderVariant::WithPast;
+        step_session = decoder_with_past;
+    } else {
+        return full_prefix;
+    }
+
+    auto step_inputs = GetSessionInputNames(*step_session);
+    auto step_outputs = GetSessionOutputNames(*step_session);
+
+    layout.next_step_inputs = step_inputs;
+    layout.next_step_outputs = { layout.first_step_outputs[0] };
+    if (!ContainsName(step_outputs, layout.next_step_outputs[0])) return full_prefix;
+
+    for (const auto& past_name : step_inputs) {
+        if (!past_name.starts_with(PAST_INPUT_PREFIX)) continue;
+        auto present_name = std::string(PRESENT_OUTPUT_PREFIX) + past_name.substr(PAST_INPUT_PREFIX.size());
+        // The first step has to produce every cache entry later steps consume.
+        if (!ContainsName(decoder_outputs, present_name)) return full_prefix;
+        layout.first_step_outputs.push_back(present_name);
+        // Cross-attention entries are only re-emitted by merged graphs; otherwise they are kept from step one.
+        if (ContainsName(step_outputs, present_name)) layout.next_step_outputs.push_back(present_name);
+        layout.present_to_past.emplace(present_name, past_name);
+    }
+    if (layout.present_to_past.empty()) return full_prefix;
+
+    for (size_t i = 0; i < step_session->GetInputCount(); ++i) {
+        const auto& name = step_inputs[i];
+        auto tensor_info = step_session->GetInputTypeInfo(i).GetTensorTypeAndShapeInfo();
+        if (name == "encoder_attention_mask") {
+            layout.needs_encoder_attention_mask = true;
+            layout.mask_type = tensor_info.GetElementType();
+        } else if (name == "input_ids") {
+            auto shape = tensor_info.GetShape();
+            layout.step_accepts_blocks = shape.size() >= 2 && shape[1] < 0;
+        } else if (name.starts_with(PAST_INPUT_PREFIX)) {
+            layout.past_type = tensor_info.GetElementType();
+            if (layout.variant == DecoderVariant::Merged) {
+                // [batch, num_heads, past_sequence_length, head_dim] with no past yet; batch is set per request.
+                auto shape = tensor_info.GetShape();
+                for (auto& dim : shape) if (dim < 0) dim = 1;
+                shape[2] = 0;
+                layout.empty_past_shapes.emplace_back(name, std::move(shape));
+            }
+        }
+    }
+    return layout;
+}
+
+EncoderLayout DetectEncoderLayout(const Ort::Session& encoder) {
+    EncoderLayout layout;
+    layout.input_names = GetSessionInputNames(encoder);
+    for (size_t i = 0; i < encoder.GetInputCount(); ++i) {
+        if (layout.input_names[i] == "attention_mask") {
+            layout.has_attention_mask = true;
+            layout.mask_type = encoder.GetInputTypeInfo(i).GetTensorTypeAndShapeInfo().GetElementType();
+        }
+    }
+    return layout;
+}
+
+// One intra-op pool shared by every session, instead of the encoder and each decoder spinning up
+// a pool sized for the whole machine. Its threads are created through g_thread_budget, so they
+// follow the [Threads] core, priority and load settings like the pipeline stages do.
+void CreateOrtEnvironment() {
+    if (env) return;
+    Ort::ThreadingOptions threading_options;
+    threading_options.SetGlobalIntraOpNumThreads(g_thread_budget.translate_threads());
+    threading_options.SetGlobalInterOpNumThreads(1);
+    threading_options.SetGlobalSpinControl(g_config.ort_spinning ? 1 : 0);
+    threading_options.SetGlobalCustomThreadCreationOptions(&g_thread_budget);
+    threading_options.SetGlobalCustomCreateThreadFn(CreateBudgetedOrtThread);
+    threading_options.SetGlobalCustomJoinThreadFn(JoinBudgetedOrtThread);
+    env = std::make_unique<Ort::Env>(threading_options, ORT_LOGGING_LEVEL_WARNING, "ocr-translator-env");
+    if (g_config.ort_arena && g_config.ort_arena_limit > 0) {
+        // One capped arena for every session, growing only by what each request needs.
+        Ort::ArenaCfg arena_config(static_cast<size_t>(g_config.ort_arena_limit), 1 /* kSameAsRequested */, -1, -1);
+        env->CreateAndRegisterAllocator(memory_info, arena_config);
+    }
+}
+
+// --- Memory Usage ---
+
+// The working set by page kind. Shareable pages can be mapped by several processes at once (mapped
+// model graphs, DLL code); shared ones currently are.
+struct MemoryUsage {
+    uint64_t resident_bytes = 0;
+    uint64_t shareable_bytes = 0;
+    uint64_t shared_bytes = 0;
+
+    uint64_t private_bytes() const { return resident_bytes - shareable_bytes; }
+};
+
+#ifdef _WIN32
+std::optional<MemoryUsage> QueryMemoryUsage() {
+    SYSTEM_INFO system_info{};
+    GetSystemInfo(&system_info);
+    std::vector<ULONG_PTR> buffer(4096);
+    for (int attempt = 0; attempt < 4; ++attempt) {
+        auto* info = reinterpret_cast<PSAPI_WORKING_SET_INFORMATION*>(buffer.data());
+        if (QueryWorkingSet(GetCurrentProcess(), info, static_cast<DWORD>(buffer.size() * sizeof(ULONG_PTR)))) {
+            MemoryUsage usage;
+            for (ULONG_PTR i = 0; i < info->NumberOfEntries; ++i) {
+                const auto& page = info->WorkingSetInfo[i];
+                usage.resident_bytes += system_info.dwPageSize;
+                if (page.Shared) usage.shareable_bytes += system_info.dwPageSize;
+                if (page.Shared && page.ShareCount > 1) usage.shared_bytes += system_info.dwPageSize;
+            }
+            return usage;
+        }
+        if (GetLastError() != ERROR_BAD_LENGTH) return std::nullopt;
+        // The working set can grow before the next call, so leave some room.
+        size_t entries = static_cast<size_t>(info->NumberOfEntries);
+        buffer.resize(entries + entries / 4 + 1024);
+    }
+    return std::nullopt;
+}
+
+double PeakWorkingSetMb() {
+    PROCESS_MEMORY_COUNTERS memory_counters = { sizeof(memory_counters) };
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &memory_counters, sizeof(memory_counters))) return 0.0;
+    return static_cast<double>(memory_counters.PeakWorkingSetSize) / (1 << 20);
+}
+#else
+// From /proc/self/smaps_rollup: file-backed pages are the shareable ones.
+std::optional<MemoryUsage> QueryMemoryUsage() {
+    std::ifstream smaps("/proc/self/smaps_rollup");
+    std::string field;
+    uint64_t kilobytes = 0, anonymous = 0;
+    MemoryUsage usage;
+    bool found = false;
+    while (smaps >> field) {
+        if (!(smaps >> kilobytes)) {
+            smaps.clear();
+            smaps.ignore((std::numeric_limits<std::streamsize>::max)(), '\n');
+            continue;
+        }
+        if (field == "Rss:") {
+            usage.resident_bytes = kilobytes << 10;
+            found = true;
+        } else if (field == "Anonymous:") {
+            anonymous = kilobytes << 10;
+        } else if (field == "Shared_Clean:" || field == "Shared_Dirty:") {
+            usage.shared_bytes += kilobytes << 10;
+        }
+        smaps.ignore((std::numeric_limits<std::streamsize>::max)(), '\n');
+    }
+    if (!found) return std::nullopt;
+    usage.shareable_bytes = usage.resident_bytes > anonymous ? usage.resident_bytes - anonymous : 0;
+    return usage;
+}
+
+double PeakWorkingSetMb() {
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0.0;
+    return static_cast<double>(usage.ru_maxrss) / 1024; // kilobytes
+}
+#endif
+
+void ReportMemoryUsage(std::wstring_view when) {
+    auto usage = QueryMemoryUsage();
+    if (!usage) return;
+    auto report = std::format(L"Memory {}: {} MB resident, {} MB private, {} MB shareable, {} MB shared with other processes\n",
+        when, usage->resident_bytes >> 20, usage->private_bytes() >> 20, usage->shareable_bytes >> 20, usage->shared_bytes >> 20);
+    DebugReport(report);
+}
+
+// --- Model Registry ---
+
+// Everything one language pair needs to translate. Requests hold it through a shared_ptr, so an
+// evicted pair is only freed once the translations still running on it finish.
+struct TranslationModel {
+    std::string name; // models\ subdirectory, or empty for a model directly in models\ itself
+    std::optional<LanguagePair> pair;
+    ModelPrecision precision = ModelPrecision::Fp32; // what was actually loaded
+    std::vector<std::unique_ptr<MappedFile>> mapped_graphs; // before the sessions reading from them, so it outlives them
+    std::unique_ptr<Ort::Session> encoder_session;
+    std::unique_ptr<Ort::Session> decoder_session;
+    std::unique_ptr<Ort::Session> decoder_with_past_session;
+    sentencepiece::SentencePieceProcessor sp_source_processor;
+    sentencepiece::SentencePieceProcessor sp_target_processor;
+    EncoderLayout encoder_layout;
+    DecoderLayout decoder_layout;
+    std::unique_ptr<MappedFile> projection_file;
+    std::optional<OutputProjection> output_projection; // into projection_file, from output_projection.bin
+    std::unique_ptr<LexicalShortlist> shortlist;       // from lex.s2t, used with output_projection
+    std::unique_ptr<TranslationCache> translation_cache;
+    uint64_t resident_bytes = 0; // estimate: loaded graph and tokenizer file sizes plus the cache's memory budget
+};
+
+struct ModelLoadError {
+    std::wstring title;
+    std::wstring message;
+};
+
+std::wstring ModelDisplayName(const std::string& name) {
+    return name.empty() ? L"models" : utf8_to_wstring(name);
+}
+
+std::shared_ptr<TranslationModel> LoadTranslationModel(const std::filesystem::path& models_dir, ModelPrecision precision,
+    ModelLoadError& error) {
+    auto source_spm_path = models_dir / L"source.spm";
+    auto target_spm_path = models_dir / L"target.spm";
+    auto projection_path = models_dir / L"output_projection.bin";
+    auto lexical_table_path = models_dir / L"lex.s2t";
+
+    auto model_files = FindModelFiles(models_dir, precision);
+    if (!model_files) {
+        error = { L"Model Error", utf8_to_wstring(std::format("No {} encoder/decoder models found in {}",
+            ModelPrecisionName(precision), wstring_to_utf8(models_dir.wstring()))) };
+        return nullptr;
+    }
+    auto model = std::make_shared<TranslationModel>();
+    model->precision = model_files->precision;
+    const auto& encoder_model_path = model_files->encoder;
+    const auto& decoder_model_path = model_files->decoder;
+    const auto& decoder_merged_model_path = model_files->decoder_merged;
+    const auto& decoder_with_past_model_path = model_files->decoder_with_past;
+
+    // SentencePiece: wstring -> utf8 string
+    auto source_spm_path_s = wstring_to_utf8(source_spm_path.wstring());
+    auto target_spm_path_s = wstring_to_utf8(target_spm_path.wstring());
+
+    // Tokenizers and graphs load concurrently. Prefer KV-cache capable exports; plain
+    // decoder_model.onnx keeps working without them.
+    bool use_merged_decoder = std::filesystem::exists(decoder_merged_model_path);
+    bool use_decoder_with_past = !use_merged_decoder && std::filesystem::exists(decoder_with_past_model_path);
+    auto source_load = std::async(std::launch::async, [&] { return model->sp_source_processor.Load(source_spm_path_s.c_str()); });
+    auto target_load = std::async(std::launch::async, [&] { return model->sp_target_processor.Load(target_spm_path_s.c_str()); });
+    auto encoder_load = std::async(std::launch::async, [&] { return CreateSessionWithGraphCache(encoder_model_path); });
+    auto decoder_load = std::async(std::launch::async, [&] {
+        return CreateSessionWithGraphCache(use_merged_decoder ? decoder_merged_model_path : decoder_model_path);
+    });
+    std::future<GraphSession> decoder_with_past_load;
+    if (use_decoder_with_past) {
+        decoder_with_past_load = std::async(std::launch::async, [&] { return CreateSessionWithGraphCache(decoder_with_past_model_path); });
+    }
+
+    // Every load is collected before any error is reported, so none is still running on return.
+    std::optional<std::string> onnx_error;
+    auto collect_session = [&](std::future<GraphSession>& load) -> std::unique_ptr<Ort::Session> {
+        if (!load.valid()) return nullptr;
+        try {
+            auto graph = load.get();
+            if (graph.mapping) model->mapped_graphs.push_back(std::move(graph.mapping));
+            return std::move(graph.session);
+        } catch (const std::exception& e) {
+            if (!onnx_error) onnx_error = e.what();
+            return nullptr;
+        }
+    };
+    auto source_status = source_load.get();
+    auto target_status = target_load.get();
+
+    // The shortlist table is in pieces, so it is read once both tokenizers are, while graphs still load.
+    auto projection_file = std::make_unique<MappedFile>();
+    if (projection_file->OpenReadOnly(projection_path)) {
+        model->output_projection = ParseOutputProjection(projection_file->data(), projection_file->size());
+        if (model->output_projection) model->projection_file = std::move(projection_file);
+    }
+    std::future<std::vector<LexicalEntry>> lexical_table_load;
+    if (g_config.shortlist && model->output_projection && source_status.ok() && target_status.ok()
+        && std::filesystem::exists(lexical_table_path)) {
+        lexical_table_load = std::async(std::launch::async, [&] {
+            auto piece_id = [](const sentencepiece::SentencePieceProcessor& processor) {
+                return [&processor](std::string_view piece) -> std::optional<int32_t> {
+                    int id = processor.PieceToId(piece);
+                    if (id == processor.unk_id()) return std::nullopt;
+                    return id;
+                };
+            };
+            std::ifstream table(lexical_table_path, std::ios::binary);
+            return ReadLexicalTable(table, piece_id(model->sp_source_processor), piece_id(model->sp_target_processor));
+        });
+    }
+    model->encoder_session = collect_session(encoder_load);
+    model->decoder_session = collect_session(decoder_load);
+    model->decoder_with_past_session = collect_session(decoder_with_past_load);
+    if (lexical_table_load.valid()) {
+        model->shortlist = std::make_unique<LexicalShortlist>(lexical_table_load.get(), g_config.shortlist_first, g_config.shortlist_best,
+            model->output_projection->vocab_size, std::vector<int32_t>{ EOS_TOKEN_ID });
+        if (model->shortlist->empty()) model->shortlist.reset();
+    }
+
+    if (!source_status.ok()) {
+        error = { L"Model Error", utf8_to_wstring("Failed to load source SentencePiece model (" + source_spm_path_s + "): " + source_status.ToString()) };
+        return nullptr;
+    }
+    if (!target_status.ok()) {
+        error = { L"Model Error", utf8_to_wstring("Failed to load target SentencePiece model (" + target_spm_path_s + "): " + target_status.ToString()) };
+        return nullptr;
+    }
+    if (onnx_error) {
+        error = { L"ONNX Error", utf8_to_wstring(std::format("Failed to load ONNX models from {}: {}", wstring_to_utf8(models_dir.wstring()), *onnx_error)) };
+        return nullptr;
+    }
+
+    try {
+        model->encoder_layout = DetectEncoderLayout(*model->encoder_session);
+        model->decoder_layout = DetectDecoderLayout(*model->decoder_session, model->decoder_with_past_session.get(),
+            model->output_projection.has_value());
+        if (model->decoder_layout.variant != DecoderVariant::WithPast) {
+            model->decoder_with_past_session.reset();
+        }
+    } catch (const Ort::Exception& e) {
+        error = { L"ONNX Error", utf8_to_wstring(std::format("Failed to load ONNX models from {}: {}", wstring_to_utf8(models_dir.wstring()), e.what())) };
+        return nullptr;
+    }
+    const auto& layout = model->decoder_layout;
+    if (layout.hidden_state_output && (!model->output_projection
+        || (layout.hidden_size > 0 && static_cast<size_t>(layout.hidden_size) != model->output_projection->hidden_size))) {
+        error = { L"Model Error", utf8_to_wstring(std::format("The decoder in {} ends at last_hidden_state, but {} is missing or doesn't match it",
+            wstring_to_utf8(models_dir.wstring()), wstring_to_utf8(projection_path.filename().wstring()))) };
+        return nullptr;
+    }
+    if (!layout.hidden_state_output) {
+        // A logits export scores every token itself; there is nothing to shortlist.
+        model->shortlist.reset();
+        model->output_projection.reset();
+        model->projection_file.reset();
+    }
+
+    std::vector<std::filesystem::path> loaded_files = { source_spm_path, target_spm_path, encoder_model_path,
+        use_merged_decoder ? decoder_merged_model_path : decoder_model_path };
+    if (model->decoder_with_past_session) loaded_files.push_back(decoder_with_past_model_path);
+    if (model->projection_file) loaded_files.push_back(projection_path);
+    model->resident_bytes = TRANSLATION_CACHE_MEMORY_BUDGET + (model->shortlist ? model->shortlist->entry_count() * sizeof(int32_t) : 0);
+    for (const auto& file : loaded_files) {
+        std::error_code ec;
+        auto size = std::filesystem::file_size(file, ec);
+        if (!ec) model->resident_bytes += size;
+    }
+
+    uint64_t model_identity = ComputeModelIdentity({ source_spm_path, target_spm_path, encoder_model_path,
+        decoder_model_path, decoder_merged_model_path, decoder_with_past_model_path, projection_path, lexical_table_path });
+    if (model->shortlist) {
+        // Shortlist decodes can differ from full ones, so each set of [Translation] Shortlist* settings
+        // gets its own cache; a model decoded over the whole vocabulary keeps the plain identity.
+        model_identity = Fnv1a64(std::format("shortlist {} {} {} {}", g_config.shortlist_first, g_config.shortlist_best,
+            g_config.shortlist_check, g_config.shortlist_tolerance), model_identity);
+    }
+    model->translation_cache = std::make_unique<TranslationCache>(GetCacheDirectoryPath(), model_identity,
+        TRANSLATION_CACHE_MEMORY_BUDGET, TRANSLATION_CACHE_DISK_BUDGET);
+    return model;
+}
+
+// The language pairs under models\: each subdirectory holding a model, named for its pair as in
+// "en-de" (see ParseLanguagePair), plus models\ itself for the single-pair layout. Pairs load on
+// first use, and past the [Models] memory budget the least recently used are unloaded again.
+// The default pair is loaded up front and never unloaded, so requests always have a fallback.
+class ModelRegistry {
+public:
+    bool Open(const std::filesystem::path& models_dir, ModelPrecision precision, const AppConfig& config, ModelLoadError& error) {
+        {
+            std::lock_guard lock(mutex_);
+            precision_ = precision;
+            source_language_ = config.source_language;
+            target_language_ = config.target_language;
+            residency_ = ModelResidency(config.model_memory_budget);
+            default_model_.reset();
+            default_entry_ = nullptr;
+            entries_.clear();
+            evictions_ = 0;
+
+            if (FindModelFiles(models_dir, precision)) AddEntryLocked("", models_dir);
+            std::error_code ec;
+            for (const auto& entry : std::filesystem::directory_iterator(models_dir, ec)) {
+                if (entry.is_directory(ec) && FindModelFiles(entry.path(), precision)) {
+                    AddEntryLocked(wstring_to_utf8(entry.path().filename().wstring()), entry.path());
+                }
+            }
+            if (entries_.empty()) {
+                error = { L"Model Error", utf8_to_wstring(std::format("No {} encoder/decoder models found in {}",
+                    ModelPrecisionName(precision), wstring_to_utf8(models_dir.wstring()))) };
+                return false;
+            }
+
+            if (!config.model_pair.empty()) {
+                auto it = entries_.find(wstring_to_utf8(config.model_pair));
+                if (it == entries_.end()) {
+                    error = { L"Model Error", std::format(L"Model pair {} not found in {}", config.model_pair, models_dir.wstring()) };
+                    return false;
+                }
+                default_entry_ = it->second.get();
+            } else if (entries_.contains("")) {
+                default_entry_ = entries_.at("").get();
+            } else {
+                default_entry_ = FindLocked(source_language_);
+                if (!default_entry_) default_entry_ = entries_.begin()->second.get();
+            }
+        }
+        auto model = Load(*default_entry_, error);
+        if (!model) return false;
+        std::lock_guard lock(mutex_);
+        default_model_ = std::move(model);
+        return true;
+    }
+
+    // The default pair. Set once Open has succeeded.
+    std::shared_ptr<TranslationModel> DefaultModel() const {
+        std::lock_guard lock(mutex_);
+        return default_model_;
+    }
+
+    // The pair to translate `texts` with: the one for the configured source language, or else for
+    // the language detected in `texts` among the pairs' sources. Falls back to the default pair
+    // when there is no such pair or it fails to load.
+    std::shared_ptr<TranslationModel> Route(const std::vector<std::wstring>& texts) {
+        Entry* entry = nullptr;
+        {
+            std::lock_guard lock(mutex_);
+            if (entries_.size() > 1) {
+                std::string source = source_language_;
+                if (source.empty()) {
+                    std::wstring joined;
+                    for (const auto& text : texts) joined += text + L'\n';
+                    source = DetectSourceLanguage(joined, source_languages_);
+                }
+                entry = FindLocked(source);
+            }
+            if (!entry) entry = default_entry_;
+        }
+        ModelLoadError error;
+        if (auto model = Load(*entry, error)) return model;
+        g_tracer.RecordError("model_load", wstring_to_utf8(error.message));
+        std::lock_guard lock(mutex_);
+        return default_model_;
+    }
+
+    void ForEachLoaded(const std::function<void(TranslationModel&)>& visit) {
+        std::vector<std::shared_ptr<TranslationModel>> loaded;
+        {
+            std::lock_guard lock(mutex_);
+            for (const auto& [name, entry] : entries_) {
+                if (entry->model) loaded.push_back(entry->model);
+            }
+        }
+        for (const auto& model : loaded) visit(*model);
+    }
+
+    uint64_t evictions() const {
+        std::lock_guard lock(mutex_);
+        return evictions_;
+    }
+
+    void Report() const {
+        std::lock_guard lock(mutex_);
+        auto report = std::format(L"Model registry: {} pairs, {} loaded, ~{} MB of a {} MB budget, {} evictions\n",
+            entries_.size(), residency_.resident_count(), residency_.resident_bytes() >> 20, residency_.budget_bytes() >> 20, evictions_);
+        DebugReport(report);
+    }
+
+private:
+    struct Entry {
+        std::string name;
+        std::filesystem::path directory;
+        std::optional<LanguagePair> pair;
+        std::mutex load_mutex;                    // one load of a pair at a time; not held with mutex_ waiting
+        std::shared_ptr<TranslationModel> model;  // guarded by mutex_
+        bool failed = false;                      // guarded by mutex_; a pair that failed to load isn't retried
+    };
+
+    void AddEntryLocked(const std::string& name, const std::filesystem::path& directory) {
+        auto entry = std::make_unique<Entry>();
+        entry->name = name;
+        entry->directory = directory;
+        entry->pair = ParseLanguagePair(directory.filename().wstring());
+        if (name.empty()) entry->pair.reset(); // models\ itself doesn't name a pair
+        bool wanted_target = target_language_.empty() || (entry->pair && entry->pair->target == target_language_);
+        if (entry->pair && wanted_target
+            && std::find(source_languages_.begin(), source_languages_.end(), entry->pair->source) == source_languages_.end()) {
+            source_languages_.push_back(entry->pair->source);
+        }
+        entries_[name] = std::move(entry);
+    }
+
+    // The pair translating from `source`, preferring the default pair and then the configured target.
+    Entry* FindLocked(const std::string& source) const {
+        if (source.empty()) return nullptr;
+        auto matches = [&](const Entry* entry) { return entry && entry->pair && entry->pair->source == source; };
+        if (matches(default_entry_)) return default_entry_;
+        Entry* found = nullptr;
+        for (const auto& [name, entry] : entries_) {
+            if (!matches(entry.get())) continue;
+            if (target_language_.empty() || entry->pair->target == target_language_) return entry.get();
+            if (!found) found = entry.get();
+        }
+        return found;
+    }
+
+    std::shared_ptr<TranslationModel> Load(Entry& entry, ModelLoadError& error) {
+        std::lock_guard load_lock(entry.load_mutex);
+        std::vector<std::shared_ptr<TranslationModel>> unloaded; // released after mutex_, outside the lock
+        {
+            std::lock_guard lock(mutex_);
+            if (entry.model) {
+                residency_.Touch(entry.name, entry.model->resident_bytes);
+                unloaded = EvictLocked(entry);
+                return entry.model;
+            }
+            if (entry.failed) {
+                error = { L"Model Error", L"Model pair " + ModelDisplayName(entry.name) + L" failed to load earlier" };
+                return nullptr;
+            }
+        }
+        auto model = LoadTranslationModel(entry.directory, precision_, error);
+        std::lock_guard lock(mutex_);
+        if (!model) {
+            entry.failed = true;
+            return nullptr;
+        }
+        model->name = entry.name;
+        model->pair = entry.pair;
+        entry.model = model;
+        residency_.Touch(entry.name, model->resident_bytes);
+        unloaded = EvictLocked(entry);
+        ReportMemoryUsage(L"after loading " + ModelDisplayName(entry.name));
+        return model;
+    }
+
+    // Drops least recently used pairs past the budget, other than `keep`. Pairs still held by a
+    // request are skipped until a later load or route finds them released.
+    std::vector<std::shared_ptr<TranslationModel>> EvictLocked(const Entry& keep) {
+        std::vector<std::shared_ptr<TranslationModel>> unloaded;
+        auto evictions = residency_.Evictions([&](const std::string& name) {
+            const auto& entry = *entries_.at(name);
+            return &entry != &keep && &entry != default_entry_ && entry.model.use_count() == 1;
+        });
+        for (const auto& name : evictions) {
+            auto& entry = *entries_.at(name);
+            if (entry.model->translation_cache) entry.model->translation_cache->Flush();
+            unloaded.push_back(std::move(entry.model));
+            residency_.Remove(name);
+            ++evictions_;
+            auto report = std::format(L"Unloaded model pair {} to stay within the memory budget\n", ModelDisplayName(name));
+            DebugReport(report);
+        }
+        return unloaded;
+    }
+
+    mutable std::mutex mutex_;
+    ModelPrecision precision_ = ModelPrecision::Auto;
+    std::string source_language_;
+    std::string target_language_;
+    std::map<std::string, std::unique_ptr<Entry>> entries_;
+    std::vector<std::string> source_languages_; // sources of the pairs into the configured target
+    Entry* default_entry_ = nullptr;
+    std::shared_ptr<TranslationModel> default_model_;
+    ModelResidency residency_;
+    uint64_t evictions_ = 0;
+};
+
+// Source languages of the pairs under models\ into the configured target, the configured default
+// pair's first and the rest in name order, without duplicates. models\ itself names no pair.
+std::vector<std::string> PairSourceLanguages(const std::filesystem::path& models_dir, const AppConfig& config) {
+    std::vector<std::filesystem::path> pair_dirs;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(models_dir, ec)) {
+        if (entry.is_directory(ec) && FindModelFiles(entry.path(), config.precision)) pair_dirs.push_back(entry.path());
+    }
+    std::sort(pair_dirs.begin(), pair_dirs.end());
+    auto is_default = [&](const std::filesystem::path& dir) { return dir.filename().wstring() == config.model_pair; };
+    std::stable_partition(pair_dirs.begin(), pair_dirs.end(), is_default);
+
+    std::vector<std::string> languages;
+    for (const auto& dir : pair_dirs) {
+        auto pair = ParseLanguagePair(dir.filename().wstring());
+        if (!pair || (!config.target_language.empty() && pair->target != config.target_language)) continue;
+        if (std::find(languages.begin(), languages.end(), pair->source) == languages.end()) languages.push_back(pair->source);
+    }
+    return languages;
+}
+
+ModelRegistry g_model_registry;
+thread_local TranslationModel* g_bound_model = nullptr;
+
+// Makes `model` the one CurrentModel() returns on this thread for the binding's lifetime. A null
+// model leaves the current binding in place.
+class ModelBinding {
+public:
+    explicit ModelBinding(std::shared_ptr<TranslationModel> model) : model_(std::move(model)), previous_(g_bound_model) {
+        if (model_) g_bound_model = model_.get();
+    }
+    ~ModelBinding() { g_bound_model = previous_; }
+    ModelBinding(const ModelBinding&) = delete;
+    ModelBinding& operator=(const ModelBinding&) = delete;
+
+private:
+    std::shared_ptr<TranslationModel> model_;
+    TranslationModel* previous_;
+};
+
+// The model the engine functions below translate with: the one bound to this thread, else the
+// default pair.
+TranslationModel& CurrentModel() {
+    return g_bound_model ? *g_bound_model : *g_model_registry.DefaultModel();
+}
+
+bool InitTranslationEngine(ModelPrecision precision) {
+    CreateOrtEnvironment();
+    session_options.DisablePerSessionThreads();
+    session_options.SetGraphOptimizationLevel(GRAPH_OPTIMIZATION_LEVEL);
+    if (!g_config.ort_arena) {
+        session_options.DisableCpuMemArena();
+    } else if (g_config.ort_arena_limit > 0) {
+        session_options.AddConfigEntry("session.use_env_allocators", "1"); // the capped arena from CreateOrtEnvironment
+    }
+
+    ModelLoadError error;
+    if (!g_model_registry.Open(GetModelsDirectoryPath(), precision, g_config, error)) {
+        show_message_box(error.message, error.title);
+        return false;
+    }
+    return true;
+}
+
+// Non-owning view of an existing tensor, so it can be fed to Run without giving it up.
+Ort::Value WrapTensor(Ort::Value& value) {
+    auto tensor_info = value.GetTensorTypeAndShapeInfo();
+    auto tensor_shape = tensor_info.GetShape();
+    return Ort::Value::CreateTensor(
+        memory_info,
+        value.GetTensorMutableData<void>(),
+        tensor_info.GetElementCount() * Ort::GetTensorElementSize(tensor_info.GetElementType()),
+        tensor_shape.data(),
+        tensor_shape.size(),
+        tensor_info.GetElementType());
+}
+
+// [batch, padded_length] mask with ones over each row's real tokens and zeros over padding.
+Ort::Value CreatePaddingMask(OrtAllocator* allocator, const std::vector<int64_t>& lengths, int64_t padded_length,
+    ONNXTensorElementDataType type) {
+    std::vector<int64_t> shape = { static_cast<int64_t>(lengths.size()), padded_length };
+    auto mask = Ort::Value::CreateTensor(allocator, shape.data(), shape.size(), type);
+    auto fill = [&](auto* data) {
+        for (size_t row = 0; row < lengths.size(); ++row) {
+            auto* row_data = data + row * padded_length;
+            std::fill(row_data, row_data + lengths[row], 1);
+            std::fill(row_data + lengths[row], row_data + padded_length, 0);
+        }
+    };
+    if (type == ONNX_TENSOR_ELEMENT_DATA_TYPE_INT32) {
+        fill(mask.GetTensorMutableData<int32_t>());
+    } else {
+        fill(mask.GetTensorMutableData<int64_t>());
+    }
+    return mask;
+}
+
+// Copies the selected rows (first dimension) of a batch-major tensor into a new tensor.
+Ort::Value GatherBatchRows(OrtAllocator* allocator, Ort::Value& value, const std::vector<size_t>& rows) {
+    auto tensor_info = value.GetTensorTypeAndShapeInfo();
+    auto shape = tensor_info.GetShape();
+    size_t row_bytes = tensor_info.GetElementCount() / static_cast<size_t>(shape[0])
+        * Ort::GetTensorElementSize(tensor_info.GetElementType());
+    shape[0] = static_cast<int64_t>(rows.size());
+
+    auto gathered = Ort::Value::CreateTensor(allocator, shape.data(), shape.size(), tensor_info.GetElementType());
+    if (row_bytes == 0) return gathered;
+    const auto* src = static_cast<const uint8_t*>(value.GetTensorMutableData<void>());
+    auto* dst = static_cast<uint8_t*>(gathered.GetTensorMutableData<void>());
+    for (size_t i = 0; i < rows.size(); ++i) {
+        std::memcpy(dst + i * row_bytes, src + rows[i] * row_bytes, row_bytes);
+    }
+    return gathered;
+}
+
+// Copies the first `length` positions (third dimension) of a [batch, heads, sequence, head_dim] tensor.
+Ort::Value TruncateSequence(OrtAllocator* allocator, Ort::Value& value, int64_t length) {
+    auto tensor_info = value.GetTensorTypeAndShapeInfo();
+    auto shape = tensor_info.GetShape();
+    size_t position_bytes = static_cast<size_t>(shape[3]) * Ort::GetTensorElementSize(tensor_info.GetElementType());
+    size_t source_block = static_cast<size_t>(shape[2]) * position_bytes;
+    size_t target_block = static_cast<size_t>(length) * position_bytes;
+    size_t blocks = static_cast<size_t>(shape[0] * shape[1]);
+    shape[2] = length;
+
+    auto truncated = Ort::Value::CreateTensor(allocator, shape.data(), shape.size(), tensor_info.GetElementType());
+    if (target_block == 0) return truncated;
+    const auto* src = static_cast<const uint8_t*>(value.GetTensorMutableData<void>());
+    auto* dst = static_cast<uint8_t*>(truncated.GetTensorMutableData<void>());
+    for (size_t i = 0; i < blocks; ++i) {
+        std::memcpy(dst + i * target_block, src + i * source_block, target_block);
+    }
+    return truncated;
+}
+
+// Runs a session feeding each declared input from `feeds` by name. Inputs are moved back
+// afterwards, so persistent tensors (encoder state, KV cache) survive across steps.
+std::vector<Ort::Value> RunWithFeeds(Ort::Session& session,
+    const std::vector<std::string>& input_names,
+    const std::vector<std::string>& output_names,
+    std::unordered_map<std::string, Ort::Value>& feeds) {
+    std::vector<const char*> input_name_ptrs;
+    std::vector<Ort::Value> input_values;
+    input_name_ptrs.reserve(input_names.size());
+    input_values.reserve(input_names.size());
+    for (const auto& name : input_names) {
+        auto it = feeds.find(name);
+        if (it == feeds.end()) {
+            throw std::runtime_error("No value for model input " + name);
+        }
+        input_name_ptrs.push_back(name.c_str());
+        input_values.push_back(std::move(it->second));
+    }
+
+    std::vector<const char*> output_name_ptrs;
+    output_name_ptrs.reserve(output_names.size());
+    for (const auto& name : output_names) output_name_ptrs.push_back(name.c_str());
+
+    auto outputs = session.Run(
+        Ort::RunOptions{ nullptr },
+        input_name_ptrs.data(), input_values.data(), input_values.size(),
+        output_name_ptrs.data(), output_name_ptrs.size());
+
+    for (size_t i = 0; i < input_names.size(); ++i) {
+        feeds.find(input_names[i])->second = std::move(input_values[i]);
+    }
+    return outputs;
+}
+
+// Greedy pick for one batch row from [batch, sequence, vocab] logits, at the last position.
+int32_t ArgmaxLastPosition(const float* logits_data, int64_t sequence_length, int64_t vocab_size, size_t row) {
+    const float* last_token_logits = logits_data + (static_cast<int64_t>(row) * sequence_length + sequence_length - 1) * vocab_size;
+    return static_cast<int32_t>(std::distance(last_token_logits,
+        std::max_element(last_token_logits, last_token_logits + vocab_size)));
+}
+
+// IEEE 754 binary16 to float, for fp16 exports whose logits stay in half precision.
+inline float HalfToFloat(uint16_t half) {
+    uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1F;
+    uint32_t mantissa = half & 0x3FF;
+    uint32_t bits;
+    if (exponent == 0x1F) {
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    } else if (exponent != 0) {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    } else if (mantissa == 0) {
+        bits = sign;
+    } else {
+        // Subnormal: shift the mantissa up until its leading one becomes the implicit bit.
+        exponent = 113;
+        while (!(mantissa & 0x400)) {
+            mantissa <<= 1;
+            --exponent;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+    }
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// --- Vocabulary Shortlist ---
+
+struct ShortlistStats {
+    std::atomic<uint64_t> picks{ 0 };      // tokens picked from a shortlist
+    std::atomic<uint64_t> candidates{ 0 }; // tokens scored for those picks
+    std::atomic<uint64_t> checks{ 0 };     // picks also scored over the whole vocabulary
+    std::atomic<uint64_t> overrides{ 0 };  // checks won by a token outside the shortlist
+    std::atomic<uint64_t> declined{ 0 };   // checks it led by less than ShortlistTolerance
+};
+
+ShortlistStats g_shortlist_stats;
+
+// Whether the pick at output index `position` is scored over the whole vocabulary: always without
+// a shortlist, and at every [Translation] ShortlistCheck-th position with one. Counting positions
+// rather than picks keeps a segment's output independent of what else is decoding at the same time.
+bool NeedsFullProjection(bool shortlisted, size_t position) {
+    return !shortlisted || (g_config.shortlist_check > 0 && position % g_config.shortlist_check == 0);
+}
+
+// Greedy pick from one last_hidden_state row through the model's output projection, over
+// `candidates` (ascending) or, without them, the whole vocabulary. `full` is the row's
+// whole-vocabulary pick when NeedsFullProjection asks for one (scored for every such row of a
+// step at once, by ProjectArgmaxRows), null otherwise. A token outside the shortlist beating the
+// shortlist's pick by at least ShortlistTolerance replaces it.
+int32_t PickProjectedToken(const TranslationModel& model, const float* hidden, const std::vector<int32_t>* candidates,
+    const ProjectedPick* full) {
+    if (!candidates) return full->token;
+    ProjectedPick pick = ProjectArgmax(*model.output_projection, hidden, candidates->data(), candidates->size());
+    ++g_shortlist_stats.picks;
+    g_shortlist_stats.candidates += candidates->size();
+    if (full) {
+        ++g_shortlist_stats.checks;
+        // The kernels score a token the same with or without a shortlist, so a different winner
+        // is one outside it.
+        if (full->token != pick.token) {
+            if (full->score - pick.score >= g_config.shortlist_tolerance) {
+                ++g_shortlist_stats.overrides;
+                return full->token;
+            }
+            ++g_shortlist_stats.declined;
+        }
+    }
+    return pick.token;
+}
+
+// Decoder inputs that hold for a whole request: the encoder state and its mask and, for merged
+// graphs, use_cache_branch (a view of `use_cache_branch`, so flipping the flag updates it) and the
+// empty past tensors of the first step. Throws on ORT errors.
+std::unordered_map<std::string, Ort::Value> CreateDecoderFeeds(OrtAllocator* allocator, Ort::Value& encoder_hidden_state,
+    const std::vector<int64_t>& source_lengths, bool& use_cache_branch) {
+    const auto& layout = CurrentModel().decoder_layout;
+    std::unordered_map<std::string, Ort::Value> feeds;
+    feeds.emplace("encoder_hidden_states", WrapTensor(encoder_hidden_state));
+    if (layout.needs_encoder_attention_mask) {
+        int64_t padded_length = encoder_hidden_state.GetTensorTypeAndShapeInfo().GetShape()[1];
+        feeds.emplace("encoder_attention_mask", CreatePaddingMask(allocator, source_lengths, padded_length, layout.mask_type));
+    }
+    if (layout.variant == DecoderVariant::Merged) {
+        std::array<int64_t, 1> use_cache_shape = { 1 };
+        feeds.emplace("use_cache_branch", Ort::Value::CreateTensor<bool>(
+            memory_info, &use_cache_branch, 1, use_cache_shape.data(), use_cache_shape.size()));
+        for (auto [name, shape] : layout.empty_past_shapes) {
+            shape[0] = static_cast<int64_t>(source_lengths.size());
+            feeds.emplace(name, Ort::Value::CreateTensor(allocator, shape.data(), shape.size(), layout.past_type));
+        }
+    }
+    return feeds;
+}
+
+// Buffers reused across decode steps and requests, one set per decoding thread. They only grow,
+// so a steady-state step makes no heap allocations of its own: next tokens are written into
+// `input_ids` in place, logits (or hidden states) land in `logits`, and only the KV cache comes
+// from ORT's arena.
+struct DecodeWorkspace {
+    std::vector<int32_t> input_ids;
+    std::vector<int32_t> next_input_ids;
+    std::vector<float> logits;
+    std::vector<std::vector<int32_t>> shortlists; // per batch row
+    std::vector<const float*> full_rows;        // hidden states scored over the whole vocabulary this step
+    std::vector<ProjectedPick> full_picks;
+    std::vector<size_t> active_rows;
+    std::vector<size_t> still_active;
+    std::vector<size_t> keep;
+};
+
+thread_local DecodeWorkspace g_decode_workspace;
+
+// Receives a batch row and every token decoded for it so far, each time the row grows.
+using TokenCallback = std::function<void(size_t row, const std::vector<int32_t>& tokens)>;
+
+// Greedy decoding for a padded batch. With a KV cache the first step runs on BOS and returns the
+// self-attention and cross-attention caches, and every later step feeds one token per row plus
+// the cache from the step before; without one the whole prefix is re-run each step. Rows that
+// emit EOS are retired by compacting every batch-major tensor, so later steps only pay for the
+// rows still running. Returns false on failure or when `stop` is requested between steps.
+//
+// Each graph gets one IoBinding for the whole request. Tensors that don't change between steps
+// (encoder state, masks, use_cache_branch) are views created once and only rebuilt when rows
+// retire; input_ids and, with a KV cache, the [rows, 1, vocab] logits are views over the
+// workspace, so a step only rebinds the past tensors produced by the step before. `on_tokens`
+// sees each row's tokens as they are produced, for streaming.
+//
+// A decoder ending at last_hidden_state is scored through the model's output projection. Given
+// each row's source tokens in `sources`, and with [Translation] Shortlist on, only the row's
+// shortlist is scored; otherwise the whole vocabulary is.
+bool DecodeBatch(Ort::Value& encoder_hidden_state, const std::vector<int64_t>& source_lengths,
+    std::vector<std::vector<int32_t>>& output_tokens, std::stop_token stop = {}, const TokenCallback& on_tokens = {},
+    const std::vector<const std::vector<int32_t>*>& sources = {}) {
+    TranslationModel& model = CurrentModel();
+    const auto& layout = model.decoder_layout;
+    const bool use_kv_cache = (layout.variant != DecoderVariant::FullPrefix);
+    // Logits, or the hidden state the output projection scores; either way one row per position.
+    const bool hidden_output = layout.hidden_state_output;
+    const int64_t static_width = hidden_output ? layout.hidden_size : layout.vocab_size;
+    // Full-prefix logits grow with the prefix, so only fixed-shape KV-cache logits are preallocated.
+    // Half-precision logits are widened into the workspace after each step instead.
+    const bool half_logits = (layout.logits_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16);
+    const bool reuse_logits = use_kv_cache && static_width > 0 && !half_logits;
+    Ort::AllocatorWithDefaultOptions allocator;
+    DecodeWorkspace& workspace = g_decode_workspace;
+
+    size_t batch_size = source_lengths.size();
+    output_tokens.assign(batch_size, {});
+    for (auto& tokens : output_tokens) tokens.reserve(MAX_DECODE_STEPS);
+    const bool use_shortlist = hidden_output && model.shortlist && g_config.shortlist && sources.size() == batch_size;
+    if (use_shortlist) {
+        if (workspace.shortlists.size() < batch_size) workspace.shortlists.resize(batch_size);
+        for (size_t row = 0; row < batch_size; ++row) model.shortlist->Candidates(*sources[row], workspace.shortlists[row]);
+    }
+    auto& active_rows = workspace.active_rows;
+    active_rows.resize(batch_size);
+    std::iota(active_rows.begin(), active_rows.end(), size_t{ 0 });
+
+    // Row-major [rows, decoder_length]; with a KV cache only the newest token of each row is kept.
+    auto& decoder_input_ids = workspace.input_ids;
+    decoder_input_ids.assign(batch_size, BOS_TOKEN_ID);
+    int64_t decoder_length = 1;
+    // use_cache_branch points at this flag, so flipping it updates the tensor in place.
+    bool use_cache_branch = false;
+
+    std::unordered_map<std::string, Ort::Value> feeds;
+    try {
+        feeds = CreateDecoderFeeds(allocator, encoder_hidden_state, source_lengths, use_cache_branch);
+
+        Ort::IoBinding first_step_binding(*model.decoder_session);
+        std::optional<Ort::IoBinding> next_step_binding;
+        if (use_kv_cache) {
+            next_step_binding.emplace(layout.variant == DecoderVariant::WithPast ? *model.decoder_with_past_session : *model.decoder_session);
+        }
+
+        // Views over workspace buffers, rebuilt only when the row count or prefix length changes.
+        Ort::Value input_ids_tensor{ nullptr };
+        Ort::Value logits_tensor{ nullptr };
+        size_t tensor_rows = 0;
+        int64_t tensor_length = 0;
+
+        for (int step = 0; step < MAX_DECODE_STEPS && !active_rows.empty(); ++step) {
+            if (stop.stop_requested()) return false;
+            TraceScope trace(g_tracer, "decoder_step");
+            bool first_step = (step == 0);
+            size_t rows = active_rows.size();
+            if (rows != tensor_rows || decoder_length != tensor_length) {
+                std::array<int64_t, 2> input_shape = { static_cast<int64_t>(rows), decoder_length };
+                input_ids_tensor = Ort::Value::CreateTensor<int32_t>(
+                    memory_info, decoder_input_ids.data(), rows * static_cast<size_t>(decoder_length),
+                    input_shape.data(), input_shape.size());
+                if (reuse_logits) {
+                    std::array<int64_t, 3> logits_shape = { static_cast<int64_t>(rows), 1, static_width };
+                    workspace.logits.resize(rows * static_cast<size_t>(static_width));
+                    logits_tensor = Ort::Value::CreateTensor<float>(
+                        memory_info, workspace.logits.data(), workspace.logits.size(),
+                        logits_shape.data(), logits_shape.size());
+                }
+                tensor_rows = rows;
+                tensor_length = decoder_length;
+            }
+            use_cache_branch = !first_step;
+
+            bool use_step_graph = use_kv_cache && !first_step;
+            Ort::Session& session = (use_step_graph && layout.variant == DecoderVariant::WithPast)
+                ? *model.decoder_with_past_session : *model.decoder_session;
+            Ort::IoBinding& binding = use_step_graph ? *next_step_binding : first_step_binding;
+            const auto& input_names = use_step_graph ? layout.next_step_inputs : layout.first_step_inputs;
+            const auto& output_names = use_step_graph ? layout.next_step_outputs : layout.first_step_outputs;
+
+            for (const auto& name : input_names) {
+                if (name == "input_ids") {
+                    binding.BindInput(name.c_str(), input_ids_tensor);
+                    continue;
+                }
+                auto it = feeds.find(name);
+                if (it == feeds.end()) {
+                    throw std::runtime_error("No value for model input " + name);
+                }
+                binding.BindInput(name.c_str(), it->second);
+            }
+            if (reuse_logits) {
+                binding.BindOutput(output_names[0].c_str(), logits_tensor);
+            } else {
+                binding.BindOutput(output_names[0].c_str(), memory_info);
+            }
+            for (size_t i = 1; i < output_names.size(); ++i) {
+                binding.BindOutput(output_names[i].c_str(), memory_info);
+            }
+
+            session.Run(Ort::RunOptions{ nullptr }, binding);
+            // Values come back in binding order: logits (or last_hidden_state) first, then the present.* outputs.
+            auto decoder_outputs = binding.GetOutputValues();
+
+            for (size_t i = 1; i < decoder_outputs.size(); ++i) {
+                feeds.insert_or_assign(layout.present_to_past.at(output_names[i]), std::move(decoder_outputs[i]));
+            }
+
+            int64_t sequence_length = use_kv_cache ? 1 : decoder_length;
+            int64_t vocab_size = static_width > 0
+                ? static_width
+                : decoder_outputs[0].GetTensorTypeAndShapeInfo().GetShape()[2];
+            if (hidden_output && static_cast<size_t>(vocab_size) != model.output_projection->hidden_size) {
+                throw std::runtime_error("last_hidden_state doesn't match output_projection.bin");
+            }
+            const float* logits = nullptr;
+            if (half_logits) {
+                // Only the last position of each row is needed for the greedy pick.
+                const auto* half_data = decoder_outputs[0].GetTensorData<uint16_t>();
+                workspace.logits.resize(rows * static_cast<size_t>(vocab_size));
+                for (size_t b = 0; b < rows; ++b) {
+                    const uint16_t* row_logits = half_data + (static_cast<int64_t>(b) * sequence_length + sequence_length - 1) * vocab_size;
+                    float* widened = workspace.logits.data() + b * static_cast<size_t>(vocab_size);
+                    for (int64_t v = 0; v < vocab_size; ++v) widened[v] = HalfToFloat(row_logits[v]);
+                }
+                logits = workspace.logits.data();
+                sequence_length = 1;
+            } else {
+                logits = decoder_outputs[0].GetTensorData<float>();
+            }
+
+            // With a hidden-state export, vocab_size is the hidden size and "logits" the hidden states.
+            auto hidden_row = [&](size_t b) { return logits + (static_cast<int64_t>(b) * sequence_length + sequence_length - 1) * vocab_size; };
+            if (hidden_output) {
+                // Rows scored over the whole vocabulary share one pass over the output projection.
+                auto& full_rows = workspace.full_rows;
+                full_rows.clear();
+                for (size_t b = 0; b < rows; ++b) {
+                    if (NeedsFullProjection(use_shortlist, output_tokens[active_rows[b]].size())) full_rows.push_back(hidden_row(b));
+                }
+                workspace.full_picks.resize(full_rows.size());
+                ProjectArgmaxRows(*model.output_projection, full_rows.data(), full_rows.size(), workspace.full_picks.data());
+            }
+
+            auto& keep = workspace.keep;
+            auto& next_input_ids = workspace.next_input_ids;
+            keep.clear();
+            next_input_ids.clear();
+            size_t next_full_pick = 0;
+            for (size_t b = 0; b < rows; ++b) {
+                auto& tokens = output_tokens[active_rows[b]];
+                int32_t next_token_id;
+                if (hidden_output) {
+                    const ProjectedPick* full = NeedsFullProjection(use_shortlist, tokens.size())
+                        ? &workspace.full_picks[next_full_pick++] : nullptr;
+                    next_token_id = PickProjectedToken(model, hidden_row(b), use_shortlist ? &workspace.shortlists[active_rows[b]] : nullptr, full);
+                } else {
+                    next_token_id = ArgmaxLastPosition(logits, sequence_length, vocab_size, b);
+                }
+
+                if (next_token_id == EOS_TOKEN_ID) continue;
+                tokens.push_back(next_token_id);
+                if (on_tokens) on_tokens(active_rows[b], tokens);
+                if (tokens.size() >= MAX_DECODE_STEPS) continue;
+
+                keep.push_back(b);
+                if (use_kv_cache) {
+                    // Kept rows only move towards the front, so this never overwrites an unread row.
+                    decoder_input_ids[keep.size() - 1] = next_token_id;
+                } else {
+                    auto prefix = decoder_input_ids.begin() + static_cast<std::ptrdiff_t>(b * decoder_length);
+                    next_input_ids.insert(next_input_ids.end(), prefix, prefix + decoder_length);
+                    next_input_ids.push_back(next_token_id);
+                }
+            }
+            if (!use_kv_cache) {
+                std::swap(decoder_input_ids, next_input_ids);
+                ++decoder_length;
+            }
+
+            if (!keep.empty() && keep.size() < rows) {
+                for (auto& [name, value] : feeds) {
+                    if (name == "use_cache_branch") continue;
+                    value = GatherBatchRows(allocator, value, keep);
+                }
+            }
+            auto& still_active = workspace.still_active;
+            still_active.clear();
+            for (size_t b : keep) still_active.push_back(active_rows[b]);
+            std::swap(active_rows, still_active);
+        }
+    } catch (const std::exception& e) {
+        g_tracer.RecordError("decoder", e.what());
+        return false;
+    }
+    return true;
+}
+
+// --- Speculative Decoding ---
+
+SpeculativeStats g_speculative_stats;
+
+// The model's decoder graphs for one segment, as DecodeWithDraft drives them. Without a KV cache
+// the working cache is just the token prefix, re-run whole every time. Throws on ORT errors.
+class OrtDraftDecoder : public DraftDecoder {
+public:
+    OrtDraftDecoder(Ort::Value& encoder_hidden_state, int64_t source_length)
+        : layout_(CurrentModel().decoder_layout),
+          feeds_(CreateDecoderFeeds(allocator_, encoder_hidden_state, { source_length }, use_cache_branch_)) {}
+    OrtDraftDecoder(const OrtDraftDecoder&) = delete;
+    OrtDraftDecoder& operator=(const OrtDraftDecoder&) = delete;
+
+    void Run(const std::vector<int32_t>& tokens) override {
+        TraceScope trace(g_tracer, "decoder_verify");
+        TranslationModel& model = CurrentModel();
+        const bool use_kv_cache = (layout_.variant != DecoderVariant::FullPrefix);
+        input_ids_.clear();
+        if (!use_kv_cache) input_ids_ = prefix_;
+        input_ids_.insert(input_ids_.end(), tokens.begin(), tokens.end());
+        std::array<int64_t, 2> input_shape = { 1, static_cast<int64_t>(input_ids_.size()) };
+        feeds_.insert_or_assign("input_ids", Ort::Value::CreateTensor<int32_t>(
+            memory_info, input_ids_.data(), input_ids_.size(), input_shape.data(), input_shape.size()));
+
+        bool use_step_graph = use_kv_cache && !prefix_.empty();
+        use_cache_branch_ = use_step_graph;
+        Ort::Session& session = (use_step_graph && layout_.variant == DecoderVariant::WithPast)
+            ? *model.decoder_with_past_session : *model.decoder_session;
+        const auto& input_names = use_step_graph ? layout_.next_step_inputs : layout_.first_step_inputs;
+        const auto& output_names = use_step_graph ? layout_.next_step_outputs : layout_.first_step_outputs;
+        outputs_ = RunWithFeeds(session, input_names, output_names, feeds_);
+        if (use_kv_cache) {
+            for (size_t i = 1; i < outputs_.size(); ++i) {
+                feeds_.insert_or_assign(layout_.present_to_past.at(output_names[i]), std::move(outputs_[i]));
+            }
+        }
+        first_position_ = static_cast<int64_t>(input_ids_.size() - tokens.size());
+        prefix_.insert(prefix_.end(), tokens.begin(), tokens.end());
+    }
+
+    const float* Logits(size_t i) override {
+        int64_t offset = (first_position_ + static_cast<int64_t>(i)) * VocabSize();
+        if (layout_.logits_type != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16) return outputs_[0].GetTensorData<float>() + offset;
+        const uint16_t* half = outputs_[0].GetTensorData<uint16_t>() + offset;
+        widened_logits_.resize(static_cast<size_t>(VocabSize()));
+        for (size_t v = 0; v < widened_logits_.size(); ++v) widened_logits_[v] = HalfToFloat(half[v]);
+        return widened_logits_.data();
+    }
+
+    int64_t VocabSize() const override { return outputs_[0].GetTensorTypeAndShapeInfo().GetShape()[2]; }
+
+    void Truncate(size_t length) override {
+        prefix_.resize((std::min)(length, prefix_.size()));
+        if (layout_.variant == DecoderVariant::FullPrefix) return;
+        for (const auto& [present, past] : layout_.present_to_past) {
+            auto it = feeds_.find(past);
+            bool self_attention = present.find(".encoder.") == std::string::npos;
+            if (self_attention && it != feeds_.end() && it->second.GetTensorTypeAndShapeInfo().GetShape()[2] > static_cast<int64_t>(length)) {
+                it->second = TruncateSequence(allocator_, it->second, static_cast<int64_t>(length));
+            }
+        }
+    }
+
+    // The checkpoint owns the past tensors and the feeds see them through views, so the next run
+    // replaces the views without touching the checkpoint.
+    void Checkpoint() override {
+        checkpoint_prefix_ = prefix_;
+        checkpoint_.clear();
+        for (const auto& [present, past] : layout_.present_to_past) {
+            auto it = feeds_.find(past);
+            if (it == feeds_.end()) continue;
+            auto& kept = checkpoint_.insert_or_assign(past, std::move(it->second)).first->second;
+            it->second = WrapTensor(kept);
+        }
+    }
+
+    void Restore() override {
+        prefix_ = checkpoint_prefix_;
+        for (const auto& [present, past] : layout_.present_to_past) {
+            if (auto it = checkpoint_.find(past); it != checkpoint_.end()) {
+                feeds_.insert_or_assign(past, std::move(it->second));
+            } else {
+                feeds_.erase(past);
+            }
+        }
+        checkpoint_.clear();
+    }
+
+private:
+    Ort::AllocatorWithDefaultOptions allocator_;
+    const DecoderLayout& layout_;
+    bool use_cache_branch_ = false; // feeds_ holds a view of it for merged graphs
+    std::unordered_map<std::string, Ort::Value> feeds_;
+    std::unordered_map<std::string, Ort::Value> checkpoint_;
+    std::vector<int32_t> prefix_;          // tokens in the working cache
+    std::vector<int32_t> checkpoint_prefix_;
+    std::vector<int32_t> input_ids_;
+    std::vector<Ort::Value> outputs_;
+    std::vector<float> widened_logits_;
+    int64_t first_position_ = 0;
+};
+
+// DecodeWithDraft over the current model, which must accept drafts (see AcceptsDrafts). The output
+// matches DecodeBatch for the segment alone; --benchmark speculative checks this on real models.
+bool DecodeSpeculative(Ort::Value& encoder_hidden_state, int64_t source_length, const std::vector<int32_t>& draft,
+    std::vector<int32_t>& output_tokens, std::stop_token stop = {}, const TokenCallback& on_tokens = {}) {
+    DraftOptions options{ BOS_TOKEN_ID, EOS_TOKEN_ID, static_cast<size_t>(MAX_DECODE_STEPS), MAX_DRAFT_BLOCK };
+    try {
+        OrtDraftDecoder decoder(encoder_hidden_state, source_length);
+        return DecodeWithDraft(decoder, draft, output_tokens, options, g_speculative_stats, stop,
+            [&](const std::vector<int32_t>& tokens) { if (on_tokens) on_tokens(0, tokens); });
+    } catch (const std::exception& e) {
+        g_tracer.RecordError("decoder", e.what());
+        return false;
+    }
+}
+
+// Pads `sources` to the longest one and runs the encoder over them as one batch. Fills
+// `source_lengths` with the unpadded lengths and returns last_hidden_state. Throws on ORT errors.
+Ort::Value EncodeBatch(const std::vector<const std::vector<int32_t>*>& sources, std::vector<int64_t>& source_lengths) {
+    TraceScope trace(g_tracer, "encoder");
+    TranslationModel& model = CurrentModel();
+    Ort::AllocatorWithDefaultOptions allocator;
+
+    source_lengths.clear();
+    int64_t padded_length = 0;
+    for (const auto* source : sources) {
+        source_lengths.push_back(static_cast<int64_t>(source->size()));
+        padded_length = std::max<int64_t>(padded_length, source_lengths.back());
+    }
+
+    std::vector<int32_t> input_ids_vec(sources.size() * static_cast<size_t>(padded_length), PAD_TOKEN_ID);
+    for (size_t row = 0; row < sources.size(); ++row) {
+        std::copy(sources[row]->begin(), sources[row]->end(), input_ids_vec.begin() + static_cast<std::ptrdiff_t>(row * padded_length));
+    }
+    std::vector<int64_t> input_shape = { static_cast<int64_t>(sources.size()), padded_length };
+
+    std::unordered_map<std::string, Ort::Value> encoder_feeds;
+    encoder_feeds.emplace("input_ids", Ort::Value::CreateTensor<int32_t>(
+        memory_info, input_ids_vec.data(), input_ids_vec.size(),
+        input_shape.data(), input_shape.size()));
+    if (model.encoder_layout.has_attention_mask) {
+        encoder_feeds.emplace("attention_mask", CreatePaddingMask(allocator, source_lengths, padded_length, model.encoder_layout.mask_type));
+    }
+    auto encoder_outputs = RunWithFeeds(*model.encoder_session, model.encoder_layout.input_names, { "last_hidden_state" }, encoder_feeds);
+    return std::move(encoder_outputs[0]);
+}
+
+// Runs the encoder and greedy decoder over one bucket of tokenized segments, padded to the
+// longest one. On success `output_tokens` holds one target sequence per source row. A decode cut
+// short by `stop` fails like any other; callers that pass `stop` check it before the error.
+std::optional<std::wstring> TranslateBucket(const std::vector<const std::vector<int32_t>*>& sources,
+    std::vector<std::vector<int32_t>>& output_tokens, std::stop_token stop = {}, const TokenCallback& on_tokens = {}) {
+    std::vector<int64_t> source_lengths;
+    Ort::Value encoder_hidden_state{ nullptr };
+    try {
+        encoder_hidden_state = EncodeBatch(sources, source_lengths);
+    } catch (const std::exception& e) {
+        g_tracer.RecordError("encoder", e.what());
+        return L"[Translation Error: Encoder Failed]";
+    }
+
+    if (!DecodeBatch(encoder_hidden_state, source_lengths, output_tokens, stop, on_tokens, sources)) {
+        return L"[Translation Error: Decoder Failed]";
+    }
+    return std::nullopt;
+}
+
+// TranslateBucket for a single segment with a draft of its translation; see DecodeSpeculative.
+std::optional<std::wstring> TranslateWithDraft(const std::vector<int32_t>& source, const std::vector<int32_t>& draft,
+    std::vector<int32_t>& output_tokens, std::stop_token stop = {}, const TokenCallback& on_tokens = {}) {
+    std::vector<int64_t> source_lengths;
+    Ort::Value encoder_hidden_state{ nullptr };
+    try {
+        encoder_hidden_state = EncodeBatch({ &source }, source_lengths);
+    } catch (const std::exception& e) {
+        g_tracer.RecordError("encoder", e.what());
+        return L"[Translation Error: Encoder Failed]";
+    }
+
+    if (!DecodeSpeculative(encoder_hidden_state, source_lengths.front(), draft, output_tokens, stop, on_tokens)) {
+        return L"[Translation Error: Decoder Failed]";
+    }
+    return std::nullopt;
+}
+
+inline bool IsTranslationError(const std::wstring& translation) {
+    return translation.starts_with(L"[Translation Error");
+}
+
+// --- Translation Service Client ---
+
+// With [Service] Connect, hands translation to a running --serve instance instead of loading the
+// models in this process. False if the service isn't up. Should it go away later, the next request
+// reconnects or loads the models here (see TranslateThroughService).
+bool ConnectTranslationService() {
+    if (!g_config.use_service) return false;
+    auto client = std::make_unique<TranslationClient>();
+    if (!client->Connect(g_config.service_name)) return false;
+    g_translation_service = std::move(client);
+    return true;
+}
+
+bool g_local_engine_failed = false; // loading the models after losing the service failed; not retried
+
+// Keeps translation going after the service exits or crashes. A service listening again (restarted,
+// or another instance) is reconnected to; otherwise the models are loaded in this process, as if
+// [Service] Connect had found no service at startup, and the client is dropped. Returns whether
+// the service is connected.
+bool ReconnectTranslationService() {
+    if (g_translation_service->connected()) return true;
+    if (g_translation_service->Connect(g_config.service_name)) return true;
+    if (g_local_engine_failed) return false;
+    TraceScope trace(g_tracer, "service_fallback");
+    g_tracer.RecordError("service", "lost the translation service; loading the models in this process");
+    if (InitTranslationEngine(g_config.precision)) {
+        g_translation_service.reset();
+    } else {
+        g_local_engine_failed = true;
+    }
+    return false;
+}
+
+// Sends every segment to the service at once so they can share a batch there, with each other and
+// with other clients' requests. The service runs the cache and picks the pair; drafts and partial
+// results don't cross the pipe, so callers only ever see whole translations. nullopt once the
+// service is gone and the models have been loaded here instead: the caller translates locally.
+// Segments still pending when `stop` is requested are left empty; the caller discards the results.
+std::optional<std::vector<std::wstring>> TranslateThroughService(const std::vector<std::wstring>& segments, std::stop_token stop) {
+    TraceScope trace(g_tracer, "service_translate");
+    std::vector<std::wstring> results(segments.size());
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        if (!ReconnectTranslationService()) {
+            if (!g_translation_service) return std::nullopt;
+            for (size_t i = 0; i < segments.size(); ++i) {
+                if (!segments[i].empty()) results[i] = L"[Translation Error: No translation service, and the models failed to load]";
+            }
+            return results;
+        }
+        std::vector<std::future<ServiceResult>> pending(segments.size());
+        for (size_t i = 0; i < segments.size(); ++i) {
+            if (!segments[i].empty()) pending[i] = g_translation_service->Translate(wstring_to_utf8(segments[i]));
+        }
+        bool failed = false;
+        for (size_t i = 0; i < segments.size(); ++i) {
+            if (!pending[i].valid()) continue;
+            if (stop.stop_requested()) break;
+            auto result = pending[i].get();
+            results[i] = utf8_to_wstring(result.text);
+            if (!result.ok && !IsTranslationError(results[i])) results[i] = L"[Translation Error: " + results[i] + L"]";
+            failed = failed || !result.ok;
+        }
+        // A service that died mid-request failed whatever was pending; the request goes once more to
+        // its replacement, or to the models loaded here.
+        if (!failed || g_translation_service->connected() || stop.stop_requested()) break;
+    }
+    return results;
+}
+
+// Sentences of normalized `text`, each keeping its closing punctuation and the space after it, so
+// concatenating them gives back `text`.
+std::vector<std::string_view> SplitSentences(std::string_view text) {
+    static constexpr std::string_view CJK_SENTENCE_ENDS[] = { "\xE3\x80\x82", "\xEF\xBC\x81", "\xEF\xBC\x9F" }; // 。！？
+    std::vector<std::string_view> sentences;
+    size_t start = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        size_t end = 0;
+        if ((text[i] == '.' || text[i] == '!' || text[i] == '?') && i + 1 < text.size() && text[i + 1] == ' ') {
+            end = i + 2;
+        } else {
+            for (auto mark : CJK_SENTENCE_ENDS) {
+                if (text.substr(i).starts_with(mark)) end = i + mark.size() + (text.substr(i + mark.size()).starts_with(' ') ? 1 : 0);
+            }
+        }
+        if (end == 0) continue;
+        sentences.push_back(text.substr(start, end - start));
+        start = end;
+        i = end - 1;
+    }
+    if (start < text.size()) sentences.push_back(text.substr(start));
+    return sentences;
+}
+
+// Part of a segment translated on its own: the whole segment unless it is too long for one pass.
+struct SourceChunk {
+    std::string text;
+    std::vector<int32_t> ids;
+};
+
+// Splits normalized `text` into chunks of at most MAX_CHUNK_SOURCE_TOKENS source tokens, packing
+// whole sentences where they fit and whole words where a sentence alone is too long, so long
+// inputs are translated piecewise instead of being cut off at MAX_DECODE_STEPS.
+std::vector<SourceChunk> SplitIntoChunks(const std::string& text, std::vector<int32_t> ids) {
+    if (ids.size() <= MAX_CHUNK_SOURCE_TOKENS) return { { text, std::move(ids) } };
+
+    TranslationModel& model = CurrentModel();
+    std::vector<SourceChunk> chunks;
+    SourceChunk current;
+    auto flush = [&] {
+        while (!current.text.empty() && current.text.back() == ' ') current.text.pop_back();
+        if (current.text.empty()) return;
+        model.sp_source_processor.Encode(current.text, &current.ids);
+        chunks.push_back(std::move(current));
+        current = {};
+    };
+    // Token counts of the pieces are added up, which can be off by a token at the joins; the margin
+    // below MAX_DECODE_STEPS absorbs that.
+    size_t current_tokens = 0;
+    auto append = [&](std::string_view piece, size_t piece_tokens) {
+        if (current_tokens + piece_tokens > MAX_CHUNK_SOURCE_TOKENS) {
+            flush();
+            current_tokens = 0;
+        }
+        current.text += piece;
+        current_tokens += piece_tokens;
+    };
+
+    std::vector<int32_t> piece_ids;
+    for (auto sentence : SplitSentences(text)) {
+        model.sp_source_processor.Encode(sentence, &piece_ids);
+        if (piece_ids.size() <= MAX_CHUNK_SOURCE_TOKENS) {
+            append(sentence, piece_ids.size());
+            continue;
+        }
+        for (size_t word_start = 0; word_start < sentence.size();) {
+            size_t word_end = sentence.find(' ', word_start);
+            word_end = (word_end == std::string_view::npos) ? sentence.size() : word_end + 1;
+            auto word = sentence.substr(word_start, word_end - word_start);
+            model.sp_source_processor.Encode(word, &piece_ids);
+            append(word, piece_ids.size());
+            word_start = word_end;
+        }
+    }
+    flush();
+    return chunks;
+}
+
+// Index of the token starting the last complete word in `tokens`: everything before it decodes to
+// whole words. SentencePiece marks a piece that starts a word with U+2581.
+size_t LastWordBoundary(const std::vector<int32_t>& tokens) {
+    const TranslationModel& model = CurrentModel();
+    for (size_t i = tokens.size(); i-- > 0;) {
+        if (model.sp_target_processor.IdToPiece(tokens[i]).starts_with("\xE2\x96\x81")) return i;
+    }
+    return 0;
+}
+
+// Receives a segment's translation so far, as whole words; called at least once per decoded token
+// of the segment, so the first call marks its first token.
+using PartialTranslationCallback = std::function<void(size_t segment, const std::wstring& partial)>;
+
+// Translates independent segments (typically OCR lines) in length-bucketed batches. The result
+// has one entry per input segment, in input order, so callers can reassemble the layout.
+// Segments already in the translation cache skip inference entirely. A segment with a non-empty
+// entry in `drafts` (a likely translation, e.g. of a similar earlier line) is decoded on its own
+// against that draft instead of joining a batch. Segments longer than MAX_CHUNK_SOURCE_TOKENS are
+// split at sentence boundaries and their chunks batched like segments. With `on_partial`, each
+// segment's text is streamed as it is decoded: its finished leading chunks followed by the whole
+// words decoded so far of the next one. Returns nullopt, and caches nothing more, once `stop` is
+// requested; without a `stop` there is always a result.
+std::optional<std::vector<std::wstring>> TranslateSegments(const std::vector<std::wstring>& segments, std::stop_token stop = {},
+    const std::vector<std::wstring>& drafts = {}, const PartialTranslationCallback& on_partial = {}) {
+    if (g_translation_service) {
+        auto translations = TranslateThroughService(segments, stop);
+        if (stop.stop_requested()) return std::nullopt;
+        if (translations) return translations;
+    }
+    // Picks the language pair for this request, unless the caller has bound one already.
+    ModelBinding binding(g_bound_model ? nullptr : g_model_registry.Route(segments));
+    TranslationModel& model = CurrentModel();
+    std::vector<std::wstring> results(segments.size());
+    bool use_drafts = g_config.speculative_decoding && AcceptsDrafts(model.decoder_layout);
+
+    struct Chunk {
+        size_t segment = 0;
+        SourceChunk source;
+        std::optional<std::wstring> translation;  // set once decoded (or an error)
+        std::wstring partial;
+        size_t partial_boundary = 0;               // tokens already decoded into `partial`
+    };
+    std::vector<Chunk> chunks;
+    std::vector<std::vector<size_t>> segment_chunks(segments.size());
+    std::vector<std::string> normalized_sources(segments.size());
+    std::vector<size_t> order;
+    std::vector<size_t> drafted;
+    for (size_t i = 0; i < segments.size(); ++i) {
+        if (segments[i].empty()) continue;
+        normalized_sources[i] = NormalizeSegment(wstring_to_utf8(segments[i]));
+        if (normalized_sources[i].empty()) continue;
+        if (model.translation_cache) {
+            if (auto cached = model.translation_cache->Lookup(normalized_sources[i])) {
+                results[i] = utf8_to_wstring(*cached);
+                continue;
+            }
+        }
+        std::vector<SourceChunk> split;
+        {
+            TraceScope trace(g_tracer, "sp_encode");
+            std::vector<int32_t> source_ids;
+            model.sp_source_processor.Encode(normalized_sources[i], &source_ids);
+            if (source_ids.empty()) continue;
+            split = SplitIntoChunks(normalized_sources[i], std::move(source_ids));
+        }
+        bool has_draft = use_drafts && split.size() == 1 && i < drafts.size() && !drafts[i].empty();
+        for (auto& source : split) {
+            Chunk chunk{ i, std::move(source) };
+            if (split.size() > 1 && model.translation_cache) {
+                if (auto cached = model.translation_cache->Lookup(chunk.source.text)) chunk.translation = utf8_to_wstring(*cached);
+            }
+            if (!chunk.translation && chunk.source.ids.empty()) chunk.translation = L"";
+            if (!chunk.translation) (has_draft ? drafted : order).push_back(chunks.size());
+            segment_chunks[i].push_back(chunks.size());
+            chunks.push_back(std::move(chunk));
+        }
+    }
+
+    auto emit_partial = [&](size_t segment) {
+        std::wstring partial;
+        for (size_t c : segment_chunks[segment]) {
+            const auto& text = chunks[c].translation ? *chunks[c].translation : chunks[c].partial;
+            if (IsTranslationError(text)) break;
+            if (!partial.empty() && !text.empty()) partial += L' ';
+            partial += text;
+            if (!chunks[c].translation) break;
+        }
+        on_partial(segment, partial);
+    };
+    auto on_chunk_tokens = [&](size_t c, const std::vector<int32_t>& tokens) {
+        auto& chunk = chunks[c];
+        size_t boundary = LastWordBoundary(tokens);
+        if (boundary > chunk.partial_boundary) {
+            TraceScope trace(g_tracer, "detokenize");
+            std::string decoded_text;
+            model.sp_target_processor.Decode(std::vector<int32_t>(tokens.begin(), tokens.begin() + static_cast<std::ptrdiff_t>(boundary)), &decoded_text);
+            chunk.partial = utf8_to_wstring(decoded_text);
+            chunk.partial_boundary = boundary;
+        }
+        emit_partial(chunk.segment);
+    };
+
+    auto store_result = [&](size_t c, const std::optional<std::wstring>& error, const std::vector<int32_t>& output_tokens) {
+        auto& chunk = chunks[c];
+        if (error) {
+            chunk.translation = *error;
+            return;
+        }
+        std::string decoded_text;
+        {
+            TraceScope trace(g_tracer, "detokenize");
+            model.sp_target_processor.Decode(output_tokens, &decoded_text);
+        }
+        chunk.translation = utf8_to_wstring(decoded_text);
+        if (model.translation_cache) model.translation_cache->Insert(chunk.source.text, decoded_text);
+        if (on_partial) emit_partial(chunk.segment);
+    };
+
+    // Shortest first, so each bucket pads to a length close to its members'.
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return chunks[a].source.ids.size() < chunks[b].source.ids.size();
+    });
+
+    size_t begin = 0;
+    while (begin < order.size()) {
+        size_t end = begin + 1;
+        while (end < order.size() && end - begin < MAX_BATCH_SEGMENTS) {
+            size_t longest = chunks[order[end]].source.ids.size();
+            if (!model.encoder_layout.has_attention_mask && longest != chunks[order[begin]].source.ids.size()) break;
+            if ((end - begin + 1) * longest > MAX_BATCH_PADDED_TOKENS) break;
+            ++end;
+        }
+
+        std::vector<const std::vector<int32_t>*> bucket;
+        for (size_t i = begin; i < end; ++i) bucket.push_back(&chunks[order[i]].source.ids);
+
+        TokenCallback on_tokens;
+        if (on_partial) {
+            on_tokens = [&, begin](size_t row, const std::vector<int32_t>& tokens) { on_chunk_tokens(order[begin + row], tokens); };
+        }
+        if (stop.stop_requested()) return std::nullopt;
+        std::vector<std::vector<int32_t>> output_tokens;
+        auto error = TranslateBucket(bucket, output_tokens, stop, on_tokens);
+        if (stop.stop_requested()) return std::nullopt;
+        for (size_t i = begin; i < end; ++i) {
+            store_result(order[i], error, error ? std::vector<int32_t>{} : output_tokens[i - begin]);
+        }
+        begin = end;
+    }
+
+    for (size_t c : drafted) {
+        if (stop.stop_requested()) return std::nullopt;
+        size_t i = chunks[c].segment;
+        std::vector<int32_t> draft_ids;
+        model.sp_target_processor.Encode(NormalizeSegment(wstring_to_utf8(drafts[i])), &draft_ids);
+        TokenCallback on_tokens;
+        if (on_partial) on_tokens = [&, c](size_t, const std::vector<int32_t>& tokens) { on_chunk_tokens(c, tokens); };
+        std::vector<int32_t> output_tokens;
+        auto error = TranslateWithDraft(chunks[c].source.ids, draft_ids, output_tokens, stop, on_tokens);
+        if (stop.stop_requested()) return std::nullopt;
+        store_result(c, error, output_tokens);
+    }
+
+    // A segment fails with its first failed chunk. Split segments are cached whole as well, so
+    // the next lookup skips splitting.
+    for (size_t i = 0; i < segments.size(); ++i) {
+        if (segment_chunks[i].empty()) continue;
+        std::wstring joined;
+        bool failed = false;
+        for (size_t c : segment_chunks[i]) {
+            const auto& text = *chunks[c].translation;
+            if (IsTranslationError(text)) {
+                joined = text;
+                failed = true;
+                break;
+            }
+            if (!joined.empty() && !text.empty()) joined += L' ';
+            joined += text;
+        }
+        if (!failed && segment_chunks[i].size() > 1 && model.translation_cache) {
+            model.translation_cache->Insert(normalized_sources[i], wstring_to_utf8(joined));
+        }
+        results[i] = std::move(joined);
+    }
+    return results;
+}
+
+// `on_partial` receives the translation so far as it is decoded; see TranslateSegments.
+std::wstring TranslateText(const std::wstring& input_text, const std::function<void(const std::wstring&)>& on_partial = {}) {
+    if (input_text.empty()) return L"";
+    PartialTranslationCallback on_segment;
+    if (on_partial) on_segment = [&](size_t, const std::wstring& partial) { on_partial(partial); };
+    return TranslateSegments({ input_text }, {}, {}, on_segment)->front();
+}
+
+// --- Incremental Retranslation ---
+
+// Translations of the lines currently on screen, kept between OCR passes so only lines that
+// were added or edited need translating.
+struct ScreenTranslation {
+    std::vector<std::wstring> source_lines;
+    std::vector<std::wstring> translated_lines;
+};
+
+// Characters two lines share at their start and end: a cheap similarity for picking a draft, since
+// a line that grew by a word or had one item changed keeps most of both.
+size_t SharedAffixLength(std::wstring_view a, std::wstring_view b) {
+    size_t prefix = static_cast<size_t>(std::mismatch(a.begin(), a.end(), b.begin(), b.end()).first - a.begin());
+    size_t limit = (std::min)(a.size(), b.size()) - prefix;
+    size_t suffix = 0;
+    while (suffix < limit && a[a.size() - 1 - suffix] == b[b.size() - 1 - suffix]) ++suffix;
+    return prefix + suffix;
+}
+
+// Translation of the previous line most like `line`, as a draft for speculative decoding, or
+// empty if no line shares at least half its text.
+std::wstring FindDraftTranslation(const ScreenTranslation& state, const std::wstring& line) {
+    size_t best_shared = 0;
+    const std::wstring* best = nullptr;
+    for (size_t i = 0; i < state.source_lines.size(); ++i) {
+        const auto& previous = state.source_lines[i];
+        if (IsTranslationError(state.translated_lines[i]) || state.translated_lines[i].empty()) continue;
+        size_t shared = SharedAffixLength(line, previous);
+        if (shared * 2 >= (std::max)(line.size(), previous.size()) && shared > best_shared) {
+            best_shared = shared;
+            best = &state.translated_lines[i];
+        }
+    }
+    return best ? *best : std::wstring();
+}
+
+// OCR re-reads that OcrJitterFilter judged to be noise rather than a real change.
+struct JitterStats {
+    std::atomic<uint64_t> passes_suppressed{ 0 };  // whole OCR passes not translated
+    std::atomic<uint64_t> lines_reused{ 0 };       // lines that kept the translation of their earlier reading
+};
+
+JitterStats g_jitter_stats;
+
+// Diffs `lines` against the previous OCR pass at line granularity. A line whose text appeared
+// anywhere on the previous screen reuses that translation (so scrolling and reordering are free),
+// as does one that only differs from a previous line by OCR jitter; it then keeps the earlier
+// reading as its source, so repeated jitter can't drift away from it. Added or modified lines are
+// translated together, each modified one using the translation of the previous line it most
+// resembles as a speculative draft. `on_progress`, if set, receives the translated lines so far on
+// the first decoded token and whenever a pending line's translation changes after that. Until its
+// first words arrive, a pending line keeps the translation of the previous line it most resembles,
+// or else of the line in its place if the line count didn't change, so edited lines don't blink
+// out. Whole passes that are only jitter are the caller's to drop, before they cancel anything (see
+// ScreenTranslationPipeline::RecognizeFrame). Returns false if the lines are exactly the previous
+// ones, or if `stop` was requested mid-translation, in which case `state` is left untouched.
+bool UpdateScreenTranslation(ScreenTranslation& state, std::vector<std::wstring> lines, std::stop_token stop = {},
+    const std::function<void(const std::vector<std::wstring>& translated_lines)>& on_progress = {}) {
+    if (lines == state.source_lines) return false;
+    OcrJitterFilter jitter_filter(g_config.ocr_jitter_threshold);
+
+    std::unordered_map<std::wstring, const std::wstring*> previous;
+    for (size_t i = 0; i < state.source_lines.size(); ++i) {
+        if (!IsTranslationError(state.translated_lines[i])) {
+            previous.emplace(state.source_lines[i], &state.translated_lines[i]);
+        }
+    }
+
+    std::vector<std::wstring> translated_lines(lines.size());
+    std::vector<std::wstring> pending_sources;
+    std::vector<std::wstring> pending_drafts;
+    std::unordered_map<std::wstring, size_t> pending_index;
+    std::vector<size_t> pending_slot(lines.size(), SIZE_MAX);
+    std::vector<std::vector<size_t>> slot_lines;       // the lines each pending source fills
+    std::vector<bool> slot_started;                    // whether its first words have arrived
+    for (size_t i = 0; i < lines.size(); ++i) {
+        if (auto it = previous.find(lines[i]); it != previous.end()) {
+            translated_lines[i] = *it->second;
+            continue;
+        }
+        size_t earlier = 0;
+        while (earlier < state.source_lines.size() && (IsTranslationError(state.translated_lines[earlier])
+            || !jitter_filter.SameLine(lines[i], state.source_lines[earlier]))) {
+            ++earlier;
+        }
+        if (earlier < state.source_lines.size()) {
+            lines[i] = state.source_lines[earlier];
+            translated_lines[i] = state.translated_lines[earlier];
+            ++g_jitter_stats.lines_reused;
+            continue;
+        }
+        std::wstring similar = FindDraftTranslation(state, lines[i]);
+        auto [it, inserted] = pending_index.emplace(lines[i], pending_sources.size());
+        if (inserted) {
+            pending_sources.push_back(lines[i]);
+            pending_drafts.push_back(g_config.speculative_decoding ? similar : std::wstring());
+            slot_lines.emplace_back();
+            slot_started.push_back(false);
+        }
+        pending_slot[i] = it->second;
+        slot_lines[it->second].push_back(i);
+        if (on_progress) {
+            bool same_layout = lines.size() == state.source_lines.size() && !IsTranslationError(state.translated_lines[i]);
+            translated_lines[i] = !similar.empty() ? std::move(similar) : same_layout ? state.translated_lines[i] : std::wstring();
+        }
+    }
+
+    if (!pending_sources.empty()) {
+        PartialTranslationCallback on_partial;
+        bool progress_reported = false;
+        if (on_progress) {
+            on_partial = [&](size_t slot, const std::wstring& partial) {
+                // Partials only change at word boundaries; most tokens leave the lines as they are.
+                bool changed = !partial.empty() && (!slot_started[slot] || partial != translated_lines[slot_lines[slot].front()]);
+                if (changed) {
+                    slot_started[slot] = true;
+                    for (size_t i : slot_lines[slot]) translated_lines[i] = partial;
+                }
+                if (changed || !progress_reported) on_progress(translated_lines);
+                progress_reported = true;
+            };
+        }
+        auto pending_translations = TranslateSegments(pending_sources, stop, pending_drafts, on_partial);
+        if (!pending_translations) return false;
+        for (size_t i = 0; i < lines.size(); ++i) {
+            if (pending_slot[i] != SIZE_MAX) translated_lines[i] = (*pending_translations)[pending_slot[i]];
+        }
+    }
+
+    state.source_lines = std::move(lines);
+    state.translated_lines = std::move(translated_lines);
+    return true;
+}
+
+#ifdef _WIN32
+INT_PTR CALLBACK MainDlgProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM) {
+    switch (message) {
+    case WM_INITDIALOG:
+        CheckRadioButton(hDlg, IDC_RADIO_FULLSCREEN, IDC_RADIO_REGION, IDC_RADIO_FULLSCREEN);
+        return TRUE;
+    case WM_COMMAND:
+        switch (LOWORD(wParam)) {
+        case IDOK:
+            g_fullscreen_mode = (IsDlgButtonChecked(hDlg, IDC_RADIO_FULLSCREEN) == BST_CHECKED);
+            EndDialog(hDlg, IDOK);
+            return TRUE;
+        case IDCANCEL:
+            EndDialog(hDlg, IDCANCEL);
+            return TRUE;
+        }
+        break;
+    }
+    return FALSE;
+}
+
+RECT SelectScreenRegion() {
+    HWND hSelectionOverlay = CreateWindowExW(
+        WS_EX_TOPMOST | WS_EX_LAYERED | WS_EX_TRANSPARENT,
+        L"STATIC", L"Drag to select region", WS_POPUP | WS_BORDER,
+        0, 0, GetSystemMetrics(SM_CXSCREEN), GetSystemMetrics(SM_CYSCREEN),
+        nullptr, nullptr, g_hinstance, nullptr);
+
+    SetLayeredWindowAttributes(hSelectionOverlay, 0, 180, LWA_ALPHA);
+    ShowWindow(hSelectionOverlay, SW_SHOW);
+    UpdateWindow(hSelectionOverlay);
+
+    POINT start_pt{}, end_pt{};
+    bool selecting_region = false;
+    HDC hdc = GetDC(hSelectionOverlay);
+    auto hPen = std::unique_ptr<HPEN, decltype(&DeleteObject)>(
+        CreatePen(PS_SOLID, 2, RGB(255, 0, 0)), DeleteObject);
+    SelectObject(hdc, GetStockObject(NULL_BRUSH));
+    SelectObject(hdc, hPen.get());
+
+    MSG msg;
+    while (true) {
+        if (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
+            TranslateMessage(&msg);
+            DispatchMessage(&msg);
+        }
+
+        if (GetAsyncKeyState(VK_LBUTTON) & 0x8000) {
+            if (!selecting_region) {
+                GetCursorPos(&start_pt);
+                ScreenToClient(hSelectionOverlay, &start_pt);
+                end_pt = start_pt;
+                selecting_region = true;
+                SetCapture(hSelectionOverlay);
+            } else {
+                GetCursorPos(&end_pt);
+                ScreenToClient(hSelectionOverlay, &end_pt);
+                InvalidateRect(hSelectionOverlay, NULL, TRUE);
+                UpdateWindow(hSelectionOverlay);
+            }
+        } else {
+            if (selecting_region) {
+                ReleaseCapture();
+                GetCursorPos(&end_pt);
+                break;
+            }
+        }
+        if (GetAsyncKeyState(VK_ESCAPE) & 0x8000) {
+            ReleaseCapture();
+            DestroyWindow(hSelectionOverlay);
+            ReleaseDC(hSelectionOverlay, hdc);
+            return RECT{ 0,0,0,0 };
+        }
+        Sleep(10);
+    }
+
+    ReleaseCapture();
+    ReleaseDC(hSelectionOverlay, hdc);
+    DestroyWindow(hSelectionOverlay);
+
+    return RECT{
+        min(start_pt.x, end_pt.x),
+        min(start_pt.y, end_pt.y),
+        max(start_pt.x, end_pt.x),
+        max(start_pt.y, end_pt.y)
+    };
+}
+
+// Interface for IBufferByteAccess
+#include <robuffer.h> // For Windows::Storage::Streams::IBufferByteAccess
+
+// --- Frame Sources ---
+
+// 32bpp top-down DIB section selected into its own memory DC. BitBlt writes straight into `bits`,
+// so captured pixels can be read in place instead of being copied out with GetDIBits.
+struct DibSection {
+    HDC dc = nullptr;
+    HBITMAP bitmap = nullptr;
+    HGDIOBJ previous_bitmap = nullptr;
+    uint8_t* bits = nullptr;
+    int width = 0;
+    int height = 0;
+
+    DibSection() = default;
+    DibSection(const DibSection&) = delete;
+    DibSection& operator=(const DibSection&) = delete;
+
+    ~DibSection() {
+        if (dc) {
+            SelectObject(dc, previous_bitmap);
+            DeleteDC(dc);
+        }
+        if (bitmap) DeleteObject(bitmap);
+    }
+
+    static std::unique_ptr<DibSection> Create(int width, int height) {
+        auto dib = std::make_unique<DibSection>();
+        BITMAPINFOHEADER bi = { sizeof(bi), width, -height, 1, 32, BI_RGB };
+        void* bits = nullptr;
+        dib->bitmap = CreateDIBSection(nullptr, reinterpret_cast<BITMAPINFO*>(&bi), DIB_RGB_COLORS, &bits, nullptr, 0);
+        if (!dib->bitmap || !bits) return nullptr;
+        dib->dc = CreateCompatibleDC(nullptr);
+        if (!dib->dc) return nullptr;
+        dib->previous_bitmap = SelectObject(dib->dc, dib->bitmap);
+        dib->bits = static_cast<uint8_t*>(bits);
+        dib->width = width;
+        dib->height = height;
+        return dib;
+    }
+};
+
+// Captures a screen rectangle into pooled DIB sections. A frame keeps its DIB out of the pool
+// until every stage holding it is done, so the next capture never overwrites pixels still in use.
+class GdiFrameSource : public FrameSource {
+public:
+    // The DPI is that of the monitor holding most of the region; the process is per-monitor DPI
+    // aware (see wWinMain), so it is the real one rather than 96.
+    explicit GdiFrameSource(const RECT& region) : region_(region) {
+        UINT dpi_x = 0, dpi_y = 0;
+        HMONITOR monitor = MonitorFromRect(&region_, MONITOR_DEFAULTTONEAREST);
+        if (SUCCEEDED(GetDpiForMonitor(monitor, MDT_EFFECTIVE_DPI, &dpi_x, &dpi_y)) && dpi_x > 0) dpi_ = static_cast<int>(dpi_x);
+    }
+
+    Frame Capture() override {
+        int width = region_.right - region_.left;
+        int height = region_.bottom - region_.top;
+        if (width <= 0 || height <= 0) return {};
+
+        std::shared_ptr<DibSection> dib = pool_.Acquire(
+            [&](const DibSection& candidate) { return candidate.width == width && candidate.height == height; },
+            [&] { return DibSection::Create(width, height); });
+        if (!dib) return {};
+
+        HDC dcScreen = GetDC(nullptr);
+        BOOL copied = BitBlt(dib->dc, 0, 0, width, height, dcScreen, region_.left, region_.top, SRCCOPY);
+        ReleaseDC(nullptr, dcScreen);
+        GdiFlush(); // the blit may still be queued; finish it before the bits are read
+        if (!copied) return {};
+
+        Frame frame;
+        frame.pixels = dib->bits;
+        frame.width = width;
+        frame.height = height;
+        frame.stride = static_cast<size_t>(width) * 4;
+        frame.sequence = next_sequence_++;
+        frame.timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        frame.dpi = dpi_;
+        frame.owner = std::move(dib);
+        return frame;
+    }
+
+    RecyclingPoolStats PoolStats() const { return pool_.Stats(); }
+
+private:
+    RECT region_;
+    int dpi_ = USER_DEFAULT_SCREEN_DPI;
+    RecyclingPool<DibSection> pool_;
+    uint64_t next_sequence_ = 0;
+};
+
+// Copies Bgra8 or Gray8 pixels into `bitmap`, reallocating it only when the size or format
+// changes. OCR only accepts a SoftwareBitmap, so this is the one copy before recognition.
+bool CopyToSoftwareBitmap(const uint8_t* pixels, int width, int height, size_t stride, BitmapPixelFormat format, SoftwareBitmap& bitmap) {
+    try {
+        if (!bitmap || bitmap.PixelWidth() != width || bitmap.PixelHeight() != height || bitmap.BitmapPixelFormat() != format) {
+            bitmap = SoftwareBitmap(format, width, height, BitmapAlphaMode::Ignore);
+        }
+
+        BitmapBuffer buffer = bitmap.LockBuffer(BitmapBufferAccessMode::Write);
+        BitmapPlaneDescription plane = buffer.GetPlaneDescription(0);
+        IMemoryBufferReference reference = buffer.CreateReference();
+
+        uint8_t* destPixels = nullptr;
+        auto byteAccess = reference.as<::Windows::Storage::Streams::IBufferByteAccess>();
+        winrt::check_hresult(byteAccess->Buffer(&destPixels));
+        uint32_t capacity = reference.Capacity();
+
+        size_t row_bytes = static_cast<size_t>(width) * (format == BitmapPixelFormat::Gray8 ? 1 : 4);
+        size_t dest_stride = static_cast<size_t>(plane.Stride);
+        size_t needed = static_cast<size_t>(plane.StartIndex) + dest_stride * (height - 1) + row_bytes;
+        bool fits = dest_stride >= row_bytes && capacity >= needed;
+        if (fits) {
+            uint8_t* dest = destPixels + plane.StartIndex;
+            if (dest_stride == stride) {
+                std::memcpy(dest, pixels, dest_stride * height);
+            } else {
+                for (int y = 0; y < height; ++y) {
+                    std::memcpy(dest + y * dest_stride, pixels + y * stride, row_bytes);
+                }
+            }
+        }
+
+        reference.Close();
+        buffer.Close();
+        return fits;
+
+    } catch (winrt::hresult_error const&) {
+        return false;
+    }
+}
+
+// --- Frame Recognition ---
+
+// OCR in the configured source language or, with [Models] Source=auto, in the source language of an
+// installed pair (see PairSourceLanguages), so a machine with only a ja-en pair reads Japanese even
+// on an English Windows. Without a pair Windows can recognize, the first display language with OCR
+// support. English is the last resort.
+OcrEngine CreateOcrEngine() {
+    OcrEngine engine = nullptr;
+    try {
+        std::vector<std::string> languages = { g_config.source_language };
+        if (g_config.source_language.empty()) languages = PairSourceLanguages(GetModelsDirectoryPath(), g_config);
+        for (const auto& language : languages) {
+            Language ocr_language(winrt::hstring(utf8_to_wstring(language)));
+            if (OcrEngine::IsLanguageSupported(ocr_language)) engine = OcrEngine::TryCreateFromLanguage(ocr_language);
+            if (engine) break;
+        }
+        if (!engine && g_config.source_language.empty()) engine = OcrEngine::TryCreateFromUserProfileLanguages();
+        if (!engine) engine = OcrEngine::TryCreateFromLanguage(Language(L"en"));
+    } catch (winrt::hresult_error const&) {}
+    return engine;
+}
+
+// OCR side of the pipeline, shared with the replay benchmark. Only the regions of the capture that
+// changed since the last recognized frame go through OCR; their lines are spliced into the cached
+// layout of the rest. This keeps its own change detector: the capture thread compares consecutive
+// captures, and changes in frames dropped on the way to OCR would otherwise be missed.
+class FrameRecognizer {
+public:
+    explicit FrameRecognizer(OcrEngine engine)
+        : engine_(std::move(engine)), change_detector_(CHANGE_DETECTION_TILE_SIZE),
+          layout_({ .full_pass_fraction = g_config.ocr_dirty_regions ? 0.5 : 0.0 }),
+          preprocessor_({ .downscale = g_config.ocr_downscale }) {}
+
+    // Lines on screen after `frame`, top to bottom.
+    std::vector<std::wstring> Recognize(const Frame& frame) {
+        TraceScope trace(g_tracer, "ocr");
+        change_detector_.Update(frame.pixels, frame.width, frame.height, frame.stride);
+        auto regions = layout_.PlanRegions(change_detector_.changed_tiles(), change_detector_.tiles_x(),
+            change_detector_.tiles_y(), change_detector_.tile_size(), frame.width, frame.height);
+        for (const auto& region : regions) {
+            layout_.Splice(region, RecognizeRegion(frame, region));
+        }
+        return layout_.Text();
+    }
+
+    OcrLayoutStats LayoutStats() const { return layout_.Stats(); }
+
+private:
+    // Lines inside `region`, with word boxes mapped back to capture pixels. With preprocessing on,
+    // OCR sees the gray, DPI-downscaled crop around likely text instead of the raw BGRA pixels.
+    std::vector<RecognizedLine> RecognizeRegion(const Frame& frame, const PixelRect& region) {
+        const uint8_t* pixels = frame.pixels + static_cast<size_t>(region.top) * frame.stride + static_cast<size_t>(region.left) * 4;
+        float origin_x = static_cast<float>(region.left), origin_y = static_cast<float>(region.top), scale = 1.0f;
+        bool copied = false;
+        if (g_config.ocr_preprocess) {
+            TraceScope trace(g_tracer, "ocr_preprocess");
+            PreprocessedImage image = preprocessor_.Process(pixels, region.width(), region.height(), frame.stride, frame.dpi);
+            if (!image) return {}; // nothing that looks like text
+            origin_x += static_cast<float>(image.origin_x);
+            origin_y += static_cast<float>(image.origin_y);
+            scale = static_cast<float>(image.scale);
+            copied = CopyToSoftwareBitmap(image.pixels, image.width, image.height, image.stride, BitmapPixelFormat::Gray8, bitmap_);
+        } else {
+            copied = CopyToSoftwareBitmap(pixels, region.width(), region.height(), frame.stride, BitmapPixelFormat::Bgra8, bitmap_);
+        }
+        if (!copied) return {};
+
+        std::vector<RecognizedLine> lines;
+        try {
+            TraceScope trace(g_tracer, "ocr_recognize");
+            OcrResult ocr_result = engine_.RecognizeAsync(bitmap_).get();
+            for (const auto& line : ocr_result.Lines()) {
+                RecognizedLine ocr_line{ std::wstring(line.Text().c_str()), {} };
+                for (const auto& word : line.Words()) {
+                    winrt::Windows::Foundation::Rect bounds = word.BoundingRect();
+                    PixelRect box{
+                        static_cast<int>(std::floor(origin_x + bounds.X * scale)),
+                        static_cast<int>(std::floor(origin_y + bounds.Y * scale)),
+                        static_cast<int>(std::ceil(origin_x + (bounds.X + bounds.Width) * scale)),
+                        static_cast<int>(std::ceil(origin_y + (bounds.Y + bounds.Height) * scale)) };
+                    ocr_line.box = ocr_line.box.Union(box);
+                }
+                lines.push_back(std::move(ocr_line));
+            }
+        } catch (winrt::hresult_error const& e) {
+            g_tracer.RecordError("ocr", winrt::to_string(e.message()));
+        }
+        return lines;
+    }
+
+    OcrEngine engine_;
+    FrameChangeDetector change_detector_;
+    OcrLayoutCache layout_;
+    OcrPreprocessor preprocessor_;
+    SoftwareBitmap bitmap_ = nullptr;
+};
+
+LRESULT CALLBACK OverlayWndProc(HWND hwnd, UINT msg, WPARAM wp, LPARAM lp) {
+    switch (msg) {
+    case WM_PAINT: {
+        TraceScope trace(g_tracer, "paint");
+        PAINTSTRUCT ps;
+        HDC hdc = BeginPaint(hwnd, &ps);
+        SetBkMode(hdc, TRANSPARENT);
+        SetTextColor(hdc, RGB(255, 255, 0));
+        RECT client_rect;
+        GetClientRect(hwnd, &client_rect);
+
+        // 24 px at 100% scaling, as large on screen at any DPI.
+        HFONT hFont = CreateFontW(MulDiv(24, static_cast<int>(GetDpiForWindow(hwnd)), USER_DEFAULT_SCREEN_DPI), 0, 0, 0, FW_BOLD, FALSE, FALSE, FALSE, DEFAULT_CHARSET,
+            OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS, DEFAULT_QUALITY,
+            DEFAULT_PITCH | FF_SWISS, L"Arial");
+        HFONT oldFont = static_cast<HFONT>(SelectObject(hdc, hFont));
+        DrawTextW(hdc, g_current_overlay_text.c_str(), -1, &client_rect, DT_CENTER | DT_VCENTER | DT_WORDBREAK | DT_NOCLIP);
+        SelectObject(hdc, oldFont);
+        DeleteObject(hFont);
+        EndPaint(hwnd, &ps);
+        return 0;
+    }
+    }
+    return DefWindowProc(hwnd, msg, wp, lp);
+}
+
+void RegisterOverlayWindowClass(HINSTANCE hInstance) {
+    WNDCLASSW wc = { 0 };
+    wc.lpfnWndProc = OverlayWndProc;
+    wc.hInstance = hInstance;
+    wc.lpszClassName = OVERLAY_WINDOW_CLASS;
+    wc.hbrBackground = static_cast<HBRUSH>(GetStockObject(BLACK_BRUSH));
+    wc.style = CS_HREDRAW | CS_VREDRAW;
+    if (!RegisterClassW(&wc)) {
+        show_message_box(L"Failed to register overlay window class.", L"Error");
+    }
+}
+
+void UnregisterOverlayWindowClass(HINSTANCE hInstance) {
+    UnregisterClassW(OVERLAY_WINDOW_CLASS, hInstance);
+}
+
+void CreateOrUpdateOverlayWindow(const std::wstring& text, const RECT& target_ocr_region) {
+    g_current_overlay_text = text;
+
+    if (!g_overlay_hwnd) {
+        int overlay_width = 600;
+        int overlay_height = 100;
+        int overlay_x = target_ocr_region.left;
+        int overlay_y = target_ocr_region.bottom + 5;
+
+        HMONITOR hMonitor = MonitorFromRect(&target_ocr_region, MONITOR_DEFAULTTONEAREST);
+        MONITORINFO monitorInfo = { sizeof(monitorInfo) };
+        if (GetMonitorInfo(hMonitor, &monitorInfo)) {
+            if (overlay_x + overlay_width > monitorInfo.rcWork.right)
+                overlay_x = monitorInfo.rcWork.right - overlay_width;
+            if (overlay_y + overlay_height > monitorInfo.rcWork.bottom)
+                overlay_y = monitorInfo.rcWork.bottom - overlay_height;
+            if (overlay_x < monitorInfo.rcWork.left) overlay_x = monitorInfo.rcWork.left;
+            if (overlay_y < monitorInfo.rcWork.top) overlay_y = monitorInfo.rcWork.top;
+        }
 
         g_overlay_hwnd = CreateWindowExW(
             WS_EX_LAYERED | WS_EX_TOPMOST | WS_EX_NOACTIVATE,
@@ -460,120 +3318,1992 @@ void CreateOrUpdateOverlayWindow(const std::wstring& text, const RECT& target_oc
             overlay_x, overlay_y, overlay_width, overlay_height,
             nullptr, nullptr, g_hinstance, nullptr);
 
-        if (!g_overlay_hwnd) {
-            return;
+        if (!g_overlay_hwnd) {
+            return;
+        }
+        SetLayeredWindowAttributes(g_overlay_hwnd, 0, 220, LWA_ALPHA);
+        ShowWindow(g_overlay_hwnd, SW_SHOWNA);
+        UpdateWindow(g_overlay_hwnd);
+    } else {
+        InvalidateRect(g_overlay_hwnd, nullptr, TRUE);
+        UpdateWindow(g_overlay_hwnd);
+    }
+}
+
+// --- Screen Translation Pipeline ---
+
+// What the pipeline skipped along the way, for the trace stats log.
+struct PipelineCounters {
+    std::atomic<uint64_t> frames_captured{ 0 };
+    std::atomic<uint64_t> frames_unchanged{ 0 };    // too few changed tiles to run OCR
+    std::atomic<uint64_t> ocr_passes{ 0 };
+    std::atomic<uint64_t> ocr_text_unchanged{ 0 };  // OCR ran but found the same lines
+    std::atomic<uint64_t> translation_passes{ 0 };
+};
+
+PipelineCounters g_pipeline_counters;
+
+// Overlay text for translated lines: one per line, blank ones skipped.
+std::wstring JoinTranslatedLines(const std::vector<std::wstring>& translated_lines) {
+    std::wstring text;
+    for (const auto& line : translated_lines) {
+        if (line.empty()) continue;
+        if (!text.empty()) text += L'\n';
+        text += line;
+    }
+    return text;
+}
+
+// Capture -> OCR -> translate, one thread per stage, joined by latest-wins queues so a slow stage
+// only ever works on the newest input. A new set of OCR lines cancels the translation in flight.
+// Finished overlay text is handed to the UI thread with WM_APP_OVERLAY_READY. Frames come from a
+// FrameSource: the screen, or a recording being replayed.
+class ScreenTranslationPipeline {
+public:
+    ScreenTranslationPipeline(OcrEngine engine, std::unique_ptr<FrameSource> frame_source, DWORD ui_thread_id,
+        std::shared_future<bool> engine_ready)
+        : recognizer_(std::move(engine)), frame_source_(std::move(frame_source)), ui_thread_id_(ui_thread_id),
+          engine_ready_(std::move(engine_ready)),
+          translate_stage_("translate",
+              [this](std::vector<std::wstring>&& lines, std::stop_token stop) { TranslateLines(std::move(lines), stop); },
+              { .capacity = 1, .cancel_superseded = true,
+                .on_thread_start = [] {
+                    g_tracer.NameCurrentThread("translate");
+                    g_thread_budget.RegisterCurrentThread(ThreadRole::Translate);
+                },
+                .on_thread_exit = [] { g_thread_budget.UnregisterCurrentThread(); } }),
+          ocr_stage_("ocr",
+              [this](Frame&& frame, std::stop_token stop) { RecognizeFrame(std::move(frame), stop); },
+              { .capacity = 1,
+                .on_thread_start = [] {
+                    winrt::init_apartment(apartment_type::multi_threaded);
+                    g_tracer.NameCurrentThread("ocr");
+                    g_thread_budget.RegisterCurrentThread(ThreadRole::Ocr);
+                },
+                .on_thread_exit = [] {
+                    g_thread_budget.UnregisterCurrentThread();
+                    winrt::uninit_apartment();
+                } }) {}
+
+    ~ScreenTranslationPipeline() { Stop(); }
+
+    void Start() {
+        start_time_ = std::chrono::steady_clock::now();
+        translate_stage_.Start();
+        ocr_stage_.Start();
+        capture_thread_ = std::jthread([this](std::stop_token stop) { CaptureLoop(stop); });
+    }
+
+    // Producers stop first so no stage is fed after its consumer has gone.
+    void Stop() {
+        if (capture_thread_.joinable()) {
+            capture_thread_.request_stop();
+            capture_thread_.join();
+        }
+        ocr_stage_.Stop();
+        translate_stage_.Stop();
+    }
+
+    // Writes every changed frame to `path` for later replay. Call before Start.
+    bool RecordTo(const std::filesystem::path& path) { return recorder_.Open(path); }
+
+    std::optional<std::wstring> TakeOverlayText() { return overlay_text_.TryPop(); }
+
+    // Time to first token and to the finished translation, per translated OCR pass. Call after Stop.
+    void ReportTranslationLatency() const {
+        if (ttft_ms_.empty()) return;
+        auto report = std::format(L"Translation latency: {} passes; first token p50 {:.1f} ms, p95 {:.1f} ms; "
+            L"complete p50 {:.1f} ms, p95 {:.1f} ms\n",
+            ttft_ms_.size(), Percentile(ttft_ms_, 0.50), Percentile(ttft_ms_, 0.95),
+            Percentile(translate_ms_, 0.50), Percentile(translate_ms_, 0.95));
+        DebugReport(report);
+    }
+
+private:
+    // OCR only runs when enough tiles changed since the last capture; the poll interval
+    // tightens while the screen is active and backs off while it is idle. Frames are handed on by
+    // reference to their pooled buffer, never copied.
+    void CaptureLoop(std::stop_token stop) {
+        g_tracer.NameCurrentThread("capture");
+        g_thread_budget.RegisterCurrentThread(ThreadRole::Capture);
+        FrameChangeDetector change_detector(CHANGE_DETECTION_TILE_SIZE);
+        AdaptivePollInterval poll_interval(FASTEST_POLL_INTERVAL, SLOWEST_POLL_INTERVAL);
+
+        bool screen_changed = false;
+        do {
+            screen_changed = false;
+            Frame frame;
+            {
+                TraceScope trace(g_tracer, "capture");
+                frame = frame_source_->Capture();
+            }
+            if (frame) {
+                ++g_pipeline_counters.frames_captured;
+                FrameChange change;
+                {
+                    TraceScope trace(g_tracer, "change_detect");
+                    change = change_detector.Update(frame.pixels, frame.width, frame.height, frame.stride);
+                }
+                screen_changed = (change.changed_tiles >= MIN_CHANGED_TILES_FOR_OCR);
+                if (!screen_changed) ++g_pipeline_counters.frames_unchanged;
+                if (change.changed_tiles > 0 && recorder_.is_open()) recorder_.Write(frame);
+            }
+            if (screen_changed) {
+                ocr_stage_.Push(std::move(frame));
+            }
+        } while (!frame_source_->Finished() && InterruptibleSleep(stop, poll_interval.Next(screen_changed)));
+        g_thread_budget.UnregisterCurrentThread();
+    }
+
+    void RecognizeFrame(Frame&& frame, std::stop_token) {
+        std::vector<std::wstring> source_lines = recognizer_.Recognize(frame);
+        frame = {}; // hand the capture buffer back to the pool before translation is queued
+        ++g_pipeline_counters.ocr_passes;
+        if (source_lines.empty()) return;
+        // Pixel changes that don't change the text (cursor blink, animations), and re-reads that
+        // differ only by OCR jitter, must not cancel the translation in flight.
+        if (source_lines == last_ocr_lines_) {
+            ++g_pipeline_counters.ocr_text_unchanged;
+            return;
+        }
+        if (jitter_filter_.SameLines(source_lines, last_ocr_lines_)) {
+            ++g_jitter_stats.passes_suppressed;
+            return;
+        }
+        last_ocr_lines_ = source_lines;
+        translate_stage_.Push(std::move(source_lines));
+    }
+
+    // Blocks until the background model load has finished. While it runs, the overlay shows a
+    // placeholder so it's clear OCR is already working.
+    bool WaitForEngine(std::stop_token stop) {
+        if (engine_state_ != EngineState::Loading) return engine_state_ == EngineState::Ready;
+        if (engine_ready_.wait_for(std::chrono::milliseconds(0)) != std::future_status::ready && !loading_notice_shown_) {
+            loading_notice_shown_ = true;
+            ShowOverlayText(L"Loading translation models...");
+        }
+        while (engine_ready_.wait_for(ENGINE_WAIT_POLL_INTERVAL) != std::future_status::ready) {
+            if (stop.stop_requested()) return false;
+        }
+        engine_state_ = engine_ready_.get() ? EngineState::Ready : EngineState::Failed;
+        if (engine_state_ == EngineState::Failed) {
+            PostThreadMessageW(ui_thread_id_, WM_APP_ENGINE_FAILED, 0, 0);
+        }
+        return engine_state_ == EngineState::Ready;
+    }
+
+    void ShowOverlayText(std::wstring text) {
+        overlay_text_.Push(std::move(text));
+        PostThreadMessageW(ui_thread_id_, WM_APP_OVERLAY_READY, 0, 0);
+    }
+
+    void ReportFirstTranslation() {
+        g_startup_metrics.first_translation_ms = g_startup_metrics.ElapsedMs();
+        auto since_capture = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time_);
+        auto report = std::format(L"Startup: models ready after {} ms ({} optimized graphs reused, {} rebuilt); "
+            L"first translation {} ms after launch, {} ms after capture started\n",
+            g_startup_metrics.engine_ready_ms.load(), g_startup_metrics.graphs_reused.load(),
+            g_startup_metrics.graphs_optimized.load(), g_startup_metrics.first_translation_ms.load(), since_capture.count());
+        DebugReport(report);
+    }
+
+    // Partial translations refresh the overlay at most every PARTIAL_OVERLAY_INTERVAL; progress in
+    // between is picked up by the next refresh or the finished text, which is always shown. Edited
+    // lines show their previous translation until their first words arrive (see
+    // UpdateScreenTranslation).
+    void TranslateLines(std::vector<std::wstring>&& lines, std::stop_token stop) {
+        if (!WaitForEngine(stop)) return;
+        TraceScope trace(g_tracer, "translate");
+        using clock = std::chrono::steady_clock;
+        auto translate_start = clock::now();
+        bool first_token_seen = false;
+        clock::time_point last_refresh;
+        std::wstring shown_text = JoinTranslatedLines(screen_translation_.translated_lines);
+        std::function<void(const std::vector<std::wstring>&)> on_progress;
+        if (g_config.streaming_overlay) {
+            on_progress = [&](const std::vector<std::wstring>& translated_lines) {
+                auto now = clock::now();
+                if (!first_token_seen) {
+                    first_token_seen = true;
+                    ttft_ms_.push_back(std::chrono::duration<double, std::milli>(now - translate_start).count());
+                }
+                if (now - last_refresh < PARTIAL_OVERLAY_INTERVAL) return;
+                auto text = JoinTranslatedLines(translated_lines);
+                if (text == shown_text) return;
+                last_refresh = now;
+                shown_text = text;
+                ShowOverlayText(std::move(text));
+            };
+        }
+
+        // Only added or edited lines are translated; the rest keep last pass's translation.
+        if (!UpdateScreenTranslation(screen_translation_, std::move(lines), stop, on_progress)) return;
+        ++g_pipeline_counters.translation_passes;
+        if (first_token_seen) translate_ms_.push_back(std::chrono::duration<double, std::milli>(clock::now() - translate_start).count());
+
+        std::wstring translated_text = JoinTranslatedLines(screen_translation_.translated_lines);
+        ShowOverlayText(translated_text.empty() ? L"..." : std::move(translated_text));
+        if (g_startup_metrics.first_translation_ms < 0) ReportFirstTranslation();
+    }
+
+    enum class EngineState { Loading, Ready, Failed };
+
+    FrameRecognizer recognizer_;                      // OCR thread only
+    std::unique_ptr<FrameSource> frame_source_;       // capture thread only
+    FrameRecorder recorder_;                          // capture thread only
+    DWORD ui_thread_id_;
+    std::shared_future<bool> engine_ready_;
+    std::chrono::steady_clock::time_point start_time_;
+
+    EngineState engine_state_ = EngineState::Loading;  // translate thread only
+    bool loading_notice_shown_ = false;                // translate thread only
+
+    std::vector<std::wstring> last_ocr_lines_;       // OCR thread only
+    OcrJitterFilter jitter_filter_{ g_config.ocr_jitter_threshold };
+    ScreenTranslation screen_translation_;            // translate thread only
+    std::vector<double> ttft_ms_;                     // translate thread only
+    std::vector<double> translate_ms_;                // translate thread only
+    LatestWinsQueue<std::wstring> overlay_text_;
+
+    // Consumers are declared before producers so destruction tears the graph down back to front.
+    PipelineStage<std::vector<std::wstring>> translate_stage_;
+    PipelineStage<Frame> ocr_stage_;
+    std::jthread capture_thread_;
+};
+
+#endif
+
+// --- Command-Line Modes ---
+
+// Greedy decode of the same sentence at several batch sizes. Reports mean latency per decode step
+// and, in builds with OSL_COUNT_ALLOCATIONS, heap allocations per step, measured on a warm
+// workspace after the timed runs ("-" otherwise). Path "bound" is DecodeBatch, which binds inputs
+// and outputs once per request and reuses its step buffers; at batch 1 path "feeds" decodes the
+// same sentence by building every step's tensors afresh and running the session on them, as
+// decoding did before IoBinding, for a before/after comparison in one binary. Both must produce
+// the same tokens.
+bool RunDecodeStepBenchmark(std::ostream& out) {
+    if (!InitTranslationEngine(g_config.precision)) {
+        out << "Translation engine failed to initialize\n";
+        return false;
+    }
+    ModelBinding binding(g_model_registry.DefaultModel()); // the default pair, whatever the text's language
+    TranslationModel& model = CurrentModel();
+
+    const std::string sample = "The quick brown fox jumps over the lazy dog while the cat watches from the window.";
+    std::vector<int32_t> source_ids;
+    model.sp_source_processor.Encode(sample, &source_ids);
+
+    auto report = [&](const char* path, size_t batch, size_t steps, double seconds, std::optional<uint64_t> allocations) {
+        out << "decode_step\t" << DecoderVariantName(model.decoder_layout.variant) << '\t' << path << '\t' << batch << '\t'
+            << steps << '\t' << seconds / static_cast<double>(steps) * 1e6 << '\t';
+        if (allocations) {
+            out << static_cast<double>(*allocations) / static_cast<double>(steps) << '\n';
+        } else {
+            out << "-\n";
+        }
+    };
+    out << "benchmark\tdecoder\tpath\tbatch\tsteps\tus_per_step\tallocations_per_step\n";
+    for (size_t batch : { 1, 4, 16 }) {
+        std::vector<const std::vector<int32_t>*> sources(batch, &source_ids);
+        std::vector<int64_t> source_lengths;
+        std::vector<std::vector<int32_t>> output_tokens;
+        Ort::Value encoder_hidden_state{ nullptr };
+        try {
+            encoder_hidden_state = EncodeBatch(sources, source_lengths);
+        } catch (const std::exception& e) {
+            out << "Encoder failed: " << e.what() << "\n";
+            return false;
+        }
+
+        bool decoded = true;
+        double seconds = MeasureSecondsPerCall([&] {
+            decoded = DecodeBatch(encoder_hidden_state, source_lengths, output_tokens) && decoded;
+        });
+        auto allocations = CountAllocations([&] { decoded = DecodeBatch(encoder_hidden_state, source_lengths, output_tokens) && decoded; });
+        if (!decoded) {
+            out << "Decoder failed\n";
+            return false;
+        }
+
+        size_t longest = 0;
+        for (const auto& tokens : output_tokens) longest = (std::max)(longest, tokens.size());
+        size_t steps = (std::min)(longest + 1, static_cast<size_t>(MAX_DECODE_STEPS));
+        report("bound", batch, steps, seconds, allocations);
+
+        // DecodeSpeculative without a draft runs one single-token step at a time through
+        // RunWithFeeds; it reads logits, so hidden-state exports have no such baseline.
+        if (batch != 1 || model.decoder_layout.hidden_state_output) continue;
+        std::vector<int32_t> feeds_tokens;
+        seconds = MeasureSecondsPerCall([&] {
+            decoded = DecodeSpeculative(encoder_hidden_state, source_lengths.front(), {}, feeds_tokens) && decoded;
+        });
+        allocations = CountAllocations([&] { decoded = DecodeSpeculative(encoder_hidden_state, source_lengths.front(), {}, feeds_tokens) && decoded; });
+        if (!decoded || feeds_tokens != output_tokens.front()) {
+            out << (decoded ? "The two decoding paths disagree\n" : "Decoder failed\n");
+            return false;
+        }
+        report("feeds", batch, steps, seconds, allocations);
+    }
+    return true;
+}
+
+// Process launch to first translated sentence, without the UI. Running it twice shows the cold
+// start (graphs optimized and serialized) against the warm one (graphs read from cache/ort).
+bool RunStartupBenchmark(std::ostream& out) {
+    using clock = std::chrono::steady_clock;
+    auto load_start = clock::now();
+    if (!InitTranslationEngine(g_config.precision)) {
+        out << "Translation engine failed to initialize\n";
+        return false;
+    }
+    double load_ms = std::chrono::duration<double, std::milli>(clock::now() - load_start).count();
+    ModelBinding binding(g_model_registry.DefaultModel()); // the default pair, whatever the text's language
+    TranslationModel& model = CurrentModel();
+    model.translation_cache.reset();
+
+    auto translate_start = clock::now();
+    auto translation = TranslateText(L"The quick brown fox jumps over the lazy dog.");
+    double translate_ms = std::chrono::duration<double, std::milli>(clock::now() - translate_start).count();
+    int64_t first_translation_ms = g_startup_metrics.ElapsedMs();
+    if (IsTranslationError(translation)) {
+        out << wstring_to_utf8(translation) << "\n";
+        return false;
+    }
+
+    // Start a second instance while the first is running to see the mapped weights counted as shared.
+    auto memory = QueryMemoryUsage().value_or(MemoryUsage{});
+    out << "benchmark\tprecision\tdecoder\tgraphs_reused\tgraphs_optimized\tload_ms\ttranslate_ms\tfirst_translation_ms"
+        << "\tresident_mb\tprivate_mb\tshareable_mb\tshared_mb\n";
+    out << "startup\t" << ModelPrecisionName(model.precision) << '\t' << DecoderVariantName(model.decoder_layout.variant) << '\t'
+        << g_startup_metrics.graphs_reused.load() << '\t' << g_startup_metrics.graphs_optimized.load() << '\t'
+        << load_ms << '\t' << translate_ms << '\t' << first_translation_ms << '\t'
+        << (memory.resident_bytes >> 20) << '\t' << (memory.private_bytes() >> 20) << '\t'
+        << (memory.shareable_bytes >> 20) << '\t' << (memory.shared_bytes >> 20) << '\n';
+    return true;
+}
+
+// Short UI and dialogue lines for the translation benchmarks when no corpus is given.
+constexpr std::array<std::string_view, 8> BENCHMARK_SENTENCES = {
+    "Press any key to continue.",
+    "The quick brown fox jumps over the lazy dog while the cat watches from the window.",
+    "Your save file is corrupted and cannot be loaded.",
+    "Quest updated: find the blacksmith in the northern village before nightfall.",
+    "Settings have been restored to their default values.",
+    "You do not have enough gold to buy this item.",
+    "The connection to the server was lost. Trying to reconnect in ten seconds.",
+    "Equip the lantern to see in dark places.",
+};
+
+// Fixed lines in several languages for `--benchmark corpus`, so its runs stay comparable. Lines in a
+// language without an installed pair go to the default pair, as they would on screen.
+constexpr std::array<std::wstring_view, 19> MULTILINGUAL_BENCHMARK_CORPUS = {
+    L"Your inventory is full. Drop or sell items to make room.", // en
+    L"The bridge collapsed behind us, so we'll have to find another way back to the village before the storm reaches the valley.", // en
+    L"Saving... Do not turn off the power.", // en
+    L"Equip the lantern to see in dark places.", // en
+    L"M\u00F6chtest du deinen Fortschritt speichern, bevor du das Spiel verl\u00E4sst?", // de
+    L"Die Verbindung zum Server wurde unterbrochen.", // de
+    L"Neue Aufgabe: Sprich mit dem Schmied im n\u00F6rdlichen Dorf.", // de
+    L"Voulez-vous vraiment quitter sans enregistrer ?", // fr
+    L"Le marchand reviendra \u00E0 l'aube. D'ici l\u00E0, les portes restent ferm\u00E9es.", // fr
+    L"No tienes suficiente oro para comprar este objeto.", // es
+    L"La partida se ha guardado correctamente.", // es
+    L"\u30BB\u30FC\u30D6\u30C7\u30FC\u30BF\u304C\u7834\u640D\u3057\u3066\u3044\u308B\u305F\u3081\u3001\u8AAD\u307F\u8FBC\u3081\u307E\u305B\u3093\u3002", // ja
+    L"\u5317\u306E\u6751\u306E\u935B\u51B6\u5C4B\u306B\u8A71\u3057\u304B\u3051\u3066\u304F\u3060\u3055\u3044\u3002", // ja
+    L"\u8A2D\u5B9A\u3092\u521D\u671F\u5024\u306B\u623B\u3057\u307E\u3057\u305F\u3002", // ja
+    L"\u8FDE\u63A5\u5DF2\u65AD\u5F00\uFF0C\u6B63\u5728\u5C1D\u8BD5\u91CD\u65B0\u8FDE\u63A5\u3002", // zh
+    L"\u4F60\u7684\u80CC\u5305\u5DF2\u6EE1\u3002", // zh
+    L"\u0412\u044B \u0434\u0435\u0439\u0441\u0442\u0432\u0438\u0442\u0435\u043B\u044C\u043D\u043E \u0445\u043E\u0442\u0438\u0442\u0435 \u0432\u044B\u0439\u0442\u0438 \u0438\u0437 \u0438\u0433\u0440\u044B?", // ru
+    L"\u0417\u0430\u0434\u0430\u043D\u0438\u0435 \u043E\u0431\u043D\u043E\u0432\u043B\u0435\u043D\u043E: \u043D\u0430\u0439\u0434\u0438\u0442\u0435 \u043A\u0443\u0437\u043D\u0435\u0446\u0430 \u0432 \u0441\u0435\u0432\u0435\u0440\u043D\u043E\u0439 \u0434\u0435\u0440\u0435\u0432\u043D\u0435.", // ru
+    L"\uC800\uC7A5\uD558\uC9C0 \uC54A\uACE0 \uC885\uB8CC\uD558\uC2DC\uACA0\uC2B5\uB2C8\uAE4C?", // ko
+};
+
+// Latency of single sentences and throughput of a 16-sentence batch at the current [Threads]
+// settings, with the translation cache off. `--benchmark threads` runs it once per thread count.
+bool RunTranslateLatencyBenchmark(std::ostream& out) {
+    if (!InitTranslationEngine(g_config.precision)) {
+        out << "Translation engine failed to initialize\n";
+        return false;
+    }
+    ModelBinding binding(g_model_registry.DefaultModel()); // the default pair, whatever the text's language
+    TranslationModel& model = CurrentModel();
+    model.translation_cache.reset();
+
+    std::vector<std::vector<int32_t>> source_ids(BENCHMARK_SENTENCES.size());
+    for (size_t i = 0; i < BENCHMARK_SENTENCES.size(); ++i) model.sp_source_processor.Encode(BENCHMARK_SENTENCES[i], &source_ids[i]);
+
+    std::vector<std::vector<int32_t>> output_tokens;
+    std::vector<double> latencies_ms;
+    for (int round = 0; round < 4; ++round) {
+        for (const auto& ids : source_ids) {
+            auto start = std::chrono::steady_clock::now();
+            if (auto error = TranslateBucket({ &ids }, output_tokens)) {
+                out << wstring_to_utf8(*error) << "\n";
+                return false;
+            }
+            // The first round warms up the sessions and the shared pool.
+            if (round > 0) latencies_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+    }
+
+    std::vector<const std::vector<int32_t>*> batch;
+    for (int copy = 0; copy < 2; ++copy) {
+        for (const auto& ids : source_ids) batch.push_back(&ids);
+    }
+    bool translated = true;
+    double seconds = MeasureSecondsPerCall([&] { translated = !TranslateBucket(batch, output_tokens) && translated; });
+    if (!translated) {
+        out << "Batch translation failed\n";
+        return false;
+    }
+
+    out << "benchmark\tthreads\tcores\tcpus\tlatency_p50_ms\tlatency_p95_ms\tbatch_sentences_per_s\n";
+    out << "translate_latency\t" << g_thread_budget.translate_threads() << '\t' << CorePreferenceName(g_config.cores) << '\t'
+        << g_thread_budget.allowed_cpus() << '\t' << Percentile(latencies_ms, 0.50) << '\t' << Percentile(latencies_ms, 0.95) << '\t'
+        << static_cast<double>(batch.size()) / seconds << '\n';
+    return true;
+}
+
+#ifdef _WIN32
+// Replays a recording through change detection, OCR and translation on one thread, so every run
+// sees the same frames in the same order. Needs an MTA thread: OCR is awaited synchronously.
+bool RunPipelineReplayBenchmark(const std::filesystem::path& recording, std::ostream& out) {
+    ReplayFrameSource replay(ReplayFrameSource::Pacing::Sequential);
+    if (!replay.Open(recording)) {
+        out << "Cannot read recording: " << wstring_to_utf8(recording.wstring()) << "\n";
+        return false;
+    }
+    OcrEngine engine = CreateOcrEngine();
+    if (!engine) {
+        out << "OCR engine failed to initialize\n";
+        return false;
+    }
+    if (!InitTranslationEngine(g_config.precision)) {
+        out << "Translation engine failed to initialize\n";
+        return false;
+    }
+    ModelBinding binding(g_model_registry.DefaultModel()); // the default pair, whatever the text's language
+    TranslationModel& model = CurrentModel();
+    model.translation_cache.reset(); // measure the models, not whatever earlier runs left in the cache
+
+    using clock = std::chrono::steady_clock;
+    auto ms_since = [](clock::time_point start) { return std::chrono::duration<double, std::milli>(clock::now() - start).count(); };
+    FrameChangeDetector change_detector(CHANGE_DETECTION_TILE_SIZE);
+    FrameRecognizer recognizer(engine);
+    ScreenTranslation screen_translation;
+    std::vector<std::wstring> last_ocr_lines;
+    OcrJitterFilter jitter_filter(g_config.ocr_jitter_threshold);
+    std::vector<double> detect_ms, ocr_ms, ttft_ms, translate_ms;
+
+    auto run_start = clock::now();
+    while (Frame frame = replay.Capture()) {
+        auto stage_start = clock::now();
+        auto change = change_detector.Update(frame.pixels, frame.width, frame.height, frame.stride);
+        detect_ms.push_back(ms_since(stage_start));
+        if (change.changed_tiles < MIN_CHANGED_TILES_FOR_OCR) continue;
+
+        // Includes preprocessing and the layout splice, as in the pipeline.
+        stage_start = clock::now();
+        std::vector<std::wstring> lines = recognizer.Recognize(frame);
+        ocr_ms.push_back(ms_since(stage_start));
+        if (lines.empty() || lines == last_ocr_lines || jitter_filter.SameLines(lines, last_ocr_lines)) continue;
+        last_ocr_lines = lines;
+
+        stage_start = clock::now();
+        bool first_token_seen = false;
+        UpdateScreenTranslation(screen_translation, std::move(lines), {}, [&](const std::vector<std::wstring>&) {
+            if (!first_token_seen) ttft_ms.push_back(ms_since(stage_start));
+            first_token_seen = true;
+        });
+        translate_ms.push_back(ms_since(stage_start));
+    }
+    double total_ms = ms_since(run_start);
+
+    out << "benchmark\tstage\tcalls\tp50_ms\tp95_ms\ttotal_ms\n";
+    auto report = [&](const char* stage, const std::vector<double>& samples) {
+        out << "pipeline_replay\t" << stage << '\t' << samples.size() << '\t' << Percentile(samples, 0.50) << '\t'
+            << Percentile(samples, 0.95) << '\t' << std::accumulate(samples.begin(), samples.end(), 0.0) << '\n';
+    };
+    report("change_detect", detect_ms);
+    report("ocr", ocr_ms);
+    report("first_token", ttft_ms);
+    report("translate", translate_ms);
+    out << "pipeline_replay\ttotal\t" << replay.frame_count() << "\t\t\t" << total_ms << '\n';
+
+    auto layout = recognizer.LayoutStats();
+    double ocr_area = layout.frame_pixels ? static_cast<double>(layout.ocr_pixels) / static_cast<double>(layout.frame_pixels) : 0.0;
+    out << "\nbenchmark\tfull_passes\tpartial_passes\tregions\tocr_area_fraction\n";
+    out << "pipeline_replay_ocr_regions\t" << layout.full_passes << '\t' << layout.partial_passes << '\t'
+        << layout.regions << '\t' << ocr_area << '\n';
+    return true;
+}
+
+// Runs a recorded session through change detection and OCR, then counts the translations each
+// OCR jitter threshold would have started: whole passes whose text changed at all, and lines that
+// could not reuse an earlier line's translation. Threshold "exact" is the old exact comparison.
+bool RunOcrJitterReplayBenchmark(const std::filesystem::path& recording, std::ostream& out) {
+    ReplayFrameSource replay(ReplayFrameSource::Pacing::Sequential);
+    if (!replay.Open(recording)) {
+        out << "Cannot read recording: " << wstring_to_utf8(recording.wstring()) << "\n";
+        return false;
+    }
+    OcrEngine engine = CreateOcrEngine();
+    if (!engine) {
+        out << "OCR engine failed to initialize\n";
+        return false;
+    }
+
+    FrameChangeDetector change_detector(CHANGE_DETECTION_TILE_SIZE);
+    FrameRecognizer recognizer(engine);
+    std::vector<std::vector<std::wstring>> passes;
+    while (Frame frame = replay.Capture()) {
+        auto change = change_detector.Update(frame.pixels, frame.width, frame.height, frame.stride);
+        if (change.changed_tiles < MIN_CHANGED_TILES_FOR_OCR) continue;
+        auto lines = recognizer.Recognize(frame);
+        if (!lines.empty()) passes.push_back(std::move(lines));
+    }
+
+    out << "benchmark\tthreshold\tocr_passes\ttranslated_passes\ttranslated_lines\tpasses_avoided\tlines_avoided\n";
+    size_t exact_passes = 0, exact_lines = 0;
+    for (double threshold : { -1.0, 0.0, 0.02, 0.05, 0.1 }) {
+        OcrJitterFilter filter((std::max)(threshold, 0.0));
+        std::vector<std::wstring> reference;
+        size_t translated_passes = 0, translated_lines = 0;
+        for (const auto& lines : passes) {
+            bool same = threshold < 0 ? lines == reference : filter.SameLines(lines, reference);
+            if (same) continue;
+            ++translated_passes;
+            std::vector<std::wstring> next = lines;
+            for (auto& line : next) {
+                auto earlier = std::find_if(reference.begin(), reference.end(), [&](const std::wstring& previous) {
+                    return threshold < 0 ? line == previous : filter.SameLine(line, previous);
+                });
+                if (earlier != reference.end()) {
+                    line = *earlier;
+                } else {
+                    ++translated_lines;
+                }
+            }
+            reference = std::move(next);
+        }
+        if (threshold < 0) {
+            exact_passes = translated_passes;
+            exact_lines = translated_lines;
+        }
+        out << "ocr_jitter_replay\t" << (threshold < 0 ? std::string("exact") : std::format("{}", threshold)) << '\t' << passes.size() << '\t'
+            << translated_passes << '\t' << translated_lines << '\t'
+            << static_cast<int64_t>(exact_passes) - static_cast<int64_t>(translated_passes) << '\t'
+            << static_cast<int64_t>(exact_lines) - static_cast<int64_t>(translated_lines) << '\n';
+    }
+    return true;
+}
+#endif
+
+// UTF-8 corpus, one segment per line; blank lines are skipped.
+std::vector<std::string> ReadCorpusLines(const std::filesystem::path& path) {
+    std::vector<std::string> lines;
+    std::ifstream file(path, std::ios::binary);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (lines.empty() && line.starts_with("\xEF\xBB\xBF")) line.erase(0, 3);
+        if (!NormalizeSegment(line).empty()) lines.push_back(std::move(line));
+    }
+    return lines;
+}
+
+// Checks speculative decoding against plain greedy decoding of each segment alone, with three
+// kinds of draft: the translation of the segment minus its last word (a subtitle that grew), the
+// segment's own greedy translation (best case) and that of the next segment (useless draft). Both
+// decode from the same encoder output. Any output that differs from greedy fails the run.
+bool RunSpeculativeBenchmark(const std::optional<std::filesystem::path>& corpus_path, std::ostream& out) {
+    if (!InitTranslationEngine(g_config.precision)) {
+        out << "Translation engine failed to initialize\n";
+        return false;
+    }
+    ModelBinding binding(g_model_registry.DefaultModel()); // the default pair, whatever the text's language
+    TranslationModel& model = CurrentModel();
+    model.translation_cache.reset();
+    if (!AcceptsDrafts(model.decoder_layout)) {
+        out << (model.decoder_layout.hidden_state_output ? "The decoder export ends at last_hidden_state"
+            : "The decoder export takes one token per step") << ", so speculative decoding is unavailable\n";
+        return false;
+    }
+
+    std::vector<std::string> segments;
+    if (corpus_path) {
+        for (auto& line : ReadCorpusLines(*corpus_path)) segments.push_back(NormalizeSegment(line));
+    } else {
+        segments.assign(BENCHMARK_SENTENCES.begin(), BENCHMARK_SENTENCES.end());
+    }
+    if (segments.empty()) {
+        out << "No segments to translate\n";
+        return false;
+    }
+
+    using clock = std::chrono::steady_clock;
+    auto ms_since = [](clock::time_point start) { return std::chrono::duration<double, std::milli>(clock::now() - start).count(); };
+    auto translate = [&](const std::string& text) {
+        std::vector<int32_t> source_ids;
+        model.sp_source_processor.Encode(text, &source_ids);
+        std::vector<std::vector<int32_t>> output_tokens;
+        if (source_ids.empty() || TranslateBucket({ &source_ids }, output_tokens)) return std::vector<int32_t>{};
+        return output_tokens.front();
+    };
+
+    std::vector<std::vector<int32_t>> references;
+    for (const auto& segment : segments) references.push_back(translate(segment));
+
+    struct Totals {
+        size_t segments = 0;
+        size_t mismatches = 0;
+        double greedy_ms = 0;
+        double speculative_ms = 0;
+        uint64_t greedy_passes = 0;
+        uint64_t speculative_passes = 0;
+        uint64_t reruns = 0;
+        uint64_t drafted = 0;
+        uint64_t accepted = 0;
+    };
+    const char* draft_kinds[] = { "grown", "self", "unrelated" };
+    std::array<Totals, 3> totals;
+
+    for (size_t i = 0; i < segments.size(); ++i) {
+        std::vector<int32_t> source_ids;
+        model.sp_source_processor.Encode(segments[i], &source_ids);
+        if (source_ids.empty()) continue;
+        std::vector<int64_t> source_lengths;
+        Ort::Value encoder_hidden_state{ nullptr };
+        std::vector<std::vector<int32_t>> greedy_tokens;
+        try {
+            encoder_hidden_state = EncodeBatch({ &source_ids }, source_lengths);
+        } catch (const std::exception& e) {
+            out << "Encoder failed: " << e.what() << "\n";
+            return false;
+        }
+        auto greedy_start = clock::now();
+        if (!DecodeBatch(encoder_hidden_state, source_lengths, greedy_tokens)) {
+            out << "Decoder failed\n";
+            return false;
+        }
+        double greedy_ms = ms_since(greedy_start);
+        const auto& greedy = greedy_tokens.front();
+
+        // Drafts go through text, as they do on screen.
+        std::vector<int32_t> grown_draft;
+        if (size_t cut = segments[i].rfind(' '); cut != std::string::npos) {
+            std::string shorter_translation;
+            model.sp_target_processor.Decode(translate(segments[i].substr(0, cut)), &shorter_translation);
+            model.sp_target_processor.Encode(shorter_translation, &grown_draft);
+        }
+        const std::vector<int32_t>* drafts[] = { &grown_draft, &greedy, &references[(i + 1) % references.size()] };
+
+        for (size_t kind = 0; kind < totals.size(); ++kind) {
+            if (drafts[kind]->empty()) continue;
+            uint64_t passes_before = g_speculative_stats.verify_passes + g_speculative_stats.single_steps;
+            uint64_t drafted_before = g_speculative_stats.drafted_tokens;
+            uint64_t accepted_before = g_speculative_stats.accepted_tokens;
+            uint64_t reruns_before = g_speculative_stats.exact_reruns;
+            std::vector<int32_t> speculative;
+            auto speculative_start = clock::now();
+            if (!DecodeSpeculative(encoder_hidden_state, source_lengths.front(), *drafts[kind], speculative)) {
+                out << "Speculative decoder failed\n";
+                return false;
+            }
+            auto& total = totals[kind];
+            total.speculative_ms += ms_since(speculative_start);
+            total.greedy_ms += greedy_ms;
+            ++total.segments;
+            if (speculative != greedy) {
+                ++total.mismatches;
+                out << "mismatch (" << draft_kinds[kind] << " draft): " << segments[i] << "\n";
+            }
+            total.greedy_passes += (std::min)(greedy.size() + 1, static_cast<size_t>(MAX_DECODE_STEPS));
+            total.speculative_passes += g_speculative_stats.verify_passes + g_speculative_stats.single_steps - passes_before;
+            total.drafted += g_speculative_stats.drafted_tokens - drafted_before;
+            total.accepted += g_speculative_stats.accepted_tokens - accepted_before;
+            total.reruns += g_speculative_stats.exact_reruns - reruns_before;
+        }
+    }
+
+    size_t mismatches = 0;
+    out << "benchmark\tdraft\tsegments\tmismatches\tgreedy_ms\tspeculative_ms\tgreedy_passes\tspeculative_passes\treruns\tacceptance\n";
+    for (size_t kind = 0; kind < totals.size(); ++kind) {
+        const auto& total = totals[kind];
+        mismatches += total.mismatches;
+        out << "speculative\t" << draft_kinds[kind] << '\t' << total.segments << '\t' << total.mismatches << '\t'
+            << total.greedy_ms << '\t' << total.speculative_ms << '\t' << total.greedy_passes << '\t' << total.speculative_passes << '\t' << total.reruns << '\t'
+            << (total.drafted ? static_cast<double>(total.accepted) / static_cast<double>(total.drafted) : 0.0) << '\n';
+    }
+    return mismatches == 0;
+}
+
+// Times the projection kernels alone (see RunShortlistKernelBenchmark), then greedy-decodes each
+// segment three ways from the same encoder output: over the whole vocabulary, over its shortlist,
+// and over its shortlist with every pick checked against the whole vocabulary. When the decoder
+// graph also outputs logits, a fourth way picks from those, as a logits export does. Reports time
+// per decoder step and how many segments come out differently from the full decode. A checked
+// segment may only differ where a check declined a better token by less than ShortlistTolerance
+// (never, at the default of 0); any other mismatch fails the run. Last,
+// one batch of up to MAX_BATCH_SEGMENTS segments is decoded over the whole vocabulary through the
+// projection and, when it can be, through the logits output, to compare the batched projection
+// with the export's own matrix product.
+bool RunShortlistBenchmark(const std::optional<std::filesystem::path>& corpus_path, std::ostream& out) {
+    RunShortlistKernelBenchmark(out);
+    out << "\n";
+    if (!InitTranslationEngine(g_config.precision)) {
+        out << "Translation engine failed to initialize\n";
+        return false;
+    }
+    ModelBinding binding(g_model_registry.DefaultModel()); // the default pair, whatever the text's language
+    TranslationModel& model = CurrentModel();
+    model.translation_cache.reset();
+    if (!g_config.shortlist) {
+        out << "Shortlist decoding is off in [Translation] Shortlist\n";
+        return false;
+    }
+    if (!model.decoder_layout.hidden_state_output || !model.shortlist) {
+        out << "Shortlist decoding needs a decoder ending at last_hidden_state, with output_projection.bin and lex.s2t beside it\n";
+        return false;
+    }
+
+    std::vector<std::string> segments;
+    if (corpus_path) {
+        for (auto& line : ReadCorpusLines(*corpus_path)) segments.push_back(NormalizeSegment(line));
+    } else {
+        segments.assign(BENCHMARK_SENTENCES.begin(), BENCHMARK_SENTENCES.end());
+    }
+    if (segments.empty()) {
+        out << "No segments to translate\n";
+        return false;
+    }
+
+    // The same graphs read through their logits output, if they have one.
+    std::optional<DecoderLayout> logits_layout;
+    if (auto layout = DetectDecoderLayout(*model.decoder_session, model.decoder_with_past_session.get()); !layout.hidden_state_output) {
+        logits_layout = std::move(layout);
+    }
+    // Swaps the model's layout with the logits one and back; DecodeBatch reads it from the model.
+    auto swap_layouts = [&] { std::swap(model.decoder_layout, *logits_layout); };
+
+    struct Mode {
+        const char* name;
+        bool shortlist;
+        uint64_t check; // ShortlistCheck while decoding
+        bool logits = false;
+    };
+    std::vector<Mode> modes = { { "full", false, 0 }, { "shortlist", true, 0 }, { "checked", true, 1 } };
+    if (logits_layout) modes.push_back({ "logits", false, 0, true });
+    struct Totals {
+        size_t segments = 0;
+        size_t mismatches = 0;
+        size_t unexplained = 0; // mismatches with no declined check in the segment
+        double ms = 0;
+        uint64_t steps = 0;
+        uint64_t candidates = 0;
+        uint64_t picks = 0;
+        uint64_t overrides = 0;
+    };
+    std::vector<Totals> totals(modes.size());
+    // PickProjectedToken reads the check interval from g_config; put the configured one back after.
+    struct RestoreShortlistCheck {
+        uint64_t value = g_config.shortlist_check;
+        ~RestoreShortlistCheck() { g_config.shortlist_check = value; }
+    } restore_check;
+
+    using clock = std::chrono::steady_clock;
+    for (const auto& segment : segments) {
+        std::vector<int32_t> source_ids;
+        model.sp_source_processor.Encode(segment, &source_ids);
+        if (source_ids.empty()) continue;
+        std::vector<int64_t> source_lengths;
+        Ort::Value encoder_hidden_state{ nullptr };
+        try {
+            encoder_hidden_state = EncodeBatch({ &source_ids }, source_lengths);
+        } catch (const std::exception& e) {
+            out << "Encoder failed: " << e.what() << "\n";
+            return false;
         }
-        SetLayeredWindowAttributes(g_overlay_hwnd, 0, 220, LWA_ALPHA);
-        ShowWindow(g_overlay_hwnd, SW_SHOWNA);
-        UpdateWindow(g_overlay_hwnd);
-    } else {
-        InvalidateRect(g_overlay_hwnd, nullptr, TRUE);
-        UpdateWindow(g_overlay_hwnd);
+
+        std::vector<int32_t> full_tokens;
+        for (size_t m = 0; m < std::size(modes); ++m) {
+            g_config.shortlist_check = modes[m].check;
+            uint64_t picks_before = g_shortlist_stats.picks, candidates_before = g_shortlist_stats.candidates;
+            uint64_t overrides_before = g_shortlist_stats.overrides, declined_before = g_shortlist_stats.declined;
+            std::vector<std::vector<int32_t>> output_tokens;
+            if (modes[m].logits) swap_layouts();
+            auto start = clock::now();
+            bool decoded = modes[m].shortlist
+                ? DecodeBatch(encoder_hidden_state, source_lengths, output_tokens, {}, {}, { &source_ids })
+                : DecodeBatch(encoder_hidden_state, source_lengths, output_tokens);
+            double ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+            if (modes[m].logits) swap_layouts();
+            if (!decoded) {
+                out << "Decoder failed\n";
+                return false;
+            }
+
+            auto& total = totals[m];
+            const auto& tokens = output_tokens.front();
+            uint64_t steps = (std::min)(tokens.size() + 1, static_cast<size_t>(MAX_DECODE_STEPS));
+            ++total.segments;
+            total.ms += ms;
+            total.steps += steps;
+            total.picks += modes[m].shortlist ? g_shortlist_stats.picks - picks_before : steps;
+            total.candidates += modes[m].shortlist ? g_shortlist_stats.candidates - candidates_before
+                : steps * model.output_projection->vocab_size;
+            total.overrides += g_shortlist_stats.overrides - overrides_before;
+            if (m == 0) {
+                full_tokens = tokens;
+            } else if (tokens != full_tokens) {
+                ++total.mismatches;
+                if (modes[m].check && g_shortlist_stats.declined == declined_before) {
+                    ++total.unexplained;
+                    out << "mismatch (checked): " << segment << "\n";
+                }
+            }
+        }
+    }
+
+    out << "benchmark\tmode\tsegments\tsteps\tms\tus_per_step\tcandidates_per_pick\toverrides\tmismatches\tmismatch_rate\n";
+    for (size_t m = 0; m < std::size(modes); ++m) {
+        const auto& total = totals[m];
+        out << "shortlist_decode\t" << modes[m].name << '\t' << total.segments << '\t' << total.steps << '\t' << total.ms << '\t'
+            << total.ms * 1e3 / static_cast<double>((std::max)(total.steps, uint64_t{ 1 })) << '\t'
+            << static_cast<double>(total.candidates) / static_cast<double>((std::max)(total.picks, uint64_t{ 1 })) << '\t'
+            << total.overrides << '\t' << total.mismatches << '\t'
+            << static_cast<double>(total.mismatches) / static_cast<double>((std::max)(total.segments, size_t{ 1 })) << '\n';
+    }
+    if (!logits_layout) out << "(no logits output in this decoder export to compare against)\n";
+
+    std::vector<std::vector<int32_t>> batch_sources;
+    for (const auto& segment : segments) {
+        if (batch_sources.size() == MAX_BATCH_SEGMENTS) break;
+        std::vector<int32_t> source_ids;
+        model.sp_source_processor.Encode(segment, &source_ids);
+        if (!source_ids.empty()) batch_sources.push_back(std::move(source_ids));
+    }
+    std::vector<const std::vector<int32_t>*> batch;
+    for (const auto& source : batch_sources) batch.push_back(&source);
+    out << "\nbenchmark\tmode\trows\tms\n";
+    try {
+        std::vector<int64_t> source_lengths;
+        Ort::Value encoder_hidden_state = EncodeBatch(batch, source_lengths);
+        for (bool logits : { false, true }) {
+            if (logits && !logits_layout) break;
+            if (logits) swap_layouts();
+            std::vector<std::vector<int32_t>> output_tokens;
+            bool decoded = true;
+            double seconds = MeasureSecondsPerCall([&] { decoded = DecodeBatch(encoder_hidden_state, source_lengths, output_tokens) && decoded; });
+            if (logits) swap_layouts();
+            if (!decoded) {
+                out << "Decoder failed\n";
+                return false;
+            }
+            out << "projection_batch\t" << (logits ? "logits" : "full") << '\t' << batch.size() << '\t' << seconds * 1e3 << '\n';
+        }
+    } catch (const std::exception& e) {
+        out << "Encoder failed: " << e.what() << "\n";
+        return false;
     }
+    return totals[2].unexplained == 0;
 }
 
-int APIENTRY wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE, _In_ LPWSTR, _In_ int) {
-    g_hinstance = hInstance;
-    winrt::init_apartment(apartment_type::single_threaded);
+struct EvalVariantResult {
+    double load_ms = 0;
+    double mean_ms = 0;
+    double p50_ms = 0;
+    double p95_ms = 0;
+    uint64_t output_tokens = 0;
+    double total_seconds = 0;
+    double peak_working_set_mb = 0;
+    std::vector<std::string> translations;
+};
 
-    RegisterOverlayWindowClass(hInstance);
+// Translates the corpus one line at a time with the cache disabled, at a single precision.
+// Writes a metrics line followed by one translation per corpus line.
+bool RunEvalVariant(const std::filesystem::path& corpus_path, ModelPrecision precision, std::ostream& out) {
+    using clock = std::chrono::steady_clock;
+    auto load_start = clock::now();
+    if (!InitTranslationEngine(precision)) return false;
+    EvalVariantResult result;
+    result.load_ms = std::chrono::duration<double, std::milli>(clock::now() - load_start).count();
+    ModelBinding binding(g_model_registry.DefaultModel()); // the default pair, whatever the text's language
+    TranslationModel& model = CurrentModel();
+    model.translation_cache.reset();
 
-    if (!InitTranslationEngine()) {
-        show_message_box(L"Translation engine failed to initialize. Check model paths and dependencies.", L"Initialization Error");
-        UnregisterOverlayWindowClass(hInstance);
-        winrt::uninit_apartment();
+    std::vector<double> latencies_ms;
+    for (const auto& line : ReadCorpusLines(corpus_path)) {
+        std::vector<int32_t> source_ids;
+        model.sp_source_processor.Encode(NormalizeSegment(line), &source_ids);
+        std::vector<std::vector<int32_t>> output_tokens;
+
+        auto start = clock::now();
+        auto error = TranslateBucket({ &source_ids }, output_tokens);
+        latencies_ms.push_back(std::chrono::duration<double, std::milli>(clock::now() - start).count());
+
+        std::string translation;
+        if (error) {
+            translation = wstring_to_utf8(*error);
+        } else {
+            model.sp_target_processor.Decode(output_tokens.front(), &translation);
+            result.output_tokens += output_tokens.front().size();
+        }
+        std::replace(translation.begin(), translation.end(), '\n', ' ');
+        result.translations.push_back(std::move(translation));
+    }
+
+    for (double ms : latencies_ms) result.total_seconds += ms / 1e3;
+    result.mean_ms = latencies_ms.empty() ? 0.0 : result.total_seconds * 1e3 / static_cast<double>(latencies_ms.size());
+    result.p50_ms = Percentile(latencies_ms, 0.50);
+    result.p95_ms = Percentile(latencies_ms, 0.95);
+    result.peak_working_set_mb = PeakWorkingSetMb();
+
+    out << result.load_ms << '\t' << result.mean_ms << '\t' << result.p50_ms << '\t' << result.p95_ms << '\t'
+        << result.output_tokens << '\t' << result.total_seconds << '\t' << result.peak_working_set_mb << '\n';
+    for (const auto& translation : result.translations) out << translation << '\n';
+    return true;
+}
+
+std::optional<EvalVariantResult> ReadEvalVariantResult(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    EvalVariantResult result;
+    if (!(file >> result.load_ms >> result.mean_ms >> result.p50_ms >> result.p95_ms
+        >> result.output_tokens >> result.total_seconds >> result.peak_working_set_mb)) {
+        return std::nullopt;
+    }
+    std::string line;
+    std::getline(file, line);
+    while (std::getline(file, line)) result.translations.push_back(std::move(line));
+    return result;
+}
+
+// Runs this executable with `arguments` and waits for it. Returns its exit code, or -1.
+int RunChildProcess(const std::vector<std::wstring>& arguments) {
+#ifdef _WIN32
+    std::wstring command_line = L"\"" + GetExecutablePath().wstring() + L"\"";
+    for (const auto& argument : arguments) command_line += L" \"" + argument + L"\"";
+
+    STARTUPINFOW startup_info = { sizeof(startup_info) };
+    PROCESS_INFORMATION process_info = {};
+    if (!CreateProcessW(nullptr, command_line.data(), nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startup_info, &process_info)) {
         return -1;
     }
+    WaitForSingleObject(process_info.hProcess, INFINITE);
+    DWORD exit_code = static_cast<DWORD>(-1);
+    GetExitCodeProcess(process_info.hProcess, &exit_code);
+    CloseHandle(process_info.hThread);
+    CloseHandle(process_info.hProcess);
+    return static_cast<int>(exit_code);
+#else
+    std::string executable = GetExecutablePath().string();
+    std::vector<std::string> strings{ executable };
+    for (const auto& argument : arguments) strings.push_back(wstring_to_utf8(argument));
+    std::vector<char*> argv;
+    for (auto& string : strings) argv.push_back(string.data());
+    argv.push_back(nullptr);
+    pid_t child = 0;
+    if (posix_spawn(&child, executable.c_str(), nullptr, nullptr, argv.data(), environ) != 0) return -1;
+    int status = 0;
+    if (waitpid(child, &status, 0) != child || !WIFEXITED(status)) return -1;
+    return WEXITSTATUS(status);
+#endif
+}
+
+inline uint32_t CurrentProcessId() {
+#ifdef _WIN32
+    return GetCurrentProcessId();
+#else
+    return static_cast<uint32_t>(getpid());
+#endif
+}
+
+// Compares every precision variant found in the models directory on the same corpus. Each variant
+// runs in its own child process so load time and peak memory are not skewed by the others.
+// Agreement is the fraction of lines whose output matches the first variant (fp32 when present)
+// exactly.
+bool RunEvalMode(const std::filesystem::path& corpus_path, std::ostream& out) {
+    auto models_dir = GetModelsDirectoryPath();
+    std::vector<ModelPrecision> precisions;
+    for (auto precision : { ModelPrecision::Fp32, ModelPrecision::Int8, ModelPrecision::Fp16 }) {
+        if (FindModelFiles(models_dir, precision)) precisions.push_back(precision);
+    }
+    if (precisions.empty()) {
+        out << "No models found in " << wstring_to_utf8(models_dir.wstring()) << "\n";
+        return false;
+    }
 
-    INT_PTR dlg_result = DialogBoxParamW(
-        hInstance,
-        MAKEINTRESOURCE(IDD_MAIN_DIALOG),
-        nullptr,
-        MainDlgProc,
-        0);
+    out << "precision\tload_ms\tlines\tmean_ms\tp50_ms\tp95_ms\ttokens_per_s\tpeak_working_set_mb\tagreement\n";
+    std::vector<std::string> reference;
+    for (auto precision : precisions) {
+        auto precision_name = utf8_to_wstring(ModelPrecisionName(precision));
+        auto result_path = std::filesystem::temp_directory_path()
+            / std::format(L"OfflineScreenLance_eval_{}_{}.tsv", CurrentProcessId(), precision_name);
+        int exit_code = RunChildProcess({ L"--eval-variant", precision_name, L"--corpus", corpus_path.wstring(),
+            L"--output", result_path.wstring(), L"--models", GetModelsDirectoryPath().wstring() });
+        auto result = (exit_code == 0) ? ReadEvalVariantResult(result_path) : std::nullopt;
+        std::error_code ignored;
+        std::filesystem::remove(result_path, ignored);
+        if (!result) {
+            out << ModelPrecisionName(precision) << "\tfailed (exit code " << exit_code << ")\n";
+            continue;
+        }
 
-    if (dlg_result != IDOK) {
-        UnregisterOverlayWindowClass(hInstance);
+        if (reference.empty()) reference = result->translations;
+        size_t compared = (std::min)(reference.size(), result->translations.size());
+        size_t agreeing = 0;
+        for (size_t i = 0; i < compared; ++i) {
+            if (reference[i] == result->translations[i]) ++agreeing;
+        }
+        double tokens_per_second = result->total_seconds > 0 ? static_cast<double>(result->output_tokens) / result->total_seconds : 0.0;
+        out << ModelPrecisionName(precision) << '\t' << result->load_ms << '\t' << result->translations.size() << '\t'
+            << result->mean_ms << '\t' << result->p50_ms << '\t' << result->p95_ms << '\t' << tokens_per_second << '\t'
+            << result->peak_working_set_mb << '\t'
+            << (compared ? static_cast<double>(agreeing) / static_cast<double>(compared) : 0.0) << '\n';
+    }
+    return true;
+}
+
+// Sweeps the size of the shared intra-op pool, which is fixed once the ONNX Runtime environment
+// exists, so each thread count runs translate-latency in its own child process. Shows what
+// leaving cores to the foreground app costs in latency and in batch throughput.
+bool RunThreadSweepBenchmark(std::ostream& out) {
+    int allowed_cpus = (std::max)(g_thread_budget.allowed_cpus(), 1);
+    std::vector<int> thread_counts;
+    for (int threads = 1; threads < allowed_cpus; threads *= 2) thread_counts.push_back(threads);
+    thread_counts.push_back(allowed_cpus);
+    thread_counts.push_back(g_thread_budget.translate_threads()); // the auto setting
+    std::sort(thread_counts.begin(), thread_counts.end());
+    thread_counts.erase(std::unique(thread_counts.begin(), thread_counts.end()), thread_counts.end());
+
+    out << "benchmark\tthreads\tcores\tcpus\tlatency_p50_ms\tlatency_p95_ms\tbatch_sentences_per_s\n";
+    bool any_completed = false;
+    for (int threads : thread_counts) {
+        auto result_path = std::filesystem::temp_directory_path()
+            / std::format(L"OfflineScreenLance_threads_{}_{}.tsv", CurrentProcessId(), threads);
+        int exit_code = RunChildProcess({ L"--benchmark", L"translate-latency", L"--threads", std::to_wstring(threads),
+            L"--precision", utf8_to_wstring(ModelPrecisionName(g_config.precision)), L"--output", result_path.wstring(),
+            L"--models", GetModelsDirectoryPath().wstring() });
+
+        std::ifstream result(result_path);
+        std::string header, row;
+        bool completed = exit_code == 0 && std::getline(result, header) && std::getline(result, row);
+        result.close();
+        std::error_code ignored;
+        std::filesystem::remove(result_path, ignored);
+        if (!completed) {
+            out << "translate_latency\t" << threads << "\tfailed (exit code " << exit_code << ")\n";
+            continue;
+        }
+        out << row << '\n';
+        any_completed = true;
+    }
+    return any_completed;
+}
+
+// One decoder run for a single row after `past_length` earlier tokens, timed on its own: with a KV
+// cache, the step graph fed a cache that long; without one, the whole prefix. The past is built
+// from `prefix` (repeated as needed) one step at a time, and the timed run doesn't extend it, so
+// every call costs the same. Throws on ORT errors.
+double TimeDecoderStep(Ort::Value& encoder_hidden_state, const std::vector<int64_t>& source_lengths,
+    const std::vector<int32_t>& prefix, size_t past_length) {
+    TranslationModel& model = CurrentModel();
+    const auto& layout = model.decoder_layout;
+    Ort::AllocatorWithDefaultOptions allocator;
+    bool use_cache_branch = false;
+    auto feeds = CreateDecoderFeeds(allocator, encoder_hidden_state, source_lengths, use_cache_branch);
+    std::vector<int32_t> input_ids = { BOS_TOKEN_ID };
+    auto bind_input_ids = [&] {
+        std::array<int64_t, 2> shape = { 1, static_cast<int64_t>(input_ids.size()) };
+        feeds.insert_or_assign("input_ids", Ort::Value::CreateTensor<int32_t>(
+            memory_info, input_ids.data(), input_ids.size(), shape.data(), shape.size()));
+    };
+    auto next_token = [&](size_t i) { return prefix.empty() ? BOS_TOKEN_ID : prefix[i % prefix.size()]; };
+
+    if (layout.variant == DecoderVariant::FullPrefix) {
+        for (size_t i = 0; i < past_length; ++i) input_ids.push_back(next_token(i));
+        bind_input_ids();
+        return MeasureSecondsPerCall([&] { RunWithFeeds(*model.decoder_session, layout.first_step_inputs, layout.first_step_outputs, feeds); });
+    }
+
+    Ort::Session& step_session = layout.variant == DecoderVariant::WithPast ? *model.decoder_with_past_session : *model.decoder_session;
+    for (size_t i = 0; i < past_length; ++i) {
+        bool first_step = (i == 0);
+        use_cache_branch = !first_step;
+        bind_input_ids();
+        const auto& output_names = first_step ? layout.first_step_outputs : layout.next_step_outputs;
+        auto outputs = RunWithFeeds(first_step ? *model.decoder_session : step_session,
+            first_step ? layout.first_step_inputs : layout.next_step_inputs, output_names, feeds);
+        for (size_t j = 1; j < outputs.size(); ++j) {
+            feeds.insert_or_assign(layout.present_to_past.at(output_names[j]), std::move(outputs[j]));
+        }
+        input_ids[0] = next_token(i);
+    }
+    use_cache_branch = true;
+    bind_input_ids();
+    return MeasureSecondsPerCall([&] { RunWithFeeds(step_session, layout.next_step_inputs, layout.next_step_outputs, feeds); });
+}
+
+// Microbenchmarks of the translation core, one row per case: UTF-16/UTF-8 conversion, the greedy
+// argmax over a logits row, SentencePiece encode and decode, single encoder runs across source
+// lengths, and single decoder steps across past lengths (`size` is the past length; one row per
+// call, so ns_per_unit is per step). The conversion and argmax rows need no models.
+bool RunCoreBenchmark(std::ostream& out) {
+    constexpr std::chrono::milliseconds MIN_DURATION{ 200 };
+    constexpr size_t DECODER_STEP_SOURCE_TOKENS = 32;
+    out << "benchmark\tsize\tunit\tus_per_call\tns_per_unit\n";
+    auto report = [&](const char* name, size_t size, const char* unit, double seconds, size_t units = 0) {
+        if (units == 0) units = (std::max)(size, size_t{ 1 });
+        out << name << '\t' << size << '\t' << unit << '\t' << seconds * 1e6 << '\t'
+            << seconds * 1e9 / static_cast<double>(units) << '\n';
+    };
+
+    // Latin with accents and CJK, so both the one-byte and the multi-byte paths are timed.
+    const std::wstring pattern = L"Quest updated: caf\u00E9 \u00FCber \u65E5\u672C\u8A9E\u306E\u30C6\u30AD\u30B9\u30C8 ";
+    for (size_t length : { 16, 256, 4096 }) {
+        std::wstring wide;
+        while (wide.size() < length) wide += pattern;
+        wide.resize(length);
+        std::string narrow = wstring_to_utf8(wide);
+        std::wstring round_trip;
+        report("utf16_to_utf8", length, "char", MeasureSecondsPerCall([&] { narrow = wstring_to_utf8(wide); }, MIN_DURATION));
+        report("utf8_to_utf16", length, "char", MeasureSecondsPerCall([&] { round_trip = utf8_to_wstring(narrow); }, MIN_DURATION));
+    }
+
+    std::mt19937 rng(1);
+    std::normal_distribution<float> logit(0.0f, 4.0f);
+    for (size_t vocab : { 8192, 32000, 65536 }) {
+        std::vector<float> logits(vocab);
+        for (auto& value : logits) value = logit(rng);
+        volatile int32_t token = 0; // keeps the timed calls from being optimized away
+        report("argmax", vocab, "logit", MeasureSecondsPerCall([&] {
+            token = ArgmaxLastPosition(logits.data(), 1, static_cast<int64_t>(vocab), 0);
+        }, MIN_DURATION));
+        report("decisive_argmax", vocab, "logit", MeasureSecondsPerCall([&] {
+            token = DecisiveArgmax(logits.data(), static_cast<int64_t>(vocab)).first;
+        }, MIN_DURATION));
+    }
+
+    if (!InitTranslationEngine(g_config.precision)) {
+        out << "Translation engine failed to initialize\n";
+        return false;
+    }
+    ModelBinding binding(g_model_registry.DefaultModel()); // the default pair, whatever the text's language
+    TranslationModel& model = CurrentModel();
+
+    std::string paragraph;
+    for (auto sentence : BENCHMARK_SENTENCES) paragraph += std::string(sentence) + ' ';
+    for (const std::string& text : { NormalizeSegment(std::string(BENCHMARK_SENTENCES[0])), NormalizeSegment(paragraph) }) {
+        std::vector<int32_t> ids;
+        report("sp_encode", text.size(), "byte", MeasureSecondsPerCall([&] {
+            ids.clear();
+            model.sp_source_processor.Encode(text, &ids);
+        }, MIN_DURATION));
+        std::vector<int32_t> target_ids;
+        model.sp_target_processor.Encode(text, &target_ids);
+        std::string decoded;
+        report("sp_decode", target_ids.size(), "token", MeasureSecondsPerCall([&] {
+            model.sp_target_processor.Decode(target_ids, &decoded);
+        }, MIN_DURATION));
+    }
+
+    // Sources of each length cut from the benchmark sentences, still ending in EOS.
+    std::vector<int32_t> source_pool;
+    while (source_pool.size() < MAX_CHUNK_SOURCE_TOKENS) {
+        std::vector<int32_t> ids;
+        model.sp_source_processor.Encode(NormalizeSegment(paragraph), &ids);
+        if (!ids.empty() && ids.back() == EOS_TOKEN_ID) ids.pop_back();
+        if (ids.empty()) break;
+        source_pool.insert(source_pool.end(), ids.begin(), ids.end());
+    }
+    for (size_t length : { size_t{ 8 }, size_t{ 32 }, MAX_CHUNK_SOURCE_TOKENS }) {
+        if (length > source_pool.size() + 1) break;
+        std::vector<int32_t> source(source_pool.begin(), source_pool.begin() + static_cast<std::ptrdiff_t>(length - 1));
+        source.push_back(EOS_TOKEN_ID);
+        std::vector<int64_t> source_lengths;
+        Ort::Value encoder_hidden_state{ nullptr };
+        try {
+            report("encoder", length, "token", MeasureSecondsPerCall([&] { encoder_hidden_state = EncodeBatch({ &source }, source_lengths); }));
+        } catch (const std::exception& e) {
+            out << "Encoder failed: " << e.what() << "\n";
+            return false;
+        }
+    }
+
+    // Decoder steps against one fixed source, so only the past length varies between rows. The
+    // past is the source's own greedy translation, repeated when it is shorter.
+    size_t source_length = (std::min)(DECODER_STEP_SOURCE_TOKENS, source_pool.size() + 1);
+    std::vector<int32_t> source(source_pool.begin(), source_pool.begin() + static_cast<std::ptrdiff_t>(source_length - 1));
+    source.push_back(EOS_TOKEN_ID);
+    std::vector<int64_t> source_lengths;
+    std::vector<std::vector<int32_t>> output_tokens;
+    try {
+        Ort::Value encoder_hidden_state = EncodeBatch({ &source }, source_lengths);
+        if (!DecodeBatch(encoder_hidden_state, source_lengths, output_tokens)) {
+            out << "Decoder failed\n";
+            return false;
+        }
+        for (size_t past_length : { size_t{ 1 }, size_t{ 16 }, size_t{ 64 }, static_cast<size_t>(MAX_DECODE_STEPS - 1) }) {
+            report("decoder_step", past_length, "step", TimeDecoderStep(encoder_hidden_state, source_lengths, output_tokens[0], past_length), 1);
+        }
+    } catch (const std::exception& e) {
+        out << "Decoder failed: " << e.what() << "\n";
+        return false;
+    }
+    return true;
+}
+
+// End-to-end latency over a fixed multilingual corpus (or --corpus), one segment per request as
+// the overlay sends edited lines. A warm-up pass loads every pair the lines route to; translation
+// caches are then dropped and CORPUS_BENCHMARK_PASSES timed passes run. Writes a JSON object with
+// latency percentiles, throughput in segments and tokens, and peak memory, for run-to-run diffs.
+bool RunCorpusBenchmark(const std::optional<std::filesystem::path>& corpus_path, std::ostream& out) {
+    constexpr int CORPUS_BENCHMARK_PASSES = 3;
+    if (!InitTranslationEngine(g_config.precision)) {
+        out << "Translation engine failed to initialize\n";
+        return false;
+    }
+    std::vector<std::wstring> segments;
+    if (corpus_path) {
+        for (const auto& line : ReadCorpusLines(*corpus_path)) segments.push_back(utf8_to_wstring(line));
+    } else {
+        segments.assign(MULTILINGUAL_BENCHMARK_CORPUS.begin(), MULTILINGUAL_BENCHMARK_CORPUS.end());
+    }
+    if (segments.empty()) {
+        out << "The corpus has no lines to translate\n";
+        return false;
+    }
+
+    for (const auto& segment : segments) TranslateSegments({ segment });
+    g_model_registry.ForEachLoaded([](TranslationModel& model) { model.translation_cache.reset(); });
+
+    std::vector<double> latencies_ms;
+    uint64_t source_tokens = 0, target_tokens = 0, errors = 0;
+    double seconds = 0.0;
+    for (int pass = 0; pass < CORPUS_BENCHMARK_PASSES; ++pass) {
+        for (const auto& segment : segments) {
+            auto start = std::chrono::steady_clock::now();
+            std::wstring translation = TranslateSegments({ segment })->front();
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            latencies_ms.push_back(elapsed * 1e3);
+            seconds += elapsed;
+
+            // Counted afterwards with the pair the segment was routed to, outside the timing.
+            auto model = g_model_registry.Route({ segment });
+            std::vector<int32_t> ids;
+            model->sp_source_processor.Encode(NormalizeSegment(wstring_to_utf8(segment)), &ids);
+            source_tokens += ids.size();
+            if (IsTranslationError(translation)) {
+                ++errors;
+                continue;
+            }
+            ids.clear();
+            model->sp_target_processor.Encode(wstring_to_utf8(translation), &ids);
+            target_tokens += ids.size();
+        }
+    }
+
+    double mean_ms = seconds * 1e3 / static_cast<double>(latencies_ms.size());
+    double peak_working_set_mb = PeakWorkingSetMb();
+    std::string pairs;
+    g_model_registry.ForEachLoaded([&](TranslationModel& model) {
+        pairs += std::string(pairs.empty() ? "" : ", ") + '"' + JsonEscape(wstring_to_utf8(ModelDisplayName(model.name))) + '"';
+    });
+
+    out << "{\n"
+        << "  \"benchmark\": \"corpus\",\n"
+        << "  \"corpus\": \"" << (corpus_path ? JsonEscape(wstring_to_utf8(corpus_path->wstring())) : std::string("builtin")) << "\",\n"
+        << "  \"precision\": \"" << ModelPrecisionName(g_model_registry.DefaultModel()->precision) << "\",\n"
+        << "  \"threads\": " << g_thread_budget.translate_threads() << ",\n"
+        << "  \"pairs\": [" << pairs << "],\n"
+        << "  \"passes\": " << CORPUS_BENCHMARK_PASSES << ",\n"
+        << "  \"segments\": " << latencies_ms.size() << ",\n"
+        << "  \"errors\": " << errors << ",\n"
+        << "  \"seconds\": " << seconds << ",\n"
+        << "  \"segments_per_s\": " << static_cast<double>(latencies_ms.size()) / seconds << ",\n"
+        << "  \"source_tokens_per_s\": " << static_cast<double>(source_tokens) / seconds << ",\n"
+        << "  \"target_tokens_per_s\": " << static_cast<double>(target_tokens) / seconds << ",\n"
+        << "  \"latency_ms\": { \"mean\": " << mean_ms << ", \"p50\": " << Percentile(latencies_ms, 0.50)
+        << ", \"p90\": " << Percentile(latencies_ms, 0.90) << ", \"p95\": " << Percentile(latencies_ms, 0.95)
+        << ", \"p99\": " << Percentile(latencies_ms, 0.99) << ", \"max\": " << Percentile(latencies_ms, 1.0) << " },\n"
+        << "  \"peak_working_set_mb\": " << peak_working_set_mb << "\n"
+        << "}\n";
+    return errors == 0;
+}
+
+#ifdef _WIN32
+bool IsImageFile(const std::filesystem::path& path) {
+    auto extension = path.extension().wstring();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](wchar_t c) { return static_cast<wchar_t>(std::towlower(c)); });
+    return extension == L".png" || extension == L".jpg" || extension == L".jpeg" || extension == L".bmp"
+        || extension == L".gif" || extension == L".tif" || extension == L".tiff";
+}
+
+// Lines of a screenshot file, read by the same recognizer as live captures, preprocessing
+// included. nullopt if the image can't be decoded. Needs a multithreaded apartment.
+std::optional<std::vector<std::string>> RecognizeImageFile(const OcrEngine& engine, const std::filesystem::path& path) {
+    TraceScope trace(g_tracer, "bulk_image");
+    std::ifstream file(path, std::ios::binary);
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (bytes.empty()) return std::nullopt;
+    try {
+        InMemoryRandomAccessStream stream;
+        DataWriter writer(stream);
+        writer.WriteBytes(bytes);
+        writer.StoreAsync().get();
+        writer.DetachStream();
+        stream.Seek(0);
+        BitmapDecoder decoder = BitmapDecoder::CreateAsync(stream).get();
+        SoftwareBitmap bitmap = decoder.GetSoftwareBitmapAsync(BitmapPixelFormat::Bgra8, BitmapAlphaMode::Premultiplied).get();
+        Buffer pixels(static_cast<uint32_t>(bitmap.PixelWidth()) * static_cast<uint32_t>(bitmap.PixelHeight()) * 4);
+        bitmap.CopyToBuffer(pixels);
+
+        Frame frame;
+        frame.pixels = pixels.data();
+        frame.width = bitmap.PixelWidth();
+        frame.height = bitmap.PixelHeight();
+        frame.stride = static_cast<size_t>(frame.width) * 4;
+        FrameRecognizer recognizer(engine);
+        std::vector<std::string> lines;
+        for (const auto& line : recognizer.Recognize(frame)) lines.push_back(wstring_to_utf8(line));
+        return lines;
+    } catch (winrt::hresult_error const& e) {
+        g_tracer.RecordError("bulk_image", winrt::to_string(e.message()));
+        return std::nullopt;
+    }
+}
+#endif
+
+// Translates a text file, or every text file and screenshot under a directory, into `destination`
+// (see RunBulkJob). Interrupted runs pick up where they stopped when started again, and files with
+// lines that failed to translate are left .partial and retried. Reports throughput and time per
+// stage; fails if any file couldn't be read or any line translated.
+// Screenshots need Windows.Media.Ocr, so elsewhere only text files are translated.
+bool RunBulkMode(const std::filesystem::path& input, const std::filesystem::path& destination, size_t workers, std::ostream& out) {
+    if (!InitTranslationEngine(g_config.precision)) {
+        out << "Translation engine failed to initialize\n";
+        return false;
+    }
+#ifdef _WIN32
+    OcrEngine engine = CreateOcrEngine(); // without one, screenshots are left out
+    auto is_image = [&](const std::filesystem::path& file) { return engine && IsImageFile(file); };
+    auto recognize = [&](const std::filesystem::path& file) { return RecognizeImageFile(engine, file); };
+#else
+    auto is_image = [](const std::filesystem::path&) { return false; };
+    auto recognize = [](const std::filesystem::path&) { return std::optional<std::vector<std::string>>(); };
+#endif
+    auto files = CollectBulkFiles(input, destination, is_image);
+    if (files.empty()) {
+        out << "Nothing to translate in " << wstring_to_utf8(input.wstring()) << "\n";
+        return false;
+    }
+
+    BulkOptions options;
+    options.workers = workers;
+    options.max_batch = MAX_BATCH_SEGMENTS;
+    options.max_batch_tokens = MAX_BATCH_PADDED_TOKENS;
+    // Bucketing only needs lengths, so the default pair's tokenizer serves every language.
+    std::shared_ptr<TranslationModel> tokenizer = g_model_registry.DefaultModel();
+    auto job = RunBulkJob(files, recognize,
+        [](const std::vector<std::string>& texts) {
+            std::vector<std::wstring> segments;
+            for (const auto& text : texts) segments.push_back(utf8_to_wstring(text));
+            auto translations = *TranslateSegments(segments);
+            std::vector<BulkTranslation> results;
+            for (const auto& translation : translations) results.push_back({ !IsTranslationError(translation), wstring_to_utf8(translation) });
+            return results;
+        },
+        [&](const std::string& text) {
+            std::vector<int32_t> ids;
+            tokenizer->sp_source_processor.Encode(NormalizeSegment(text), &ids);
+            return ids.size();
+        },
+        options);
+    WriteBulkReport(job, out);
+    ReportTranslationCacheStats();
+    g_model_registry.ForEachLoaded([](TranslationModel& model) {
+        if (model.translation_cache) model.translation_cache->Flush();
+    });
+    return job.files_failed == 0 && job.translation.errors == 0;
+}
+
+// Loads the models once and translates for every local client of [Service] Name, gathering
+// concurrent requests into shared batches of up to MAX_BATCH_SEGMENTS. Runs until a client sends
+// Shutdown (--stop-service), then reports how well requests were batched.
+bool RunTranslationService(std::ostream& out) {
+    if (!InitTranslationEngine(g_config.precision)) {
+        out << "Translation engine failed to initialize\n";
+        return false;
+    }
+    DynamicBatcher batcher([](const std::vector<std::string>& texts) {
+        // Clients may be reading different languages; each pair translates its own share of the batch.
+        std::vector<std::wstring> segments;
+        std::vector<std::shared_ptr<TranslationModel>> models;
+        std::vector<std::vector<size_t>> groups;
+        for (const auto& text : texts) {
+            segments.push_back(utf8_to_wstring(text));
+            auto model = g_model_registry.Route({ segments.back() });
+            auto it = std::find(models.begin(), models.end(), model);
+            if (it == models.end()) {
+                models.push_back(model);
+                groups.emplace_back();
+                it = models.end() - 1;
+            }
+            groups[static_cast<size_t>(it - models.begin())].push_back(segments.size() - 1);
+        }
+        std::vector<ServiceResult> results(texts.size());
+        for (size_t g = 0; g < models.size(); ++g) {
+            ModelBinding binding(models[g]);
+            std::vector<std::wstring> group_segments;
+            for (size_t i : groups[g]) group_segments.push_back(segments[i]);
+            auto translations = *TranslateSegments(group_segments);
+            for (size_t k = 0; k < groups[g].size(); ++k) {
+                results[groups[g][k]] = { !IsTranslationError(translations[k]), wstring_to_utf8(translations[k]) };
+            }
+        }
+        return results;
+    }, MAX_BATCH_SEGMENTS, g_config.service_batch_delay);
+
+    TranslationServer server(batcher);
+    if (!server.Start(g_config.service_name)) {
+        out << "Cannot listen on " << LocalEndpoint(g_config.service_name) << "; is the service already running?\n";
+        return false;
+    }
+    out << "Translation service listening on " << LocalEndpoint(g_config.service_name) << std::endl;
+    server.Wait();
+    server.Stop();
+    batcher.Stop();
+
+    auto stats = batcher.stats();
+    out << "clients\trequests\tbatches\tmean_batch\tlargest_batch\n"
+        << server.clients_served() << '\t' << stats.requests << '\t' << stats.batches << '\t'
+        << static_cast<double>(stats.requests) / static_cast<double>((std::max)(stats.batches, uint64_t{ 1 })) << '\t'
+        << stats.largest_batch << '\n';
+    ReportTranslationCacheStats();
+    g_model_registry.ForEachLoaded([](TranslationModel& model) {
+        if (model.translation_cache) model.translation_cache->Flush();
+    });
+    return true;
+}
+
+#ifdef _WIN32
+// GUI-subsystem builds have no stdout; borrow the console of the shell that launched us.
+void AttachParentConsole() {
+    if (AttachConsole(ATTACH_PARENT_PROCESS) || AllocConsole()) {
+        FILE* stream = nullptr;
+        freopen_s(&stream, "CONOUT$", "w", stdout);
+    }
+}
+
+std::vector<std::wstring> GetCommandLineArgs() {
+    int argc = 0;
+    LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    if (!argv) return {};
+    std::vector<std::wstring> args(argv + 1, argv + argc);
+    LocalFree(argv);
+    return args;
+}
+
+// Runs `task` on a thread in the multithreaded apartment, which awaiting OCR synchronously needs.
+bool RunInMultithreadedApartment(const std::function<bool()>& task) {
+    bool completed = false;
+    std::thread([&] {
+        winrt::init_apartment(apartment_type::multi_threaded);
+        completed = task();
         winrt::uninit_apartment();
+    }).join();
+    return completed;
+}
+#else
+void AttachParentConsole() {}
+
+std::vector<std::wstring> g_command_line_args; // set by main
+
+std::vector<std::wstring> GetCommandLineArgs() {
+    return g_command_line_args;
+}
+
+bool RunInMultithreadedApartment(const std::function<bool()>& task) {
+    return task();
+}
+#endif
+
+std::optional<std::wstring> GetOptionValue(const std::vector<std::wstring>& args, std::wstring_view option) {
+    auto it = std::find(args.begin(), args.end(), option);
+    if (it == args.end() || std::next(it) == args.end()) return std::nullopt;
+    return *std::next(it);
+}
+
+bool HasOption(const std::vector<std::wstring>& args, std::wstring_view option) {
+    return std::find(args.begin(), args.end(), option) != args.end();
+}
+
+// --models reads models from another directory; OfflineScreenLance.ini and cache\ are then looked
+// for beside it. Applied before the configuration is loaded.
+void ApplyModelsDirectoryOption() {
+    if (auto models = GetOptionValue(GetCommandLineArgs(), L"--models")) g_models_directory = std::filesystem::absolute(*models);
+}
+
+// Headless tools share the executable with the overlay:
+//   OfflineScreenLance.exe --benchmark frame-change|ocr-preprocess|decode-step|startup [--precision p] [--output report.tsv]
+//   OfflineScreenLance.exe --benchmark replay|pipeline --replay session.frames [--output report.tsv]
+//   OfflineScreenLance.exe --benchmark translate-latency|threads [--threads n] [--precision p] [--output report.tsv]
+//   OfflineScreenLance.exe --benchmark speculative [--corpus corpus.txt] [--precision p] [--output report.tsv]
+//   OfflineScreenLance.exe --benchmark shortlist [--corpus corpus.txt] [--precision p] [--output report.tsv]
+//   OfflineScreenLance.exe --benchmark ocr-jitter [--replay session.frames] [--output report.tsv]
+//   OfflineScreenLance.exe --benchmark core [--precision p] [--threads n] [--output report.tsv]
+//   OfflineScreenLance.exe --benchmark corpus [--corpus corpus.txt] [--precision p] [--threads n] [--output report.json]
+//   OfflineScreenLance.exe --eval corpus.txt [--output report.tsv]
+//   OfflineScreenLance.exe --serve [--service name] [--precision p] [--threads n]
+//   OfflineScreenLance.exe --load-test [--clients n] [--requests n] [--corpus corpus.txt] [--stop-service] [--output report.tsv]
+//   OfflineScreenLance.exe --stop-service
+//   OfflineScreenLance.exe --bulk <file or directory> --to <file or directory> [--workers n] [--precision p] [--output report.tsv]
+// Any of them also takes --trace trace.json to record per-stage spans to a Chrome trace, and
+// --models <directory> in place of models\ next to the executable.
+// Built for Linux (CMakeLists.txt), the executable is this headless tool alone; modes that replay
+// recordings through OCR and --bulk on screenshots need Windows.Media.Ocr and are unavailable there.
+// OfflineScreenLanceBench --make-test-models <directory> writes small models for --models, so the
+// model-backed benchmarks run without a real export (ctest -L benchmark runs core, corpus and
+// decode-step on them). decode-step reports allocations per step only from a build configured with
+// -DOSL_COUNT_ALLOCATIONS=ON.
+// --serve runs the shared translation service until --stop-service; --load-test drives it from 1, 4
+// and 16 concurrent clients unless --clients picks one count. --service overrides [Service] Name.
+// --bulk translates .txt/.srt/.vtt files and screenshots line by line, --workers batches at a time;
+// rerun the same command to resume an interrupted run.
+// --threads overrides [Threads] Translate. Headless runs keep a fixed thread budget, so results don't
+// depend on what else is on screen.
+// Returns the process exit code, or nullopt to start the interactive overlay.
+std::optional<int> RunCommandLineMode() {
+    std::vector<std::wstring> args = GetCommandLineArgs();
+
+    auto benchmark = GetOptionValue(args, L"--benchmark");
+    auto eval_corpus = GetOptionValue(args, L"--eval");
+    auto eval_variant = GetOptionValue(args, L"--eval-variant");
+    bool serve = HasOption(args, L"--serve");
+    bool load_test = HasOption(args, L"--load-test");
+    bool stop_service = HasOption(args, L"--stop-service");
+    auto bulk_input = GetOptionValue(args, L"--bulk");
+    if (!benchmark && !eval_corpus && !eval_variant && !serve && !load_test && !stop_service && !bulk_input) return std::nullopt;
+
+    std::ofstream output_file;
+    if (auto output_path = GetOptionValue(args, L"--output")) {
+        output_file.open(std::filesystem::path(*output_path));
+    } else {
+        AttachParentConsole();
+    }
+    std::ostream& out = output_file.is_open() ? output_file : std::cout;
+
+    if (auto precision_name = GetOptionValue(args, L"--precision")) {
+        auto precision = ParseModelPrecision(*precision_name);
+        if (!precision) {
+            out << "Unknown precision: " << wstring_to_utf8(*precision_name) << "\n";
+            return 1;
+        }
+        g_config.precision = *precision;
+    }
+    if (auto threads = GetOptionValue(args, L"--threads")) {
+        g_config.translate_threads = static_cast<int>(std::wcstol(threads->c_str(), nullptr, 10));
+        if (g_config.translate_threads <= 0) {
+            out << "Invalid thread count: " << wstring_to_utf8(*threads) << "\n";
+            return 1;
+        }
+    }
+    if (auto trace_path = GetOptionValue(args, L"--trace")) {
+        g_config.trace = true;
+        g_config.trace_file = *trace_path;
+        g_tracer.Enable(true);
+    }
+    if (auto service_name = GetOptionValue(args, L"--service")) g_config.service_name = wstring_to_utf8(*service_name);
+    g_config.threads_adaptive = false;
+    g_thread_budget.Configure(g_config);
+
+    if (serve) {
+        return RunTranslationService(out) ? 0 : 1;
+    }
+    if (bulk_input) {
+        auto destination = GetOptionValue(args, L"--to");
+        if (!destination) {
+            out << "--bulk needs --to <output file or directory>\n";
+            return 1;
+        }
+        size_t workers = 2;
+        if (auto count = GetOptionValue(args, L"--workers")) workers = (std::max)(std::wcstoul(count->c_str(), nullptr, 10), 1ul);
+        return RunInMultithreadedApartment([&] { return RunBulkMode(*bulk_input, *destination, workers, out); }) ? 0 : 1;
+    }
+    if (load_test) {
+        std::vector<std::string> texts(BENCHMARK_SENTENCES.begin(), BENCHMARK_SENTENCES.end());
+        if (auto corpus = GetOptionValue(args, L"--corpus")) texts = ReadCorpusLines(*corpus);
+        std::vector<size_t> client_counts = { 1, 4, 16 };
+        if (auto clients = GetOptionValue(args, L"--clients")) client_counts = { std::wcstoul(clients->c_str(), nullptr, 10) };
+        size_t requests = 200;
+        if (auto count = GetOptionValue(args, L"--requests")) requests = std::wcstoul(count->c_str(), nullptr, 10);
+        if (texts.empty() || client_counts.front() == 0 || requests == 0) {
+            out << "Nothing to send: check --corpus, --clients and --requests\n";
+            return 1;
+        }
+        if (!RunServiceLoadTest(g_config.service_name, texts, client_counts, requests, out)) {
+            out << "No translation service on " << LocalEndpoint(g_config.service_name) << "; start one with --serve\n";
+            return 1;
+        }
+    }
+    if (stop_service) {
+        TranslationClient client;
+        if (!client.Connect(g_config.service_name) || !client.RequestShutdown()) {
+            out << "No translation service on " << LocalEndpoint(g_config.service_name) << "\n";
+            return 1;
+        }
+    }
+    if (load_test || stop_service) return 0;
+
+    if (eval_corpus) {
+        return RunEvalMode(*eval_corpus, out) ? 0 : 1;
+    }
+    if (eval_variant) {
+        auto precision = ParseModelPrecision(*eval_variant);
+        auto corpus = GetOptionValue(args, L"--corpus");
+        if (!precision || !corpus) return 1;
+        return RunEvalVariant(*corpus, *precision, out) ? 0 : 1;
+    }
+
+    if (*benchmark == L"frame-change") {
+        RunFrameChangeDetectorBenchmark(out);
+        return 0;
+    }
+    if (*benchmark == L"ocr-preprocess") {
+        RunOcrPreprocessBenchmark(out);
         return 0;
     }
+    if (*benchmark == L"decode-step") {
+        return RunDecodeStepBenchmark(out) ? 0 : 1;
+    }
+    if (*benchmark == L"startup") {
+        return RunStartupBenchmark(out) ? 0 : 1;
+    }
+    if (*benchmark == L"translate-latency") {
+        return RunTranslateLatencyBenchmark(out) ? 0 : 1;
+    }
+    if (*benchmark == L"threads") {
+        return RunThreadSweepBenchmark(out) ? 0 : 1;
+    }
+    if (*benchmark == L"shortlist") {
+        auto corpus = GetOptionValue(args, L"--corpus");
+        return RunShortlistBenchmark(corpus ? std::optional<std::filesystem::path>(*corpus) : std::nullopt, out) ? 0 : 1;
+    }
+    if (*benchmark == L"speculative") {
+        auto corpus = GetOptionValue(args, L"--corpus");
+        return RunSpeculativeBenchmark(corpus ? std::optional<std::filesystem::path>(*corpus) : std::nullopt, out) ? 0 : 1;
+    }
+    if (*benchmark == L"core") {
+        return RunCoreBenchmark(out) ? 0 : 1;
+    }
+    if (*benchmark == L"corpus") {
+        auto corpus = GetOptionValue(args, L"--corpus");
+        return RunCorpusBenchmark(corpus ? std::optional<std::filesystem::path>(*corpus) : std::nullopt, out) ? 0 : 1;
+    }
+    if (*benchmark == L"ocr-jitter") {
+        RunOcrJitterBenchmark(out);
+        auto recording = GetOptionValue(args, L"--replay");
+        if (!recording) return 0;
+        out << '\n';
+#ifdef _WIN32
+        return RunInMultithreadedApartment([&] { return RunOcrJitterReplayBenchmark(*recording, out); }) ? 0 : 1;
+#else
+        out << "Replaying a recording through OCR needs Windows.Media.Ocr\n";
+        return 1;
+#endif
+    }
+    if (*benchmark == L"replay" || *benchmark == L"pipeline") {
+        auto recording = GetOptionValue(args, L"--replay");
+        if (!recording) {
+            out << "--benchmark " << wstring_to_utf8(*benchmark) << " needs --replay <recording>\n";
+            return 1;
+        }
+        if (*benchmark == L"replay") {
+            return RunReplayBenchmark(*recording, out, CHANGE_DETECTION_TILE_SIZE, MIN_CHANGED_TILES_FOR_OCR) ? 0 : 1;
+        }
+#ifdef _WIN32
+        return RunInMultithreadedApartment([&] { return RunPipelineReplayBenchmark(*recording, out); }) ? 0 : 1;
+#else
+        out << "--benchmark pipeline replays through OCR, which needs Windows.Media.Ocr\n";
+        return 1;
+#endif
+    }
+    out << "Unknown benchmark: " << wstring_to_utf8(*benchmark) << "\n";
+    return 1;
+}
+
+// One line per pair still loaded; pairs unloaded earlier took their counts with them.
+void ReportTranslationCacheStats() {
+    g_model_registry.ForEachLoaded([](TranslationModel& model) {
+        if (!model.translation_cache) return;
+        auto stats = model.translation_cache->Stats();
+        auto report = std::format(L"Translation cache ({}): {} memory hits, {} disk hits, {} misses, {} insertions, {} evictions, {} records on disk, "
+            L"{} kept in memory only (store full)\n",
+            ModelDisplayName(model.name), stats.memory_hits, stats.disk_hits, stats.misses, stats.insertions, stats.evictions, stats.disk_records,
+            stats.not_persisted);
+        DebugReport(report);
+    });
+    g_model_registry.Report();
+}
+
+void ReportJitterStats() {
+    auto report = std::format(L"OCR jitter: {} passes and {} more lines not retranslated\n",
+        g_jitter_stats.passes_suppressed.load(), g_jitter_stats.lines_reused.load());
+    DebugReport(report);
+}
+
+void ReportShortlistStats() {
+    if (g_shortlist_stats.picks == 0) return;
+    auto report = std::format(L"Vocabulary shortlist: {} tokens picked from {} candidates on average, {} checked against the whole vocabulary, "
+        L"{} overridden, {} kept within ShortlistTolerance\n",
+        g_shortlist_stats.picks.load(), g_shortlist_stats.candidates.load() / g_shortlist_stats.picks.load(),
+        g_shortlist_stats.checks.load(), g_shortlist_stats.overrides.load(), g_shortlist_stats.declined.load());
+    DebugReport(report);
+}
+
+void ReportSpeculativeStats() {
+    if (g_speculative_stats.requests == 0) return;
+    auto report = std::format(L"Speculative decoding: {} segments, {} of {} draft tokens accepted, {} verifying and {} single-step decoder runs, {} positions re-run from single steps\n",
+        g_speculative_stats.requests.load(), g_speculative_stats.accepted_tokens.load(), g_speculative_stats.drafted_tokens.load(),
+        g_speculative_stats.verify_passes.load(), g_speculative_stats.single_steps.load(), g_speculative_stats.exact_reruns.load());
+    DebugReport(report);
+}
+
+// --- Trace Output ---
+
+#ifdef _WIN32
+// Appends per-stage percentiles over the last TRACE_STATS_INTERVAL, the pipeline's skip counters,
+// cache statistics and any new errors to a log file, every interval and once more on Stop.
+class TraceStatsLog {
+public:
+    ~TraceStatsLog() { Stop(); }
+
+    void Start(const std::filesystem::path& path) {
+        path_ = path;
+        thread_ = std::jthread([this](std::stop_token stop) {
+            while (InterruptibleSleep(stop, TRACE_STATS_INTERVAL)) Append();
+        });
+    }
+
+    void Stop() {
+        if (!thread_.joinable()) return;
+        thread_.request_stop();
+        thread_.join();
+        Append();
+    }
+
+private:
+    void Append() {
+        std::ofstream log(path_, std::ios::app);
+        if (!log) return;
+        log << std::format("[{:%F %T}]\n", std::chrono::floor<std::chrono::seconds>(std::chrono::system_clock::now()));
+        log << "stage\tcalls\tp50_ms\tp95_ms\tp99_ms\n";
+        for (const auto& [stage, summary] : g_tracer.Summaries(TRACE_STATS_INTERVAL)) {
+            log << stage << '\t' << summary.count << '\t' << summary.p50_ms << '\t' << summary.p95_ms << '\t' << summary.p99_ms << '\n';
+        }
+
+        log << "counter\tvalue\n";
+        auto counter = [&](const char* name, uint64_t value) { log << name << '\t' << value << '\n'; };
+        counter("frames_captured", g_pipeline_counters.frames_captured);
+        counter("frames_unchanged", g_pipeline_counters.frames_unchanged);
+        counter("ocr_passes", g_pipeline_counters.ocr_passes);
+        counter("ocr_text_unchanged", g_pipeline_counters.ocr_text_unchanged);
+        counter("translation_passes", g_pipeline_counters.translation_passes);
+        counter("jitter_passes_suppressed", g_jitter_stats.passes_suppressed);
+        counter("jitter_lines_reused", g_jitter_stats.lines_reused);
+        TranslationCacheStats cache_stats;
+        g_model_registry.ForEachLoaded([&](TranslationModel& model) {
+            if (!model.translation_cache) return;
+            auto stats = model.translation_cache->Stats();
+            cache_stats.memory_hits += stats.memory_hits;
+            cache_stats.disk_hits += stats.disk_hits;
+            cache_stats.misses += stats.misses;
+            cache_stats.evictions += stats.evictions;
+        });
+        counter("cache_memory_hits", cache_stats.memory_hits);
+        counter("cache_disk_hits", cache_stats.disk_hits);
+        counter("cache_misses", cache_stats.misses);
+        counter("cache_evictions", cache_stats.evictions);
+        counter("model_evictions", g_model_registry.evictions());
+        counter("speculative_drafted_tokens", g_speculative_stats.drafted_tokens);
+        counter("speculative_accepted_tokens", g_speculative_stats.accepted_tokens);
+        counter("shortlist_picks", g_shortlist_stats.picks);
+        counter("shortlist_overrides", g_shortlist_stats.overrides);
+
+        for (const auto& error : g_tracer.Errors(errors_logged_)) log << "error\t" << error << '\n';
+        errors_logged_ = g_tracer.error_count();
+        log << '\n';
+    }
+
+    std::filesystem::path path_;
+    uint64_t errors_logged_ = 0;
+    std::jthread thread_;
+};
+#endif
+
+void WriteChromeTraceFile(const std::filesystem::path& path) {
+    if (!g_tracer.enabled() || !path.has_filename()) return;
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (file) g_tracer.WriteChromeTrace(file);
+}
+
+#ifdef _WIN32
+int APIENTRY wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE, _In_ LPWSTR, _In_ int) {
+    g_hinstance = hInstance;
+    // Before any window exists. Without it Windows scales captures of HiDPI screens and reports
+    // 96 DPI for every monitor, so OCR preprocessing never sees the real scale and the selected
+    // region is in scaled coordinates.
+    SetProcessDpiAwarenessContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2);
+    winrt::init_apartment(apartment_type::single_threaded);
+    ApplyModelsDirectoryOption();
+    g_config = LoadAppConfig();
+    g_tracer.Enable(g_config.trace);
+    g_tracer.NameCurrentThread("ui");
+
+    if (auto exit_code = RunCommandLineMode()) {
+        WriteChromeTraceFile(g_config.trace_file);
+        winrt::uninit_apartment();
+        return *exit_code;
+    }
+
+    g_thread_budget.Configure(g_config);
+    RegisterOverlayWindowClass(hInstance);
+
+    // Models load in the background while the user picks a mode and region; the translate stage
+    // waits for them, so capture and OCR can already run. With [Service] Connect and a service
+    // running, nothing loads here at all.
+    std::shared_future<bool> engine_ready = std::async(std::launch::async, [] {
+        bool ready = ConnectTranslationService() || InitTranslationEngine(g_config.precision);
+        g_startup_metrics.engine_ready_ms = g_startup_metrics.ElapsedMs();
+        return ready;
+    }).share();
+
+    // --replay plays a recorded session back in place of the screen, at its recorded pace; the
+    // overlay goes where a capture of the recorded size would have been.
+    std::vector<std::wstring> args = GetCommandLineArgs();
+    auto replay_path = GetOptionValue(args, L"--replay");
+    auto record_path = GetOptionValue(args, L"--record");
 
     RECT capture_region{};
-    if (g_fullscreen_mode) {
-        capture_region = { 0, 0, GetSystemMetrics(SM_CXSCREEN), GetSystemMetrics(SM_CYSCREEN) };
+    std::unique_ptr<FrameSource> frame_source;
+    if (replay_path) {
+        auto replay = std::make_unique<ReplayFrameSource>(ReplayFrameSource::Pacing::Realtime);
+        if (!replay->Open(*replay_path)) {
+            show_message_box(L"Cannot read the recorded session: " + *replay_path, L"Replay Error");
+            UnregisterOverlayWindowClass(hInstance);
+            winrt::uninit_apartment();
+            return -1;
+        }
+        capture_region = { 0, 0, replay->width(), replay->height() };
+        frame_source = std::move(replay);
     } else {
-        capture_region = SelectScreenRegion();
-        if ((capture_region.right - capture_region.left) < 10 || (capture_region.bottom - capture_region.top) < 10) {
-            show_message_box(L"Selected region is too small.", L"Region Error", MB_OK | MB_ICONWARNING);
+        INT_PTR dlg_result = DialogBoxParamW(
+            hInstance,
+            MAKEINTRESOURCE(IDD_MAIN_DIALOG),
+            nullptr,
+            MainDlgProc,
+            0);
+
+        if (dlg_result != IDOK) {
             UnregisterOverlayWindowClass(hInstance);
             winrt::uninit_apartment();
             return 0;
         }
-    }
 
-    OcrEngine engine = nullptr;
-    try {
-        engine = OcrEngine::TryCreateFromLanguage(Language(L"en"));
-    } catch (winrt::hresult_error const&) {}
+        if (g_fullscreen_mode) {
+            capture_region = { 0, 0, GetSystemMetrics(SM_CXSCREEN), GetSystemMetrics(SM_CYSCREEN) };
+        } else {
+            capture_region = SelectScreenRegion();
+            if ((capture_region.right - capture_region.left) < 10 || (capture_region.bottom - capture_region.top) < 10) {
+                show_message_box(L"Selected region is too small.", L"Region Error", MB_OK | MB_ICONWARNING);
+                UnregisterOverlayWindowClass(hInstance);
+                winrt::uninit_apartment();
+                return 0;
+            }
+        }
+        frame_source = std::make_unique<GdiFrameSource>(capture_region);
+    }
 
+    OcrEngine engine = CreateOcrEngine();
     if (!engine) {
-        show_message_box(L"OCR engine (English) failed to initialize. Please ensure the English language pack for OCR is installed in Windows settings.", L"OCR Error");
+        show_message_box(L"OCR engine failed to initialize. Please ensure the OCR language pack for the source language ([Models] Source, or English) is installed in Windows settings.", L"OCR Error");
         UnregisterOverlayWindowClass(hInstance);
         winrt::uninit_apartment();
         return -1;
     }
 
-    std::wstring last_ocr_text;
-    bool keep_running = true;
+    // Capture, OCR and translation run on their own threads; this thread only pumps messages,
+    // paints the overlay and watches for ESC, so a slow translation never stalls input.
+    ScreenTranslationPipeline pipeline(engine, std::move(frame_source), GetCurrentThreadId(), engine_ready);
+    if (record_path && !pipeline.RecordTo(*record_path)) {
+        show_message_box(L"Cannot create the recording file: " + *record_path, L"Record Error", MB_OK | MB_ICONWARNING);
+    }
+    pipeline.Start();
+    TraceStatsLog trace_stats_log;
+    if (g_config.trace && g_config.trace_stats_log.has_filename()) trace_stats_log.Start(g_config.trace_stats_log);
+
+    UINT_PTR escape_timer = SetTimer(nullptr, 0, ESCAPE_POLL_INTERVAL_MS, nullptr);
     MSG msg = {};
-    while (keep_running) {
-        while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
-            if (msg.message == WM_QUIT) {
-                keep_running = false;
-                break;
+    while (GetMessageW(&msg, nullptr, 0, 0) > 0) {
+        if (msg.hwnd == nullptr && msg.message == WM_APP_OVERLAY_READY) {
+            if (auto text = pipeline.TakeOverlayText()) {
+                CreateOrUpdateOverlayWindow(*text, capture_region);
             }
-            TranslateMessage(&msg);
-            DispatchMessage(&msg);
+            continue;
         }
-        if (!keep_running) break;
-
-        SoftwareBitmap software_bitmap = CaptureScreen(
-            capture_region.left,
-            capture_region.top,
-            capture_region.right - capture_region.left,
-            capture_region.bottom - capture_region.top);
-
-        if (software_bitmap) {
-            OcrResult ocr_result = nullptr;
-            try {
-                ocr_result = engine.RecognizeAsync(software_bitmap).get();
-            } catch (winrt::hresult_error const&) {}
-
-            if (ocr_result && !ocr_result.Text().empty()) {
-                std::wstring current_text = ocr_result.Text().c_str();
-                if (current_text != last_ocr_text) {
-                    last_ocr_text = current_text;
-                    std::wstring translated_text = TranslateText(current_text);
-                    if (!translated_text.empty()) {
-                        CreateOrUpdateOverlayWindow(translated_text, capture_region);
-                    } else if (translated_text.empty() && !current_text.empty()) {
-                        CreateOrUpdateOverlayWindow(L"...", capture_region);
-                    }
-                }
-            }
+        if (msg.hwnd == nullptr && msg.message == WM_APP_ENGINE_FAILED) {
+            show_message_box(L"Translation engine failed to initialize. Check model paths and dependencies.", L"Initialization Error");
+            PostQuitMessage(0);
+            continue;
         }
-
-        if (GetAsyncKeyState(VK_ESCAPE) & 0x8000) {
-            keep_running = false;
+        if (msg.hwnd == nullptr && msg.message == WM_TIMER && msg.wParam == escape_timer) {
+            if (GetAsyncKeyState(VK_ESCAPE) & 0x8000) {
+                PostQuitMessage(0);
+            }
+            continue;
         }
-        Sleep(500);
+        TranslateMessage(&msg);
+        DispatchMessage(&msg);
     }
+    KillTimer(nullptr, escape_timer);
+    pipeline.Stop();
+    trace_stats_log.Stop();
+    engine_ready.wait();
+    g_translation_service.reset();
 
     if (g_overlay_hwnd) {
         DestroyWindow(g_overlay_hwnd);
         g_overlay_hwnd = nullptr;
     }
+    ReportTranslationCacheStats();
+    ReportSpeculativeStats();
+    ReportShortlistStats();
+    ReportJitterStats();
+    pipeline.ReportTranslationLatency();
+    WriteChromeTraceFile(g_config.trace_file);
+    g_model_registry.ForEachLoaded([](TranslationModel& model) {
+        if (model.translation_cache) model.translation_cache->Flush();
+    });
     UnregisterOverlayWindowClass(hInstance);
     winrt::uninit_apartment();
     return 0;
 }
+#else
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) g_command_line_args.push_back(utf8_to_wstring(argv[i]));
+    ApplyModelsDirectoryOption();
+    g_config = LoadAppConfig();
+    g_tracer.Enable(g_config.trace);
+    g_tracer.NameCurrentThread("main");
+
+    auto exit_code = RunCommandLineMode();
+    if (!exit_code) {
+        std::cerr << "usage: " << argv[0] << " --serve | --load-test | --stop-service | --bulk <input> --to <output>"
+            " | --benchmark <name> | --eval <corpus> [--models <directory>] [options]\n";
+        return 2;
+    }
+    WriteChromeTraceFile(g_config.trace_file);
+    return *exit_code;
+}
+#endif
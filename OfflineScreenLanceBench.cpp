@@ -0,0 +1,92 @@
+// Benchmarks that need neither models nor Windows, and the small test models the engine's own
+// benchmarks (--benchmark core, corpus, decode-step) can run on where no real export is at hand:
+//   OfflineScreenLanceBench --benchmark frame-change|ocr-preprocess|ocr-jitter|shortlist [--output report.tsv]
+//   OfflineScreenLanceBench --benchmark replay --replay session.frames [--output report.tsv]
+//   OfflineScreenLanceBench --make-test-recording session.frames [--size 1920x1080] [--frames n]
+//   OfflineScreenLanceBench --make-test-models <directory>
+//   OfflineScreenLance --benchmark core --models <directory>
+// Sessions recorded by the overlay replay here as they do in OfflineScreenLance --benchmark replay;
+// --make-test-recording writes a synthetic one (see WriteSyntheticRecording).
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "TestModels.h"
+
+namespace {
+
+std::optional<std::string> GetOptionValue(const std::vector<std::string>& args, std::string_view option) {
+    auto it = std::find(args.begin(), args.end(), option);
+    if (it == args.end() || std::next(it) == args.end()) return std::nullopt;
+    return *std::next(it);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+
+    if (auto recording = GetOptionValue(args, "--make-test-recording")) {
+        int width = 1920, height = 1080, frames = 100;
+        if (auto size = GetOptionValue(args, "--size")) {
+            if (std::sscanf(size->c_str(), "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+                std::cerr << "Invalid size: " << *size << "\n";
+                return 1;
+            }
+        }
+        if (auto count = GetOptionValue(args, "--frames")) frames = (std::max)(std::atoi(count->c_str()), 1);
+        if (!WriteSyntheticRecording(*recording, width, height, frames)) {
+            std::cerr << "Couldn't write " << *recording << "\n";
+            return 1;
+        }
+        return 0;
+    }
+    if (auto directory = GetOptionValue(args, "--make-test-models")) {
+        if (!WriteTestModels(*directory)) {
+            std::cerr << "Couldn't write the test models to " << *directory << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    auto benchmark = GetOptionValue(args, "--benchmark");
+    if (!benchmark) {
+        std::cerr << "Usage: OfflineScreenLanceBench --benchmark frame-change|ocr-preprocess|ocr-jitter|shortlist [--output report.tsv]\n"
+                     "       OfflineScreenLanceBench --benchmark replay --replay session.frames [--output report.tsv]\n"
+                     "       OfflineScreenLanceBench --make-test-recording session.frames [--size 1920x1080] [--frames n]\n"
+                     "       OfflineScreenLanceBench --make-test-models <directory>\n";
+        return 2;
+    }
+    std::ofstream output_file;
+    if (auto output_path = GetOptionValue(args, "--output")) output_file.open(*output_path);
+    std::ostream& out = output_file.is_open() ? output_file : std::cout;
+
+    if (*benchmark == "frame-change") {
+        RunFrameChangeDetectorBenchmark(out);
+    } else if (*benchmark == "ocr-preprocess") {
+        RunOcrPreprocessBenchmark(out);
+    } else if (*benchmark == "ocr-jitter") {
+        RunOcrJitterBenchmark(out);
+    } else if (*benchmark == "shortlist") {
+        RunShortlistKernelBenchmark(out);
+    } else if (*benchmark == "replay") {
+        auto recording = GetOptionValue(args, "--replay");
+        if (!recording) {
+            out << "--benchmark replay needs --replay <recording>\n";
+            return 1;
+        }
+        return RunReplayBenchmark(*recording, out, CHANGE_DETECTION_TILE_SIZE, MIN_CHANGED_TILES_FOR_OCR) ? 0 : 1;
+    } else {
+        out << "Unknown benchmark: " << *benchmark << "\n";
+        return 1;
+    }
+    return 0;
+}
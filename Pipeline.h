@@ -0,0 +1,207 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <utility>
+
+// --- Latest-Wins Queue ---
+
+// Bounded hand-off between pipeline stages. When full, Push drops the oldest item instead of
+// blocking the producer, so a slow consumer always sees the most recent frames.
+template <class T>
+class LatestWinsQueue {
+public:
+    explicit LatestWinsQueue(size_t capacity = 1) : capacity_(capacity ? capacity : 1) {}
+
+    // Returns the number of stale items dropped to make room (0 or 1).
+    size_t Push(T item) {
+        size_t dropped = 0;
+        {
+            std::lock_guard lock(mutex_);
+            if (items_.size() >= capacity_) {
+                items_.pop_front();
+                dropped = 1;
+                ++dropped_total_;
+            }
+            items_.push_back(std::move(item));
+        }
+        ready_.notify_one();
+        return dropped;
+    }
+
+    // Blocks until an item is available; returns nullopt once `stop` is requested.
+    std::optional<T> Pop(std::stop_token stop) {
+        std::unique_lock lock(mutex_);
+        if (!ready_.wait(lock, stop, [&] { return !items_.empty(); })) return std::nullopt;
+        T item = std::move(items_.front());
+        items_.pop_front();
+        return item;
+    }
+
+    std::optional<T> TryPop() {
+        std::lock_guard lock(mutex_);
+        if (items_.empty()) return std::nullopt;
+        T item = std::move(items_.front());
+        items_.pop_front();
+        return item;
+    }
+
+    size_t size() const {
+        std::lock_guard lock(mutex_);
+        return items_.size();
+    }
+
+    uint64_t dropped_total() const {
+        std::lock_guard lock(mutex_);
+        return dropped_total_;
+    }
+
+private:
+    size_t capacity_;
+    mutable std::mutex mutex_;
+    std::condition_variable_any ready_;
+    std::deque<T> items_;
+    uint64_t dropped_total_ = 0;
+};
+
+// Sleeps for `duration` unless `stop` is requested first. Returns false if woken by stop.
+inline bool InterruptibleSleep(std::stop_token stop, std::chrono::milliseconds duration) {
+    std::mutex mutex;
+    std::condition_variable_any wake;
+    std::unique_lock lock(mutex);
+    wake.wait_for(lock, stop, duration, [] { return false; });
+    return !stop.stop_requested();
+}
+
+// --- Pipeline Stage ---
+
+struct PipelineStageStats {
+    uint64_t processed = 0;
+    uint64_t dropped = 0;
+    uint64_t superseded = 0;
+};
+
+// One worker thread draining a LatestWinsQueue. The handler receives a stop_token that fires when
+// the pipeline shuts down and, if `cancel_superseded` is set, as soon as a newer item is pushed
+// while the current one is still being processed. Long-running handlers poll it and bail out so
+// the worker can move on to the newer input.
+template <class In>
+class PipelineStage {
+public:
+    using Handler = std::function<void(In&&, std::stop_token)>;
+
+    struct Options {
+        size_t capacity = 1;
+        bool cancel_superseded = false;
+        // Run on the worker thread around the processing loop (e.g. COM apartment setup).
+        std::function<void()> on_thread_start = {};
+        std::function<void()> on_thread_exit = {};
+    };
+
+    PipelineStage(std::string name, Handler handler, Options options = {})
+        : name_(std::move(name)), handler_(std::move(handler)), options_(std::move(options)),
+          queue_(options_.capacity) {}
+
+    ~PipelineStage() { Stop(); }
+
+    PipelineStage(const PipelineStage&) = delete;
+    PipelineStage& operator=(const PipelineStage&) = delete;
+
+    void Start() {
+        if (worker_.joinable()) return;
+        worker_ = std::jthread([this](std::stop_token stop) { Run(stop); });
+    }
+
+    // Requests shutdown, cancels the in-flight item and joins the worker.
+    void Stop() {
+        if (!worker_.joinable()) return;
+        worker_.request_stop();
+        worker_.join();
+    }
+
+    void Push(In item) {
+        uint64_t generation = ++pushed_generation_;
+        if (queue_.Push(Item{ std::move(item), generation })) ++dropped_;
+        if (!options_.cancel_superseded) return;
+
+        std::lock_guard lock(job_mutex_);
+        if (job_active_ && job_generation_ < generation) {
+            job_source_.request_stop();
+        }
+    }
+
+    PipelineStageStats Stats() const {
+        return { processed_.load(), dropped_.load(), superseded_.load() };
+    }
+
+    const std::string& name() const { return name_; }
+
+private:
+    struct Item {
+        In value;
+        uint64_t generation;
+    };
+
+    void Run(std::stop_token stop) {
+        if (options_.on_thread_start) options_.on_thread_start();
+        while (auto item = queue_.Pop(stop)) {
+            std::stop_token job_token;
+            {
+                // A Push that landed between Pop and here already superseded this item.
+                std::lock_guard lock(job_mutex_);
+                job_source_ = std::stop_source();
+                job_generation_ = item->generation;
+                job_active_ = true;
+                if (options_.cancel_superseded && pushed_generation_.load() > item->generation) {
+                    job_source_.request_stop();
+                }
+                job_token = job_source_.get_token();
+            }
+            std::stop_callback forward_shutdown(stop, [this] {
+                std::lock_guard lock(job_mutex_);
+                job_source_.request_stop();
+            });
+
+            handler_(std::move(item->value), job_token);
+
+            {
+                std::lock_guard lock(job_mutex_);
+                job_active_ = false;
+            }
+            if (job_token.stop_requested() && !stop.stop_requested()) {
+                ++superseded_;
+            } else {
+                ++processed_;
+            }
+        }
+        if (options_.on_thread_exit) options_.on_thread_exit();
+    }
+
+    std::string name_;
+    Handler handler_;
+    Options options_;
+    LatestWinsQueue<Item> queue_;
+
+    std::mutex job_mutex_;
+    std::stop_source job_source_;
+    uint64_t job_generation_ = 0;
+    bool job_active_ = false;
+
+    std::atomic<uint64_t> pushed_generation_{ 0 };
+    std::atomic<uint64_t> processed_{ 0 };
+    std::atomic<uint64_t> dropped_{ 0 };
+    std::atomic<uint64_t> superseded_{ 0 };
+
+    // Declared last so the worker is joined before the members it uses are destroyed.
+    std::jthread worker_;
+};
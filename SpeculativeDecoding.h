@@ -0,0 +1,201 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stop_token>
+#include <utility>
+#include <vector>
+
+// --- Speculative Decoding ---
+
+constexpr float SPECULATIVE_MIN_MARGIN = 1e-2f; // of the winning logit's magnitude
+
+struct SpeculativeStats {
+    std::atomic<uint64_t> requests{ 0 };
+    std::atomic<uint64_t> verify_passes{ 0 };  // decoder runs that checked draft tokens
+    std::atomic<uint64_t> single_steps{ 0 };   // decoder runs without any
+    std::atomic<uint64_t> drafted_tokens{ 0 };
+    std::atomic<uint64_t> accepted_tokens{ 0 };
+    std::atomic<uint64_t> exact_reruns{ 0 };   // positions settled by going back to the checkpoint
+};
+
+// Greedy pick from one position's logits, and whether it wins by enough that the rounding
+// differences between a multi-token run and a single-token one could not have changed it.
+inline std::pair<int32_t, bool> DecisiveArgmax(const float* logits, int64_t vocab_size) {
+    int64_t best = 0;
+    float best_value = logits[0];
+    float runner_up = -std::numeric_limits<float>::infinity();
+    for (int64_t v = 1; v < vocab_size; ++v) {
+        if (logits[v] > best_value) {
+            runner_up = best_value;
+            best_value = logits[v];
+            best = v;
+        } else if (logits[v] > runner_up) {
+            runner_up = logits[v];
+        }
+    }
+    bool decisive = best_value - runner_up > SPECULATIVE_MIN_MARGIN * (std::max)(1.0f, std::fabs(best_value));
+    return { static_cast<int32_t>(best), decisive };
+}
+
+// Where `output` continues in `draft`: just past the first occurrence, at or after `from`, of the
+// output's last two tokens (its only token, early on). SIZE_MAX once the output has left the draft,
+// e.g. inside an inserted phrase; a later call finds the draft again where the two meet up.
+inline size_t FindDraftContinuation(const std::vector<int32_t>& draft, const std::vector<int32_t>& output, size_t from) {
+    if (output.empty()) return 0;
+    size_t n = (std::min)(output.size(), size_t{ 2 });
+    for (size_t position = (std::max)(from, n); position <= draft.size(); ++position) {
+        if (std::equal(output.end() - static_cast<std::ptrdiff_t>(n), output.end(),
+            draft.begin() + static_cast<std::ptrdiff_t>(position - n))) {
+            return position;
+        }
+    }
+    return SIZE_MAX;
+}
+
+// The decoder as DecodeWithDraft drives it, for one segment. Runs extend a working self-attention
+// cache; a checkpoint keeps an earlier state of it so decoding can go back there.
+class DraftDecoder {
+public:
+    virtual ~DraftDecoder() = default;
+
+    // Runs the decoder once over `tokens`, after the tokens already in the working cache, and adds
+    // them to it. Logits(i) is then the distribution over the token that follows tokens[i], valid
+    // until the next call.
+    virtual void Run(const std::vector<int32_t>& tokens) = 0;
+    virtual const float* Logits(size_t i) = 0;
+    virtual int64_t VocabSize() const = 0;
+    // Keeps only the first `length` tokens of the working cache.
+    virtual void Truncate(size_t length) = 0;
+    // Keeps the working cache as it is now as the checkpoint, replacing any earlier one.
+    virtual void Checkpoint() = 0;
+    // Makes the checkpoint the working cache again.
+    virtual void Restore() = 0;
+};
+
+struct DraftOptions {
+    int32_t bos_token;
+    int32_t eos_token;
+    size_t max_tokens;
+    size_t max_block; // draft tokens checked per run; 0 decodes one token per run
+};
+
+// Greedy decoding of one segment that checks a draft of the answer, typically the translation of
+// a similar line from the previous OCR pass, up to max_block tokens per decoder run. The draft
+// tokens are fed after the pending token and each is kept while it is what greedy decoding picks
+// at its position; the first disagreement contributes the model's own pick, and the cache is cut
+// back to the kept tokens.
+//
+// A multi-token run rounds differently from the single-token runs of plain greedy decoding, and
+// so does every run on a cache it wrote. Picks from such runs only count when DecisiveArgmax
+// vouches for them. Any other position is settled the way plain greedy decoding reaches it: back
+// to the checkpoint, which holds only single-token runs, then one single-token run per token since
+// (replacing any kept pick they disagree with) and one for the position itself. Returns false when
+// `stop` is requested between runs; exceptions from the decoder propagate.
+inline bool DecodeWithDraft(DraftDecoder& decoder, const std::vector<int32_t>& draft, std::vector<int32_t>& output_tokens,
+    const DraftOptions& options, SpeculativeStats& stats, std::stop_token stop = {},
+    const std::function<void(const std::vector<int32_t>&)>& on_tokens = {}) {
+    ++stats.requests;
+    output_tokens.clear();
+    // Every token so far, BOS first; all but the last one are in the working cache.
+    std::vector<int32_t> sequence = { options.bos_token };
+    std::vector<int32_t> input_ids;
+    size_t draft_from = 0;
+    bool allow_draft = options.max_block > 0;
+    // Whether only single-token runs built the working cache. Once a multi-token run extends it,
+    // the checkpoint holds the first `checked_length` tokens of `sequence` as they were built.
+    bool working_checked = true;
+    size_t checked_length = 0;
+
+    auto emit = [&] {
+        if (on_tokens) on_tokens(output_tokens);
+    };
+
+    while (output_tokens.size() < options.max_tokens) {
+        if (stop.stop_requested()) return false;
+
+        size_t block_begin = 0;
+        size_t block_size = 0;
+        if (allow_draft) {
+            size_t position = FindDraftContinuation(draft, output_tokens, draft_from);
+            if (position != SIZE_MAX) {
+                draft_from = position;
+                block_begin = position;
+                block_size = (std::min)({ options.max_block, draft.size() - position, options.max_tokens - output_tokens.size() - 1 });
+            }
+        }
+        allow_draft = options.max_block > 0;
+
+        if (block_size > 0 && working_checked) {
+            decoder.Checkpoint();
+            checked_length = sequence.size() - 1;
+            working_checked = false;
+        }
+        input_ids.assign(1, sequence.back());
+        auto block = draft.begin() + static_cast<std::ptrdiff_t>(block_begin);
+        input_ids.insert(input_ids.end(), block, block + static_cast<std::ptrdiff_t>(block_size));
+        decoder.Run(input_ids);
+        ++(block_size ? stats.verify_passes : stats.single_steps);
+        stats.drafted_tokens += block_size;
+
+        // Position i of the run predicts the token after input i, counted from the pending token.
+        size_t length_before = sequence.size();
+        size_t accepted = 0;
+        bool finished = false;
+        bool unsettled = false;
+        for (size_t i = 0; i <= block_size; ++i) {
+            auto [token, decisive] = DecisiveArgmax(decoder.Logits(i), decoder.VocabSize());
+            // A single-token run on a checked cache is exactly what plain greedy decoding runs.
+            if (!working_checked && !decisive) {
+                unsettled = true;
+                break;
+            }
+            if (token == options.eos_token) {
+                finished = true;
+                break;
+            }
+            output_tokens.push_back(token);
+            sequence.push_back(token);
+            if (i == block_size || token != block[static_cast<std::ptrdiff_t>(i)]) break;
+            ++accepted;
+        }
+        stats.accepted_tokens += accepted;
+        if (sequence.size() > length_before) emit();
+        if (finished) return true;
+        if (!unsettled) {
+            decoder.Truncate(sequence.size() - 1);
+            continue;
+        }
+
+        // Replay from the checkpoint one token at a time. The pending position then gets its own
+        // single-token run on the next pass.
+        ++stats.exact_reruns;
+        decoder.Restore();
+        working_checked = true;
+        allow_draft = false;
+        for (size_t position = checked_length; position + 1 < sequence.size(); ++position) {
+            input_ids.assign(1, sequence[position]);
+            decoder.Run(input_ids);
+            ++stats.single_steps;
+            int32_t token = DecisiveArgmax(decoder.Logits(0), decoder.VocabSize()).first;
+            if (token == sequence[position + 1]) continue;
+            // Rounding did change a kept pick after all; greedy decoding goes on from this one.
+            sequence.resize(position + 1);
+            output_tokens.resize(position);
+            if (token == options.eos_token) {
+                emit();
+                return true;
+            }
+            sequence.push_back(token);
+            output_tokens.push_back(token);
+            emit();
+            break;
+        }
+    }
+    return true;
+}
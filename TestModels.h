@@ -0,0 +1,360 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// --- Protocol Buffers Writer ---
+
+// Just enough of the protobuf wire format to write ONNX and SentencePiece models without either
+// library: varints, length-delimited fields and 32-bit floats.
+class ProtoWriter {
+public:
+    void Varint(uint32_t field, uint64_t value) {
+        Tag(field, 0);
+        Raw(value);
+    }
+
+    // int32 and int64 fields: negative values take ten bytes, as in the reference encoder.
+    void Int(uint32_t field, int64_t value) { Varint(field, static_cast<uint64_t>(value)); }
+
+    void Float(uint32_t field, float value) {
+        Tag(field, 5);
+        char bytes[sizeof(value)];
+        std::memcpy(bytes, &value, sizeof(value));
+        bytes_.append(bytes, sizeof(bytes));
+    }
+
+    void Bytes(uint32_t field, std::string_view value) {
+        Tag(field, 2);
+        Raw(value.size());
+        bytes_.append(value);
+    }
+
+    void Message(uint32_t field, const ProtoWriter& message) { Bytes(field, message.bytes_); }
+
+    const std::string& bytes() const { return bytes_; }
+
+private:
+    void Tag(uint32_t field, uint32_t wire_type) { Raw(static_cast<uint64_t>(field) << 3 | wire_type); }
+
+    void Raw(uint64_t value) {
+        do {
+            uint8_t byte = value & 0x7F;
+            value >>= 7;
+            bytes_.push_back(static_cast<char>(value ? byte | 0x80 : byte));
+        } while (value);
+    }
+
+    std::string bytes_;
+};
+
+// --- ONNX Graph Builder ---
+
+namespace onnx_proto {
+
+constexpr int32_t FLOAT = 1;
+constexpr int32_t INT32 = 6;
+constexpr int32_t INT64 = 7;
+
+// A dimension: a fixed size, or a symbolic one when `name` is set.
+struct Dim {
+    int64_t size = 0;
+    std::string name = {};
+};
+
+struct Attribute {
+    std::string name;
+    std::vector<int64_t> ints; // an INT attribute when `list` is false
+    bool list = false;
+};
+
+// A graph in the order ONNX wants it written: nodes topologically sorted, weights as initializers.
+class Graph {
+public:
+    explicit Graph(std::string name) : name_(std::move(name)) {}
+
+    void Input(const std::string& name, int32_t type, const std::vector<Dim>& dims) { inputs_.push_back(ValueInfo(name, type, dims)); }
+    void Output(const std::string& name, int32_t type, const std::vector<Dim>& dims) { outputs_.push_back(ValueInfo(name, type, dims)); }
+
+    void Floats(const std::string& name, const std::vector<int64_t>& dims, const std::vector<float>& values) {
+        Initializer(name, dims, FLOAT, std::string_view(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(float)));
+    }
+
+    void Int64s(const std::string& name, const std::vector<int64_t>& dims, const std::vector<int64_t>& values) {
+        Initializer(name, dims, INT64, std::string_view(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(int64_t)));
+    }
+
+    void Node(const std::string& op, const std::vector<std::string>& inputs, const std::string& output,
+        const std::vector<Attribute>& attributes = {}) {
+        ProtoWriter node;
+        for (const auto& input : inputs) node.Bytes(1, input);
+        node.Bytes(2, output);
+        node.Bytes(3, output); // named after its output, which is unique
+        node.Bytes(4, op);
+        for (const auto& attribute : attributes) {
+            ProtoWriter written;
+            written.Bytes(1, attribute.name);
+            if (attribute.list) {
+                for (int64_t value : attribute.ints) written.Int(8, value);
+                written.Varint(20, 7); // INTS
+            } else {
+                written.Int(3, attribute.ints.at(0));
+                written.Varint(20, 2); // INT
+            }
+            node.Message(5, written);
+        }
+        nodes_.push_back(std::move(node));
+    }
+
+    // ModelProto at IR version 7 and opset 13, whose Squeeze and Unsqueeze take axes as an input
+    // and ReduceMean as an attribute.
+    std::string Serialize() const {
+        ProtoWriter graph;
+        for (const auto& node : nodes_) graph.Message(1, node);
+        graph.Bytes(2, name_);
+        for (const auto& initializer : initializers_) graph.Message(5, initializer);
+        for (const auto& input : inputs_) graph.Message(11, input);
+        for (const auto& output : outputs_) graph.Message(12, output);
+
+        ProtoWriter opset;
+        opset.Bytes(1, "");
+        opset.Int(2, 13);
+        ProtoWriter model;
+        model.Int(1, 7);
+        model.Bytes(2, "OfflineScreenLance test models");
+        model.Message(7, graph);
+        model.Message(8, opset);
+        return model.bytes();
+    }
+
+private:
+    static ProtoWriter ValueInfo(const std::string& name, int32_t type, const std::vector<Dim>& dims) {
+        ProtoWriter shape;
+        for (const auto& dim : dims) {
+            ProtoWriter written;
+            if (dim.name.empty()) {
+                written.Int(1, dim.size);
+            } else {
+                written.Bytes(2, dim.name);
+            }
+            shape.Message(1, written);
+        }
+        ProtoWriter tensor_type;
+        tensor_type.Int(1, type);
+        tensor_type.Message(2, shape);
+        ProtoWriter value_type;
+        value_type.Message(1, tensor_type);
+        ProtoWriter value_info;
+        value_info.Bytes(1, name);
+        value_info.Message(2, value_type);
+        return value_info;
+    }
+
+    void Initializer(const std::string& name, const std::vector<int64_t>& dims, int32_t type, std::string_view data) {
+        ProtoWriter tensor;
+        for (int64_t dim : dims) tensor.Int(1, dim);
+        tensor.Int(2, type);
+        tensor.Bytes(8, name);
+        tensor.Bytes(9, data);
+        initializers_.push_back(std::move(tensor));
+    }
+
+    std::string name_;
+    std::vector<ProtoWriter> nodes_, initializers_, inputs_, outputs_;
+};
+
+} // namespace onnx_proto
+
+// --- Test Models ---
+
+// A tiny stand-in for an Optimum MarianMT export, for running the engine and its benchmarks where
+// no real model can be downloaded: same file names, inputs and outputs (encoder, first-step
+// decoder and KV-cache step decoder), random but fixed weights, and a SentencePiece vocabulary of
+// ASCII characters and common English words. One attention layer and a hidden size of
+// TEST_MODEL_HIDDEN_SIZE keep every graph well under a megabyte. Its translations are nonsense of
+// a realistic length: the EOS logit grows with the output, so decoding stops within a few dozen
+// tokens. Token ids follow the engine's: 0 pad and decoder start, 1 unknown, 2 EOS.
+constexpr int64_t TEST_MODEL_HIDDEN_SIZE = 64;
+
+// Pieces in id order, with their unigram scores; control and unknown pieces score 0.
+inline std::vector<std::pair<std::string, float>> TestModelVocabulary() {
+    std::vector<std::pair<std::string, float>> pieces = { { "<pad>", 0.0f }, { "<unk>", 0.0f }, { "</s>", 0.0f } };
+    const std::string space = "\xE2\x96\x81"; // U+2581, SentencePiece's word boundary
+    for (const char* word : { "the", "a", "to", "of", "and", "in", "is", "you", "it", "that", "for", "on", "with", "your",
+             "quest", "item", "save", "game", "press", "start", "level", "new", "options", "continue" }) {
+        pieces.emplace_back(space + word, -3.0f);
+    }
+    pieces.emplace_back(space, -4.0f);
+    for (char c = 'a'; c <= 'z'; ++c) pieces.emplace_back(std::string(1, c), -5.0f);
+    for (char c = 'A'; c <= 'Z'; ++c) pieces.emplace_back(std::string(1, c), -6.0f);
+    for (char c = '0'; c <= '9'; ++c) pieces.emplace_back(std::string(1, c), -6.0f);
+    for (char c : std::string_view(".,!?'\"-:;()/%&+")) pieces.emplace_back(std::string(1, c), -6.0f);
+    return pieces;
+}
+
+// SentencePiece ModelProto for a unigram model over TestModelVocabulary, with identity
+// normalization.
+inline std::string SerializeTestSentencePieceModel() {
+    ProtoWriter model;
+    auto pieces = TestModelVocabulary();
+    for (size_t id = 0; id < pieces.size(); ++id) {
+        ProtoWriter piece;
+        piece.Bytes(1, pieces[id].first);
+        piece.Float(2, pieces[id].second);
+        piece.Varint(3, id == 1 ? 2 : id < 3 ? 3 : 1); // UNKNOWN, CONTROL, NORMAL
+        model.Message(1, piece);
+    }
+    ProtoWriter trainer;
+    trainer.Varint(3, 1); // UNIGRAM
+    trainer.Int(4, static_cast<int64_t>(pieces.size()));
+    trainer.Int(40, 1);  // unk_id
+    trainer.Int(41, -1); // bos_id: the decoder start is fed by the engine, never encoded
+    trainer.Int(42, 2);  // eos_id
+    trainer.Int(43, 0);  // pad_id
+    model.Message(2, trainer);
+    ProtoWriter normalizer;
+    normalizer.Bytes(1, "identity");
+    normalizer.Varint(3, 1); // add_dummy_prefix
+    normalizer.Varint(4, 1); // remove_extra_whitespaces
+    normalizer.Varint(5, 1); // escape_whitespaces
+    model.Message(3, normalizer);
+    return model.bytes();
+}
+
+// Uniform weights in [-scale, scale] from a fixed linear congruential sequence, so the models are
+// byte-identical on every machine.
+inline std::vector<float> TestModelWeights(size_t count, float scale, uint32_t seed) {
+    std::vector<float> weights(count);
+    uint32_t state = seed * 2654435761u + 1;
+    for (auto& weight : weights) {
+        state = state * 1664525u + 1013904223u;
+        weight = (static_cast<float>(state >> 8) / static_cast<float>(1u << 24) * 2.0f - 1.0f) * scale;
+    }
+    return weights;
+}
+
+// Encoder: embeddings through one projection and tanh, with padding positions zeroed.
+inline std::string SerializeTestEncoder(int64_t vocab_size) {
+    const int64_t hidden = TEST_MODEL_HIDDEN_SIZE;
+    onnx_proto::Graph graph("encoder");
+    graph.Input("input_ids", onnx_proto::INT32, { { 0, "batch_size" }, { 0, "encoder_sequence_length" } });
+    graph.Input("attention_mask", onnx_proto::INT64, { { 0, "batch_size" }, { 0, "encoder_sequence_length" } });
+    graph.Output("last_hidden_state", onnx_proto::FLOAT, { { 0, "batch_size" }, { 0, "encoder_sequence_length" }, { hidden } });
+    graph.Floats("embedding", { vocab_size, hidden }, TestModelWeights(static_cast<size_t>(vocab_size * hidden), 1.0f, 1));
+    graph.Floats("projection", { hidden, hidden }, TestModelWeights(static_cast<size_t>(hidden * hidden), 0.2f, 2));
+    graph.Int64s("last_axis", { 1 }, { 2 });
+    graph.Node("Gather", { "embedding", "input_ids" }, "embedded");
+    graph.Node("MatMul", { "embedded", "projection" }, "projected");
+    graph.Node("Tanh", { "projected" }, "activated");
+    graph.Node("Cast", { "attention_mask" }, "mask", { { "to", { onnx_proto::FLOAT } } });
+    graph.Node("Unsqueeze", { "mask", "last_axis" }, "mask_3d");
+    graph.Node("Mul", { "activated", "mask_3d" }, "last_hidden_state");
+    return graph.Serialize();
+}
+
+// Decoder: one single-head self-attention layer over the tokens so far plus the mean encoder
+// state, projected to logits. The first-step graph takes the whole prefix and returns the
+// self-attention keys and values as present.0.decoder.*; with `with_past` it takes one token and
+// those caches as past_key_values.0.decoder.* and returns them one longer.
+inline std::string SerializeTestDecoder(int64_t vocab_size, bool with_past) {
+    const int64_t hidden = TEST_MODEL_HIDDEN_SIZE;
+    onnx_proto::Graph graph(with_past ? "decoder_with_past" : "decoder");
+    onnx_proto::Dim batch{ 0, "batch_size" };
+    onnx_proto::Dim length = with_past ? onnx_proto::Dim{ 1 } : onnx_proto::Dim{ 0, "decoder_sequence_length" };
+    onnx_proto::Dim past{ 0, "past_decoder_sequence_length" };
+    onnx_proto::Dim present{ 0, with_past ? "past_decoder_sequence_length + 1" : "decoder_sequence_length" };
+    graph.Input("input_ids", onnx_proto::INT32, { batch, length });
+    graph.Input("encoder_hidden_states", onnx_proto::FLOAT, { batch, { 0, "encoder_sequence_length" }, { hidden } });
+    if (with_past) {
+        graph.Input("past_key_values.0.decoder.key", onnx_proto::FLOAT, { batch, { 1 }, past, { hidden } });
+        graph.Input("past_key_values.0.decoder.value", onnx_proto::FLOAT, { batch, { 1 }, past, { hidden } });
+    }
+    graph.Output("logits", onnx_proto::FLOAT, { batch, length, { vocab_size } });
+    graph.Output("present.0.decoder.key", onnx_proto::FLOAT, { batch, { 1 }, present, { hidden } });
+    graph.Output("present.0.decoder.value", onnx_proto::FLOAT, { batch, { 1 }, present, { hidden } });
+
+    // Both graphs share their weights, so cached and uncached decoding agree.
+    std::vector<float> eos_growth(static_cast<size_t>(vocab_size), 0.0f);
+    eos_growth[2] = 0.15f;
+    graph.Floats("embedding", { vocab_size, hidden }, TestModelWeights(static_cast<size_t>(vocab_size * hidden), 1.0f, 3));
+    graph.Floats("query", { hidden, hidden }, TestModelWeights(static_cast<size_t>(hidden * hidden), 0.2f, 4));
+    graph.Floats("key", { hidden, hidden }, TestModelWeights(static_cast<size_t>(hidden * hidden), 0.2f, 5));
+    graph.Floats("value", { hidden, hidden }, TestModelWeights(static_cast<size_t>(hidden * hidden), 0.2f, 6));
+    graph.Floats("output", { hidden, vocab_size }, TestModelWeights(static_cast<size_t>(hidden * vocab_size), 0.9f, 7));
+    graph.Floats("eos_growth", { vocab_size }, eos_growth);
+    graph.Floats("attention_scale", {}, { 1.0f / std::sqrt(static_cast<float>(hidden)) });
+    graph.Int64s("head_axis", { 1 }, { 1 });
+    graph.Int64s("sequence_axis", {}, { 1 });
+    graph.Int64s("past_axis", {}, { 2 });
+    graph.Int64s("one", {}, { 1 });
+
+    graph.Node("Gather", { "embedding", "input_ids" }, "embedded");
+    graph.Node("MatMul", { "embedded", "query" }, "queries");
+    graph.Node("MatMul", { "embedded", "key" }, "keys");
+    graph.Node("MatMul", { "embedded", "value" }, "values");
+    graph.Node("Unsqueeze", { "queries", "head_axis" }, "queries_4d");
+    const char* key_cache = "present.0.decoder.key";
+    const char* value_cache = "present.0.decoder.value";
+    if (with_past) {
+        graph.Node("Unsqueeze", { "keys", "head_axis" }, "keys_4d");
+        graph.Node("Unsqueeze", { "values", "head_axis" }, "values_4d");
+        graph.Node("Concat", { "past_key_values.0.decoder.key", "keys_4d" }, key_cache, { { "axis", { 2 } } });
+        graph.Node("Concat", { "past_key_values.0.decoder.value", "values_4d" }, value_cache, { { "axis", { 2 } } });
+    } else {
+        graph.Node("Unsqueeze", { "keys", "head_axis" }, key_cache);
+        graph.Node("Unsqueeze", { "values", "head_axis" }, value_cache);
+    }
+    graph.Node("Transpose", { key_cache }, "keys_transposed", { { "perm", { 0, 1, 3, 2 }, true } });
+    graph.Node("MatMul", { "queries_4d", "keys_transposed" }, "scores");
+    graph.Node("Mul", { "scores", "attention_scale" }, "scaled_scores");
+    graph.Node("Softmax", { "scaled_scores" }, "weights", { { "axis", { -1 } } });
+    graph.Node("MatMul", { "weights", value_cache }, "attended_4d");
+    graph.Node("Squeeze", { "attended_4d", "head_axis" }, "attended");
+    graph.Node("ReduceMean", { "encoder_hidden_states" }, "context", { { "axes", { 1 }, true }, { "keepdims", { 1 } } });
+    graph.Node("Add", { "embedded", "attended" }, "residual");
+    graph.Node("Add", { "residual", "context" }, "combined");
+    graph.Node("Tanh", { "combined" }, "hidden");
+    graph.Node("MatMul", { "hidden", "output" }, "scores_per_token");
+
+    // The output length so far: the prefix, or the cache plus the new token.
+    if (with_past) {
+        graph.Node("Shape", { "past_key_values.0.decoder.key" }, "past_shape");
+        graph.Node("Gather", { "past_shape", "past_axis" }, "past_length");
+        graph.Node("Add", { "past_length", "one" }, "output_length");
+    } else {
+        graph.Node("Shape", { "input_ids" }, "input_shape");
+        graph.Node("Gather", { "input_shape", "sequence_axis" }, "output_length");
+    }
+    graph.Node("Cast", { "output_length" }, "output_length_float", { { "to", { onnx_proto::FLOAT } } });
+    graph.Node("Mul", { "eos_growth", "output_length_float" }, "eos_bias");
+    graph.Node("Add", { "scores_per_token", "eos_bias" }, "logits");
+    return graph.Serialize();
+}
+
+// Writes encoder_model.onnx, decoder_model.onnx, decoder_with_past_model.onnx, source.spm and
+// target.spm into `directory`. False if any of them couldn't be written.
+inline bool WriteTestModels(const std::filesystem::path& directory) {
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    auto vocab_size = static_cast<int64_t>(TestModelVocabulary().size());
+    auto spm = SerializeTestSentencePieceModel();
+    std::pair<const char*, std::string> files[] = {
+        { "encoder_model.onnx", SerializeTestEncoder(vocab_size) },
+        { "decoder_model.onnx", SerializeTestDecoder(vocab_size, false) },
+        { "decoder_with_past_model.onnx", SerializeTestDecoder(vocab_size, true) },
+        { "source.spm", spm },
+        { "target.spm", spm },
+    };
+    for (const auto& [name, bytes] : files) {
+        std::ofstream file(directory / name, std::ios::binary | std::ios::trunc);
+        file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        if (!file) return false;
+    }
+    return true;
+}
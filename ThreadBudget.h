@@ -0,0 +1,113 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <vector>
+
+// --- CPU Selection ---
+
+enum class CorePreference {
+    Any,         // every CPU; efficient cores go to background work first when the budget shrinks
+    Efficiency,  // only the lowest efficiency class (E-cores on hybrid CPUs)
+    Performance  // only the highest efficiency class (P-cores)
+};
+
+inline const char* CorePreferenceName(CorePreference preference) {
+    switch (preference) {
+    case CorePreference::Efficiency: return "efficiency";
+    case CorePreference::Performance: return "performance";
+    default: return "any";
+    }
+}
+
+// One logical processor. SMT siblings share `core`; a higher `efficiency_class` is a faster,
+// hungrier core. Non-hybrid CPUs report a single class.
+struct LogicalCpu {
+    uint32_t id = 0;
+    int core = 0;
+    int efficiency_class = 0;
+};
+
+// The CPUs background work may use under `preference`, in the order a budget takes them: lower
+// efficiency classes first, and one logical CPU per physical core before any SMT sibling, so a
+// budget of N spreads over N cores.
+inline std::vector<LogicalCpu> OrderCpusForBudget(const std::vector<LogicalCpu>& cpus, CorePreference preference) {
+    if (cpus.empty()) return {};
+    auto by_class = [](const LogicalCpu& a, const LogicalCpu& b) { return a.efficiency_class < b.efficiency_class; };
+    int lowest = std::min_element(cpus.begin(), cpus.end(), by_class)->efficiency_class;
+    int highest = std::max_element(cpus.begin(), cpus.end(), by_class)->efficiency_class;
+
+    struct Ranked {
+        LogicalCpu cpu;
+        int sibling; // 0 for the first logical CPU seen on its core
+    };
+    std::vector<Ranked> ranked;
+    std::map<int, int> seen_per_core;
+    for (const auto& cpu : cpus) {
+        if (preference == CorePreference::Efficiency && cpu.efficiency_class != lowest) continue;
+        if (preference == CorePreference::Performance && cpu.efficiency_class != highest) continue;
+        ranked.push_back({ cpu, seen_per_core[cpu.core]++ });
+    }
+    std::stable_sort(ranked.begin(), ranked.end(), [](const Ranked& a, const Ranked& b) {
+        if (a.cpu.efficiency_class != b.cpu.efficiency_class) return a.cpu.efficiency_class < b.cpu.efficiency_class;
+        return a.sibling < b.sibling;
+    });
+
+    std::vector<LogicalCpu> ordered;
+    ordered.reserve(ranked.size());
+    for (const auto& entry : ranked) ordered.push_back(entry.cpu);
+    return ordered;
+}
+
+inline int CountPhysicalCores(const std::vector<LogicalCpu>& cpus) {
+    std::set<int> cores;
+    for (const auto& cpu : cpus) cores.insert(cpu.core);
+    return static_cast<int>(cores.size());
+}
+
+// --- Thread Budget Policy ---
+
+// How many CPUs background work may use while the foreground application is busy. The budget
+// shrinks as soon as the foreground needs more room and grows back one CPU at a time, only after
+// the load has stayed low for a few samples, so loading spikes in a game don't make it flap.
+class ThreadBudgetPolicy {
+public:
+    static constexpr double HEADROOM_CPUS = 1.0;  // kept free on top of what the foreground used
+    static constexpr int GROW_AFTER_SAMPLES = 3;
+
+    ThreadBudgetPolicy() = default;
+
+    // `total_cpus` is every logical CPU in the machine; the budget stays within [min_cpus, max_cpus].
+    ThreadBudgetPolicy(int min_cpus, int max_cpus, int total_cpus)
+        : min_cpus_((std::max)(min_cpus, 1)), max_cpus_((std::max)(max_cpus, min_cpus_)),
+          total_cpus_(total_cpus), budget_(max_cpus_) {}
+
+    // `foreground_cpus` is how many cores' worth of CPU time the foreground application used over
+    // the last sample period. Returns the new budget.
+    int Update(double foreground_cpus) {
+        int wanted = total_cpus_ - static_cast<int>(std::ceil((std::max)(foreground_cpus, 0.0) + HEADROOM_CPUS));
+        wanted = std::clamp(wanted, min_cpus_, max_cpus_);
+        if (wanted < budget_) {
+            budget_ = wanted;
+            calm_samples_ = 0;
+        } else if (wanted > budget_ && ++calm_samples_ >= GROW_AFTER_SAMPLES) {
+            ++budget_;
+            calm_samples_ = 0;
+        } else if (wanted == budget_) {
+            calm_samples_ = 0;
+        }
+        return budget_;
+    }
+
+    int budget() const { return budget_; }
+
+private:
+    int min_cpus_ = 1;
+    int max_cpus_ = 1;
+    int total_cpus_ = 1;
+    int budget_ = 1;
+    int calm_samples_ = 0;
+};
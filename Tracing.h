@@ -0,0 +1,246 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Benchmarks.h"
+
+// --- Trace Buffers ---
+
+// One completed span. `name` must be a string literal (or otherwise outlive the tracer).
+struct TraceEvent {
+    const char* name = nullptr;
+    int64_t start_ns = 0;
+    int64_t duration_ns = 0;
+};
+
+// Ring of the most recent spans of one thread. Only that thread appends, without locks or
+// allocation; any thread may take a Snapshot at any time. Slots are written with relaxed atomics
+// between two counters, seqlock style, so a reader can tell which slots the writer reused while
+// they were being copied and drop them.
+class TraceBuffer {
+public:
+    static constexpr size_t CAPACITY = size_t{ 1 } << 14;
+
+    TraceBuffer(uint32_t thread_id, std::string thread_name) : thread_id_(thread_id), thread_name_(std::move(thread_name)) {}
+
+    void Append(const char* name, int64_t start_ns, int64_t duration_ns) {
+        uint64_t index = written_.load(std::memory_order_relaxed);
+        claimed_.store(index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        auto& slot = slots_[index & (CAPACITY - 1)];
+        slot.name.store(name, std::memory_order_relaxed);
+        slot.start_ns.store(start_ns, std::memory_order_relaxed);
+        slot.duration_ns.store(duration_ns, std::memory_order_relaxed);
+        written_.store(index + 1, std::memory_order_release);
+    }
+
+    // Events still in the ring, oldest first.
+    std::vector<TraceEvent> Snapshot() const {
+        uint64_t end = written_.load(std::memory_order_acquire);
+        uint64_t begin = end > CAPACITY ? end - CAPACITY : 0;
+        std::vector<TraceEvent> events;
+        events.reserve(static_cast<size_t>(end - begin));
+        for (uint64_t index = begin; index < end; ++index) {
+            const auto& slot = slots_[index & (CAPACITY - 1)];
+            events.push_back({ slot.name.load(std::memory_order_relaxed), slot.start_ns.load(std::memory_order_relaxed),
+                slot.duration_ns.load(std::memory_order_relaxed) });
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t claimed = claimed_.load(std::memory_order_relaxed);
+        if (claimed > CAPACITY && claimed - CAPACITY > begin) {
+            size_t overwritten = static_cast<size_t>((std::min)(claimed - CAPACITY, end) - begin);
+            events.erase(events.begin(), events.begin() + static_cast<std::ptrdiff_t>(overwritten));
+        }
+        return events;
+    }
+
+    uint32_t thread_id() const { return thread_id_; }
+    const std::string& thread_name() const { return thread_name_; }
+
+private:
+    struct Slot {
+        std::atomic<const char*> name{ nullptr };
+        std::atomic<int64_t> start_ns{ 0 };
+        std::atomic<int64_t> duration_ns{ 0 };
+    };
+
+    uint32_t thread_id_;
+    std::string thread_name_;
+    std::atomic<uint64_t> claimed_{ 0 };
+    std::atomic<uint64_t> written_{ 0 };
+    std::array<Slot, CAPACITY> slots_;
+};
+
+// --- Tracer ---
+
+struct LatencySummary {
+    size_t count = 0;
+    double p50_ms = 0.0;
+    double p95_ms = 0.0;
+    double p99_ms = 0.0;
+};
+
+// Collects spans from every thread that records one. While disabled, a TraceScope costs one relaxed
+// load and a branch. Errors are kept whether or not tracing is on, since they are rare and
+// otherwise only surface as "[Translation Error: ...]".
+class Tracer {
+public:
+    static constexpr size_t MAX_ERRORS = 64;
+
+    void Enable(bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    int64_t NowNs() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch_).count();
+    }
+
+    // Names the calling thread in the trace. Takes effect if called before its first span.
+    void NameCurrentThread(std::string name) { CurrentThreadName() = std::move(name); }
+
+    void Record(const char* name, int64_t start_ns, int64_t duration_ns) {
+        ThreadBuffer().Append(name, start_ns, duration_ns);
+    }
+
+    void RecordError(std::string_view stage, std::string_view message) {
+        std::lock_guard lock(mutex_);
+        if (errors_.size() == MAX_ERRORS) errors_.pop_front();
+        errors_.push_back({ NowNs(), std::string(stage), std::string(message) });
+        ++error_count_;
+    }
+
+    // Percentiles per span name over the spans that started within the last `window`.
+    std::map<std::string, LatencySummary> Summaries(std::chrono::nanoseconds window) const {
+        int64_t since_ns = NowNs() - window.count();
+        std::map<std::string, std::vector<double>> samples;
+        for (const auto& buffer : Buffers()) {
+            for (const auto& event : buffer->Snapshot()) {
+                if (event.start_ns >= since_ns) samples[event.name].push_back(static_cast<double>(event.duration_ns) / 1e6);
+            }
+        }
+        std::map<std::string, LatencySummary> summaries;
+        for (auto& [name, durations] : samples) {
+            summaries[name] = { durations.size(), Percentile(durations, 0.50), Percentile(durations, 0.95), Percentile(durations, 0.99) };
+        }
+        return summaries;
+    }
+
+    // Errors recorded after the first `skip`, oldest first, as "stage: message".
+    std::vector<std::string> Errors(uint64_t skip = 0) const {
+        std::lock_guard lock(mutex_);
+        uint64_t first_kept = error_count_ - errors_.size();
+        std::vector<std::string> messages;
+        for (size_t i = 0; i < errors_.size(); ++i) {
+            if (first_kept + i >= skip) messages.push_back(errors_[i].stage + ": " + errors_[i].message);
+        }
+        return messages;
+    }
+
+    uint64_t error_count() const {
+        std::lock_guard lock(mutex_);
+        return error_count_;
+    }
+
+    // Chrome trace event format (chrome://tracing, Perfetto): one complete event per span, thread
+    // names as metadata, errors as instant events.
+    void WriteChromeTrace(std::ostream& out) const {
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        auto separator = [&] {
+            if (!first) out << ",\n";
+            first = false;
+        };
+        for (const auto& buffer : Buffers()) {
+            separator();
+            out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->thread_id()
+                << ",\"args\":{\"name\":\"" << JsonEscape(buffer->thread_name()) << "\"}}";
+            for (const auto& event : buffer->Snapshot()) {
+                separator();
+                out << "{\"name\":\"" << JsonEscape(event.name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread_id()
+                    << ",\"ts\":" << Microseconds(event.start_ns) << ",\"dur\":" << Microseconds(event.duration_ns) << '}';
+            }
+        }
+        std::lock_guard lock(mutex_);
+        for (const auto& error : errors_) {
+            separator();
+            out << "{\"name\":\"" << JsonEscape(error.stage) << " error\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":"
+                << Microseconds(error.time_ns) << ",\"args\":{\"message\":\"" << JsonEscape(error.message) << "\"}}";
+        }
+        out << "]}\n";
+    }
+
+private:
+    struct Error {
+        int64_t time_ns;
+        std::string stage;
+        std::string message;
+    };
+
+    static std::string& CurrentThreadName() {
+        thread_local std::string name;
+        return name;
+    }
+
+    // Buffers are registered once per thread and kept after it exits, so its spans can still be dumped.
+    TraceBuffer& ThreadBuffer() {
+        thread_local TraceBuffer* buffer = nullptr;
+        thread_local const Tracer* owner = nullptr;
+        if (!buffer || owner != this) {
+            std::lock_guard lock(mutex_);
+            auto& name = CurrentThreadName();
+            uint32_t id = static_cast<uint32_t>(buffers_.size() + 1);
+            buffers_.push_back(std::make_shared<TraceBuffer>(id, name.empty() ? "thread " + std::to_string(id) : name));
+            buffer = buffers_.back().get();
+            owner = this;
+        }
+        return *buffer;
+    }
+
+    std::vector<std::shared_ptr<TraceBuffer>> Buffers() const {
+        std::lock_guard lock(mutex_);
+        return buffers_;
+    }
+
+    // Fixed-point, so long traces keep sub-microsecond resolution.
+    static std::string Microseconds(int64_t ns) {
+        std::string fraction = std::to_string(1000 + ns % 1000);
+        return std::to_string(ns / 1000) + '.' + fraction.substr(1);
+    }
+
+    std::chrono::steady_clock::time_point epoch_ = std::chrono::steady_clock::now();
+    std::atomic<bool> enabled_{ false };
+    mutable std::mutex mutex_;
+    std::vector<std::shared_ptr<TraceBuffer>> buffers_;
+    std::deque<Error> errors_;
+    uint64_t error_count_ = 0;
+};
+
+// Records the enclosing scope as a span named `name` (a string literal) when tracing is on.
+class TraceScope {
+public:
+    TraceScope(Tracer& tracer, const char* name) : tracer_(tracer.enabled() ? &tracer : nullptr), name_(name) {
+        if (tracer_) start_ns_ = tracer_->NowNs();
+    }
+    ~TraceScope() {
+        if (tracer_) tracer_->Record(name_, start_ns_, tracer_->NowNs() - start_ns_);
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    Tracer* tracer_;
+    const char* name_;
+    int64_t start_ns_ = 0;
+};
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "MappedFile.h"
+
+// --- Hashing / Normalization ---
+
+inline uint64_t Fnv1a64(std::string_view data, uint64_t hash = 14695981039346656037ull) {
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Cache key form of a UTF-8 segment: trimmed, with every whitespace run collapsed to one space.
+inline std::string NormalizeSegment(std::string_view text) {
+    std::string normalized;
+    normalized.reserve(text.size());
+    bool pending_space = false;
+    for (char c : text) {
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v') {
+            pending_space = !normalized.empty();
+            continue;
+        }
+        if (pending_space) normalized += ' ';
+        pending_space = false;
+        normalized += c;
+    }
+    return normalized;
+}
+
+// --- Translation Cache ---
+
+struct TranslationCacheStats {
+    uint64_t memory_hits = 0;
+    uint64_t disk_hits = 0;
+    uint64_t misses = 0;
+    uint64_t insertions = 0;
+    uint64_t evictions = 0;
+    uint64_t not_persisted = 0; // insertions kept in memory only: the store was full or couldn't grow
+    size_t memory_bytes = 0;
+    size_t disk_records = 0;
+};
+
+// Segment-level translation memo: an LRU bounded by `memory_budget_bytes` in front of an
+// append-only, memory-mapped store that survives restarts. One store file per model identity,
+// so switching models never serves stale translations. Keys are normalized source segments.
+//
+// Store layout: a 32-byte header (magic, used bytes, record count, reserved) followed by records
+// of { u64 key hash, u32 source bytes, u32 target bytes, source, target } padded to 8 bytes.
+// A record becomes visible only once the header's used-bytes field has been advanced past it.
+class TranslationCache {
+public:
+    TranslationCache(const std::filesystem::path& directory, uint64_t model_identity,
+        size_t memory_budget_bytes, uint64_t disk_budget_bytes)
+        : memory_budget_bytes_(memory_budget_bytes), disk_budget_bytes_(disk_budget_bytes) {
+        if (disk_budget_bytes_ < INITIAL_FILE_SIZE) return;
+        std::error_code ec;
+        std::filesystem::create_directories(directory, ec);
+        char file_name[64];
+        std::snprintf(file_name, sizeof(file_name), "translation_cache_%016llx.bin",
+            static_cast<unsigned long long>(model_identity));
+        if (store_.Open(directory / file_name, INITIAL_FILE_SIZE)) {
+            LoadIndex();
+        }
+    }
+
+    std::optional<std::string> Lookup(const std::string& source) {
+        std::lock_guard lock(mutex_);
+        if (auto it = memory_index_.find(source); it != memory_index_.end()) {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            ++stats_.memory_hits;
+            return it->second->second;
+        }
+        if (auto target = LookupDisk(source)) {
+            ++stats_.disk_hits;
+            InsertMemory(source, *target);
+            return target;
+        }
+        ++stats_.misses;
+        return std::nullopt;
+    }
+
+    void Insert(const std::string& source, const std::string& target) {
+        std::lock_guard lock(mutex_);
+        ++stats_.insertions;
+        InsertMemory(source, target);
+        AppendDisk(source, target);
+    }
+
+    TranslationCacheStats Stats() const {
+        std::lock_guard lock(mutex_);
+        auto stats = stats_;
+        stats.memory_bytes = memory_bytes_;
+        stats.disk_records = disk_index_.size();
+        return stats;
+    }
+
+    void Flush() {
+        std::lock_guard lock(mutex_);
+        store_.Flush();
+    }
+
+private:
+    static constexpr uint64_t MAGIC = 0x3130304354534C4Full; // "OLSTC001"
+    static constexpr uint64_t HEADER_SIZE = 32;
+    static constexpr uint64_t RECORD_HEADER_SIZE = 16;
+    static constexpr uint64_t INITIAL_FILE_SIZE = 1ull << 20;
+    static constexpr size_t ENTRY_OVERHEAD = 64; // rough per-entry list/map bookkeeping
+
+    struct Header {
+        uint64_t magic;
+        uint64_t used_bytes;
+        uint64_t record_count;
+        uint64_t reserved;
+    };
+
+    Header* header() const { return reinterpret_cast<Header*>(store_.data()); }
+
+    static uint64_t Align8(uint64_t value) { return (value + 7) & ~uint64_t{ 7 }; }
+
+    void LoadIndex() {
+        Header* h = header();
+        if (h->magic != MAGIC || h->used_bytes < HEADER_SIZE || h->used_bytes > store_.size()) {
+            std::memset(h, 0, HEADER_SIZE);
+            h->magic = MAGIC;
+            h->used_bytes = HEADER_SIZE;
+        }
+        uint64_t offset = HEADER_SIZE;
+        while (offset + RECORD_HEADER_SIZE <= h->used_bytes) {
+            uint64_t key;
+            uint32_t source_size, target_size;
+            std::memcpy(&key, store_.data() + offset, 8);
+            std::memcpy(&source_size, store_.data() + offset + 8, 4);
+            std::memcpy(&target_size, store_.data() + offset + 12, 4);
+            uint64_t record_size = Align8(RECORD_HEADER_SIZE + source_size + target_size);
+            if (offset + record_size > h->used_bytes) break;
+            disk_index_[key] = offset; // later records win
+            offset += record_size;
+        }
+        h->used_bytes = offset;
+    }
+
+    std::optional<std::string> LookupDisk(const std::string& source) const {
+        if (!store_.is_open()) return std::nullopt;
+        auto it = disk_index_.find(Fnv1a64(source));
+        if (it == disk_index_.end()) return std::nullopt;
+
+        const uint8_t* record = store_.data() + it->second;
+        uint32_t source_size, target_size;
+        std::memcpy(&source_size, record + 8, 4);
+        std::memcpy(&target_size, record + 12, 4);
+        const char* text = reinterpret_cast<const char*>(record + RECORD_HEADER_SIZE);
+        if (std::string_view(text, source_size) != source) return std::nullopt; // hash collision
+        return std::string(text + source_size, target_size);
+    }
+
+    void AppendDisk(const std::string& source, const std::string& target) {
+        if (!store_.is_open()) return;
+        uint64_t record_size = Align8(RECORD_HEADER_SIZE + source.size() + target.size());
+        uint64_t needed = header()->used_bytes + record_size;
+        if (needed > disk_budget_bytes_) { // full: keep serving what is already stored
+            ++stats_.not_persisted;
+            return;
+        }
+        if (needed > store_.size()) {
+            uint64_t grown = store_.size() * 2;
+            while (grown < needed) grown *= 2;
+            if (grown > disk_budget_bytes_) grown = disk_budget_bytes_;
+            if (!store_.Resize(grown)) {
+                ++stats_.not_persisted;
+                return;
+            }
+        }
+
+        uint64_t offset = header()->used_bytes;
+        uint8_t* record = store_.data() + offset;
+        uint64_t key = Fnv1a64(source);
+        uint32_t source_size = static_cast<uint32_t>(source.size());
+        uint32_t target_size = static_cast<uint32_t>(target.size());
+        std::memcpy(record, &key, 8);
+        std::memcpy(record + 8, &source_size, 4);
+        std::memcpy(record + 12, &target_size, 4);
+        std::memcpy(record + RECORD_HEADER_SIZE, source.data(), source.size());
+        std::memcpy(record + RECORD_HEADER_SIZE + source.size(), target.data(), target.size());
+
+        header()->used_bytes = offset + record_size;
+        ++header()->record_count;
+        disk_index_[key] = offset;
+    }
+
+    void InsertMemory(const std::string& source, const std::string& target) {
+        if (auto it = memory_index_.find(source); it != memory_index_.end()) {
+            memory_bytes_ -= EntryBytes(*it->second);
+            lru_.erase(it->second);
+            memory_index_.erase(it);
+        }
+        lru_.emplace_front(source, target);
+        memory_index_.emplace(source, lru_.begin());
+        memory_bytes_ += EntryBytes(lru_.front());
+
+        while (memory_bytes_ > memory_budget_bytes_ && !lru_.empty()) {
+            memory_bytes_ -= EntryBytes(lru_.back());
+            memory_index_.erase(lru_.back().first);
+            lru_.pop_back();
+            ++stats_.evictions;
+        }
+    }
+
+    static size_t EntryBytes(const std::pair<std::string, std::string>& entry) {
+        return 2 * entry.first.size() + entry.second.size() + ENTRY_OVERHEAD;
+    }
+
+    mutable std::mutex mutex_;
+    size_t memory_budget_bytes_;
+    uint64_t disk_budget_bytes_;
+    size_t memory_bytes_ = 0;
+    std::list<std::pair<std::string, std::string>> lru_;
+    std::unordered_map<std::string, std::list<std::pair<std::string, std::string>>::iterator> memory_index_;
+    MappedFile store_;
+    std::unordered_map<uint64_t, uint64_t> disk_index_;
+    TranslationCacheStats stats_;
+};
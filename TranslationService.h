@@ -0,0 +1,805 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "Benchmarks.h"
+
+// --- Wire Protocol ---
+
+// Every message is a 12-byte header followed by `text`:
+//   u32 text bytes, u8 type, u8 status, u16 reserved (0), u32 request id   (little-endian)
+// Clients send Translate (text = UTF-8 source) and may pipeline any number of them; the service
+// answers each with a Result carrying the same id, in whatever order batches finish. Shutdown
+// asks the service to exit once queued requests are answered.
+enum class MessageType : uint8_t { Translate = 1, Result = 2, Shutdown = 3 };
+enum class ResultStatus : uint8_t { Ok = 0, Error = 1 };
+
+struct ServiceMessage {
+    MessageType type = MessageType::Translate;
+    ResultStatus status = ResultStatus::Ok;
+    uint32_t id = 0;
+    std::string text;
+};
+
+constexpr size_t SERVICE_HEADER_BYTES = 12;
+constexpr uint32_t SERVICE_MAX_TEXT_BYTES = 1u << 20;
+// Results the service holds for a client that isn't reading them; past this the client is dropped.
+constexpr size_t SERVICE_MAX_QUEUED_RESULT_BYTES = 16u << 20;
+
+inline std::string EncodeMessage(const ServiceMessage& message) {
+    auto length = static_cast<uint32_t>(message.text.size());
+    std::string bytes(SERVICE_HEADER_BYTES, '\0');
+    for (int i = 0; i < 4; ++i) {
+        bytes[i] = static_cast<char>((length >> (8 * i)) & 0xFF);
+        bytes[8 + i] = static_cast<char>((message.id >> (8 * i)) & 0xFF);
+    }
+    bytes[4] = static_cast<char>(message.type);
+    bytes[5] = static_cast<char>(message.status);
+    bytes += message.text;
+    return bytes;
+}
+
+// Reassembles messages from a byte stream that may split or merge them arbitrarily.
+class MessageReader {
+public:
+    void Append(const char* data, size_t size) { buffer_.append(data, size); }
+
+    // The next complete message, or nullopt until more bytes arrive. Oversized or unknown
+    // messages make the stream malformed(); the connection should then be dropped.
+    std::optional<ServiceMessage> Next() {
+        if (malformed_ || buffer_.size() - offset_ < SERVICE_HEADER_BYTES) return std::nullopt;
+        const auto* header = reinterpret_cast<const unsigned char*>(buffer_.data() + offset_);
+        uint32_t length = 0, id = 0;
+        for (int i = 0; i < 4; ++i) {
+            length |= static_cast<uint32_t>(header[i]) << (8 * i);
+            id |= static_cast<uint32_t>(header[8 + i]) << (8 * i);
+        }
+        if (length > SERVICE_MAX_TEXT_BYTES || header[4] < 1 || header[4] > 3 || header[5] > 1) {
+            malformed_ = true;
+            return std::nullopt;
+        }
+        if (buffer_.size() - offset_ < SERVICE_HEADER_BYTES + length) return std::nullopt;
+        ServiceMessage message{ static_cast<MessageType>(header[4]), static_cast<ResultStatus>(header[5]), id,
+            buffer_.substr(offset_ + SERVICE_HEADER_BYTES, length) };
+        offset_ += SERVICE_HEADER_BYTES + length;
+        if (offset_ == buffer_.size()) {
+            buffer_.clear();
+            offset_ = 0;
+        } else if (offset_ > 64 * 1024) {
+            buffer_.erase(0, offset_);
+            offset_ = 0;
+        }
+        return message;
+    }
+
+    bool malformed() const { return malformed_; }
+
+private:
+    std::string buffer_;
+    size_t offset_ = 0;
+    bool malformed_ = false;
+};
+
+// --- Local Transport ---
+
+// Where a service called `name` (ASCII) listens: the named pipe \\.\pipe\<name> on Windows, and a
+// Unix-domain socket in $XDG_RUNTIME_DIR (else /tmp) elsewhere. A name containing '/' is used as
+// the socket path itself.
+inline std::string LocalEndpoint(const std::string& name) {
+#ifdef _WIN32
+    return "\\\\.\\pipe\\" + name;
+#else
+    if (name.find('/') != std::string::npos) return name;
+    const char* runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+    if (runtime_dir && *runtime_dir) return std::string(runtime_dir) + "/" + name + ".sock";
+    return "/tmp/" + name + "-" + std::to_string(getuid()) + ".sock";
+#endif
+}
+
+// A connected, full-duplex byte stream to or from a local service. One thread may read while
+// others write; writes are serialized.
+class LocalStream {
+public:
+    LocalStream(const LocalStream&) = delete;
+    LocalStream& operator=(const LocalStream&) = delete;
+
+#ifdef _WIN32
+    explicit LocalStream(HANDLE pipe)
+        : pipe_(pipe), read_event_(CreateEventW(nullptr, TRUE, FALSE, nullptr)), write_event_(CreateEventW(nullptr, TRUE, FALSE, nullptr)) {}
+    ~LocalStream() {
+        CloseHandle(pipe_);
+        CloseHandle(read_event_);
+        CloseHandle(write_event_);
+    }
+
+    static std::unique_ptr<LocalStream> Connect(const std::string& name) {
+        auto endpoint = LocalEndpoint(name);
+        std::wstring path(endpoint.begin(), endpoint.end());
+        for (int attempt = 0; attempt < 5; ++attempt) {
+            HANDLE pipe = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, nullptr);
+            if (pipe != INVALID_HANDLE_VALUE) return std::make_unique<LocalStream>(pipe);
+            // Every instance is taken until the service creates the next one.
+            if (GetLastError() != ERROR_PIPE_BUSY || !WaitNamedPipeW(path.c_str(), 1000)) return nullptr;
+        }
+        return nullptr;
+    }
+
+    bool WriteAll(const std::string& bytes) {
+        std::lock_guard lock(write_mutex_);
+        size_t written = 0;
+        while (written < bytes.size()) {
+            if (shut_down_) return false;
+            OVERLAPPED overlapped{};
+            overlapped.hEvent = write_event_;
+            DWORD count = 0;
+            auto chunk = static_cast<DWORD>((std::min)(bytes.size() - written, size_t{ 1 } << 20));
+            if (!WriteFile(pipe_, bytes.data() + written, chunk, nullptr, &overlapped) && GetLastError() != ERROR_IO_PENDING) return false;
+            if (shut_down_) CancelIoEx(pipe_, &overlapped);
+            if (!GetOverlappedResult(pipe_, &overlapped, &count, TRUE) || count == 0) return false;
+            written += count;
+        }
+        return true;
+    }
+
+    // Blocks until some bytes arrive. 0 once the other end has gone or Shutdown was called.
+    size_t ReadSome(char* buffer, size_t size) {
+        if (shut_down_) return 0;
+        OVERLAPPED overlapped{};
+        overlapped.hEvent = read_event_;
+        DWORD count = 0;
+        if (!ReadFile(pipe_, buffer, static_cast<DWORD>(size), nullptr, &overlapped) && GetLastError() != ERROR_IO_PENDING) return 0;
+        // A Shutdown between the check above and ReadFile cancelled nothing; cancel this read instead.
+        if (shut_down_) CancelIoEx(pipe_, &overlapped);
+        if (!GetOverlappedResult(pipe_, &overlapped, &count, TRUE)) return 0;
+        return count;
+    }
+
+    // Makes a blocked ReadSome or WriteAll return, e.g. to stop the threads using the stream.
+    void Shutdown() {
+        shut_down_ = true;
+        CancelIoEx(pipe_, nullptr);
+    }
+
+private:
+    HANDLE pipe_;
+    HANDLE read_event_;
+    HANDLE write_event_;
+    std::atomic<bool> shut_down_{ false };
+#else
+    explicit LocalStream(int fd) : fd_(fd) {}
+    ~LocalStream() { close(fd_); }
+
+    static std::unique_ptr<LocalStream> Connect(const std::string& name) {
+        sockaddr_un address{};
+        auto path = LocalEndpoint(name);
+        if (path.size() >= sizeof(address.sun_path)) return nullptr;
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return nullptr;
+        if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+            close(fd);
+            return nullptr;
+        }
+        return std::make_unique<LocalStream>(fd);
+    }
+
+    bool WriteAll(const std::string& bytes) {
+        std::lock_guard lock(write_mutex_);
+        size_t written = 0;
+        while (written < bytes.size()) {
+#ifdef MSG_NOSIGNAL
+            ssize_t count = send(fd_, bytes.data() + written, bytes.size() - written, MSG_NOSIGNAL);
+#else
+            ssize_t count = send(fd_, bytes.data() + written, bytes.size() - written, 0);
+#endif
+            if (count <= 0) return false;
+            written += static_cast<size_t>(count);
+        }
+        return true;
+    }
+
+    // Blocks until some bytes arrive. 0 once the other end has gone or Shutdown was called.
+    size_t ReadSome(char* buffer, size_t size) {
+        ssize_t count = recv(fd_, buffer, size, 0);
+        return count > 0 ? static_cast<size_t>(count) : 0;
+    }
+
+    // Makes a blocked ReadSome or WriteAll return, e.g. to stop the threads using the stream.
+    void Shutdown() { shutdown(fd_, SHUT_RDWR); }
+
+private:
+    int fd_;
+#endif
+    std::mutex write_mutex_;
+};
+
+// Accepts connections from processes on this machine only.
+class LocalListener {
+public:
+    LocalListener() = default;
+    LocalListener(const LocalListener&) = delete;
+    LocalListener& operator=(const LocalListener&) = delete;
+    ~LocalListener() {
+        Close();
+        Release();
+    }
+
+#ifdef _WIN32
+    // Fails if another service already owns `name`.
+    bool Listen(const std::string& name) {
+        auto endpoint = LocalEndpoint(name);
+        path_.assign(endpoint.begin(), endpoint.end());
+        stop_event_ = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        pending_ = CreatePipeInstance(true);
+        return pending_ != INVALID_HANDLE_VALUE;
+    }
+
+    // Blocks for the next client. nullptr once Close has been called.
+    std::unique_ptr<LocalStream> Accept() {
+        while (pending_ != INVALID_HANDLE_VALUE) {
+            OVERLAPPED overlapped{};
+            overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+            bool connected = ConnectNamedPipe(pending_, &overlapped) || GetLastError() == ERROR_PIPE_CONNECTED;
+            if (!connected && GetLastError() == ERROR_IO_PENDING) {
+                HANDLE events[] = { overlapped.hEvent, stop_event_ };
+                if (WaitForMultipleObjects(2, events, FALSE, INFINITE) != WAIT_OBJECT_0) {
+                    CancelIoEx(pending_, &overlapped);
+                    DWORD ignored = 0;
+                    GetOverlappedResult(pending_, &overlapped, &ignored, TRUE);
+                    CloseHandle(overlapped.hEvent);
+                    return nullptr;
+                }
+                DWORD ignored = 0;
+                connected = GetOverlappedResult(pending_, &overlapped, &ignored, FALSE) != 0;
+            }
+            CloseHandle(overlapped.hEvent);
+            HANDLE client = pending_;
+            pending_ = CreatePipeInstance(false);
+            if (connected) return std::make_unique<LocalStream>(client);
+            CloseHandle(client); // the client gave up before we got to it
+        }
+        return nullptr;
+    }
+
+    // Makes a blocked Accept return nullptr.
+    void Close() {
+        if (stop_event_) SetEvent(stop_event_);
+    }
+
+private:
+    void Release() {
+        if (pending_ != INVALID_HANDLE_VALUE) CloseHandle(pending_);
+        if (stop_event_) CloseHandle(stop_event_);
+        pending_ = INVALID_HANDLE_VALUE;
+        stop_event_ = nullptr;
+    }
+
+    HANDLE CreatePipeInstance(bool first) {
+        DWORD open_mode = PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0);
+        return CreateNamedPipeW(path_.c_str(), open_mode, PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+            PIPE_UNLIMITED_INSTANCES, 64 * 1024, 64 * 1024, 0, nullptr);
+    }
+
+    std::wstring path_;
+    HANDLE stop_event_ = nullptr;
+    HANDLE pending_ = INVALID_HANDLE_VALUE;
+#else
+    // Fails if another service already owns `name`. A socket file left by one that crashed is replaced.
+    bool Listen(const std::string& name) {
+        path_ = LocalEndpoint(name);
+        if (auto existing = LocalStream::Connect(name)) return false;
+        sockaddr_un address{};
+        if (path_.size() >= sizeof(address.sun_path)) return false;
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path_.c_str(), path_.size() + 1);
+        unlink(path_.c_str());
+        fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd_ < 0) return false;
+        // The socket file is created by bind, for this user only from the start. The umask is
+        // process-wide, but the service listens once, at startup.
+        mode_t previous_umask = umask(0177);
+        bool bound = bind(fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+        umask(previous_umask);
+        if (!bound || listen(fd_, 16) != 0) {
+            close(fd_);
+            fd_ = -1;
+            return false;
+        }
+        return true;
+    }
+
+    // Blocks for the next client. nullptr once Close has been called, or if accepting fails for
+    // good. While the process is out of descriptors or memory it retries every ACCEPT_BACKOFF.
+    std::unique_ptr<LocalStream> Accept() {
+        while (!closed_.load()) {
+            int client = accept(fd_, nullptr, nullptr);
+            if (client >= 0) return std::make_unique<LocalStream>(client);
+            if (errno == EINTR || errno == ECONNABORTED || errno == EAGAIN || errno == EPROTO) continue;
+            if (errno != EMFILE && errno != ENFILE && errno != ENOBUFS && errno != ENOMEM) return nullptr;
+            std::this_thread::sleep_for(ACCEPT_BACKOFF);
+        }
+        return nullptr;
+    }
+
+    // Makes a blocked Accept return nullptr.
+    void Close() {
+        if (fd_ < 0 || closed_.exchange(true)) return;
+        shutdown(fd_, SHUT_RDWR);
+        unlink(path_.c_str());
+    }
+
+private:
+    static constexpr std::chrono::milliseconds ACCEPT_BACKOFF{ 100 };
+
+    void Release() {
+        if (fd_ >= 0) close(fd_);
+        fd_ = -1;
+    }
+
+    std::string path_;
+    int fd_ = -1;
+    std::atomic<bool> closed_{ false };
+#endif
+};
+
+// --- Dynamic Batching ---
+
+struct ServiceResult {
+    bool ok = false;
+    std::string text; // the translation, or what went wrong
+};
+
+// Gathers requests from any number of clients into batches for one translator. A batch runs as
+// soon as it holds `max_batch` requests or its oldest request has waited `max_delay`, so a lone
+// request pays at most `max_delay` extra latency while concurrent clients share encoder passes.
+// Requests that arrive while a batch is translating simply wait for the next one.
+class DynamicBatcher {
+public:
+    using TranslateBatch = std::function<std::vector<ServiceResult>(const std::vector<std::string>& texts)>;
+    using Completion = std::function<void(ServiceResult result)>;
+
+    struct Stats {
+        uint64_t batches = 0;
+        uint64_t requests = 0;
+        size_t largest_batch = 0;
+    };
+
+    DynamicBatcher(TranslateBatch translate, size_t max_batch, std::chrono::microseconds max_delay)
+        : translate_(std::move(translate)), max_batch_((std::max)(max_batch, size_t{ 1 })), max_delay_(max_delay),
+          worker_([this] { Run(); }) {}
+    ~DynamicBatcher() { Stop(); }
+
+    // `done` runs on the batching thread once `text` is translated.
+    void Submit(std::string text, Completion done) {
+        {
+            std::lock_guard lock(mutex_);
+            if (!stopping_) {
+                queue_.push_back({ std::move(text), std::move(done), std::chrono::steady_clock::now() });
+                cv_.notify_one();
+                return;
+            }
+        }
+        done({ false, "the translation service is shutting down" });
+    }
+
+    // Translates whatever is already queued, then ends the batching thread.
+    void Stop() {
+        {
+            std::lock_guard lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_one();
+        std::lock_guard lock(join_mutex_);
+        if (worker_.joinable()) worker_.join();
+    }
+
+    Stats stats() const {
+        std::lock_guard lock(mutex_);
+        return stats_;
+    }
+
+private:
+    struct Request {
+        std::string text;
+        Completion done;
+        std::chrono::steady_clock::time_point arrival;
+    };
+
+    void Run() {
+        std::unique_lock lock(mutex_);
+        while (true) {
+            cv_.wait(lock, [&] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) return;
+            cv_.wait_until(lock, queue_.front().arrival + max_delay_, [&] { return stopping_ || queue_.size() >= max_batch_; });
+            auto count = static_cast<std::ptrdiff_t>((std::min)(queue_.size(), max_batch_));
+            std::vector<Request> batch(std::make_move_iterator(queue_.begin()), std::make_move_iterator(queue_.begin() + count));
+            queue_.erase(queue_.begin(), queue_.begin() + count);
+            ++stats_.batches;
+            stats_.requests += batch.size();
+            stats_.largest_batch = (std::max)(stats_.largest_batch, batch.size());
+            lock.unlock();
+
+            std::vector<std::string> texts;
+            texts.reserve(batch.size());
+            for (const auto& request : batch) texts.push_back(request.text);
+            std::vector<ServiceResult> results;
+            try {
+                results = translate_(texts);
+            } catch (const std::exception& e) {
+                results.assign(batch.size(), { false, e.what() });
+            }
+            for (size_t i = 0; i < batch.size(); ++i) {
+                batch[i].done(i < results.size() ? std::move(results[i]) : ServiceResult{ false, "no result for this request" });
+            }
+            lock.lock();
+        }
+    }
+
+    TranslateBatch translate_;
+    size_t max_batch_;
+    std::chrono::microseconds max_delay_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Request> queue_;
+    bool stopping_ = false;
+    Stats stats_;
+    std::mutex join_mutex_;
+    std::thread worker_; // last, so everything it uses exists before it starts
+};
+
+// --- Translation Server ---
+
+// Serves a DynamicBatcher to local clients. Each connection gets a thread that reads requests and
+// submits them, so one client's pipelined requests can share a batch with each other and with
+// other clients'. As a batch finishes, the batching thread only queues each result for its
+// connection, whose writer thread sends it: a client that stops reading holds up nobody else, and
+// is dropped once SERVICE_MAX_QUEUED_RESULT_BYTES of its results are waiting.
+class TranslationServer {
+public:
+    explicit TranslationServer(DynamicBatcher& batcher) : batcher_(batcher) {}
+    ~TranslationServer() { Stop(); }
+
+    // Fails if the endpoint is taken, usually by a service that is already running.
+    bool Start(const std::string& name) {
+        listener_ = std::make_unique<LocalListener>();
+        if (!listener_->Listen(name)) return false;
+        accept_thread_ = std::thread([this] { AcceptClients(); });
+        return true;
+    }
+
+    // Blocks until a client sends Shutdown or Stop is called.
+    void Wait() {
+        std::unique_lock lock(mutex_);
+        cv_.wait(lock, [&] { return shutdown_requested_; });
+    }
+
+    // Stops accepting, disconnects every client and joins their threads. Results the batcher
+    // finishes afterwards have nowhere to go and are dropped.
+    void Stop() {
+        {
+            std::lock_guard lock(mutex_);
+            if (stopped_) return;
+            stopped_ = true;
+            shutdown_requested_ = true;
+        }
+        cv_.notify_all();
+        if (listener_) listener_->Close();
+        if (accept_thread_.joinable()) accept_thread_.join();
+        listener_.reset(); // refuses clients still waiting to be accepted
+        for (auto& connection : connections_) {
+            Close(*connection.outbox);
+            connection.stream->Shutdown();
+        }
+        for (auto& connection : connections_) {
+            connection.reader.join();
+            connection.writer.join();
+        }
+        connections_.clear();
+    }
+
+    uint64_t clients_served() const {
+        std::lock_guard lock(mutex_);
+        return clients_served_;
+    }
+
+private:
+    // Encoded results waiting for one connection's writer thread.
+    struct Outbox {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<std::string> messages;
+        size_t bytes = 0;
+        size_t awaiting = 0;        // submitted requests whose result hasn't been queued yet
+        bool reading_done = false;  // the client has stopped sending
+        bool closed = false;        // the connection is gone; results are dropped
+    };
+
+    struct Connection {
+        std::shared_ptr<LocalStream> stream;
+        std::shared_ptr<Outbox> outbox;
+        std::thread reader;
+        std::thread writer;
+        int threads_finished = 0;
+    };
+
+    static void Close(Outbox& outbox) {
+        {
+            std::lock_guard lock(outbox.mutex);
+            outbox.closed = true;
+            outbox.messages.clear();
+            outbox.bytes = 0;
+        }
+        outbox.cv.notify_all();
+    }
+
+    // Runs on the batching thread; never blocks on the client.
+    static void Post(Outbox& outbox, LocalStream& stream, std::string message) {
+        bool dropped = false;
+        {
+            std::lock_guard lock(outbox.mutex);
+            --outbox.awaiting;
+            if (!outbox.closed) {
+                outbox.bytes += message.size();
+                outbox.messages.push_back(std::move(message));
+                // Not reading its results: drop the client rather than buffer without bound.
+                if (outbox.bytes > SERVICE_MAX_QUEUED_RESULT_BYTES) {
+                    outbox.closed = dropped = true;
+                    outbox.messages.clear();
+                    outbox.bytes = 0;
+                }
+            }
+        }
+        outbox.cv.notify_all();
+        if (dropped) stream.Shutdown(); // unblocks the writer, stuck on the full socket
+    }
+
+    void Finish(std::list<Connection>::iterator connection) {
+        std::lock_guard lock(mutex_);
+        ++connection->threads_finished;
+    }
+
+    void AcceptClients() {
+        while (auto stream = listener_->Accept()) {
+            std::lock_guard lock(mutex_);
+            if (stopped_) break;
+            // Join the threads of clients that have disconnected since.
+            for (auto it = connections_.begin(); it != connections_.end();) {
+                if (it->threads_finished < 2) {
+                    ++it;
+                    continue;
+                }
+                it->reader.join();
+                it->writer.join();
+                it = connections_.erase(it);
+            }
+            ++clients_served_;
+            auto connection = connections_.insert(connections_.end(),
+                { std::shared_ptr<LocalStream>(std::move(stream)), std::make_shared<Outbox>(), {}, {}, 0 });
+            connection->reader = std::thread([this, connection] { Serve(connection); });
+            connection->writer = std::thread([this, connection] { WriteResults(connection); });
+        }
+    }
+
+    void Serve(std::list<Connection>::iterator connection) {
+        auto stream = connection->stream;
+        auto outbox = connection->outbox;
+        MessageReader reader;
+        std::vector<char> buffer(64 * 1024);
+        while (size_t count = stream->ReadSome(buffer.data(), buffer.size())) {
+            reader.Append(buffer.data(), count);
+            while (auto message = reader.Next()) {
+                if (message->type == MessageType::Shutdown) {
+                    std::lock_guard lock(mutex_);
+                    shutdown_requested_ = true;
+                    cv_.notify_all();
+                } else if (message->type == MessageType::Translate) {
+                    {
+                        std::lock_guard lock(outbox->mutex);
+                        ++outbox->awaiting;
+                    }
+                    batcher_.Submit(std::move(message->text), [stream, outbox, id = message->id](ServiceResult result) {
+                        Post(*outbox, *stream, EncodeMessage({ MessageType::Result, result.ok ? ResultStatus::Ok : ResultStatus::Error, id, std::move(result.text) }));
+                    });
+                }
+            }
+            if (reader.malformed()) break;
+        }
+        {
+            std::lock_guard lock(outbox->mutex);
+            outbox->reading_done = true;
+        }
+        outbox->cv.notify_all();
+        Finish(connection);
+    }
+
+    // Sends queued results until the client is gone, or has stopped sending and every result it
+    // asked for has gone out.
+    void WriteResults(std::list<Connection>::iterator connection) {
+        auto stream = connection->stream;
+        auto outbox = connection->outbox;
+        while (true) {
+            std::unique_lock lock(outbox->mutex);
+            outbox->cv.wait(lock, [&] {
+                return outbox->closed || !outbox->messages.empty() || (outbox->reading_done && outbox->awaiting == 0);
+            });
+            if (outbox->closed || outbox->messages.empty()) break;
+            std::string message = std::move(outbox->messages.front());
+            outbox->messages.pop_front();
+            outbox->bytes -= message.size();
+            lock.unlock();
+            if (!stream->WriteAll(message)) break;
+        }
+        Close(*outbox);
+        stream->Shutdown(); // ends the reader too, if the client was dropped
+        Finish(connection);
+    }
+
+    DynamicBatcher& batcher_;
+    std::unique_ptr<LocalListener> listener_;
+    std::thread accept_thread_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::list<Connection> connections_;
+    bool shutdown_requested_ = false;
+    bool stopped_ = false;
+    uint64_t clients_served_ = 0;
+};
+
+// --- Translation Client ---
+
+// One connection to a running service. Translate may be called from any number of threads; their
+// requests are pipelined on the connection and matched to results by id. Connect and Close must
+// not race with Translate.
+class TranslationClient {
+public:
+    TranslationClient() = default;
+    TranslationClient(const TranslationClient&) = delete;
+    TranslationClient& operator=(const TranslationClient&) = delete;
+    ~TranslationClient() { Close(); }
+
+    bool Connect(const std::string& name) {
+        Close();
+        stream_ = LocalStream::Connect(name);
+        if (!stream_) return false;
+        connected_ = true;
+        reader_ = std::thread([this] { ReadResults(); });
+        return true;
+    }
+
+    bool connected() const { return connected_.load(); }
+
+    // Resolves to the translation of `text`, or to an error if the service goes away first.
+    std::future<ServiceResult> Translate(std::string text) {
+        std::promise<ServiceResult> promise;
+        auto future = promise.get_future();
+        uint32_t id = 0;
+        {
+            std::lock_guard lock(mutex_);
+            if (!connected_) {
+                promise.set_value({ false, "not connected to the translation service" });
+                return future;
+            }
+            id = next_id_++;
+            pending_.emplace(id, std::move(promise));
+        }
+        // A failed write means the connection is gone; the reader then fails everything pending.
+        if (!stream_->WriteAll(EncodeMessage({ MessageType::Translate, ResultStatus::Ok, id, std::move(text) }))) stream_->Shutdown();
+        return future;
+    }
+
+    // Asks the service to exit once the requests it has queued are answered.
+    bool RequestShutdown() {
+        return connected_ && stream_->WriteAll(EncodeMessage({ MessageType::Shutdown, ResultStatus::Ok, 0, {} }));
+    }
+
+    void Close() {
+        if (!stream_) return;
+        stream_->Shutdown();
+        if (reader_.joinable()) reader_.join();
+        stream_.reset();
+    }
+
+private:
+    void ReadResults() {
+        MessageReader reader;
+        std::vector<char> buffer(64 * 1024);
+        while (size_t count = stream_->ReadSome(buffer.data(), buffer.size())) {
+            reader.Append(buffer.data(), count);
+            while (auto message = reader.Next()) {
+                if (message->type != MessageType::Result) continue;
+                std::unique_lock lock(mutex_);
+                auto it = pending_.find(message->id);
+                if (it == pending_.end()) continue;
+                auto promise = std::move(it->second);
+                pending_.erase(it);
+                lock.unlock();
+                promise.set_value({ message->status == ResultStatus::Ok, std::move(message->text) });
+            }
+            if (reader.malformed()) break;
+        }
+        std::unordered_map<uint32_t, std::promise<ServiceResult>> orphaned;
+        {
+            std::lock_guard lock(mutex_);
+            connected_ = false;
+            orphaned.swap(pending_);
+        }
+        for (auto& [id, promise] : orphaned) promise.set_value({ false, "lost the connection to the translation service" });
+    }
+
+    std::unique_ptr<LocalStream> stream_;
+    std::thread reader_;
+    std::atomic<bool> connected_{ false };
+    std::mutex mutex_;
+    std::unordered_map<uint32_t, std::promise<ServiceResult>> pending_;
+    uint32_t next_id_ = 1;
+};
+
+// --- Service Load Test ---
+
+// Closed-loop load against a running service: for each entry of `client_counts`, that many
+// connections each translate `requests_per_client` texts (cycling through `texts`), sending the
+// next as soon as the previous result arrives. Reports throughput and per-request latency
+// percentiles as TSV. Returns false if the service can't be reached.
+inline bool RunServiceLoadTest(const std::string& name, const std::vector<std::string>& texts,
+    const std::vector<size_t>& client_counts, size_t requests_per_client, std::ostream& out) {
+    if (texts.empty()) return false;
+    out << "benchmark\tclients\trequests\terrors\tseconds\trequests_per_s\tp50_ms\tp95_ms\tp99_ms\n";
+    for (size_t clients : client_counts) {
+        std::vector<std::unique_ptr<TranslationClient>> connections;
+        for (size_t c = 0; c < clients; ++c) {
+            connections.push_back(std::make_unique<TranslationClient>());
+            if (!connections.back()->Connect(name)) return false;
+        }
+        std::vector<std::vector<double>> latencies(clients);
+        std::atomic<size_t> errors{ 0 };
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (size_t c = 0; c < clients; ++c) {
+            threads.emplace_back([&, c] {
+                for (size_t r = 0; r < requests_per_client; ++r) {
+                    auto sent = std::chrono::steady_clock::now();
+                    auto result = connections[c]->Translate(texts[(c * requests_per_client + r) % texts.size()]).get();
+                    latencies[c].push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sent).count());
+                    if (!result.ok) ++errors;
+                }
+            });
+        }
+        for (auto& thread : threads) thread.join();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::vector<double> all;
+        for (const auto& samples : latencies) all.insert(all.end(), samples.begin(), samples.end());
+        out << "service_load\t" << clients << '\t' << all.size() << '\t' << errors.load() << '\t' << seconds << '\t'
+            << static_cast<double>(all.size()) / (std::max)(seconds, 1e-9) << '\t' << Percentile(all, 0.5) << '\t'
+            << Percentile(all, 0.95) << '\t' << Percentile(all, 0.99) << '\n';
+    }
+    return true;
+}
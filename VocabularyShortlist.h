@@ -0,0 +1,287 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <istream>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "FrameChangeDetector.h"
+
+// --- Output Projection ---
+
+// The decoder's final linear layer, for decoder graphs exported to end at last_hidden_state
+// instead of logits: the logit of token v is bias[v] + dot(row v of weights, hidden state).
+// Stored in output_projection.bin next to the graphs as the 8 bytes "OSLPROJ1", the vocabulary
+// and hidden sizes as little-endian uint32, vocab x hidden float32 weights (one row per target
+// token, the layout of lm_head.weight) and vocab float32 biases (final_logits_bias).
+struct OutputProjection {
+    const float* weights = nullptr;
+    const float* bias = nullptr;
+    size_t vocab_size = 0;
+    size_t hidden_size = 0;
+};
+
+constexpr char OUTPUT_PROJECTION_MAGIC[8] = { 'O', 'S', 'L', 'P', 'R', 'O', 'J', '1' };
+constexpr size_t OUTPUT_PROJECTION_HEADER_BYTES = 16;
+
+// A view into an output_projection.bin image, or nullopt if `data` isn't one. The weights start
+// 16 bytes in, so a page-aligned mapping keeps them aligned for SIMD loads.
+inline std::optional<OutputProjection> ParseOutputProjection(const uint8_t* data, uint64_t size) {
+    if (!data || size < OUTPUT_PROJECTION_HEADER_BYTES || std::memcmp(data, OUTPUT_PROJECTION_MAGIC, sizeof(OUTPUT_PROJECTION_MAGIC)) != 0) {
+        return std::nullopt;
+    }
+    uint32_t vocab_size = 0, hidden_size = 0;
+    std::memcpy(&vocab_size, data + 8, sizeof(vocab_size));
+    std::memcpy(&hidden_size, data + 12, sizeof(hidden_size));
+    uint64_t floats = (static_cast<uint64_t>(vocab_size) * hidden_size + vocab_size);
+    if (vocab_size == 0 || hidden_size == 0 || size != OUTPUT_PROJECTION_HEADER_BYTES + floats * sizeof(float)) return std::nullopt;
+
+    OutputProjection projection;
+    projection.weights = reinterpret_cast<const float*>(data + OUTPUT_PROJECTION_HEADER_BYTES);
+    projection.bias = projection.weights + static_cast<size_t>(vocab_size) * hidden_size;
+    projection.vocab_size = vocab_size;
+    projection.hidden_size = hidden_size;
+    return projection;
+}
+
+// --- Projection Kernels ---
+
+// Logits for a chosen set of target tokens, fused with the greedy argmax so no logits row is ever
+// stored. Every kernel sums a dot product in the same order: element i goes to partial sum
+// i % LANES, the partial sums are folded pairwise, then the tail elements are added in index
+// order. No kernel contracts multiply-adds into FMA, so scalar and SIMD scores are bit-identical
+// and a shortlist pick can be compared exactly against a full-vocabulary one.
+namespace projection_kernels {
+
+using frame_hash::Kernel;
+using frame_hash::KernelName;
+
+constexpr size_t LANES = 16;
+
+inline float FoldLanes(float lanes[LANES]) {
+    for (size_t width = LANES / 2; width > 0; width /= 2) {
+        for (size_t i = 0; i < width; ++i) lanes[i] = lanes[i] + lanes[i + width];
+    }
+    return lanes[0];
+}
+
+inline float DotScalar(const float* row, const float* hidden, size_t size) {
+    float lanes[LANES] = {};
+    size_t body = size - size % LANES;
+    for (size_t i = 0; i < body; i += LANES) {
+        for (size_t lane = 0; lane < LANES; ++lane) {
+            float product = row[i + lane] * hidden[i + lane];
+            lanes[lane] = lanes[lane] + product;
+        }
+    }
+    float sum = FoldLanes(lanes);
+    for (size_t i = body; i < size; ++i) {
+        float product = row[i] * hidden[i];
+        sum = sum + product;
+    }
+    return sum;
+}
+
+#ifdef OSL_HAS_X86_SIMD
+inline float DotSse2(const float* row, const float* hidden, size_t size) {
+    __m128 acc[4] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+    size_t body = size - size % LANES;
+    for (size_t i = 0; i < body; i += LANES) {
+        for (size_t k = 0; k < 4; ++k) {
+            acc[k] = _mm_add_ps(acc[k], _mm_mul_ps(_mm_loadu_ps(row + i + 4 * k), _mm_loadu_ps(hidden + i + 4 * k)));
+        }
+    }
+    alignas(16) float lanes[LANES];
+    for (size_t k = 0; k < 4; ++k) _mm_store_ps(lanes + 4 * k, acc[k]);
+    float sum = FoldLanes(lanes);
+    for (size_t i = body; i < size; ++i) {
+        float product = row[i] * hidden[i];
+        sum = sum + product;
+    }
+    return sum;
+}
+
+OSL_TARGET_AVX2 inline float DotAvx2(const float* row, const float* hidden, size_t size) {
+    __m256 acc_lo = _mm256_setzero_ps();
+    __m256 acc_hi = _mm256_setzero_ps();
+    size_t body = size - size % LANES;
+    for (size_t i = 0; i < body; i += LANES) {
+        acc_lo = _mm256_add_ps(acc_lo, _mm256_mul_ps(_mm256_loadu_ps(row + i), _mm256_loadu_ps(hidden + i)));
+        acc_hi = _mm256_add_ps(acc_hi, _mm256_mul_ps(_mm256_loadu_ps(row + i + 8), _mm256_loadu_ps(hidden + i + 8)));
+    }
+    alignas(32) float lanes[LANES];
+    _mm256_store_ps(lanes, acc_lo);
+    _mm256_store_ps(lanes + 8, acc_hi);
+    float sum = FoldLanes(lanes);
+    for (size_t i = body; i < size; ++i) {
+        float product = row[i] * hidden[i];
+        sum = sum + product;
+    }
+    return sum;
+}
+#endif
+
+using DotFunction = float (*)(const float* row, const float* hidden, size_t size);
+
+inline DotFunction DotKernel(Kernel kernel) {
+#ifdef OSL_HAS_X86_SIMD
+    if (kernel == Kernel::Avx2) return DotAvx2;
+    if (kernel == Kernel::Sse2) return DotSse2;
+#endif
+    return DotScalar;
+}
+
+} // namespace projection_kernels
+
+struct ProjectedPick {
+    int32_t token = -1;
+    float score = -std::numeric_limits<float>::infinity();
+    float runner_up = -std::numeric_limits<float>::infinity();
+
+    // Tokens must be offered in ascending order for ties to go to the lowest id.
+    void Offer(size_t candidate, float candidate_score) {
+        if (candidate_score > score) {
+            runner_up = score;
+            score = candidate_score;
+            token = static_cast<int32_t>(candidate);
+        } else if (candidate_score > runner_up) {
+            runner_up = candidate_score;
+        }
+    }
+};
+
+// Weight rows scored against every hidden state before moving on: 64 rows of a 512-wide
+// projection are 128 KB, which stays in L2 while a batch's hidden states go past it.
+constexpr size_t PROJECTION_BLOCK_TOKENS = 64;
+
+// The highest-scoring of `count` candidate tokens for one hidden state, or of the whole vocabulary
+// when `candidates` is null. Candidates must be ascending: weight rows are then read front to
+// back, and on equal scores the lowest id wins, as in a full-vocabulary argmax.
+inline ProjectedPick ProjectArgmax(const OutputProjection& projection, const float* hidden, const int32_t* candidates, size_t count,
+    frame_hash::Kernel kernel = frame_hash::BestKernel()) {
+    auto dot = projection_kernels::DotKernel(kernel);
+    ProjectedPick pick;
+    size_t tokens = candidates ? count : projection.vocab_size;
+    for (size_t i = 0; i < tokens; ++i) {
+        size_t token = candidates ? static_cast<size_t>(candidates[i]) : i;
+        pick.Offer(token, dot(projection.weights + token * projection.hidden_size, hidden, projection.hidden_size) + projection.bias[token]);
+    }
+    return pick;
+}
+
+// ProjectArgmax over the whole vocabulary for `rows` hidden states at once, as a blocked
+// matrix-vector product: each block of PROJECTION_BLOCK_TOKENS weight rows is read from memory
+// once and scored against every hidden state, instead of the whole projection being streamed once
+// per row. Scores and picks are bit-identical to ProjectArgmax on each row alone.
+inline void ProjectArgmaxRows(const OutputProjection& projection, const float* const* hidden, size_t rows, ProjectedPick* picks,
+    frame_hash::Kernel kernel = frame_hash::BestKernel()) {
+    auto dot = projection_kernels::DotKernel(kernel);
+    std::fill(picks, picks + rows, ProjectedPick{});
+    for (size_t block = 0; block < projection.vocab_size; block += PROJECTION_BLOCK_TOKENS) {
+        size_t block_end = (std::min)(block + PROJECTION_BLOCK_TOKENS, projection.vocab_size);
+        for (size_t row = 0; row < rows; ++row) {
+            for (size_t token = block; token < block_end; ++token) {
+                picks[row].Offer(token, dot(projection.weights + token * projection.hidden_size, hidden[row], projection.hidden_size) + projection.bias[token]);
+            }
+        }
+    }
+}
+
+// --- Lexical Shortlist ---
+
+struct LexicalEntry {
+    int32_t source = 0;
+    int32_t target = 0;
+    float probability = 0;
+};
+
+// Entries of a source-to-target lexical table in the lex.s2t format Marian builds its shortlists
+// from: "target source probability" per line, over SentencePiece pieces. Lines naming NULL or a
+// piece for which `source_id` / `target_id` return nullopt are skipped.
+inline std::vector<LexicalEntry> ReadLexicalTable(std::istream& in,
+    const std::function<std::optional<int32_t>(std::string_view piece)>& source_id,
+    const std::function<std::optional<int32_t>(std::string_view piece)>& target_id) {
+    std::vector<LexicalEntry> entries;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::string_view fields[3];
+        size_t field = 0, position = 0;
+        while (field < 3 && position < line.size()) {
+            size_t start = line.find_first_not_of(" \t\r", position);
+            if (start == std::string::npos) break;
+            size_t end = (std::min)(line.find_first_of(" \t\r", start), line.size());
+            fields[field++] = std::string_view(line).substr(start, end - start);
+            position = end;
+        }
+        if (field < 3 || fields[0] == "NULL" || fields[1] == "NULL") continue;
+        auto target = target_id(fields[0]);
+        auto source = source_id(fields[1]);
+        if (!target || !source || *target < 0 || *source < 0) continue;
+        entries.push_back({ *source, *target, std::strtof(std::string(fields[2]).c_str(), nullptr) });
+    }
+    return entries;
+}
+
+// The target tokens worth scoring for a source sentence: the `first` lowest ids (SentencePiece
+// numbers pieces roughly by frequency, so these cover punctuation and common words), the `best`
+// likeliest translations of each source token, and a few tokens every output needs such as EOS.
+// Marian's "--shortlist lex.s2t 100 100" defaults, with the table kept in memory as one array.
+class LexicalShortlist {
+public:
+    LexicalShortlist() = default;
+
+    LexicalShortlist(std::vector<LexicalEntry> entries, size_t first, size_t best, size_t target_vocab_size, std::vector<int32_t> always)
+        : first_((std::min)(first, target_vocab_size)), always_(std::move(always)) {
+        std::erase_if(entries, [&](const LexicalEntry& entry) { return static_cast<size_t>(entry.target) >= target_vocab_size; });
+        std::sort(entries.begin(), entries.end(), [](const LexicalEntry& a, const LexicalEntry& b) {
+            return a.source != b.source ? a.source < b.source : a.probability > b.probability;
+        });
+        size_t sources = entries.empty() ? 0 : static_cast<size_t>(entries.back().source) + 1;
+        offsets_.assign(sources + 1, 0);
+        for (size_t i = 0; i < entries.size();) {
+            size_t end = i;
+            while (end < entries.size() && entries[end].source == entries[i].source) ++end;
+            for (size_t k = i; k < end && k - i < best; ++k) {
+                if (static_cast<size_t>(entries[k].target) >= first_) targets_.push_back(entries[k].target);
+            }
+            offsets_[static_cast<size_t>(entries[i].source) + 1] = static_cast<uint32_t>(targets_.size());
+            i = end;
+        }
+        // Sources without entries end where the previous one did.
+        for (size_t s = 1; s < offsets_.size(); ++s) offsets_[s] = (std::max)(offsets_[s], offsets_[s - 1]);
+        // Anything below first_ is in every shortlist already.
+        std::erase_if(always_, [&](int32_t token) { return static_cast<size_t>(token) < first_ || static_cast<size_t>(token) >= target_vocab_size; });
+    }
+
+    // Fills `candidates` for `source_ids`, ascending and without duplicates.
+    void Candidates(const std::vector<int32_t>& source_ids, std::vector<int32_t>& candidates) const {
+        candidates.resize(first_);
+        for (size_t i = 0; i < first_; ++i) candidates[i] = static_cast<int32_t>(i);
+        for (int32_t source : source_ids) {
+            if (source < 0 || static_cast<size_t>(source) + 1 >= offsets_.size()) continue;
+            candidates.insert(candidates.end(), targets_.begin() + offsets_[static_cast<size_t>(source)],
+                targets_.begin() + offsets_[static_cast<size_t>(source) + 1]);
+        }
+        candidates.insert(candidates.end(), always_.begin(), always_.end());
+        // Everything past the first_ ids is at least first_, so sorting that part sorts the whole.
+        std::sort(candidates.begin() + static_cast<std::ptrdiff_t>(first_), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+    }
+
+    bool empty() const { return targets_.empty(); }
+    size_t entry_count() const { return targets_.size(); }
+
+private:
+    size_t first_ = 0;
+    std::vector<int32_t> always_;
+    std::vector<uint32_t> offsets_; // source id -> its targets, targets_[offsets_[s], offsets_[s + 1])
+    std::vector<int32_t> targets_;  // ids below first_ are left out, as Candidates adds them anyway
+};
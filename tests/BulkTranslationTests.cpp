@@ -0,0 +1,170 @@
+#include "BulkTranslation.h"
+
+#include <atomic>
+#include <sstream>
+
+#include <gtest/gtest.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// A fresh per-test directory under the temp directory, removed again at the end.
+class BulkJobTest : public testing::Test {
+protected:
+    void SetUp() override {
+        auto test = testing::UnitTest::GetInstance()->current_test_info()->name();
+#ifdef _WIN32
+        auto pid = GetCurrentProcessId();
+#else
+        auto pid = getpid();
+#endif
+        root_ = fs::temp_directory_path() / ("osl-bulk-" + std::to_string(pid) + "-" + test);
+        fs::remove_all(root_);
+        fs::create_directories(root_ / "in");
+    }
+
+    void TearDown() override {
+        std::error_code ec;
+        fs::remove_all(root_, ec);
+    }
+
+    void WriteInput(const std::string& name, const std::string& content) {
+        fs::create_directories((root_ / "in" / name).parent_path());
+        std::ofstream(root_ / "in" / name, std::ios::binary) << content;
+    }
+
+    static std::string Read(const fs::path& path) {
+        std::ifstream file(path, std::ios::binary);
+        std::stringstream content;
+        content << file.rdbuf();
+        return content.str();
+    }
+
+    BulkJobStats Run(const BulkTranslateBatch& translate) {
+        BulkOptions options;
+        options.workers = 3;
+        options.max_batch = 4;
+        options.window = 64;
+        auto extract = [](const fs::path&) -> std::optional<std::vector<std::string>> { return std::nullopt; };
+        return RunBulkJob(CollectBulkFiles(root_ / "in", root_ / "out"), extract, translate, CountWords, options);
+    }
+
+    fs::path root_;
+};
+
+// Wraps each text in T[...]; texts containing "fail" fail while `failing` is set.
+BulkTranslateBatch Bracket(std::atomic<uint64_t>& translated, const bool& failing = false) {
+    return [&translated, &failing](const std::vector<std::string>& texts) {
+        std::vector<BulkTranslation> results;
+        for (const auto& text : texts) {
+            ++translated;
+            if (failing && text.find("fail") != std::string::npos) {
+                results.push_back({ false, "[Translation Error: test]" });
+            } else {
+                results.push_back({ true, "T[" + text + "]" });
+            }
+        }
+        return results;
+    };
+}
+
+std::string Lines(int count, const std::string& prefix = {}) {
+    std::string lines;
+    // Lengths vary so the length sort reorders each window.
+    for (int i = 0; i < count; ++i) lines += prefix + std::string(i * 7 % 23 + 1, 'a' + i % 26) + " w" + std::to_string(i) + "\n";
+    return lines;
+}
+
+std::string Bracketed(const std::string& lines) {
+    std::istringstream in(lines);
+    std::string line, out;
+    while (std::getline(in, line)) out += "T[" + line + "]\n";
+    return out;
+}
+
+} // namespace
+
+// --- Bulk Job ---
+
+TEST_F(BulkJobTest, WritesTranslationsInInputOrder) {
+    auto lines = Lines(1000);
+    WriteInput("big.txt", lines);
+    WriteInput("sub/small.srt", "1\n00:00:01,000 --> 00:00:02,000\nHi there\n\n");
+    WriteInput("empty.txt", "");
+
+    std::atomic<uint64_t> translated{ 0 };
+    auto job = Run(Bracket(translated));
+    EXPECT_EQ(Read(root_ / "out" / "big.txt"), Bracketed(lines));
+    EXPECT_EQ(Read(root_ / "out" / "sub" / "small.srt"), "1\n00:00:01,000 --> 00:00:02,000\nT[Hi there]\n\n");
+    EXPECT_TRUE(fs::exists(root_ / "out" / "empty.txt"));
+    EXPECT_EQ(job.files, 3u);
+    EXPECT_EQ(job.translation.errors, 0u);
+    EXPECT_EQ(translated, 1001u);
+
+    // A second run finds every output complete.
+    auto again = Run(Bracket(translated));
+    EXPECT_EQ(again.files_done, 3u);
+    EXPECT_EQ(again.translation.lines, 0u);
+}
+
+TEST_F(BulkJobTest, ResumesAnInterruptedOutputAfterItsLastCompleteLine) {
+    auto lines = Lines(300);
+    WriteInput("big.txt", lines);
+    auto expected = Bracketed(lines);
+    auto done = expected.substr(0, expected.find('\n', expected.find("w99]")) + 1);
+    fs::create_directories(root_ / "out");
+    std::ofstream(root_ / "out" / "big.txt.partial", std::ios::binary) << done << "T[cut of";
+
+    std::atomic<uint64_t> translated{ 0 };
+    auto job = Run(Bracket(translated));
+    EXPECT_EQ(job.lines_resumed, 100u);
+    EXPECT_EQ(translated, 200u);
+    EXPECT_EQ(Read(root_ / "out" / "big.txt"), expected);
+    EXPECT_FALSE(fs::exists(root_ / "out" / "big.txt.partial"));
+}
+
+TEST_F(BulkJobTest, RetriesFilesWithFailedLinesOnTheNextRun) {
+    WriteInput("a.txt", "one\nfail two\nthree\nfail four\n");
+    WriteInput("b.txt", "fine\n");
+
+    std::atomic<uint64_t> translated{ 0 };
+    bool failing = true;
+    auto job = Run(Bracket(translated, failing));
+    EXPECT_EQ(job.translation.errors, 2u);
+    EXPECT_EQ(job.files_with_errors, 1u);
+    EXPECT_FALSE(fs::exists(root_ / "out" / "a.txt"));
+    EXPECT_EQ(Read(root_ / "out" / "a.txt.partial"), "T[one]\n[Translation Error: test]\nT[three]\n[Translation Error: test]\n");
+    EXPECT_EQ(ReadFailedLine(root_ / "out" / "a.txt"), 1u);
+    EXPECT_EQ(Read(root_ / "out" / "b.txt"), "T[fine]\n");
+
+    // The rerun keeps the lines before the first failure and translates the rest again.
+    failing = false;
+    translated = 0;
+    auto again = Run(Bracket(translated, failing));
+    EXPECT_EQ(again.files_done, 1u);
+    EXPECT_EQ(again.lines_resumed, 1u);
+    EXPECT_EQ(again.files_with_errors, 0u);
+    EXPECT_EQ(translated, 3u);
+    EXPECT_EQ(Read(root_ / "out" / "a.txt"), "T[one]\nT[fail two]\nT[three]\nT[fail four]\n");
+    EXPECT_FALSE(fs::exists(root_ / "out" / "a.txt.partial"));
+    EXPECT_FALSE(fs::exists(FailedLinePath(root_ / "out" / "a.txt")));
+}
+
+TEST_F(BulkJobTest, RecordsAFailureBeforeTheFileIsComplete) {
+    // An interrupted run that already wrote a failed line still retries it.
+    WriteInput("a.txt", "one\nfail two\nthree\n");
+    fs::create_directories(root_ / "out");
+    std::ofstream(root_ / "out" / "a.txt.partial", std::ios::binary) << "T[one]\n[Translation Error: test]\n";
+    std::ofstream(FailedLinePath(root_ / "out" / "a.txt")) << "1\n";
+
+    std::atomic<uint64_t> translated{ 0 };
+    auto job = Run(Bracket(translated));
+    EXPECT_EQ(job.lines_resumed, 1u);
+    EXPECT_EQ(translated, 2u);
+    EXPECT_EQ(Read(root_ / "out" / "a.txt"), "T[one]\nT[fail two]\nT[three]\n");
+}
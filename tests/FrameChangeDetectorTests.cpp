@@ -0,0 +1,138 @@
+#include "FrameChangeDetector.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+// A BGRA frame with distinct bytes everywhere, rows `stride` bytes apart; padding bytes are 0xEE.
+struct TestFrame {
+    int width, height;
+    size_t stride;
+    std::vector<uint8_t> pixels;
+
+    TestFrame(int w, int h, size_t padding = 0)
+        : width(w), height(h), stride(static_cast<size_t>(w) * 4 + padding), pixels(stride * static_cast<size_t>(h), 0xEE) {
+        for (int y = 0; y < height; ++y) {
+            uint8_t* row = pixels.data() + static_cast<size_t>(y) * stride;
+            for (size_t x = 0; x < static_cast<size_t>(width) * 4; ++x) row[x] = static_cast<uint8_t>(x * 7 + static_cast<size_t>(y) * 13);
+        }
+    }
+
+    uint8_t* At(int x, int y) { return pixels.data() + static_cast<size_t>(y) * stride + static_cast<size_t>(x) * 4; }
+};
+
+FrameChange Update(FrameChangeDetector& detector, const TestFrame& frame) {
+    return detector.Update(frame.pixels.data(), frame.width, frame.height, frame.stride);
+}
+
+std::vector<frame_hash::Kernel> AvailableKernels() {
+    std::vector<frame_hash::Kernel> kernels = { frame_hash::Kernel::Scalar };
+#ifdef OSL_HAS_X86_SIMD
+    kernels.push_back(frame_hash::Kernel::Sse2);
+    if (frame_hash::CpuSupportsAvx2()) kernels.push_back(frame_hash::Kernel::Avx2);
+#endif
+    return kernels;
+}
+
+} // namespace
+
+// --- Tile Hashing ---
+
+TEST(TileHash, KernelsAgree) {
+    TestFrame frame(256, 48, 24);
+    for (size_t row_bytes : { size_t{ 32 }, size_t{ 128 }, size_t{ 1024 }, size_t{ 40 } }) {
+        uint64_t scalar = frame_hash::HashTile(frame.pixels.data(), row_bytes, 48, frame.stride, frame_hash::Kernel::Scalar);
+        for (auto kernel : AvailableKernels()) {
+            EXPECT_EQ(frame_hash::HashTile(frame.pixels.data(), row_bytes, 48, frame.stride, kernel), scalar)
+                << frame_hash::KernelName(kernel) << ", " << row_bytes << " bytes per row";
+        }
+    }
+}
+
+TEST(TileHash, DependsOnRowOrder) {
+    TestFrame frame(8, 2);
+    uint64_t before = frame_hash::HashTile(frame.pixels.data(), frame.stride, 2, frame.stride, frame_hash::Kernel::Scalar);
+    std::swap_ranges(frame.At(0, 0), frame.At(0, 1), frame.At(0, 1));
+    EXPECT_NE(frame_hash::HashTile(frame.pixels.data(), frame.stride, 2, frame.stride, frame_hash::Kernel::Scalar), before);
+}
+
+// --- Frame Change Detection ---
+
+TEST(FrameChangeDetector, FirstFrameIsFullyChanged) {
+    FrameChangeDetector detector(32);
+    TestFrame frame(100, 70);
+    auto change = Update(detector, frame);
+    EXPECT_EQ(change.total_tiles, 4u * 3u);
+    EXPECT_EQ(change.changed_tiles, change.total_tiles);
+    EXPECT_EQ(change.left, 0);
+    EXPECT_EQ(change.top, 0);
+    EXPECT_EQ(change.right, 100);
+    EXPECT_EQ(change.bottom, 70);
+
+    change = Update(detector, frame);
+    EXPECT_EQ(change.changed_tiles, 0u);
+    EXPECT_EQ(change.right - change.left, 0);
+    EXPECT_EQ(change.bottom - change.top, 0);
+}
+
+TEST(FrameChangeDetector, OneChangedTileIsEnoughForOcr) {
+    for (auto kernel : AvailableKernels()) {
+        FrameChangeDetector detector(CHANGE_DETECTION_TILE_SIZE, kernel);
+        TestFrame frame(320, 160, 16);
+        Update(detector, frame);
+        frame.At(100, 70)[1] ^= 1; // one channel of one pixel, in tile (3, 2)
+        auto change = Update(detector, frame);
+        EXPECT_EQ(change.changed_tiles, 1u) << frame_hash::KernelName(kernel);
+        EXPECT_GE(change.changed_tiles, MIN_CHANGED_TILES_FOR_OCR);
+        EXPECT_EQ(change.left, 96);
+        EXPECT_EQ(change.top, 64);
+        EXPECT_EQ(change.right, 128);
+        EXPECT_EQ(change.bottom, 96);
+        EXPECT_EQ(detector.changed_tiles()[2 * 10 + 3], 1);
+    }
+}
+
+TEST(FrameChangeDetector, BoundsCoverEveryChangedTile) {
+    FrameChangeDetector detector(32);
+    TestFrame frame(100, 70);
+    Update(detector, frame);
+    frame.At(31, 5)[0] ^= 1;
+    frame.At(99, 69)[3] ^= 1; // in the partial corner tile
+    auto change = Update(detector, frame);
+    EXPECT_EQ(change.changed_tiles, 2u);
+    EXPECT_EQ(change.left, 0);
+    EXPECT_EQ(change.top, 0);
+    EXPECT_EQ(change.right, 100);
+    EXPECT_EQ(change.bottom, 70);
+    EXPECT_EQ(std::count(detector.changed_tiles().begin(), detector.changed_tiles().end(), 1), 2);
+}
+
+TEST(FrameChangeDetector, IgnoresRowPadding) {
+    FrameChangeDetector detector(32);
+    TestFrame frame(64, 64, 32);
+    Update(detector, frame);
+    frame.pixels[frame.stride - 1] ^= 0xFF;
+    EXPECT_EQ(Update(detector, frame).changed_tiles, 0u);
+}
+
+TEST(FrameChangeDetector, ResizeAndResetReportEverything) {
+    FrameChangeDetector detector(32);
+    Update(detector, TestFrame(64, 64));
+    auto change = Update(detector, TestFrame(96, 64));
+    EXPECT_EQ(change.changed_tiles, 6u);
+    detector.Reset();
+    EXPECT_EQ(Update(detector, TestFrame(96, 64)).changed_tiles, 6u);
+}
+
+// --- Adaptive Polling ---
+
+TEST(AdaptivePollInterval, BacksOffWhileIdleAndSnapsBackOnActivity) {
+    using std::chrono::milliseconds;
+    AdaptivePollInterval interval(milliseconds(100), milliseconds(1000), 2.0);
+    EXPECT_EQ(interval.Next(false), milliseconds(200));
+    EXPECT_EQ(interval.Next(false), milliseconds(400));
+    EXPECT_EQ(interval.Next(false), milliseconds(800));
+    EXPECT_EQ(interval.Next(false), milliseconds(1000));
+    EXPECT_EQ(interval.Next(false), milliseconds(1000));
+    EXPECT_EQ(interval.Next(true), milliseconds(100));
+}
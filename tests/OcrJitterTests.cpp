@@ -0,0 +1,106 @@
+#include "OcrJitter.h"
+
+#include <random>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+// Random text over a small alphabet, so strings share characters, mixing ASCII with accented Latin,
+// kana and CJK, which the bit-parallel kernel looks up outside its ASCII table.
+std::wstring RandomText(std::mt19937& rng, size_t length) {
+    static constexpr wchar_t ALPHABET[] = { L'a', L'b', L'c', L' ', L'1', L'\u00E9', L'\u00FC', L'\u3042', L'\u65E5', L'\u672C' };
+    std::wstring text;
+    for (size_t i = 0; i < length; ++i) text += ALPHABET[rng() % std::size(ALPHABET)];
+    return text;
+}
+
+// `text` after a few random substitutions, insertions and deletions.
+std::wstring Mutate(std::mt19937& rng, std::wstring text, size_t edits) {
+    for (size_t e = 0; e < edits; ++e) {
+        size_t at = text.empty() ? 0 : rng() % text.size();
+        switch (rng() % 3) {
+        case 0: if (!text.empty()) text[at] = RandomText(rng, 1)[0]; break;
+        case 1: text.insert(at, RandomText(rng, 1)); break;
+        default: if (!text.empty()) text.erase(at, 1); break;
+        }
+    }
+    return text;
+}
+
+} // namespace
+
+// --- Edit Distance Kernels ---
+
+TEST(EditDistance, KnownDistances) {
+    for (auto kernel : { edit_distance::Kernel::DynamicProgramming, edit_distance::Kernel::BitParallel }) {
+        EXPECT_EQ(edit_distance::Levenshtein(L"", L"", kernel), 0u) << edit_distance::KernelName(kernel);
+        EXPECT_EQ(edit_distance::Levenshtein(L"", L"abc", kernel), 3u) << edit_distance::KernelName(kernel);
+        EXPECT_EQ(edit_distance::Levenshtein(L"kitten", L"sitting", kernel), 3u) << edit_distance::KernelName(kernel);
+        EXPECT_EQ(edit_distance::Levenshtein(L"flaw", L"lawn", kernel), 2u) << edit_distance::KernelName(kernel);
+        EXPECT_EQ(edit_distance::Levenshtein(L"\u65E5\u672C\u8A9E", L"\u65E5\u672C", kernel), 1u) << edit_distance::KernelName(kernel);
+    }
+}
+
+TEST(EditDistance, BitParallelMatchesTheReference) {
+    std::mt19937 rng(17);
+    // Around the one-word pattern limit of 64 characters, and well past it.
+    const size_t lengths[] = { 0, 1, 2, 31, 63, 64, 65, 127, 128, 129, 200, 333 };
+    for (size_t length_a : lengths) {
+        for (size_t length_b : lengths) {
+            for (int iteration = 0; iteration < 4; ++iteration) {
+                std::wstring a = RandomText(rng, length_a), b = RandomText(rng, length_b);
+                ASSERT_EQ(edit_distance::BitParallel(a, b), edit_distance::DynamicProgramming(a, b))
+                    << length_a << " and " << length_b << " characters";
+            }
+        }
+        // Near-identical strings, where the distance is small and the deltas carry across words.
+        for (size_t edits : { 1, 3, 10 }) {
+            std::wstring a = RandomText(rng, length_a);
+            std::wstring b = Mutate(rng, a, edits);
+            ASSERT_EQ(edit_distance::BitParallel(a, b), edit_distance::DynamicProgramming(a, b))
+                << length_a << " characters, " << edits << " edits";
+            ASSERT_EQ(edit_distance::BitParallel(b, a), edit_distance::BitParallel(a, b));
+        }
+    }
+}
+
+// --- OCR Jitter Filter ---
+
+TEST(OcrJitterFilter, IgnoresWhatNormalizationRemoves) {
+    OcrJitterFilter filter(0.0);
+    EXPECT_TRUE(filter.SameLine(L"Hello, world.", L"Hello world"));
+    EXPECT_TRUE(filter.SameLine(L"  Hello   world ", L"Hello world"));
+    EXPECT_TRUE(filter.SameLine(L"Il est l\u2019heure", L"|l est l'heure"));
+    EXPECT_TRUE(filter.SameLine(L"Total: 1OO", L"Total: 100"));
+    EXPECT_FALSE(filter.SameLine(L"Hello world", L"Hello word"));
+}
+
+TEST(OcrJitterFilter, ChangedNumbersAreAlwaysReal) {
+    OcrJitterFilter filter(0.5);
+    EXPECT_FALSE(filter.SameLine(L"Price 120 EUR", L"Price 125 EUR"));
+    EXPECT_FALSE(filter.SameLine(L"Level 9", L"Level 19"));
+    EXPECT_TRUE(filter.SameLine(L"Price 120 EUR", L"Prlce 120 EUR"));
+}
+
+TEST(OcrJitterFilter, AllowsEditsUpToTheThreshold) {
+    // "w" read as "vv": two edits in 25 characters.
+    const wchar_t* line = L"The quick brown fox jumps";
+    const wchar_t* misread = L"The quick brovvn fox jumps";
+    EXPECT_FALSE(OcrJitterFilter(0.05).SameLine(line, misread)); // allows one edit
+    EXPECT_TRUE(OcrJitterFilter(0.1).SameLine(line, misread));   // allows two
+    EXPECT_FALSE(OcrJitterFilter(0.1).SameLine(line, L"The quick red fox jumps"));
+
+    // Both kernels decide the same.
+    OcrJitterFilter reference(0.1, edit_distance::Kernel::DynamicProgramming);
+    EXPECT_TRUE(reference.SameLine(line, misread));
+}
+
+TEST(OcrJitterFilter, ComparesWholeScreensLineByLine) {
+    OcrJitterFilter filter(0.1);
+    std::vector<std::wstring> lines = { L"File  Edit  View", L"The quick brown fox jumps" };
+    EXPECT_TRUE(filter.SameLines(lines, { L"File Edit View", L"The quick brovvn fox jumps." }));
+    EXPECT_FALSE(filter.SameLines(lines, { L"File Edit View" }));
+    EXPECT_FALSE(filter.SameLines(lines, { L"The quick brown fox jumps", L"File Edit View" }));
+    EXPECT_TRUE(filter.SameLines({}, {}));
+}
@@ -0,0 +1,145 @@
+#include "OcrPreprocessor.h"
+
+#include <random>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+std::vector<image_kernels::Kernel> AvailableKernels() {
+    std::vector<image_kernels::Kernel> kernels = { image_kernels::Kernel::Scalar };
+#ifdef OSL_HAS_X86_SIMD
+    kernels.push_back(image_kernels::Kernel::Sse2);
+    if (frame_hash::CpuSupportsAvx2()) kernels.push_back(image_kernels::Kernel::Avx2);
+#endif
+    return kernels;
+}
+
+// A white BGRA capture with a block of dark vertical strokes, 3 px wide and 3 px apart, standing in
+// for a line of text.
+struct Capture {
+    int width, height;
+    std::vector<uint8_t> pixels;
+
+    Capture(int w, int h) : width(w), height(h), pixels(static_cast<size_t>(w) * h * 4, 255) {}
+
+    size_t stride() const { return static_cast<size_t>(width) * 4; }
+
+    void DrawText(int left, int top, int right, int bottom) {
+        for (int y = top; y < bottom; ++y) {
+            for (int x = left; x < right; ++x) {
+                if ((x / 3) % 2) std::memset(&pixels[(static_cast<size_t>(y) * width + x) * 4], 0, 3);
+            }
+        }
+    }
+};
+
+} // namespace
+
+// --- Image Kernels ---
+
+TEST(ImageKernels, KernelsMatchTheScalarDefinitions) {
+    std::mt19937 rng(7);
+    for (int iteration = 0; iteration < 100; ++iteration) {
+        int width = 1 + static_cast<int>(rng() % 200), height = 1 + static_cast<int>(rng() % 40);
+        size_t stride = static_cast<size_t>(width) * 4 + (rng() % 3) * 4;
+        std::vector<uint8_t> bgra(stride * height);
+        for (auto& byte : bgra) byte = static_cast<uint8_t>(rng());
+
+        std::vector<uint8_t> gray(static_cast<size_t>(width) * height);
+        image_kernels::BgraToGray(bgra.data(), stride, width, height, gray.data(), width, image_kernels::Kernel::Scalar);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                const uint8_t* p = &bgra[y * stride + x * 4];
+                ASSERT_EQ(gray[y * width + x], static_cast<uint8_t>((29 * p[0] + 150 * p[1] + 77 * p[2] + 128) >> 8));
+            }
+        }
+        std::vector<uint8_t> half(static_cast<size_t>(width / 2) * (height / 2) + 1);
+        image_kernels::Downscale2x(gray.data(), width, width, height, half.data(), width / 2, image_kernels::Kernel::Scalar);
+        std::vector<uint16_t> edges;
+        image_kernels::CountCellEdges(gray.data(), width, width, height, 40, edges, image_kernels::Kernel::Scalar);
+
+        for (auto kernel : AvailableKernels()) {
+            std::vector<uint8_t> kernel_gray(gray.size());
+            image_kernels::BgraToGray(bgra.data(), stride, width, height, kernel_gray.data(), width, kernel);
+            EXPECT_EQ(kernel_gray, gray) << image_kernels::KernelName(kernel);
+            std::vector<uint8_t> kernel_half(half.size());
+            image_kernels::Downscale2x(gray.data(), width, width, height, kernel_half.data(), width / 2, kernel);
+            EXPECT_EQ(kernel_half, half) << image_kernels::KernelName(kernel);
+            std::vector<uint16_t> kernel_edges;
+            image_kernels::CountCellEdges(gray.data(), width, width, height, 40, kernel_edges, kernel);
+            EXPECT_EQ(kernel_edges, edges) << image_kernels::KernelName(kernel);
+        }
+    }
+}
+
+TEST(ImageKernels, DownscaleRoundsTheBoxAverage) {
+    const uint8_t source[] = { 0, 1, 9, 9, 9,
+                               1, 1, 9, 10, 9 };
+    uint8_t target[2] = {};
+    image_kernels::Downscale2x(source, 5, 5, 2, target, 2, image_kernels::Kernel::Scalar);
+    EXPECT_EQ(target[0], 1); // (0 + 1 + 1 + 1 + 2) / 4
+    EXPECT_EQ(target[1], 9); // (9 + 9 + 9 + 10 + 2) / 4
+}
+
+TEST(ImageKernels, FindsConnectedCellRegions) {
+    std::vector<int> cells = { 1, 1, 0, 0,
+                               0, 1, 0, 1,
+                               0, 0, 0, 0 };
+    auto regions = FindCellRegions(cells, 4, 3, 1, 2);
+    ASSERT_EQ(regions.size(), 1u); // the lone cell on the right is too small
+    EXPECT_EQ(regions[0].left, 0);
+    EXPECT_EQ(regions[0].top, 0);
+    EXPECT_EQ(regions[0].right, 2);
+    EXPECT_EQ(regions[0].bottom, 2);
+    EXPECT_EQ(regions[0].cells, 3);
+}
+
+// --- OCR Preprocessor ---
+
+TEST(OcrPreprocessor, DownscalesByTheCaptureDpi) {
+    Capture capture(640, 320);
+    capture.DrawText(100, 100, 500, 140);
+    OcrPreprocessor preprocessor({ .crop_to_text = false });
+    for (auto [dpi, scale] : { std::pair{ 96, 1 }, std::pair{ 120, 1 }, std::pair{ 144, 1 }, std::pair{ 192, 2 },
+             std::pair{ 288, 2 }, std::pair{ 384, 4 } }) {
+        auto image = preprocessor.Process(capture.pixels.data(), capture.width, capture.height, capture.stride(), dpi);
+        ASSERT_TRUE(image) << dpi;
+        EXPECT_EQ(image.scale, scale) << dpi;
+        EXPECT_EQ(image.width, capture.width / scale) << dpi;
+        EXPECT_EQ(image.height, capture.height / scale) << dpi;
+    }
+    OcrPreprocessor fixed({ .downscale = 2, .crop_to_text = false });
+    EXPECT_EQ(fixed.Process(capture.pixels.data(), capture.width, capture.height, capture.stride(), 96).scale, 2);
+}
+
+TEST(OcrPreprocessor, CropsToTheTextAndMapsBackToCapturePixels) {
+    Capture capture(1280, 720);
+    capture.DrawText(600, 400, 900, 440);
+    OcrPreprocessor preprocessor;
+    auto image = preprocessor.Process(capture.pixels.data(), capture.width, capture.height, capture.stride(), 192);
+    ASSERT_TRUE(image);
+    EXPECT_EQ(image.scale, 2);
+    EXPECT_LE(image.origin_x, 600);
+    EXPECT_LE(image.origin_y, 400);
+    EXPECT_GE(image.origin_x + image.width * image.scale, 900);
+    EXPECT_GE(image.origin_y + image.height * image.scale, 440);
+    EXPECT_LT(image.width * image.height * 4, capture.width * capture.height / 4); // well under the whole frame
+
+    // The stroke over capture columns 603-605 is dark in the image; the background stays white.
+    auto at = [&](int x, int y) { return image.pixels[static_cast<size_t>((y - image.origin_y) / 2) * image.stride + (x - image.origin_x) / 2]; };
+    EXPECT_LT(at(604, 420), 64);
+    EXPECT_EQ(at(image.origin_x, image.origin_y), 255);
+    ASSERT_FALSE(preprocessor.regions().empty());
+    EXPECT_LE(preprocessor.regions().front().left, 600);
+}
+
+TEST(OcrPreprocessor, FindsNothingWithoutText) {
+    Capture capture(640, 360);
+    OcrPreprocessor preprocessor;
+    EXPECT_FALSE(preprocessor.Process(capture.pixels.data(), capture.width, capture.height, capture.stride(), 96));
+
+    capture.DrawText(291, 96, 294, 108); // a caret-sized speck, inside one cell
+    EXPECT_FALSE(preprocessor.Process(capture.pixels.data(), capture.width, capture.height, capture.stride(), 96));
+    EXPECT_TRUE(preprocessor.regions().empty());
+}
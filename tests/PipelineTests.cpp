@@ -0,0 +1,167 @@
+#include "Pipeline.h"
+
+#include <algorithm>
+#include <future>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+// Collects what a fake final stage was handed, and lets a test wait for a given item.
+class Sink {
+public:
+    void Add(int value) {
+        {
+            std::lock_guard lock(mutex_);
+            values_.push_back(value);
+        }
+        changed_.notify_all();
+    }
+
+    bool WaitFor(int value, std::chrono::milliseconds timeout = 5s) {
+        std::unique_lock lock(mutex_);
+        return changed_.wait_for(lock, timeout, [&] { return !values_.empty() && values_.back() == value; });
+    }
+
+    std::vector<int> values() const {
+        std::lock_guard lock(mutex_);
+        return values_;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::condition_variable changed_;
+    std::vector<int> values_;
+};
+
+} // namespace
+
+// --- Latest-Wins Queue ---
+
+TEST(LatestWinsQueue, DropsTheOldestItemWhenFull) {
+    LatestWinsQueue<int> queue(2);
+    EXPECT_EQ(queue.Push(1), 0u);
+    EXPECT_EQ(queue.Push(2), 0u);
+    EXPECT_EQ(queue.Push(3), 1u);
+    EXPECT_EQ(queue.dropped_total(), 1u);
+    EXPECT_EQ(queue.TryPop(), 2);
+    EXPECT_EQ(queue.TryPop(), 3);
+    EXPECT_EQ(queue.TryPop(), std::nullopt);
+}
+
+TEST(LatestWinsQueue, PopGivesUpWhenStopped) {
+    LatestWinsQueue<int> queue;
+    std::stop_source stop;
+    auto popped = std::async(std::launch::async, [&] { return queue.Pop(stop.get_token()); });
+    stop.request_stop();
+    EXPECT_EQ(popped.get(), std::nullopt);
+}
+
+TEST(InterruptibleSleep, WakesOnStop) {
+    std::stop_source stop;
+    auto start = std::chrono::steady_clock::now();
+    std::jthread stopper([&] { stop.request_stop(); });
+    EXPECT_FALSE(InterruptibleSleep(stop.get_token(), 60s));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 30s);
+    EXPECT_TRUE(InterruptibleSleep(std::stop_source().get_token(), 1ms));
+}
+
+// --- Pipeline Stage ---
+
+TEST(PipelineStage, CancelsTheItemInFlightWhenANewerOneArrives) {
+    Sink sink;
+    std::promise<void> first_started;
+    PipelineStage<int> stage("translate", [&](int&& value, std::stop_token stop) {
+        if (value == 1) {
+            first_started.set_value();
+            while (!stop.stop_requested()) std::this_thread::sleep_for(1ms);
+            return;
+        }
+        sink.Add(value);
+    }, { .capacity = 1, .cancel_superseded = true });
+    stage.Start();
+
+    stage.Push(1);
+    first_started.get_future().wait();
+    stage.Push(2);
+    ASSERT_TRUE(sink.WaitFor(2));
+    stage.Stop();
+    EXPECT_EQ(sink.values(), std::vector<int>{ 2 });
+    auto stats = stage.Stats();
+    EXPECT_EQ(stats.superseded, 1u);
+    EXPECT_EQ(stats.processed, 1u);
+}
+
+TEST(PipelineStage, LetsTheItemInFlightFinishUnlessAskedToCancel) {
+    Sink sink;
+    std::promise<void> first_started;
+    std::promise<void> release;
+    auto released = release.get_future().share();
+    PipelineStage<int> stage("ocr", [&](int&& value, std::stop_token stop) {
+        if (value == 1) {
+            first_started.set_value();
+            released.wait();
+            EXPECT_FALSE(stop.stop_requested());
+        }
+        sink.Add(value);
+    });
+    stage.Start();
+
+    stage.Push(1);
+    first_started.get_future().wait();
+    stage.Push(2);
+    release.set_value();
+    ASSERT_TRUE(sink.WaitFor(2));
+    stage.Stop();
+    EXPECT_EQ(sink.values(), (std::vector<int>{ 1, 2 }));
+    EXPECT_EQ(stage.Stats().superseded, 0u);
+}
+
+TEST(PipelineStage, StopCancelsTheItemInFlight) {
+    std::promise<void> started;
+    std::atomic<bool> saw_stop = false;
+    PipelineStage<int> stage("slow", [&](int&&, std::stop_token stop) {
+        started.set_value();
+        while (!stop.stop_requested()) std::this_thread::sleep_for(1ms);
+        saw_stop = true;
+    });
+    stage.Start();
+    stage.Push(1);
+    started.get_future().wait();
+    stage.Stop();
+    EXPECT_TRUE(saw_stop);
+    EXPECT_EQ(stage.Stats().superseded, 0u); // shutdown, not a newer item
+}
+
+TEST(PipelineStage, AChainOfStagesEndsOnTheNewestInput) {
+    // A fast "OCR" stage feeding a slow "translate" stage that gives up on superseded work, as in
+    // the screen pipeline. Whatever gets dropped or cancelled on the way, the last input comes out.
+    Sink sink;
+    PipelineStage<int> translate("translate", [&](int&& value, std::stop_token stop) {
+        for (int i = 0; i < 5; ++i) {
+            if (stop.stop_requested()) return;
+            std::this_thread::sleep_for(1ms);
+        }
+        sink.Add(value);
+    }, { .capacity = 1, .cancel_superseded = true });
+    PipelineStage<int> ocr("ocr", [&](int&& value, std::stop_token) { translate.Push(value); });
+    translate.Start();
+    ocr.Start();
+
+    constexpr int INPUTS = 50;
+    for (int i = 1; i <= INPUTS; ++i) ocr.Push(i);
+    ASSERT_TRUE(sink.WaitFor(INPUTS));
+    ocr.Stop();
+    translate.Stop();
+
+    auto values = sink.values();
+    EXPECT_TRUE(std::is_sorted(values.begin(), values.end()));
+    auto ocr_stats = ocr.Stats();
+    auto translate_stats = translate.Stats();
+    EXPECT_EQ(ocr_stats.processed + ocr_stats.dropped, static_cast<uint64_t>(INPUTS));
+    EXPECT_EQ(translate_stats.processed + translate_stats.dropped + translate_stats.superseded, ocr_stats.processed);
+    EXPECT_LE(translate_stats.processed, values.size()); // one superseded just after finishing still counts as such
+}
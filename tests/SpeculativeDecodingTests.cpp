@@ -0,0 +1,215 @@
+#include "SpeculativeDecoding.h"
+
+#include <array>
+#include <map>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+constexpr int32_t BOS = 0;
+constexpr int32_t EOS = 2;
+constexpr int32_t RIVAL = 15; // the runner-up at a near tie
+constexpr int64_t VOCAB = 16;
+constexpr float NEAR_TIE_GAP = 0.05f; // under SPECULATIVE_MIN_MARGIN of a logit of 10
+constexpr DraftOptions OPTIONS{ BOS, EOS, 64, 8 };
+
+// A decoder whose greedy output is `target`. At the positions in `ties` (indexes into the output)
+// RIVAL trails the target token by NEAR_TIE_GAP, unless the run or the cache it extends came from
+// a multi-token run; then, as if rounded differently, RIVAL leads by the tie's drift. Off the
+// target, EOS leads RIVAL by NEAR_TIE_GAP.
+class StubDecoder : public DraftDecoder {
+public:
+    explicit StubDecoder(std::vector<int32_t> target, std::map<size_t, float> ties = {})
+        : target_(std::move(target)), ties_(std::move(ties)) {}
+
+    void Run(const std::vector<int32_t>& tokens) override {
+        ++runs;
+        logits_.clear();
+        for (int32_t token : tokens) {
+            cache_.push_back({ token, tokens.size() > 1 });
+            logits_.push_back(Score());
+        }
+    }
+
+    const float* Logits(size_t i) override { return logits_.at(i).data(); }
+    int64_t VocabSize() const override { return VOCAB; }
+    void Truncate(size_t length) override { cache_.resize((std::min)(length, cache_.size())); }
+    void Checkpoint() override { checkpoint_ = cache_; }
+    void Restore() override { cache_ = checkpoint_; }
+
+    size_t runs = 0;
+
+private:
+    struct Entry {
+        int32_t token;
+        bool from_block;
+    };
+
+    // Logits for the token after everything in the cache.
+    std::array<float, VOCAB> Score() const {
+        std::array<float, VOCAB> logits{};
+        size_t length = cache_.size() - 1; // decoded tokens, BOS aside
+        bool on_target = length <= target_.size() && std::equal(cache_.begin() + 1, cache_.end(), target_.begin(),
+            [](const Entry& entry, int32_t token) { return entry.token == token; });
+        if (!on_target) {
+            logits[EOS] = 10.0f;
+            logits[RIVAL] = 10.0f - NEAR_TIE_GAP;
+        } else if (length == target_.size()) {
+            logits[EOS] = 10.0f;
+        } else {
+            logits[target_[length]] = 10.0f;
+            if (auto tie = ties_.find(length); tie != ties_.end()) {
+                bool rounded = std::any_of(cache_.begin(), cache_.end(), [](const Entry& entry) { return entry.from_block; });
+                logits[RIVAL] = rounded ? 10.0f + tie->second : 10.0f - NEAR_TIE_GAP;
+            }
+        }
+        return logits;
+    }
+
+    std::vector<int32_t> target_;
+    std::map<size_t, float> ties_;
+    std::vector<Entry> cache_;
+    std::vector<Entry> checkpoint_;
+    std::vector<std::array<float, VOCAB>> logits_;
+};
+
+// Plain greedy decoding: one single-token run per output token.
+std::vector<int32_t> PlainGreedy(StubDecoder& decoder) {
+    std::vector<int32_t> tokens;
+    int32_t last = BOS;
+    while (tokens.size() < OPTIONS.max_tokens) {
+        decoder.Run({ last });
+        last = DecisiveArgmax(decoder.Logits(0), VOCAB).first;
+        if (last == EOS) break;
+        tokens.push_back(last);
+    }
+    return tokens;
+}
+
+std::vector<int32_t> Target() {
+    return { 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 3, 5, 7, 9, 11, 13, 4, 6 };
+}
+
+} // namespace
+
+// --- Draft Continuation ---
+
+TEST(DraftContinuation, FollowsTheOutputsLastTwoTokens) {
+    std::vector<int32_t> draft = { 3, 4, 5, 4, 6 };
+    EXPECT_EQ(FindDraftContinuation(draft, {}, 0), 0u);
+    EXPECT_EQ(FindDraftContinuation(draft, { 3, 4 }, 0), 2u);
+    EXPECT_EQ(FindDraftContinuation(draft, { 5, 4 }, 0), 4u);
+    EXPECT_EQ(FindDraftContinuation(draft, { 9, 4 }, 0), SIZE_MAX);
+    EXPECT_EQ(FindDraftContinuation(draft, { 4, 6 }, 0), 5u);
+}
+
+// --- Speculative Decoding ---
+
+TEST(SpeculativeDecoding, MatchesGreedyDecodingWithAnyDraft) {
+    std::map<size_t, float> ties = { { 4, NEAR_TIE_GAP }, { 11, NEAR_TIE_GAP } };
+    StubDecoder reference(Target(), ties);
+    auto greedy = PlainGreedy(reference);
+    ASSERT_EQ(greedy, Target());
+
+    std::vector<int32_t> grown(greedy.begin(), greedy.end() - 3);
+    std::vector<int32_t> inserted = greedy;
+    inserted.insert(inserted.begin() + 6, { 14, 13 });
+    std::vector<int32_t> longer = greedy;
+    longer.insert(longer.end(), { 5, 5, 5 });
+    std::vector<int32_t> unrelated = { 6, 6, 8, 8, 10, 10, 12, 12 };
+    for (const auto& draft : { greedy, grown, inserted, longer, unrelated, std::vector<int32_t>{} }) {
+        StubDecoder decoder(Target(), ties);
+        SpeculativeStats stats;
+        std::vector<int32_t> output;
+        std::vector<int32_t> streamed;
+        ASSERT_TRUE(DecodeWithDraft(decoder, draft, output, OPTIONS, stats, {},
+            [&](const std::vector<int32_t>& tokens) { streamed = tokens; }));
+        EXPECT_EQ(output, greedy) << "draft of " << draft.size() << " tokens";
+        EXPECT_EQ(streamed, greedy);
+    }
+}
+
+TEST(SpeculativeDecoding, ChecksAGoodDraftInFewerRuns) {
+    StubDecoder reference(Target());
+    auto greedy = PlainGreedy(reference);
+
+    StubDecoder decoder(Target());
+    SpeculativeStats stats;
+    std::vector<int32_t> output;
+    ASSERT_TRUE(DecodeWithDraft(decoder, greedy, output, OPTIONS, stats));
+    EXPECT_EQ(output, greedy);
+    EXPECT_EQ(stats.accepted_tokens, greedy.size() - 2); // the last pick of each block is the model's own
+    EXPECT_EQ(stats.exact_reruns, 0u);
+    EXPECT_LT(decoder.runs, reference.runs / 4);
+}
+
+TEST(SpeculativeDecoding, SettlesANearTieAfterABlockRunFromSingleSteps) {
+    // The draft covers the first four tokens; the fifth is a near tie that the cache written by the
+    // block run would tip towards RIVAL.
+    StubDecoder reference(Target(), { { 4, NEAR_TIE_GAP } });
+    auto greedy = PlainGreedy(reference);
+    std::vector<int32_t> draft(greedy.begin(), greedy.begin() + 4);
+
+    StubDecoder decoder(Target(), { { 4, NEAR_TIE_GAP } });
+    SpeculativeStats stats;
+    std::vector<int32_t> output;
+    ASSERT_TRUE(DecodeWithDraft(decoder, draft, output, OPTIONS, stats));
+    EXPECT_EQ(output, greedy);
+    EXPECT_EQ(stats.exact_reruns, 1u);
+    EXPECT_EQ(stats.accepted_tokens, draft.size());
+}
+
+TEST(SpeculativeDecoding, RepairsAKeptPickThatRoundingFlipped) {
+    // Rounding moves RIVAL far enough ahead at position 3 to look decisive. The output then leaves
+    // the target, where the next position is unsettled, and replaying from single steps finds the
+    // flipped pick.
+    StubDecoder reference(Target(), { { 3, 0.5f } });
+    auto greedy = PlainGreedy(reference);
+
+    StubDecoder decoder(Target(), { { 3, 0.5f } });
+    SpeculativeStats stats;
+    std::vector<int32_t> output;
+    std::vector<std::vector<int32_t>> streamed;
+    ASSERT_TRUE(DecodeWithDraft(decoder, greedy, output, OPTIONS, stats, {},
+        [&](const std::vector<int32_t>& tokens) { streamed.push_back(tokens); }));
+    EXPECT_EQ(output, greedy);
+    EXPECT_EQ(stats.exact_reruns, 1u);
+    EXPECT_EQ(streamed.front(), (std::vector<int32_t>{ 3, 4, 5, RIVAL }));
+    EXPECT_EQ(streamed.back(), greedy);
+}
+
+TEST(SpeculativeDecoding, RunsOneTokenAtATimeWithoutBlocks) {
+    StubDecoder reference(Target(), { { 4, NEAR_TIE_GAP } });
+    auto greedy = PlainGreedy(reference);
+
+    StubDecoder decoder(Target(), { { 4, NEAR_TIE_GAP } });
+    SpeculativeStats stats;
+    std::vector<int32_t> output;
+    DraftOptions options = OPTIONS;
+    options.max_block = 0;
+    ASSERT_TRUE(DecodeWithDraft(decoder, greedy, output, options, stats));
+    EXPECT_EQ(output, greedy);
+    EXPECT_EQ(stats.verify_passes, 0u);
+    EXPECT_EQ(decoder.runs, reference.runs);
+}
+
+TEST(SpeculativeDecoding, StopsAtTheTokenLimit) {
+    StubDecoder decoder(Target());
+    SpeculativeStats stats;
+    std::vector<int32_t> output;
+    DraftOptions options = OPTIONS;
+    options.max_tokens = 5;
+    ASSERT_TRUE(DecodeWithDraft(decoder, Target(), output, options, stats));
+    EXPECT_EQ(output, (std::vector<int32_t>{ 3, 4, 5, 6, 7 }));
+}
+
+TEST(SpeculativeDecoding, StopsWhenAsked) {
+    StubDecoder decoder(Target());
+    SpeculativeStats stats;
+    std::vector<int32_t> output;
+    std::stop_source stop;
+    stop.request_stop();
+    EXPECT_FALSE(DecodeWithDraft(decoder, Target(), output, OPTIONS, stats, stop.get_token()));
+    EXPECT_EQ(decoder.runs, 0u);
+}
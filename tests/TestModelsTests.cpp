@@ -0,0 +1,164 @@
+#include "TestModels.h"
+
+#include <map>
+#include <set>
+#include <sstream>
+
+#include <gtest/gtest.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Fields of one protobuf message: varints and floats as numbers, length-delimited ones as bytes.
+struct ProtoFields {
+    std::multimap<uint32_t, uint64_t> numbers;
+    std::multimap<uint32_t, std::string> bytes;
+
+    std::vector<std::string> All(uint32_t field) const {
+        std::vector<std::string> values;
+        for (auto [it, end] = bytes.equal_range(field); it != end; ++it) values.push_back(it->second);
+        return values;
+    }
+
+    std::string One(uint32_t field) const {
+        auto values = All(field);
+        return values.empty() ? std::string() : values.front();
+    }
+};
+
+ProtoFields ParseProto(const std::string& message) {
+    ProtoFields fields;
+    size_t i = 0;
+    auto varint = [&] {
+        uint64_t value = 0;
+        for (int shift = 0; i < message.size(); shift += 7) {
+            auto byte = static_cast<uint8_t>(message[i++]);
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) break;
+        }
+        return value;
+    };
+    while (i < message.size()) {
+        uint64_t tag = varint();
+        auto field = static_cast<uint32_t>(tag >> 3);
+        switch (tag & 7) {
+        case 0:
+            fields.numbers.emplace(field, varint());
+            break;
+        case 2: {
+            size_t length = varint();
+            fields.bytes.emplace(field, message.substr(i, length));
+            i += length;
+            break;
+        }
+        case 5: {
+            uint32_t bits = 0;
+            std::memcpy(&bits, message.data() + i, sizeof(bits));
+            fields.numbers.emplace(field, bits);
+            i += 4;
+            break;
+        }
+        default:
+            ADD_FAILURE() << "unexpected wire type " << (tag & 7);
+            return fields;
+        }
+    }
+    return fields;
+}
+
+std::string ReadFile(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+struct GraphSummary {
+    std::vector<std::string> inputs, outputs;
+    std::set<std::string> ops;
+};
+
+// Names of a model's graph inputs and outputs; fails the test if a node reads a value that no
+// input, initializer or earlier node defines, or an output is never produced.
+GraphSummary SummarizeGraph(const std::string& model) {
+    auto graph = ParseProto(ParseProto(model).One(7));
+    GraphSummary summary;
+    std::set<std::string> defined;
+    for (const auto& input : graph.All(11)) {
+        summary.inputs.push_back(ParseProto(input).One(1));
+        defined.insert(summary.inputs.back());
+    }
+    for (const auto& initializer : graph.All(5)) defined.insert(ParseProto(initializer).One(8));
+    for (const auto& node_bytes : graph.All(1)) {
+        auto node = ParseProto(node_bytes);
+        for (const auto& input : node.All(1)) EXPECT_TRUE(defined.contains(input)) << node.One(4) << " reads undefined " << input;
+        for (const auto& output : node.All(2)) EXPECT_TRUE(defined.insert(output).second) << output << " defined twice";
+        summary.ops.insert(node.One(4));
+    }
+    for (const auto& output : graph.All(12)) {
+        summary.outputs.push_back(ParseProto(output).One(1));
+        EXPECT_TRUE(defined.contains(summary.outputs.back())) << summary.outputs.back() << " never produced";
+    }
+    return summary;
+}
+
+std::filesystem::path TestDirectory() {
+#ifdef _WIN32
+    auto pid = GetCurrentProcessId();
+#else
+    auto pid = getpid();
+#endif
+    return std::filesystem::temp_directory_path() / ("osl-test-models-" + std::to_string(pid));
+}
+
+} // namespace
+
+// --- Test Models ---
+
+TEST(TestModels, WritesTheFilesTheEngineLooksFor) {
+    auto directory = TestDirectory();
+    ASSERT_TRUE(WriteTestModels(directory));
+    for (const char* name : { "encoder_model.onnx", "decoder_model.onnx", "decoder_with_past_model.onnx", "source.spm", "target.spm" }) {
+        EXPECT_TRUE(std::filesystem::exists(directory / name)) << name;
+    }
+    auto first = ReadFile(directory / "decoder_with_past_model.onnx");
+    ASSERT_TRUE(WriteTestModels(directory));
+    EXPECT_EQ(ReadFile(directory / "decoder_with_past_model.onnx"), first);
+    std::filesystem::remove_all(directory);
+}
+
+TEST(TestModels, GraphsHaveTheExportsInputsAndOutputs) {
+    auto vocab_size = static_cast<int64_t>(TestModelVocabulary().size());
+    auto encoder = SummarizeGraph(SerializeTestEncoder(vocab_size));
+    EXPECT_EQ(encoder.inputs, (std::vector<std::string>{ "input_ids", "attention_mask" }));
+    EXPECT_EQ(encoder.outputs, (std::vector<std::string>{ "last_hidden_state" }));
+
+    auto decoder = SummarizeGraph(SerializeTestDecoder(vocab_size, false));
+    EXPECT_EQ(decoder.inputs, (std::vector<std::string>{ "input_ids", "encoder_hidden_states" }));
+    EXPECT_EQ(decoder.outputs, (std::vector<std::string>{ "logits", "present.0.decoder.key", "present.0.decoder.value" }));
+
+    auto step = SummarizeGraph(SerializeTestDecoder(vocab_size, true));
+    EXPECT_EQ(step.inputs, (std::vector<std::string>{ "input_ids", "encoder_hidden_states",
+        "past_key_values.0.decoder.key", "past_key_values.0.decoder.value" }));
+    EXPECT_EQ(step.outputs, decoder.outputs);
+    EXPECT_TRUE(step.ops.contains("Concat"));
+}
+
+TEST(TestModels, VocabularyKeepsTheEnginesSpecialIds) {
+    auto model = ParseProto(SerializeTestSentencePieceModel());
+    auto pieces = model.All(1);
+    ASSERT_EQ(pieces.size(), TestModelVocabulary().size());
+    EXPECT_EQ(ParseProto(pieces[0]).One(1), "<pad>");
+    EXPECT_EQ(ParseProto(pieces[1]).One(1), "<unk>");
+    EXPECT_EQ(ParseProto(pieces[2]).One(1), "</s>");
+    std::set<std::string> unique;
+    for (const auto& piece : pieces) EXPECT_TRUE(unique.insert(ParseProto(piece).One(1)).second);
+
+    auto trainer = ParseProto(model.One(2));
+    EXPECT_EQ(trainer.numbers.find(40)->second, 1u); // unk_id
+    EXPECT_EQ(trainer.numbers.find(42)->second, 2u); // eos_id
+    EXPECT_EQ(trainer.numbers.find(43)->second, 0u); // pad_id
+}
@@ -0,0 +1,199 @@
+#include "TranslationCache.h"
+
+#include <fstream>
+
+#include <gtest/gtest.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr uint64_t MODEL = 0x1234;
+constexpr uint64_t DISK_BUDGET = 1ull << 20; // the store's initial size: it never grows
+constexpr uint64_t HEADER_SIZE = 32;
+constexpr uint64_t RECORD_HEADER_SIZE = 16;
+
+// A fresh per-test cache directory under the temp directory, removed again at the end.
+class TranslationCacheTest : public testing::Test {
+protected:
+    void SetUp() override {
+        auto test = testing::UnitTest::GetInstance()->current_test_info()->name();
+#ifdef _WIN32
+        auto pid = GetCurrentProcessId();
+#else
+        auto pid = getpid();
+#endif
+        root_ = fs::temp_directory_path() / ("osl-cache-" + std::to_string(pid) + "-" + test);
+        fs::remove_all(root_);
+    }
+
+    void TearDown() override {
+        std::error_code ec;
+        fs::remove_all(root_, ec);
+    }
+
+    TranslationCache Open(uint64_t model = MODEL, size_t memory_budget = 1 << 20, uint64_t disk_budget = DISK_BUDGET) {
+        return TranslationCache(root_, model, memory_budget, disk_budget);
+    }
+
+    fs::path StorePath(uint64_t model = MODEL) const {
+        char file_name[64];
+        std::snprintf(file_name, sizeof(file_name), "translation_cache_%016llx.bin", static_cast<unsigned long long>(model));
+        return root_ / file_name;
+    }
+
+    // Reads or overwrites 8 bytes of the closed store at `offset`.
+    uint64_t ReadStore(uint64_t offset) const {
+        std::ifstream file(StorePath(), std::ios::binary);
+        uint64_t value = 0;
+        file.seekg(static_cast<std::streamoff>(offset));
+        file.read(reinterpret_cast<char*>(&value), sizeof(value));
+        return value;
+    }
+
+    void WriteStore(uint64_t offset, const void* data, size_t size) const {
+        std::fstream file(StorePath(), std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(static_cast<std::streamoff>(offset));
+        file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    }
+
+    fs::path root_;
+};
+
+uint64_t RecordSize(const std::string& source, const std::string& target) {
+    return (RECORD_HEADER_SIZE + source.size() + target.size() + 7) & ~uint64_t{ 7 };
+}
+
+} // namespace
+
+// --- Normalization ---
+
+TEST(NormalizeSegment, CollapsesAndTrimsWhitespace) {
+    EXPECT_EQ(NormalizeSegment("  Hello \t\n world  "), "Hello world");
+    EXPECT_EQ(NormalizeSegment(" \r\n "), "");
+    EXPECT_EQ(NormalizeSegment("a"), "a");
+}
+
+// --- Translation Cache ---
+
+TEST_F(TranslationCacheTest, ReloadsFromDiskAfterARestart) {
+    {
+        auto cache = Open();
+        EXPECT_FALSE(cache.Lookup("Hello"));
+        cache.Insert("Hello", "Hallo");
+        cache.Insert("World", "Welt");
+        cache.Insert("Hello", "Servus"); // the later record wins
+        EXPECT_EQ(cache.Lookup("Hello"), "Servus");
+        EXPECT_EQ(cache.Stats().memory_hits, 1u);
+    }
+    {
+        auto cache = Open();
+        EXPECT_EQ(cache.Stats().disk_records, 2u);
+        EXPECT_EQ(cache.Lookup("Hello"), "Servus");
+        EXPECT_EQ(cache.Lookup("World"), "Welt");
+        EXPECT_EQ(cache.Lookup("World"), "Welt");
+        auto stats = cache.Stats();
+        EXPECT_EQ(stats.disk_hits, 2u);
+        EXPECT_EQ(stats.memory_hits, 1u);
+    }
+    // Another model has its own store.
+    auto other = Open(MODEL + 1);
+    EXPECT_FALSE(other.Lookup("Hello"));
+}
+
+TEST_F(TranslationCacheTest, DropsATruncatedLastRecord) {
+    {
+        auto cache = Open();
+        cache.Insert("first", "erste");
+        cache.Insert("second", "zweite");
+    }
+    // The store ends partway through the second record, as if the process died while writing it.
+    uint64_t used_bytes = HEADER_SIZE + RecordSize("first", "erste") + RecordSize("second", "zweite");
+    ASSERT_EQ(ReadStore(8), used_bytes);
+    uint64_t truncated = used_bytes - 8;
+    WriteStore(8, &truncated, sizeof(truncated));
+    {
+        auto cache = Open();
+        EXPECT_EQ(cache.Stats().disk_records, 1u);
+        EXPECT_EQ(cache.Lookup("first"), "erste");
+        EXPECT_FALSE(cache.Lookup("second"));
+        cache.Insert("third", "dritte"); // goes where the torn record was
+    }
+    EXPECT_EQ(ReadStore(8), HEADER_SIZE + RecordSize("first", "erste") + RecordSize("third", "dritte"));
+    auto cache = Open();
+    EXPECT_EQ(cache.Lookup("first"), "erste");
+    EXPECT_EQ(cache.Lookup("third"), "dritte");
+}
+
+TEST_F(TranslationCacheTest, StartsOverWhenTheHeaderIsCorrupt) {
+    for (uint64_t used_bytes : { uint64_t{ 0 }, HEADER_SIZE - 1, DISK_BUDGET + 1, ~uint64_t{ 0 } }) {
+        {
+            auto cache = Open();
+            cache.Insert("line", "Zeile");
+        }
+        WriteStore(8, &used_bytes, sizeof(used_bytes));
+        {
+            auto cache = Open();
+            EXPECT_EQ(cache.Stats().disk_records, 0u) << used_bytes;
+            EXPECT_FALSE(cache.Lookup("line")) << used_bytes;
+            cache.Insert("line", "Zeile");
+        }
+        auto cache = Open();
+        EXPECT_EQ(cache.Lookup("line"), "Zeile") << used_bytes;
+    }
+}
+
+TEST_F(TranslationCacheTest, RejectsARecordWhoseSourceDoesNotMatchItsHash) {
+    {
+        auto cache = Open();
+        cache.Insert("abc", "x");
+    }
+    // The record still carries the hash of "abc" but now holds "abd", as a colliding segment would.
+    WriteStore(HEADER_SIZE + RECORD_HEADER_SIZE + 2, "d", 1);
+    auto cache = Open();
+    EXPECT_EQ(cache.Stats().disk_records, 1u);
+    EXPECT_FALSE(cache.Lookup("abc"));
+    EXPECT_FALSE(cache.Lookup("abd"));
+    EXPECT_EQ(cache.Stats().misses, 2u);
+}
+
+TEST_F(TranslationCacheTest, EvictsTheLeastRecentlyUsedPastTheMemoryBudget) {
+    // Without a disk store (budget under its initial size), evicted entries are gone.
+    const size_t entry_bytes = 2 * 2 + 2 + 64; // two 2-byte strings and the bookkeeping estimate
+    TranslationCache cache(root_, MODEL, 3 * entry_bytes, 0);
+    cache.Insert("k1", "v1");
+    cache.Insert("k2", "v2");
+    cache.Insert("k3", "v3");
+    EXPECT_EQ(cache.Lookup("k1"), "v1"); // now the most recently used
+    cache.Insert("k4", "v4");
+    auto stats = cache.Stats();
+    EXPECT_EQ(stats.evictions, 1u);
+    EXPECT_EQ(stats.memory_bytes, 3 * entry_bytes);
+    EXPECT_FALSE(cache.Lookup("k2"));
+    EXPECT_EQ(cache.Lookup("k1"), "v1");
+    EXPECT_EQ(cache.Lookup("k3"), "v3");
+    EXPECT_EQ(cache.Lookup("k4"), "v4");
+    EXPECT_FALSE(fs::exists(StorePath()));
+}
+
+TEST_F(TranslationCacheTest, KeepsServingAndCountsWhatAFullStoreCannotTake) {
+    const std::string target(100 * 1024, 't');
+    size_t stored = 0;
+    {
+        auto cache = Open(MODEL, 1 << 20, DISK_BUDGET);
+        for (int i = 0; i < 12; ++i) cache.Insert("segment " + std::to_string(i), target);
+        auto stats = cache.Stats();
+        stored = stats.disk_records;
+        EXPECT_EQ(stored, (DISK_BUDGET - HEADER_SIZE) / RecordSize("segment 0", target));
+        EXPECT_EQ(stats.not_persisted, 12u - stored);
+        EXPECT_EQ(cache.Lookup("segment 11"), target); // still in memory
+    }
+    auto cache = Open(MODEL, 0, DISK_BUDGET);
+    EXPECT_EQ(cache.Lookup("segment 0"), target);
+    EXPECT_FALSE(cache.Lookup("segment 11"));
+    EXPECT_EQ(fs::file_size(StorePath()), DISK_BUDGET);
+}
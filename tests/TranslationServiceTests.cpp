@@ -0,0 +1,316 @@
+#include "TranslationService.h"
+
+#include <filesystem>
+#include <sstream>
+
+#include <gtest/gtest.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace {
+
+// A per-process endpoint, so parallel test runs don't collide: a pipe name on Windows, a socket
+// path in the temp directory elsewhere.
+std::string TestEndpoint(const std::string& name) {
+#ifdef _WIN32
+    return "OfflineScreenLanceTest-" + std::to_string(GetCurrentProcessId()) + "-" + name;
+#else
+    auto path = std::filesystem::temp_directory_path() / ("osl-test-" + std::to_string(getpid()) + "-" + name + ".sock");
+    return path.string();
+#endif
+}
+
+std::vector<ServiceResult> Echo(const std::vector<std::string>& texts) {
+    std::vector<ServiceResult> results;
+    for (const auto& text : texts) results.push_back({ text != "fail", "T(" + text + ")" });
+    return results;
+}
+
+// Holds translation until Release, so tests can put requests in flight deterministically.
+class Gate {
+public:
+    void Wait() {
+        std::unique_lock lock(mutex_);
+        cv_.wait(lock, [&] { return open_; });
+    }
+
+    void Release() {
+        std::lock_guard lock(mutex_);
+        open_ = true;
+        cv_.notify_all();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool open_ = false;
+};
+
+} // namespace
+
+// --- Wire Protocol ---
+
+TEST(WireProtocol, ReassemblesMessagesFedOneByteAtATime) {
+    ServiceMessage result{ MessageType::Result, ResultStatus::Error, 0xDEADBEEF, "h\xC3\xA9llo" };
+    auto bytes = EncodeMessage(result) + EncodeMessage({ MessageType::Shutdown, ResultStatus::Ok, 7, {} });
+    ASSERT_EQ(bytes.size(), 2 * SERVICE_HEADER_BYTES + result.text.size());
+
+    MessageReader reader;
+    std::vector<ServiceMessage> messages;
+    for (char c : bytes) {
+        reader.Append(&c, 1);
+        while (auto message = reader.Next()) messages.push_back(*message);
+    }
+    ASSERT_EQ(messages.size(), 2u);
+    EXPECT_EQ(messages[0].type, MessageType::Result);
+    EXPECT_EQ(messages[0].status, ResultStatus::Error);
+    EXPECT_EQ(messages[0].id, 0xDEADBEEFu);
+    EXPECT_EQ(messages[0].text, result.text);
+    EXPECT_EQ(messages[1].type, MessageType::Shutdown);
+    EXPECT_EQ(messages[1].id, 7u);
+    EXPECT_TRUE(messages[1].text.empty());
+    EXPECT_FALSE(reader.malformed());
+}
+
+TEST(WireProtocol, SplitsMergedMessages) {
+    std::string bytes;
+    for (uint32_t id = 1; id <= 100; ++id) bytes += EncodeMessage({ MessageType::Translate, ResultStatus::Ok, id, std::string(id, 'x') });
+    MessageReader reader;
+    reader.Append(bytes.data(), bytes.size());
+    for (uint32_t id = 1; id <= 100; ++id) {
+        auto message = reader.Next();
+        ASSERT_TRUE(message);
+        EXPECT_EQ(message->id, id);
+        EXPECT_EQ(message->text.size(), id);
+    }
+    EXPECT_FALSE(reader.Next());
+}
+
+TEST(WireProtocol, RejectsUnknownTypesAndOversizedText) {
+    auto unknown = EncodeMessage({ MessageType::Translate, ResultStatus::Ok, 1, "x" });
+    unknown[4] = 9;
+    MessageReader reader;
+    reader.Append(unknown.data(), unknown.size());
+    EXPECT_FALSE(reader.Next());
+    EXPECT_TRUE(reader.malformed());
+
+    auto oversized = EncodeMessage({ MessageType::Translate, ResultStatus::Ok, 1, {} });
+    uint32_t length = SERVICE_MAX_TEXT_BYTES + 1;
+    for (int i = 0; i < 4; ++i) oversized[i] = static_cast<char>((length >> (8 * i)) & 0xFF);
+    MessageReader oversized_reader;
+    oversized_reader.Append(oversized.data(), oversized.size());
+    EXPECT_FALSE(oversized_reader.Next());
+    EXPECT_TRUE(oversized_reader.malformed());
+}
+
+// --- Dynamic Batcher ---
+
+TEST(DynamicBatcher, FillsBatchesUpToMaxBatch) {
+    std::mutex mutex;
+    std::vector<size_t> batch_sizes;
+    DynamicBatcher batcher([&](const std::vector<std::string>& texts) {
+        std::lock_guard lock(mutex);
+        batch_sizes.push_back(texts.size());
+        return Echo(texts);
+    }, 4, std::chrono::seconds(30));
+
+    std::vector<std::future<ServiceResult>> results;
+    for (int i = 0; i < 8; ++i) {
+        auto promise = std::make_shared<std::promise<ServiceResult>>();
+        results.push_back(promise->get_future());
+        batcher.Submit(std::to_string(i), [promise](ServiceResult result) { promise->set_value(std::move(result)); });
+    }
+    // Full batches don't wait out the 30 s delay.
+    for (int i = 0; i < 8; ++i) {
+        ASSERT_EQ(results[i].wait_for(std::chrono::seconds(10)), std::future_status::ready);
+        EXPECT_EQ(results[i].get().text, "T(" + std::to_string(i) + ")");
+    }
+    batcher.Stop();
+    EXPECT_EQ(batch_sizes, (std::vector<size_t>{ 4, 4 }));
+    EXPECT_EQ(batcher.stats().batches, 2u);
+    EXPECT_EQ(batcher.stats().requests, 8u);
+    EXPECT_EQ(batcher.stats().largest_batch, 4u);
+}
+
+TEST(DynamicBatcher, SendsAPartialBatchAfterMaxDelay) {
+    DynamicBatcher batcher(Echo, 16, std::chrono::milliseconds(5));
+    std::promise<ServiceResult> promise;
+    auto result = promise.get_future();
+    batcher.Submit("lone", [&](ServiceResult r) { promise.set_value(std::move(r)); });
+    ASSERT_EQ(result.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    auto translation = result.get();
+    EXPECT_TRUE(translation.ok);
+    EXPECT_EQ(translation.text, "T(lone)");
+    EXPECT_EQ(batcher.stats().largest_batch, 1u);
+}
+
+TEST(DynamicBatcher, StopTranslatesWhatIsQueuedAndRefusesTheRest) {
+    DynamicBatcher batcher(Echo, 16, std::chrono::seconds(30));
+    std::vector<ServiceResult> results(3);
+    for (size_t i = 0; i < results.size(); ++i) {
+        batcher.Submit(std::to_string(i), [&results, i](ServiceResult r) { results[i] = std::move(r); });
+    }
+    batcher.Stop();
+    for (size_t i = 0; i < results.size(); ++i) {
+        EXPECT_TRUE(results[i].ok);
+        EXPECT_EQ(results[i].text, "T(" + std::to_string(i) + ")");
+    }
+
+    ServiceResult late{ true, {} };
+    batcher.Submit("late", [&](ServiceResult r) { late = std::move(r); });
+    EXPECT_FALSE(late.ok);
+}
+
+TEST(DynamicBatcher, FailsTheBatchWhenTranslationThrows) {
+    DynamicBatcher batcher([](const std::vector<std::string>&) -> std::vector<ServiceResult> {
+        throw std::runtime_error("out of memory");
+    }, 16, std::chrono::milliseconds(1));
+    std::vector<ServiceResult> results(2);
+    batcher.Submit("a", [&](ServiceResult r) { results[0] = std::move(r); });
+    batcher.Submit("b", [&](ServiceResult r) { results[1] = std::move(r); });
+    batcher.Stop();
+    for (const auto& result : results) {
+        EXPECT_FALSE(result.ok);
+        EXPECT_EQ(result.text, "out of memory");
+    }
+}
+
+// --- Translation Server ---
+
+TEST(TranslationServer, AnswersPipelinedRequestsById) {
+    DynamicBatcher batcher(Echo, 16, std::chrono::milliseconds(2));
+    TranslationServer server(batcher);
+    auto endpoint = TestEndpoint("roundtrip");
+    ASSERT_TRUE(server.Start(endpoint));
+
+    TranslationClient client;
+    ASSERT_TRUE(client.Connect(endpoint));
+    EXPECT_TRUE(client.connected());
+    std::vector<std::future<ServiceResult>> results;
+    for (int i = 0; i < 50; ++i) results.push_back(client.Translate(i == 7 ? "fail" : std::to_string(i)));
+    for (int i = 0; i < 50; ++i) {
+        auto result = results[i].get();
+        if (i == 7) {
+            EXPECT_FALSE(result.ok);
+        } else {
+            EXPECT_TRUE(result.ok);
+            EXPECT_EQ(result.text, "T(" + std::to_string(i) + ")");
+        }
+    }
+    client.Close();
+    server.Stop();
+    EXPECT_EQ(server.clients_served(), 1u);
+}
+
+TEST(TranslationServer, AClientThatStopsReadingHoldsUpNobodyElse) {
+    DynamicBatcher batcher(Echo, 16, std::chrono::milliseconds(1));
+    TranslationServer server(batcher);
+    auto endpoint = TestEndpoint("stalled");
+    ASSERT_TRUE(server.Start(endpoint));
+
+    // Pipelines more results than the service holds for it, and never reads one.
+    auto stalled = LocalStream::Connect(endpoint);
+    ASSERT_TRUE(stalled);
+    const std::string text(64 * 1024, 'x');
+    for (uint32_t id = 1; id <= 2 * SERVICE_MAX_QUEUED_RESULT_BYTES / text.size(); ++id) {
+        if (!stalled->WriteAll(EncodeMessage({ MessageType::Translate, ResultStatus::Ok, id, text }))) break; // dropped already
+    }
+
+    TranslationClient client;
+    ASSERT_TRUE(client.Connect(endpoint));
+    auto result = client.Translate("hello");
+    ASSERT_EQ(result.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    EXPECT_EQ(result.get().text, "T(hello)");
+
+    // The stalled client was dropped: what was sent before arrives, then the end of the stream.
+    std::vector<char> buffer(1 << 16);
+    while (stalled->ReadSome(buffer.data(), buffer.size()) > 0) {}
+    client.Close();
+    server.Stop();
+}
+
+#ifndef _WIN32
+TEST(TranslationServer, TheSocketIsForThisUserOnly) {
+    DynamicBatcher batcher(Echo, 16, std::chrono::milliseconds(2));
+    TranslationServer server(batcher);
+    auto endpoint = TestEndpoint("mode");
+    ASSERT_TRUE(server.Start(endpoint));
+    struct stat status{};
+    ASSERT_EQ(stat(endpoint.c_str(), &status), 0);
+    EXPECT_EQ(status.st_mode & 0777, 0600u);
+    server.Stop();
+}
+#endif
+
+TEST(TranslationServer, RefusesASecondServerOnTheSameEndpoint) {
+    DynamicBatcher batcher(Echo, 16, std::chrono::milliseconds(2));
+    TranslationServer first(batcher), second(batcher);
+    auto endpoint = TestEndpoint("taken");
+    ASSERT_TRUE(first.Start(endpoint));
+    EXPECT_FALSE(second.Start(endpoint));
+    first.Stop();
+}
+
+TEST(TranslationServer, ShutdownRequestEndsWait) {
+    DynamicBatcher batcher(Echo, 16, std::chrono::milliseconds(2));
+    TranslationServer server(batcher);
+    auto endpoint = TestEndpoint("shutdown");
+    ASSERT_TRUE(server.Start(endpoint));
+    auto waited = std::async(std::launch::async, [&] { server.Wait(); });
+
+    TranslationClient client;
+    ASSERT_TRUE(client.Connect(endpoint));
+    ASSERT_TRUE(client.RequestShutdown());
+    EXPECT_EQ(waited.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    server.Stop();
+
+    TranslationClient late;
+    EXPECT_FALSE(late.Connect(endpoint));
+}
+
+TEST(TranslationServer, ClientFailsPendingRequestsWhenTheServerGoesAway) {
+    Gate gate;
+    DynamicBatcher batcher([&](const std::vector<std::string>& texts) {
+        gate.Wait();
+        return Echo(texts);
+    }, 16, std::chrono::milliseconds(1));
+    TranslationServer server(batcher);
+    auto endpoint = TestEndpoint("lost");
+    ASSERT_TRUE(server.Start(endpoint));
+
+    TranslationClient client;
+    ASSERT_TRUE(client.Connect(endpoint));
+    auto pending = client.Translate("stuck");
+    server.Stop();
+    ASSERT_EQ(pending.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    EXPECT_FALSE(pending.get().ok);
+    EXPECT_FALSE(client.connected());
+    EXPECT_FALSE(client.Translate("after").get().ok);
+
+    gate.Release();
+    batcher.Stop();
+}
+
+TEST(TranslationServer, LoadTestReportsOneRowPerClientCount) {
+    DynamicBatcher batcher(Echo, 16, std::chrono::milliseconds(1));
+    TranslationServer server(batcher);
+    auto endpoint = TestEndpoint("load");
+    ASSERT_TRUE(server.Start(endpoint));
+
+    std::ostringstream report;
+    ASSERT_TRUE(RunServiceLoadTest(endpoint, { "one", "two", "three" }, { 1, 4 }, 25, report));
+    server.Stop();
+
+    std::istringstream lines(report.str());
+    std::string header, row;
+    std::getline(lines, header);
+    EXPECT_EQ(header.rfind("benchmark\tclients\trequests\terrors", 0), 0u);
+    for (const char* expected : { "service_load\t1\t25\t0\t", "service_load\t4\t100\t0\t" }) {
+        ASSERT_TRUE(std::getline(lines, row));
+        EXPECT_EQ(row.rfind(expected, 0), 0u) << row;
+    }
+    EXPECT_EQ(batcher.stats().requests, 125u);
+    EXPECT_FALSE(RunServiceLoadTest(TestEndpoint("nobody"), { "one" }, { 1 }, 1, report));
+}
@@ -0,0 +1,186 @@
+#include "VocabularyShortlist.h"
+
+#include <random>
+#include <set>
+#include <sstream>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+std::vector<frame_hash::Kernel> AvailableKernels() {
+    std::vector<frame_hash::Kernel> kernels = { frame_hash::Kernel::Scalar };
+#ifdef OSL_HAS_X86_SIMD
+    kernels.push_back(frame_hash::Kernel::Sse2);
+    if (frame_hash::CpuSupportsAvx2()) kernels.push_back(frame_hash::Kernel::Avx2);
+#endif
+    return kernels;
+}
+
+std::vector<float> RandomFloats(std::mt19937& rng, size_t count) {
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    std::vector<float> values(count);
+    for (auto& value : values) value = normal(rng);
+    return values;
+}
+
+// An output_projection.bin image with random weights, held in floats so the weights are aligned.
+struct TestProjection {
+    std::vector<float> image;
+    OutputProjection projection;
+
+    TestProjection(std::mt19937& rng, uint32_t vocab_size, uint32_t hidden_size) {
+        auto values = RandomFloats(rng, static_cast<size_t>(vocab_size) * hidden_size + vocab_size);
+        image.resize(OUTPUT_PROJECTION_HEADER_BYTES / sizeof(float) + values.size());
+        auto* bytes = reinterpret_cast<uint8_t*>(image.data());
+        std::memcpy(bytes, OUTPUT_PROJECTION_MAGIC, sizeof(OUTPUT_PROJECTION_MAGIC));
+        std::memcpy(bytes + 8, &vocab_size, sizeof(vocab_size));
+        std::memcpy(bytes + 12, &hidden_size, sizeof(hidden_size));
+        std::copy(values.begin(), values.end(), image.begin() + OUTPUT_PROJECTION_HEADER_BYTES / sizeof(float));
+        projection = *ParseOutputProjection(bytes, image.size() * sizeof(float));
+    }
+};
+
+} // namespace
+
+// --- Output Projection ---
+
+TEST(OutputProjection, ParsesTheHeaderAndRejectsOtherSizes) {
+    std::mt19937 rng(3);
+    TestProjection test(rng, 10, 4);
+    EXPECT_EQ(test.projection.vocab_size, 10u);
+    EXPECT_EQ(test.projection.hidden_size, 4u);
+    EXPECT_EQ(test.projection.bias, test.projection.weights + 40);
+
+    auto* bytes = reinterpret_cast<const uint8_t*>(test.image.data());
+    uint64_t size = test.image.size() * sizeof(float);
+    EXPECT_FALSE(ParseOutputProjection(bytes, size - sizeof(float)));
+    EXPECT_FALSE(ParseOutputProjection(bytes, OUTPUT_PROJECTION_HEADER_BYTES - 1));
+    std::vector<float> corrupt = test.image;
+    reinterpret_cast<uint8_t*>(corrupt.data())[0] = 'X';
+    EXPECT_FALSE(ParseOutputProjection(reinterpret_cast<const uint8_t*>(corrupt.data()), size));
+}
+
+// --- Projection Kernels ---
+
+TEST(ProjectionKernels, DotProductsAreBitIdenticalToScalar) {
+    std::mt19937 rng(11);
+    // Sizes that leave a tail after the 16-lane body, and ones under a single body step.
+    for (size_t size : { size_t{ 1 }, size_t{ 7 }, size_t{ 15 }, size_t{ 16 }, size_t{ 17 }, size_t{ 37 }, size_t{ 100 }, size_t{ 517 } }) {
+        for (int iteration = 0; iteration < 20; ++iteration) {
+            auto row = RandomFloats(rng, size), hidden = RandomFloats(rng, size);
+            float scalar = projection_kernels::DotScalar(row.data(), hidden.data(), size);
+            for (auto kernel : AvailableKernels()) {
+                float value = projection_kernels::DotKernel(kernel)(row.data(), hidden.data(), size);
+                ASSERT_EQ(std::memcmp(&value, &scalar, sizeof(float)), 0)
+                    << frame_hash::KernelName(kernel) << ", " << size << " elements: " << value << " vs " << scalar;
+            }
+        }
+    }
+}
+
+TEST(ProjectionKernels, BlockedRowsMatchOneRowAtATime) {
+    std::mt19937 rng(5);
+    // A vocabulary that ends in a partial block, and a hidden size that leaves a tail.
+    TestProjection test(rng, 3 * PROJECTION_BLOCK_TOKENS + 29, 37);
+    std::vector<std::vector<float>> hidden_states;
+    for (int row = 0; row < 5; ++row) hidden_states.push_back(RandomFloats(rng, test.projection.hidden_size));
+    std::vector<const float*> hidden;
+    for (const auto& state : hidden_states) hidden.push_back(state.data());
+
+    ProjectedPick scalar = ProjectArgmax(test.projection, hidden[0], nullptr, 0, frame_hash::Kernel::Scalar);
+    for (auto kernel : AvailableKernels()) {
+        std::vector<ProjectedPick> picks(hidden.size());
+        ProjectArgmaxRows(test.projection, hidden.data(), hidden.size(), picks.data(), kernel);
+        for (size_t row = 0; row < hidden.size(); ++row) {
+            ProjectedPick single = ProjectArgmax(test.projection, hidden[row], nullptr, 0, kernel);
+            EXPECT_EQ(picks[row].token, single.token) << frame_hash::KernelName(kernel) << ", row " << row;
+            EXPECT_EQ(picks[row].score, single.score) << frame_hash::KernelName(kernel) << ", row " << row;
+            EXPECT_EQ(picks[row].runner_up, single.runner_up) << frame_hash::KernelName(kernel) << ", row " << row;
+        }
+        EXPECT_EQ(picks[0].token, scalar.token) << frame_hash::KernelName(kernel);
+        EXPECT_EQ(picks[0].score, scalar.score) << frame_hash::KernelName(kernel);
+    }
+}
+
+TEST(ProjectionKernels, AShortlistScoresItsTokensAsTheFullVocabularyDoes) {
+    std::mt19937 rng(9);
+    TestProjection test(rng, 200, 21);
+    auto hidden = RandomFloats(rng, test.projection.hidden_size);
+    for (auto kernel : AvailableKernels()) {
+        ProjectedPick full = ProjectArgmax(test.projection, hidden.data(), nullptr, 0, kernel);
+        std::vector<int32_t> candidates = { 3, 17, full.token, 150 };
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+        ProjectedPick pick = ProjectArgmax(test.projection, hidden.data(), candidates.data(), candidates.size(), kernel);
+        EXPECT_EQ(pick.token, full.token) << frame_hash::KernelName(kernel);
+        EXPECT_EQ(pick.score, full.score) << frame_hash::KernelName(kernel);
+    }
+}
+
+// --- Lexical Shortlist ---
+
+TEST(LexicalShortlist, ReadsTheLexicalTable) {
+    std::istringstream table("der the 0.5\nNULL the 0.1\ndie the 0.3\n\nhaus house 0.9\nunbekannt the 0.2\nbad\n");
+    auto piece_id = [](std::initializer_list<std::string_view> pieces) {
+        std::vector<std::string_view> known(pieces);
+        return [known](std::string_view piece) -> std::optional<int32_t> {
+            auto it = std::find(known.begin(), known.end(), piece);
+            if (it == known.end()) return std::nullopt;
+            return static_cast<int32_t>(it - known.begin());
+        };
+    };
+    auto entries = ReadLexicalTable(table, piece_id({ "the", "house" }), piece_id({ "der", "die", "haus" }));
+    ASSERT_EQ(entries.size(), 3u);
+    EXPECT_EQ(entries[0].source, 0);
+    EXPECT_EQ(entries[0].target, 0);
+    EXPECT_FLOAT_EQ(entries[0].probability, 0.5f);
+    EXPECT_EQ(entries[2].source, 1);
+    EXPECT_EQ(entries[2].target, 2);
+}
+
+TEST(LexicalShortlist, CandidatesAreSortedUniqueAndKeepTheForcedTokens) {
+    std::mt19937 rng(23);
+    constexpr size_t VOCAB = 1000, FIRST = 50, BEST = 8;
+    const std::vector<int32_t> always = { 2, 999, 600, 600 };
+    std::vector<LexicalEntry> entries;
+    for (int i = 0; i < 3000; ++i) {
+        entries.push_back({ static_cast<int32_t>(rng() % 80), static_cast<int32_t>(rng() % (VOCAB + 20)),
+            static_cast<float>(rng() % 1000) / 1000.0f });
+    }
+    LexicalShortlist shortlist(entries, FIRST, BEST, VOCAB, always);
+    ASSERT_FALSE(shortlist.empty());
+
+    std::vector<int32_t> candidates;
+    for (int iteration = 0; iteration < 50; ++iteration) {
+        std::vector<int32_t> source_ids;
+        for (size_t n = rng() % 30; n > 0; --n) source_ids.push_back(static_cast<int32_t>(rng() % 100)); // some without entries
+        source_ids.push_back(-1);
+        shortlist.Candidates(source_ids, candidates);
+
+        ASSERT_TRUE(std::is_sorted(candidates.begin(), candidates.end()));
+        ASSERT_EQ(std::adjacent_find(candidates.begin(), candidates.end()), candidates.end());
+        ASSERT_GE(candidates.size(), FIRST);
+        for (size_t i = 0; i < FIRST; ++i) ASSERT_EQ(candidates[i], static_cast<int32_t>(i));
+        for (int32_t token : always) ASSERT_TRUE(std::binary_search(candidates.begin(), candidates.end(), token)) << token;
+        ASSERT_LT(static_cast<size_t>(candidates.back()), VOCAB);
+
+        // Each source token adds its BEST likeliest translations.
+        std::set<int32_t> sources(source_ids.begin(), source_ids.end());
+        for (int32_t source : sources) {
+            std::vector<LexicalEntry> own;
+            for (const auto& entry : entries) {
+                if (entry.source == source && static_cast<size_t>(entry.target) < VOCAB) own.push_back(entry);
+            }
+            std::stable_sort(own.begin(), own.end(), [](const LexicalEntry& a, const LexicalEntry& b) { return a.probability > b.probability; });
+            // Ties at the cut-off can go either way; everything strictly above it must be in.
+            for (size_t k = 0; k < own.size() && k < BEST; ++k) {
+                if (own.size() > BEST && own[k].probability == own[BEST].probability) continue;
+                ASSERT_TRUE(std::binary_search(candidates.begin(), candidates.end(), own[k].target)) << "source " << source;
+            }
+        }
+    }
+
+    shortlist.Candidates({}, candidates);
+    EXPECT_EQ(candidates.size(), FIRST + 2); // 2 is among the first ids already
+}